@@ -309,9 +309,13 @@ def get_var_attrs(cli, var_token, partial_word):
             var_type = 'name'
             var_desc = 'module command to run (see "show mclass")'
 
+        elif var_token == 'PORT_CMD':
+            var_type = 'name'
+            var_desc = 'port command to run (see "show driver")'
+
         elif var_token == 'ARG_TYPE':
             var_type = 'name'
-            var_desc = 'type of argument (see "show mclass")'
+            var_desc = 'type of argument (see "show mclass" or "show driver")'
 
         elif var_token == '[NEW_PORT]':
             var_type = 'name'
@@ -320,7 +324,7 @@ def get_var_attrs(cli, var_token, partial_word):
         elif var_token == '[SCHEDULER]':
             var_type = 'name'
             var_desc = 'specify the type of scheduler (none for default)'
-            var_candidates = ['', 'experimental']
+            var_candidates = ['', 'experimental', 'work_stealing']
 
         elif var_token == 'PORT':
             var_type = 'name'
@@ -1038,6 +1042,16 @@ def command_gatehook(cli, name, module, direction, gate, cmd, arg_type, args):
         cli.bess.resume_all()
 
 
+@cmd('command port PORT PORT_CMD ARG_TYPE [CMD_ARGS...]',
+     'Send a command to a port')
+def command_port(cli, port, cmd, arg_type, args):
+    if args is None:
+        args = {}
+
+    ret = cli.bess.run_port_command(port, cmd, arg_type, args)
+    cli.fout.write('response: %s\n' % repr(ret))
+
+
 # Please do not rely on this API. This API may be replaced with `command port PORT`
 # in the same way with gatehook and module
 @cmd('configure port PORT [PORT_ARGS...]', '[Experimental] Update a port configuration')
@@ -1084,21 +1098,23 @@ def delete_connection(cli, module, ogate):
 
 
 def _show_worker_header(cli):
-    cli.fout.write('  %10s%10s%10s%10s%16s\n' % (
+    cli.fout.write('  %10s%10s%10s%10s%16s%20s\n' % (
         'Worker ID',
         'Status',
         'CPU core',
         '# of TCs',
-        'Deadend pkts'))
+        'Deadend pkts',
+        'Idle cycles'))
 
 
 def _show_worker(cli, w):
-    cli.fout.write('  %10d%10s%10d%10d%16d\n' % (
+    cli.fout.write('  %10d%10s%10d%10d%16d%20d\n' % (
         w.wid,
         'RUNNING' if w.running else 'PAUSED',
         w.core,
         w.num_tcs,
-        w.silent_drops))
+        w.silent_drops,
+        w.idle_cycles))
 
 
 @cmd('show worker', 'Show the status of all worker threads')
@@ -1477,6 +1493,17 @@ def _show_port(cli, port):
     cli.fout.write('bytes: {:<20,}\n'.format(stats.out.bytes))
     cli.fout.write('{:<14} dropped: {:<20,}\n'.format('', stats.out.dropped))
 
+    # Per-queue breakdown, only interesting with multiple queues
+    for direction, queues in (('RX', stats.inc_queues),
+                              ('TX', stats.out_queues)):
+        if len(queues) <= 1:
+            continue
+        for qid, q in enumerate(queues):
+            cli.fout.write('{:>13}  '.format('%s q%d' % (direction, qid)))
+            cli.fout.write('packets: {:<20,}'.format(q.packets))
+            cli.fout.write('bytes: {:<20,}'.format(q.bytes))
+            cli.fout.write('dropped: {:<,}\n'.format(q.dropped))
+
 
 @cmd('show port', 'Show the status of all ports')
 def show_port_all(cli):
@@ -1690,7 +1717,11 @@ def _show_driver(cli, drv_name, detail):
 
     if detail:
         if info.commands:
-            cli.fout.write(COMMANDS_FORMAT % (', '.join(info.commands)))
+            cli.fout.write(COMMANDS_FORMAT %
+                           (', '.join(map(lambda cmd, msg: "%s(%s)"
+                                          % (cmd, msg),
+                                          info.commands,
+                                          info.cmd_args))))
         else:
             cli.fout.write(NO_COMMANDS_FORMAT)
 
@@ -1772,6 +1803,35 @@ def _monitor_ports(cli, *ports):
             out_bytes=(new.out.bytes - old.out.bytes) / sec_diff)
         return delta
 
+    # Per-queue rates of a port, as (qid, PortRate). Empty with one queue.
+    def get_queue_deltas(old, new):
+        sec_diff = new.timestamp - old.timestamp
+        num_queues = max(len(new.inc_queues), len(new.out_queues))
+        if num_queues <= 1:
+            return []
+
+        def rate(old_queues, new_queues, qid, field):
+            if qid >= len(new_queues) or qid >= len(old_queues):
+                return 0.
+            return (getattr(new_queues[qid], field) -
+                    getattr(old_queues[qid], field)) / sec_diff
+
+        deltas = []
+        for qid in range(num_queues):
+            deltas.append((qid, PortRate(
+                inc_packets=rate(old.inc_queues, new.inc_queues, qid,
+                                 'packets'),
+                inc_dropped=rate(old.inc_queues, new.inc_queues, qid,
+                                 'dropped'),
+                inc_bytes=rate(old.inc_queues, new.inc_queues, qid, 'bytes'),
+                out_packets=rate(old.out_queues, new.out_queues, qid,
+                                 'packets'),
+                out_dropped=rate(old.out_queues, new.out_queues, qid,
+                                 'dropped'),
+                out_bytes=rate(old.out_queues, new.out_queues, qid,
+                               'bytes'))))
+        return deltas
+
     def print_header(timestamp):
         cli.fout.write('\n')
         cli.fout.write('{:<20}{:>14}{:>10}{:>10}        {:>14}{:>10}{:>10}\n'.format(
@@ -1826,6 +1886,9 @@ def _monitor_ports(cli, *ports):
             for port in ports:
                 print_delta(now[port].timestamp, '{}{}'.format(port, drivers[port]),
                             get_delta(last[port], now[port]), csv_f)
+                for qid, delta in get_queue_deltas(last[port], now[port]):
+                    print_delta(now[port].timestamp,
+                                '  {}:q{}'.format(port, qid), delta, csv_f)
 
             print_footer()
 
@@ -1979,6 +2042,80 @@ def monitor_tc_all(cli, tcs):
     _monitor_tcs(cli, *tcs)
 
 
+def _monitor_profile(cli, *modules):
+    GUTTER_WIDTH = 5
+    FIELDS = ('CPU MHz', 'share %', 'Mpps', 'cycles/p', 'cycles/batch')
+
+    def get_profiles():
+        resp = cli.bess.get_module_profile(list(modules))
+        return resp.timestamp, {m.name: m for m in resp.modules}
+
+    def print_loop(last_ts, last):
+        while True:
+            time.sleep(1)
+
+            now_ts, now = get_profiles()
+            sec_diff = now_ts - last_ts
+
+            rows = []
+            for name, m in now.items():
+                old = last.get(name)
+                cycles = m.cycles - (old.cycles if old else 0)
+                batches = m.batches - (old.batches if old else 0)
+                packets = m.packets - (old.packets if old else 0)
+                rows.append((name, cycles, batches, packets))
+
+            # Hottest modules first
+            rows.sort(key=lambda row: row[1], reverse=True)
+            total_cycles = sum(row[1] for row in rows)
+            name_len = max([len(row[0]) for row in rows] + [10]) + GUTTER_WIDTH
+
+            cli.fout.write('\n')
+            fmt = '{:<%d}{:>12}{:>12}{:>12}{:>12}{:>14}\n' % (name_len,)
+            cli.fout.write(fmt.format(time.strftime('%X'), *FIELDS))
+            cli.fout.write('{}\n'.format('-' * (62 + name_len)))
+
+            fmt = '{:<%d}{:>12.3f}{:>12.1f}{:>12.3f}{:>12.1f}{:>14.1f}\n' % \
+                (name_len,)
+            for name, cycles, batches, packets in rows:
+                if batches == 0:
+                    continue
+                cli.fout.write(fmt.format(
+                    name,
+                    cycles / sec_diff / 1e6,
+                    100.0 * cycles / total_cycles if total_cycles else 0.,
+                    packets / sec_diff / 1e6,
+                    cycles / packets if packets else 0.,
+                    cycles / batches))
+
+            cli.fout.write('{}\n'.format('-' * (62 + name_len)))
+
+            last_ts, last = now_ts, now
+
+    last_ts, last = get_profiles()
+    if not last:
+        raise cli.CommandError('No module to monitor')
+
+    cli.fout.write('Monitoring per-module CPU usage: {}\n'.format(
+        ', '.join(sorted(last.keys()))))
+
+    try:
+        print_loop(last_ts, last)
+    except KeyboardInterrupt:
+        pass
+
+
+@cmd('monitor profile', 'Monitor the CPU cycles spent in all modules')
+def monitor_profile_all(cli):
+    _monitor_profile(cli)
+
+
+@cmd('monitor profile MODULE...',
+     'Monitor the CPU cycles spent in specified modules')
+def monitor_profile_list(cli, modules):
+    _monitor_profile(cli, *modules)
+
+
 def _capture_gate(cli, module_name, direction, gate, opts, program, hook_fn):
     if gate is None:
         gate = 0
@@ -2111,7 +2248,11 @@ def show_system_packets(cli, socket):
         socket = -1
     resp = cli.bess.dump_mempool(socket)
     for dump in resp.dumps:
-        cli.fout.write('Socket {}\n'.format(dump.socket))
+        if dump.wid >= 0:
+            cli.fout.write('Worker {} (socket {})\n'.format(dump.wid,
+                                                             dump.socket))
+        else:
+            cli.fout.write('Socket {}\n'.format(dump.socket))
         cli.fout.write('\tinitialized: {}\n'.format(dump.initialized))
         if not dump.initialized:
             continue
@@ -2126,6 +2267,8 @@ def show_system_packets(cli, socket):
         cli.fout.write('\tring_count: {}\n'.format(dump.ring_count))
         cli.fout.write('\tring_free_count: {}\n'.format(dump.ring_free_count))
         cli.fout.write('\tring_bytes: {}\n'.format(dump.ring_bytes))
+        cli.fout.write('\thigh_watermark: {}\n'.format(dump.high_watermark))
+        cli.fout.write('\talloc_failures: {}\n'.format(dump.alloc_failures))
 
 
 @cmd('http [HOST] [PORT_NUMBER]', 'Run an HTTP server')
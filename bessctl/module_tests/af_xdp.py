@@ -0,0 +1,134 @@
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import errno
+import os
+import socket
+import subprocess
+import time
+
+from test_utils import *
+
+VETH_BESS = 'bess_xdp0'
+VETH_PEER = 'bess_xdp1'
+
+
+# AF_XDP needs root, a kernel with XDP sockets, and a veth pair to attach to.
+# Tests are skipped if any of these is missing.
+class BessAFXDPPortTest(BessModuleTestCase):
+
+    def setUp(self):
+        BessModuleTestCase.setUp(self)
+
+        if os.geteuid() != 0:
+            self.skipTest('veth interfaces need root')
+
+        with open(os.devnull, 'w') as devnull:
+            ret = subprocess.call(['ip', 'link', 'add', VETH_BESS, 'type',
+                                   'veth', 'peer', 'name', VETH_PEER],
+                                  stdout=devnull, stderr=devnull)
+        if ret != 0:
+            self.skipTest('cannot create a veth pair')
+        self.addCleanup(subprocess.call, ['ip', 'link', 'del', VETH_BESS])
+
+        for dev in (VETH_BESS, VETH_PEER):
+            subprocess.check_call(['ip', 'link', 'set', dev, 'up'])
+
+    def create_port(self, **arg):
+        arg.setdefault('ifname', VETH_BESS)
+        arg.setdefault('mode', 'skb')
+        return self.bess.create_port('AFXDPPort', 'xdp0', arg)
+
+    def create_valid_port(self):
+        try:
+            return self.create_port()
+        except self.bess.Error as e:
+            if e.code in (errno.ENOTSUP, errno.EPERM, errno.EAFNOSUPPORT):
+                self.skipTest('AF_XDP is unavailable: %s' % e)
+            raise
+
+    def test_invalid_args(self):
+        self.create_valid_port()
+        self.bess.destroy_port('xdp0')
+
+        invalid = [
+            {'ifname': 'bess_no_such_if'},
+            {'mode': 'hw'},
+            {'copy': True, 'zero_copy': True},
+            {'size_inc_q': 1000},
+            {'start_queue': 1},  # a veth has a single queue by default
+            {'num_out_q': 2},
+        ]
+        for arg in invalid:
+            with self.assertRaises(self.bess.Error):
+                self.create_port(**arg)
+
+        # Failed attempts must leave the interface free for a new port.
+        self.create_port()
+
+    def test_rx_tx(self):
+        port = self.create_valid_port()
+
+        sock = socket.socket(socket.AF_PACKET, socket.SOCK_RAW,
+                             socket.htons(0x0003))  # ETH_P_ALL
+        sock.bind((VETH_PEER, 0))
+        sock.settimeout(1)
+
+        pkt = get_udp_packet(sip='10.0.0.1', dip='10.0.0.2')
+        src = Source()
+        src -> Rewrite(templates=[bytes(pkt)]) -> PortOut(port=port.name)
+        PortInc(port=port.name) -> Sink()
+
+        self.bess.resume_all()
+        for _ in range(10):
+            sock.send(bytes(pkt))
+
+        # Skip our own packets, and whatever the kernel sends on the link.
+        received = None
+        deadline = time.time() + 2
+        while received is None and time.time() < deadline:
+            data, addr = sock.recvfrom(2048)
+            if addr[2] != socket.PACKET_OUTGOING and data == bytes(pkt):
+                received = data
+
+        time.sleep(0.5)
+        self.bess.pause_all()
+        sock.close()
+
+        self.assertIsNotNone(received)
+
+        stats = self.bess.get_port_stats(port.name)
+        self.assertGreater(stats.inc.packets, 0)
+        self.assertGreater(stats.out.packets, 0)
+
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessAFXDPPortTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
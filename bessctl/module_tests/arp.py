@@ -61,6 +61,29 @@ class BessArpTest(BessModuleTestCase):
         self.assertEqual(len(pkt_outs[0]), 1)
         self.assertSamePackets(pkt_outs[0][0], arp_reply)
 
+    def test_ndp(self):
+        arp = ArpResponder()
+        arp.add(ip='2001:db8::1', mac_addr=TEST_MAC_ADDRESS)
+
+        ns = scapy.Ether(src='02:1e:67:9f:4d:ae', dst='33:33:ff:00:00:01') / \
+            scapy.IPv6(src='fe80::1', dst='ff02::1:ff00:1', hlim=255) / \
+            scapy.ICMPv6ND_NS(tgt='2001:db8::1') / \
+            scapy.ICMPv6NDOptSrcLLAddr(lladdr='02:1e:67:9f:4d:ae')
+
+        na = scapy.Ether(src=TEST_MAC_ADDRESS, dst='02:1e:67:9f:4d:ae') / \
+            scapy.IPv6(src='2001:db8::1', dst='fe80::1', hlim=255) / \
+            scapy.ICMPv6ND_NA(tgt='2001:db8::1', R=0, S=1, O=1) / \
+            scapy.ICMPv6NDOptDstLLAddr(lladdr=TEST_MAC_ADDRESS)
+
+        pkt_outs = self.run_module(arp, 0, [ns], [0])
+        self.assertEqual(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], na)
+
+        # Solicitations for unknown addresses are dropped
+        ns[scapy.ICMPv6ND_NS].tgt = '2001:db8::2'
+        pkt_outs = self.run_module(arp, 0, [ns], [0])
+        self.assertEqual(len(pkt_outs[0]), 0)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessArpTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
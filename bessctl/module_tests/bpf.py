@@ -29,6 +29,8 @@
 # ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
+import struct
+
 from test_utils import *
 
 filters = [
@@ -101,6 +103,85 @@ class BessBpfTest(BessModuleTestCase):
         self.assertEqual(len(pkt_outs[2]), 1)
         self.assertSamePackets(pkt_outs[2][0], pkt1)
 
+    # Same as above, with the filters merged into one program
+    def test_bpf_merged_rules(self):
+        bpf = BPF(merged=True)
+        bpf.add(filters=[{"priority": 2, "filter": filters[0], "gate": 1}])
+        bpf.add(filters=[{"priority": 1, "filter": filters[4], "gate": 2}])
+        bpf.add(filters=[{"priority": 0, "filter": filters[3], "gate": 3}])
+
+        pkt1 = get_udp_packet(sip='22.22.22.22', dip='12.34.56.78',
+                              sport=700)
+
+        pkt2 = get_tcp_packet(sip='22.22.22.22', dip='12.34.56.78',
+                              sport=92)
+
+        pkt3 = get_tcp_packet(sip='12.34.56.78', dip='12.34.56.78',
+                              sport=700)
+
+        pkt_outs = self.run_module(bpf, 0, [pkt3], [0])
+        self.assertEqual(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt3)
+
+        pkt_outs = self.run_module(bpf, 0, [pkt2], [1])
+        self.assertEqual(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt2)
+
+        pkt_outs = self.run_module(bpf, 0, [pkt1], [2])
+        self.assertEqual(len(pkt_outs[2]), 1)
+        self.assertSamePackets(pkt_outs[2][0], pkt1)
+
+        # A bad filter fails the whole add, and changes nothing
+        with self.assertRaises(bess.Error):
+            bpf.add(filters=[{"priority": 3, "filter": filters[1], "gate": 4},
+                             {"priority": 4, "filter": "no such", "gate": 5}])
+        self.assertEqual(len(bpf.get_initial_arg().filters), 3)
+        pkt_outs = self.run_module(bpf, 0, [pkt1], [2])
+        self.assertEqual(len(pkt_outs[2]), 1)
+
+    # An eBPF program that counts packets in a map and sends UDP to gate 1
+    def test_bpf_ebpf(self):
+        def insn(code, dst=0, src=0, off=0, imm=0):
+            return struct.pack('<BBhi', code, (src << 4) | dst, off, imm)
+
+        code = b''.join([
+            insn(0xbf, dst=6, src=1),             # r6 = r1 (ctx)
+            insn(0x62, dst=10, off=-4, imm=0),    # *(u32 *)(r10 - 4) = 0
+            insn(0x18, dst=1, src=1, imm=0),      # r1 = map 0
+            insn(0x00),
+            insn(0xbf, dst=2, src=10),            # r2 = r10 - 4
+            insn(0x07, dst=2, imm=-4),
+            insn(0x85, imm=1),                    # r0 = map_lookup_elem()
+            insn(0x15, dst=0, off=2, imm=0),      # if r0 == 0 goto +2
+            insn(0xb7, dst=1, imm=1),             # *(u64 *)r0 += 1
+            insn(0xdb, dst=0, src=1, imm=0),
+            insn(0x79, dst=2, src=6, off=0),      # r2 = ctx->data
+            insn(0xb7, dst=0, imm=0),             # r0 = 0
+            insn(0x71, dst=3, src=2, off=23),     # r3 = ip->protocol
+            insn(0x55, dst=3, off=1, imm=17),     # if r3 != 17 goto +1
+            insn(0xb7, dst=0, imm=1),             # r0 = 1
+            insn(0x95),                           # exit
+        ])
+
+        bpf = BPF(ebpf={'code': code,
+                        'maps': [{'name': 'pkts', 'key_size': 4,
+                                  'value_size': 8, 'max_entries': 1}]})
+
+        pkt1 = get_udp_packet(sip='22.22.22.22', dip='12.34.56.78')
+        pkt2 = get_tcp_packet(sip='22.22.22.22', dip='12.34.56.78')
+
+        pkt_outs = self.run_module(bpf, 0, [pkt1], [1])
+        self.assertEqual(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt1)
+
+        pkt_outs = self.run_module(bpf, 0, [pkt2], [0])
+        self.assertEqual(len(pkt_outs[0]), 1)
+        self.assertSamePackets(pkt_outs[0][0], pkt2)
+
+        entries = bpf.get_map(name='pkts').entries
+        self.assertEqual(sum(struct.unpack('<Q', e.value)[0]
+                             for e in entries), 2)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessBpfTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
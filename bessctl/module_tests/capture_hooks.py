@@ -0,0 +1,79 @@
+# SPDX-License-Identifier: BSD-3-Clause
+#
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice, this
+# list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+# this list of conditions and the following disclaimer in the documentation
+# and/or other materials provided with the distribution.
+#
+# * Neither the names of the copyright holders nor the names of their
+# contributors may be used to endorse or promote products derived from this
+# software without specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+# LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+# INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+# CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+# ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+# POSSIBILITY OF SUCH DAMAGE.
+
+import os
+import shutil
+import tempfile
+import time
+
+from test_utils import *
+
+
+class BessCaptureHookTest(BessModuleTestCase):
+
+    def _test_worker_added_later(self, configure):
+        tmpdir = tempfile.mkdtemp()
+        fifo = os.path.join(tmpdir, 'capture')
+        os.mkfifo(fifo)
+        # The hook opens the FIFO without blocking, so it needs a reader.
+        reader = os.open(fifo, os.O_RDONLY | os.O_NONBLOCK)
+
+        try:
+            src = Source()
+            src -> Sink()
+
+            # No worker runs the gate yet, so async mode sets up no rings.
+            configure(True, 'capture', src.name, fifo=fifo, async_mode=True)
+
+            self.bess.add_worker(wid=1, core=0)
+            src.attach_task(wid=1)
+            self.bess.resume_all()
+            time.sleep(0.5)
+            self.bess.pause_all()
+
+            stats = self.bess.run_gatehook_command(
+                'capture', src.name, 'out', 0, 'get_stats', 'EmptyArg', {})
+            self.assertGreater(stats.packets, 0)
+
+            configure(False, 'capture', src.name)
+        finally:
+            os.close(reader)
+            shutil.rmtree(tmpdir)
+
+    def test_tcpdump_worker_added_later(self):
+        self._test_worker_added_later(self.bess.tcpdump_gate)
+
+    def test_pcapng_worker_added_later(self):
+        self._test_worker_added_later(self.bess.pcapng_gate)
+
+
+suite = unittest.TestLoader().loadTestsFromTestCase(BessCaptureHookTest)
+results = unittest.TextTestRunner(verbosity=2).run(suite)
+
+if results.failures or results.errors:
+    sys.exit(1)
@@ -124,6 +124,54 @@ class BessExactMatchTest(BessModuleTestCase):
             self.assertEqual(len(pkt_outs[i]), 1)
             self.assertSamePackets(pkt_outs[i][0], test_packet_in)
 
+    def test_exactmatch_flow_mark(self):
+        # Rules with a mark are taken for packets carrying that mark, even
+        # if the packet itself would not match (software-emulated NIC mark).
+        em = ExactMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                        flow_marks=16)
+        em.add(fields=[{'value_bin': socket.inet_aton('65.43.21.0')}],
+               gate=1, mark=5)
+        em.add(fields=[{'value_bin': socket.inet_aton('0.12.34.56')}],
+               gate=2)
+        em.set_default_gate(gate=0)
+
+        pkt_nomatch = get_tcp_packet(sip='0.12.33.56', dip='12.34.56.78')
+        pkt2 = get_tcp_packet(sip='0.12.34.56', dip='12.34.56.78')
+
+        marked = SetMetadata(
+            attrs=[{'name': 'flow_mark', 'size': 4, 'value_int': 5}])
+        unmarked = SetMetadata(
+            attrs=[{'name': 'flow_mark', 'size': 4, 'value_int': 0}])
+        merger = Merge()
+        marked -> merger
+        unmarked -> merger
+        merger -> em
+
+        pkt_outs = self.run_pipeline(marked, em, 0, [pkt_nomatch], range(3))
+        self.assertEqual(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt_nomatch)
+
+        pkt_outs = self.run_pipeline(unmarked, em, 0, [pkt2, pkt_nomatch],
+                                     range(3))
+        self.assertEqual(len(pkt_outs[2]), 1)
+        self.assertEqual(len(pkt_outs[0]), 1)
+
+        # Deleting the rule also retires its mark.
+        em.delete(fields=[{'value_bin': socket.inet_aton('65.43.21.0')}])
+        pkt_outs = self.run_pipeline(marked, em, 0, [pkt_nomatch], range(3))
+        self.assertEqual(len(pkt_outs[0]), 1)
+
+        # Marks can be added and retired over and over.
+        for i in range(100):
+            em.add(fields=[{'value_bin': socket.inet_aton('65.43.21.0')}],
+                   gate=1, mark=5 + i % 2)
+        pkt_outs = self.run_pipeline(marked, em, 0, [pkt_nomatch], range(3))
+        self.assertEqual(len(pkt_outs[0]), 1)
+
+        with self.assertRaises(bess.Error):
+            ExactMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                       flow_marks=(1 << 20) + 1)
+
     def test_exactmatch_selfconfig(self):
         "make sure get_initial_arg and [gs]et_runtime_config work"
         iconf = {
@@ -50,6 +50,34 @@ class BessL2ForwardTest(BessModuleTestCase):
         with self.assertRaises(bess.Error):
             l2fib.delete(addrs=['00:01:02:03:04:05'])
 
+    def test_l2forward_learn(self):
+        l2fib = L2Forward(learn=True, learn_rate=100)
+        l2fib.set_default_gate(gate=0)
+        l2fib.add(entries=[{'addr': '00:01:02:03:04:05', 'gate': 3}])
+
+        def packet(src, dst):
+            return scapy.Ether(src=src, dst=dst) / scapy.IP() / \
+                scapy.UDP() / ('x' * 18)
+
+        pkt1 = packet('02:00:00:00:00:01', '02:00:00:00:00:02')
+        pkt2 = packet('02:00:00:00:00:02', '02:00:00:00:00:01')
+        pkt3 = packet('00:01:02:03:04:05', '02:00:00:00:00:01')
+
+        # Unknown destination, but its source is learned
+        pkt_outs = self.run_module(l2fib, 1, [pkt1], [0])
+        self.assertEqual(len(pkt_outs[0]), 1)
+        ret = l2fib.lookup(addrs=['02:00:00:00:00:01'])
+        self.assertEqual(ret.gates, [1])
+
+        pkt_outs = self.run_module(l2fib, 2, [pkt2], [1])
+        self.assertEqual(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt2)
+
+        # Static entries are not overwritten
+        self.run_module(l2fib, 2, [pkt3], [1])
+        ret = l2fib.lookup(addrs=['00:01:02:03:04:05', '02:00:00:00:00:02'])
+        self.assertEqual(ret.gates, [3, 2])
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessL2ForwardTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
@@ -87,6 +87,61 @@ class BessTimestampTest(BessModuleTestCase):
         diff = abs(a - b) / float(b) * 100.0
         self.assertLessEqual(diff, 1.0)
 
+    def test_source_template_measured(self):
+        # Source stamps the timestamp itself, right past the UDP header
+        udp = get_udp_packet(sip='172.12.0.3', dip='127.12.0.4')
+        src = Source(template=bytes(udp),
+                     fields=[{'offset': 30, 'size': 4, 'count': 100}],
+                     imix=[{'size': 60, 'weight': 7},
+                           {'size': 590, 'weight': 4},
+                           {'size': 1514, 'weight': 1}],
+                     seq_offset=54,
+                     timestamp_offset=42)
+        mmod = Measure(offset=42)
+        src -> mmod -> Sink()
+        self.bess.resume_all()
+        time.sleep(1)
+        self.bess.pause_all()
+        self.assertBessAlive()
+        stats = self.bess.run_module_command(mmod.name, 'get_summary',
+                                             'MeasureCommandGetSummaryArg',
+                                             {})
+        self.assertGreater(stats.latency.count, 0)
+
+        # Sizes must fit the template headers and the stamps
+        with self.assertRaises(bess.Error):
+            Source(template=bytes(udp), imix=[{'size': 50, 'weight': 1}],
+                   timestamp_offset=42)
+
+        with self.assertRaises(bess.Error):
+            Source(template=bytes(udp),
+                   fields=[{'offset': 30, 'size': 3}])
+
+    def test_measured_hdr(self):
+        udp = get_udp_packet(sip='172.12.0.3', dip='127.12.0.4')
+        # No port here, so hw_timestamp falls back to software timestamps
+        mmod = Measure(latency_ns_resolution=10, latency_significant_digits=3,
+                       hw_timestamp=True)
+        Source() -> Rewrite(templates=[bytes(udp)]) -> \
+            Timestamp(hw_timestamp=True) -> \
+            Bypass(cycles_per_batch=100) -> mmod -> Sink()
+        self.bess.resume_all()
+        time.sleep(1)
+        self.bess.pause_all()
+        self.assertBessAlive()
+        pct = [50, 99, 99.9, 100]
+        stats = self.bess.run_module_command(mmod.name, 'get_summary',
+                                             'MeasureCommandGetSummaryArg',
+                                             {'latency_percentiles': pct})
+        self.assertGreater(stats.latency.count, 0)
+        self.assertEqual(stats.hw_timestamped, 0)
+        values = list(stats.latency.percentile_values_ns)
+        self.assertEqual(values, sorted(values))
+        self.assertLessEqual(values[-1], stats.latency.max_ns)
+
+        with self.assertRaises(bess.Error):
+            Measure(latency_significant_digits=6)
+
 
 suite = unittest.TestLoader().loadTestsFromTestCase(BessTimestampTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
@@ -176,6 +176,43 @@ class BessWildcardMatchTest(BessModuleTestCase):
         #    '\nmut state:', cur_config, 'expecting:', expect_config)
     #    assert arg == iconf and cur_config == expect_config
 
+    def test_wildcardmatch_flow_mark(self):
+        # A marked packet takes its rule regardless of priority or content.
+        wm = WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                           flow_marks=16)
+        ip_mask = vstring([0xff, 0xff, 0xff, 0xff])
+        wm.add(gate=1, priority=0, masks=ip_mask,
+               values=[{'value_bin': socket.inet_aton('65.43.21.0')}], mark=3)
+        wm.add(gate=2, priority=1, masks=vstring([0, 0, 0, 0]),
+               values=vstring([0, 0, 0, 0]))
+        wm.set_default_gate(gate=0)
+
+        pkt = get_tcp_packet(sip='0.12.33.56', dip='12.34.56.78')
+
+        marked = SetMetadata(
+            attrs=[{'name': 'flow_mark', 'size': 4, 'value_int': 3}])
+        unmarked = SetMetadata(
+            attrs=[{'name': 'flow_mark', 'size': 4, 'value_int': 0}])
+        merger = Merge()
+        marked -> merger
+        unmarked -> merger
+        merger -> wm
+
+        pkt_outs = self.run_pipeline(marked, wm, 0, [pkt], range(3))
+        self.assertEqual(len(pkt_outs[1]), 1)
+        self.assertSamePackets(pkt_outs[1][0], pkt)
+
+        pkt_outs = self.run_pipeline(unmarked, wm, 0, [pkt], range(3))
+        self.assertEqual(len(pkt_outs[2]), 1)
+
+        wm.clear()
+        pkt_outs = self.run_pipeline(marked, wm, 0, [pkt], range(3))
+        self.assertEqual(len(pkt_outs[0]), 1)
+
+        with self.assertRaises(bess.Error):
+            WildcardMatch(fields=[{'offset': 26, 'num_bytes': 4}],
+                          flow_marks=(1 << 20) + 1)
+
 suite = unittest.TestLoader().loadTestsFromTestCase(BessWildcardMatchTest)
 results = unittest.TextTestRunner(verbosity=2).run(suite)
 
@@ -79,7 +79,10 @@ def measure_tc_perf(bess, duration):
     sec_diff = new.timestamp - old.timestamp
     pps = (new.packets - old.packets) / sec_diff
     cps = (new.count - old.count) / sec_diff
-    sys.stdout.write("pps: %12.f\tcounts/s: %12.f\n" % (pps, cps))
+    packets = new.packets - old.packets
+    cpp = (new.cycles - old.cycles) / packets if packets else 0.
+    sys.stdout.write("pps: %12.f\tcounts/s: %12.f\tcycles/pkt: %8.1f\n" %
+                     (pps, cps, cpp))
 
 
 def run_cmd(cmd):
@@ -221,6 +221,33 @@ static Status disable_hook_for_module(ConfigureGateHookResponse* response,
   return Status::OK;
 }
 
+static void collect_mempool(bess::PacketPool* pool, MempoolDump* dump,
+                            bool reset_stats) {
+  rte_mempool* mempool = pool->pool();
+  dump->set_initialized(mempool != nullptr);
+  if (mempool == nullptr) {
+    return;
+  }
+  struct rte_ring* ring =
+      reinterpret_cast<struct rte_ring*>(mempool->pool_data);
+  dump->set_mp_size(mempool->size);
+  dump->set_mp_cache_size(mempool->cache_size);
+  dump->set_mp_element_size(mempool->elt_size);
+  dump->set_mp_populated_size(mempool->populated_size);
+  dump->set_mp_available_count(rte_mempool_avail_count(mempool));
+  dump->set_mp_in_use_count(rte_mempool_in_use_count(mempool));
+  uint32_t ring_count = rte_ring_count(ring);
+  uint32_t ring_free_count = rte_ring_free_count(ring);
+  dump->set_ring_count(ring_count);
+  dump->set_ring_free_count(ring_free_count);
+  dump->set_ring_bytes(rte_ring_get_memsize(ring_count + ring_free_count));
+  dump->set_high_watermark(pool->high_watermark());
+  dump->set_alloc_failures(pool->alloc_failures());
+  if (reset_stats) {
+    pool->ResetStats();
+  }
+}
+
 static int collect_igates(Module* m, GetModuleInfoResponse* response) {
   for (const auto& g : m->igates()) {
     if (!g) {
@@ -558,6 +585,9 @@ class BESSControlImpl final : public BESSControl::Service {
       status->set_core(workers[wid]->core());
       status->set_num_tcs(workers[wid]->scheduler()->NumTcs());
       status->set_silent_drops(workers[wid]->silent_drops());
+      status->set_idle_cycles(workers[wid]->idle_cycles());
+      status->set_idle_sleep_cycles(workers[wid]->idle_sleep_cycles());
+      status->set_rx_interrupt_wakeups(workers[wid]->rx_interrupt_wakeups());
     }
     return Status::OK;
   }
@@ -579,12 +609,26 @@ class BESSControlImpl final : public BESSControl::Service {
                                wid);
     }
     const std::string& scheduler = request->scheduler();
-    if (scheduler != "" && scheduler != "experimental") {
+    if (scheduler != "" && scheduler != "experimental" &&
+        scheduler != "work_stealing") {
       return return_with_error(response, EINVAL, "Invalid scheduler %s",
                                scheduler.c_str());
     }
 
-    launch_worker(wid, core, scheduler);
+    if (request->max_idle_sleep_us() > UINT32_MAX ||
+        request->idle_poll_rounds() > UINT32_MAX) {
+      return return_with_error(response, EINVAL, "Invalid idle policy");
+    }
+    if (request->rx_interrupt() && request->max_idle_sleep_us() == 0) {
+      return return_with_error(response, EINVAL,
+                               "rx_interrupt requires max_idle_sleep_us");
+    }
+    IdlePolicy idle_policy = {
+        .poll_rounds = static_cast<uint32_t>(request->idle_poll_rounds()),
+        .max_sleep_us = static_cast<uint32_t>(request->max_idle_sleep_us()),
+        .rx_interrupt = request->rx_interrupt()};
+
+    launch_worker(wid, core, scheduler, idle_policy);
     return Status::OK;
   }
 
@@ -952,13 +996,10 @@ class BESSControlImpl final : public BESSControl::Service {
                                request->driver_name().c_str());
     }
 
-#if 0
-                        for (int i = 0; i < MAX_COMMANDS; i++) {
-                          if (!drv->commands[i].cmd)
-                            break;
-                          response->add_commands(drv->commands[i].cmd);
-                        }
-#endif
+    for (const auto& cmd : it->second.cmds()) {
+      response->add_commands(cmd.first);
+      response->add_cmd_args(cmd.second);
+    }
     response->set_name(it->second.class_name());
     response->set_help(it->second.help_text());
 
@@ -1158,6 +1199,19 @@ class BESSControlImpl final : public BESSControl::Service {
     *response->mutable_out()->mutable_diff_hist() = {
         stats.out.diff_hist.begin(), stats.out.diff_hist.end()};
 
+    for (const auto& q : stats.inc_queues) {
+      auto* qs = response->add_inc_queues();
+      qs->set_packets(q.packets);
+      qs->set_dropped(q.dropped);
+      qs->set_bytes(q.bytes);
+    }
+    for (const auto& q : stats.out_queues) {
+      auto* qs = response->add_out_queues();
+      qs->set_packets(q.packets);
+      qs->set_dropped(q.dropped);
+      qs->set_bytes(q.bytes);
+    }
+
     response->set_timestamp(get_epoch_time());
 
     return Status::OK;
@@ -1183,6 +1237,29 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status PortCommand(ServerContext*, const CommandRequest* request,
+                     CommandResponse* response) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+    if (!request->name().length()) {
+      return return_with_error(response, EINVAL,
+                               "Missing port name field 'name'");
+    }
+    const auto& it = PortBuilder::all_ports().find(request->name());
+    if (it == PortBuilder::all_ports().end()) {
+      return return_with_error(response, ENOENT, "No port '%s' found",
+                               request->name().c_str());
+    }
+
+    // DPDK functions may be called, so be prepared
+    current_worker.SetNonWorker();
+
+    ::Port* p = it->second;
+    *response =
+        p->port_builder()->RunCommand(p, request->cmd(), request->arg());
+    return Status::OK;
+  }
+
   Status ResetModules(ServerContext*, const EmptyRequest*,
                       EmptyResponse*) override {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
@@ -1316,6 +1393,66 @@ class BESSControlImpl final : public BESSControl::Service {
     return Status::OK;
   }
 
+  Status GetModuleProfile(ServerContext*,
+                          const GetModuleProfileRequest* request,
+                          GetModuleProfileResponse* response) override {
+    std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+#ifndef BESS_MODULE_PROFILE
+    (void)request;
+    return return_with_error(response, ENOTSUP,
+                             "bessd was built without MODULE_PROFILE=1");
+#else
+    std::vector<Module*> modules;
+    if (request->names_size() == 0) {
+      for (const auto& pair : ModuleGraph::GetAllModules()) {
+        modules.push_back(pair.second);
+      }
+    } else {
+      for (const auto& name : request->names()) {
+        const auto& it = ModuleGraph::GetAllModules().find(name);
+        if (it == ModuleGraph::GetAllModules().end()) {
+          return return_with_error(response, ENOENT, "No module '%s' found",
+                                   name.c_str());
+        }
+        modules.push_back(it->second);
+      }
+    }
+
+    response->set_timestamp(get_epoch_time());
+    for (const Module* m : modules) {
+      GetModuleProfileResponse_ModuleProfile* profile =
+          response->add_modules();
+      profile->set_name(m->name());
+      profile->set_mclass(m->module_builder()->class_name());
+
+      for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+        const Module::Profile& p = m->profile(wid);
+        if (p.batches == 0) {
+          continue;
+        }
+        GetModuleProfileResponse_WorkerProfile* w = profile->add_workers();
+        w->set_wid(wid);
+        w->set_cycles(p.cycles);
+        w->set_batches(p.batches);
+        w->set_packets(p.packets);
+        profile->set_cycles(profile->cycles() + p.cycles);
+        profile->set_batches(profile->batches() + p.batches);
+        profile->set_packets(profile->packets() + p.packets);
+      }
+    }
+
+    if (request->reset()) {
+      WorkerPauser wp;
+      for (Module* m : modules) {
+        m->ResetProfile();
+      }
+    }
+
+    return Status::OK;
+#endif
+  }
+
   Status ConnectModules(ServerContext*, const ConnectModulesRequest* request,
                         EmptyResponse* response) override {
     std::lock_guard<std::recursive_mutex> lock(mutex_);
@@ -1420,26 +1557,23 @@ class BESSControlImpl final : public BESSControl::Service {
         continue;
       }
 
-      rte_mempool* mempool = pool->pool();
       MempoolDump* dump = response->add_dumps();
       dump->set_socket(socket);
-      dump->set_initialized(mempool != nullptr);
-      if (mempool == nullptr) {
+      dump->set_wid(-1);
+      collect_mempool(pool, dump, request->reset_stats());
+    }
+
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      bess::PacketPool* pool = bess::PacketPool::GetWorkerPool(wid);
+      if (!pool || (request->socket() != -1 &&
+                    pool->socket_id() != request->socket())) {
         continue;
       }
-      struct rte_ring* ring =
-          reinterpret_cast<struct rte_ring*>(mempool->pool_data);
-      dump->set_mp_size(mempool->size);
-      dump->set_mp_cache_size(mempool->cache_size);
-      dump->set_mp_element_size(mempool->elt_size);
-      dump->set_mp_populated_size(mempool->populated_size);
-      dump->set_mp_available_count(rte_mempool_avail_count(mempool));
-      dump->set_mp_in_use_count(rte_mempool_in_use_count(mempool));
-      uint32_t ring_count = rte_ring_count(ring);
-      uint32_t ring_free_count = rte_ring_free_count(ring);
-      dump->set_ring_count(ring_count);
-      dump->set_ring_free_count(ring_free_count);
-      dump->set_ring_bytes(rte_ring_get_memsize(ring_count + ring_free_count));
+
+      MempoolDump* dump = response->add_dumps();
+      dump->set_socket(pool->socket_id());
+      dump->set_wid(wid);
+      collect_mempool(pool, dump, request->reset_stats());
     }
     return Status::OK;
   }
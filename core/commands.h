@@ -44,6 +44,7 @@
 // get in the way here.
 
 class Module;
+class Port;
 namespace bess {
 class GateHook;
 };  // namespace bess
@@ -52,9 +53,10 @@ using module_cmd_func_t =
     pb_func_t<CommandResponse, Module, google::protobuf::Any>;
 using gate_hook_cmd_func_t =
     pb_func_t<CommandResponse, bess::GateHook, google::protobuf::Any>;
+using port_cmd_func_t = pb_func_t<CommandResponse, Port, google::protobuf::Any>;
 
-// Describes a single command that can be issued to a module
-// or gate hook (according to cmd_func_t).
+// Describes a single command that can be issued to a module,
+// gate hook or port (according to cmd_func_t).
 template <typename cmd_func_t>
 struct GenericCommand {
   enum ThreadSafety { THREAD_UNSAFE = 0, THREAD_SAFE = 1 };
@@ -76,4 +78,7 @@ using Commands = std::vector<Command>;
 using GateHookCommand = GenericCommand<gate_hook_cmd_func_t>;
 using GateHookCommands = std::vector<GateHookCommand>;
 
+using PortCommand = GenericCommand<port_cmd_func_t>;
+using PortCommands = std::vector<PortCommand>;
+
 #endif  // BESS_COMMANDS_H_
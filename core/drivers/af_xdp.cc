@@ -0,0 +1,479 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "af_xdp.h"
+
+#include <dirent.h>
+#include <linux/if_link.h>
+#include <net/if.h>
+#include <rte_mempool.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <utility>
+
+#include "../utils/copy.h"
+
+namespace {
+
+// Returns the first line of a sysfs attribute of the interface, or "".
+std::string ReadNetAttr(const std::string &ifname, const char *attr) {
+  std::ifstream f("/sys/class/net/" + ifname + "/" + attr);
+  std::string line;
+  std::getline(f, line);
+  return line;
+}
+
+// Returns the number of RX queues of the interface, or 0 if unknown.
+uint32_t CountRxQueues(const std::string &ifname) {
+  DIR *dir = opendir(("/sys/class/net/" + ifname + "/queues").c_str());
+  if (!dir) {
+    return 0;
+  }
+
+  uint32_t n = 0;
+  while (struct dirent *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "rx-", 3) == 0) {
+      n++;
+    }
+  }
+  closedir(dir);
+  return n;
+}
+
+bool IsPowerOfTwo(uint32_t n) {
+  return n && !(n & (n - 1));
+}
+
+// Finds the page-aligned area that covers all the memory of `mp`.  AF_XDP
+// needs the UMEM to be one virtually contiguous area, so this fails if the
+// mempool was populated from several disjoint chunks.
+bool GetMempoolArea(struct rte_mempool *mp, char **base, uint64_t *len) {
+  std::vector<std::pair<char *, size_t>> chunks;
+  struct rte_mempool_memhdr *hdr;
+
+  STAILQ_FOREACH(hdr, &mp->mem_list, next) {
+    chunks.emplace_back(static_cast<char *>(hdr->addr), hdr->len);
+  }
+
+  if (chunks.empty()) {
+    return false;
+  }
+
+  std::sort(chunks.begin(), chunks.end());
+  for (size_t i = 1; i < chunks.size(); i++) {
+    if (chunks[i].first != chunks[i - 1].first + chunks[i - 1].second) {
+      return false;
+    }
+  }
+
+  uintptr_t page = getpagesize();
+  uintptr_t start = reinterpret_cast<uintptr_t>(chunks.front().first);
+  uintptr_t end = reinterpret_cast<uintptr_t>(chunks.back().first) +
+                  chunks.back().second;
+  start &= ~(page - 1);
+  end = (end + page - 1) & ~(page - 1);
+
+  *base = reinterpret_cast<char *>(start);
+  *len = end - start;
+  return true;
+}
+
+}  // namespace
+
+CommandResponse AFXDPPort::Init(const bess::pb::AFXDPPortArg &arg) {
+  ifname_ = arg.ifname();
+  ifindex_ = if_nametoindex(ifname_.c_str());
+  if (ifindex_ == 0) {
+    return CommandFailure(ENODEV, "Interface '%s' not found", ifname_.c_str());
+  }
+
+  uint32_t xdp_flags;
+  if (arg.mode() == "") {
+    xdp_flags = 0;
+  } else if (arg.mode() == "drv") {
+    xdp_flags = XDP_FLAGS_DRV_MODE;
+  } else if (arg.mode() == "skb") {
+    xdp_flags = XDP_FLAGS_SKB_MODE;
+  } else {
+    return CommandFailure(EINVAL, "'mode' must be 'drv', 'skb' or empty");
+  }
+
+  uint16_t bind_flags = XDP_USE_NEED_WAKEUP;
+  if (arg.zero_copy() && arg.copy()) {
+    return CommandFailure(EINVAL, "'zero_copy' and 'copy' are exclusive");
+  } else if (arg.zero_copy()) {
+    bind_flags |= XDP_ZEROCOPY;
+  } else if (arg.copy()) {
+    bind_flags |= XDP_COPY;
+  }
+
+  for (packet_dir_t dir : {PACKET_DIR_INC, PACKET_DIR_OUT}) {
+    if (!IsPowerOfTwo(queue_size[dir])) {
+      return CommandFailure(EINVAL, "Queue sizes must be powers of 2");
+    }
+  }
+
+  uint32_t num_rxq = num_queues[PACKET_DIR_INC];
+  uint32_t num_txq = num_queues[PACKET_DIR_OUT];
+  uint32_t nq = std::max(num_rxq, num_txq);
+
+  start_queue_ = arg.start_queue();
+  uint32_t dev_queues = CountRxQueues(ifname_);
+  if (dev_queues && uint64_t{start_queue_} + nq > dev_queues) {
+    return CommandFailure(EINVAL, "Queues %u-%u are out of range, %s has %u",
+                          start_queue_, start_queue_ + nq - 1, ifname_.c_str(),
+                          dev_queues);
+  }
+
+  busy_poll_ = arg.busy_poll_usecs() > 0;
+
+  int node = 0;
+  std::string numa_node = ReadNetAttr(ifname_, "device/numa_node");
+  if (!numa_node.empty()) {
+    node = std::max(0, atoi(numa_node.c_str()));
+  }
+  pool_ = (node < RTE_MAX_NUMA_NODES) ? bess::PacketPool::GetDefaultPool(node)
+                                      : nullptr;
+  if (!pool_) {
+    node = 0;
+    pool_ = bess::PacketPool::GetDefaultPool(node);
+  }
+  node_placement_ = 1ull << node;
+
+  if (!GetMempoolArea(pool_->pool(), &umem_base_, &umem_len_)) {
+    return CommandFailure(ENOTSUP,
+                          "The packet pool of node %d is not virtually "
+                          "contiguous and cannot be used as a UMEM",
+                          node);
+  }
+
+  bess::Packet *pkt = pool_->Alloc();
+  if (!pkt) {
+    return CommandFailure(ENOMEM, "Packet allocation failed");
+  }
+  data_offset_ = pkt->head_data<char *>() - reinterpret_cast<char *>(pkt);
+  bess::Packet::Free(pkt);
+  CHECK_GE(data_offset_, kXdpHeadroom);
+
+  // Frames are given to the kernel at kXdpHeadroom bytes before the packet
+  // data, and may extend up to the end of the Packet.
+  bess::utils::XskSocket::Umem umem = {
+      .addr = umem_base_,
+      .len = umem_len_,
+      .chunk_size =
+          static_cast<uint32_t>(sizeof(bess::Packet)) - data_offset_ +
+          kXdpHeadroom,
+      .headroom = 0,
+      .flags = XDP_UMEM_UNALIGNED_CHUNK_FLAG,
+  };
+
+  int ret = prog_.Attach(ifindex_, start_queue_ + nq, xdp_flags);
+  if (ret < 0) {
+    return CommandFailure(-ret, "Failed to attach the XDP program to %s",
+                          ifname_.c_str());
+  }
+
+  for (uint32_t i = 0; i < nq; i++) {
+    queues_.emplace_back(new Queue());
+    Queue *q = queues_.back().get();
+
+    // Sockets without RX still need a fill ring to bind.
+    bess::utils::XskSocket::Config config = {
+        .ifindex = ifindex_,
+        .queue_id = start_queue_ + i,
+        .rx_size = (i < num_rxq) ? queue_size[PACKET_DIR_INC] : 0,
+        .tx_size = (i < num_txq) ? queue_size[PACKET_DIR_OUT] : 0,
+        .fill_size = queue_size[PACKET_DIR_INC],
+        .comp_size = queue_size[PACKET_DIR_OUT],
+        .bind_flags = bind_flags,
+    };
+
+    int shared_fd = (i == 0) ? -1 : queues_[0]->sock.fd();
+    ret = q->sock.Open(config, umem, shared_fd);
+    if (ret < 0) {
+      DeInit();
+      return CommandFailure(-ret, "Failed to open an AF_XDP socket on %s:%u",
+                            ifname_.c_str(), start_queue_ + i);
+    }
+
+    if (busy_poll_) {
+      uint32_t budget = arg.busy_poll_budget() ? arg.busy_poll_budget()
+                                               : bess::PacketBatch::kMaxBurst;
+      ret = q->sock.SetBusyPoll(arg.busy_poll_usecs(), budget);
+      if (ret < 0) {
+        DeInit();
+        return CommandFailure(-ret, "Failed to enable busy polling");
+      }
+    }
+
+    // Submitted TX descriptors sit either in the TX or completion ring.
+    q->tx_inflight.resize(config.tx_size + config.comp_size);
+    q->tx_head = q->tx_tail = 0;
+
+    if (i < num_rxq) {
+      Refill(q, config.fill_size);
+      ret = prog_.Register(start_queue_ + i, q->sock.fd());
+      if (ret < 0) {
+        DeInit();
+        return CommandFailure(-ret, "Failed to register the AF_XDP socket");
+      }
+    }
+  }
+
+  conf_.mac_addr.FromString(ReadNetAttr(ifname_, "address"));
+
+  return CommandSuccess();
+}
+
+void AFXDPPort::DeInit() {
+  // Stop steering traffic to the sockets first.
+  prog_.Detach();
+
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+
+  for (auto &q : queues_) {
+    // Buffers on the RX and fill rings are ours again once the kernel stops
+    // using them.  Those held by the device for a zero-copy socket are
+    // returned to the fill ring on unbind, which happens only on close, so
+    // collect what the rings have now and accept the rest as lost.
+    uint32_t idx;
+    uint32_t n = q->sock.rx.is_mapped() ? q->sock.rx.Peek(UINT32_MAX, &idx) : 0;
+    while (n > 0) {
+      uint32_t burst = std::min(n, bess::PacketBatch::kMaxBurst);
+      for (uint32_t i = 0; i < burst; i++) {
+        uint64_t addr = q->sock.rx.at(idx++).addr;
+        addr = (addr & XSK_UNALIGNED_BUF_ADDR_MASK) +
+               (addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT);
+        pkts[i] = reinterpret_cast<bess::Packet *>(umem_base_ + addr -
+                                                   data_offset_);
+      }
+      bess::Packet::Free(pkts, burst);
+      n -= burst;
+    }
+
+    n = q->sock.fill.is_mapped() ? q->sock.fill.Outstanding(&idx) : 0;
+    while (n > 0) {
+      uint32_t burst = std::min(n, bess::PacketBatch::kMaxBurst);
+      for (uint32_t i = 0; i < burst; i++) {
+        uint64_t addr = q->sock.fill.at(idx++);
+        pkts[i] = reinterpret_cast<bess::Packet *>(
+            umem_base_ + addr + kXdpHeadroom - data_offset_);
+      }
+      bess::Packet::Free(pkts, burst);
+      n -= burst;
+    }
+
+    q->sock.Close();
+
+    // The socket is gone, so every pending transmission is done (or never
+    // will be).
+    uint32_t mask = q->tx_inflight.size() - 1;
+    while (q->tx_head != q->tx_tail) {
+      uint32_t burst = std::min(q->tx_tail - q->tx_head,
+                                bess::PacketBatch::kMaxBurst);
+      for (uint32_t i = 0; i < burst; i++) {
+        pkts[i] = q->tx_inflight[q->tx_head++ & mask];
+      }
+      bess::Packet::Free(pkts, burst);
+    }
+  }
+
+  queues_.clear();
+}
+
+void AFXDPPort::CollectStats(bool reset) {
+  uint64_t dropped = 0;
+
+  for (auto &q : queues_) {
+    struct xdp_statistics stats;
+    if (q->sock.GetStats(&stats) == 0) {
+      dropped += stats.rx_dropped + stats.rx_ring_full +
+                 stats.rx_fill_ring_empty_descs;
+    }
+  }
+
+  if (reset) {
+    dropped_base_ = dropped;
+  }
+
+  port_stats_.inc.dropped = dropped - dropped_base_;
+}
+
+void AFXDPPort::Refill(Queue *q, uint32_t cnt) {
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+
+  while (cnt > 0) {
+    uint32_t burst = std::min(cnt, bess::PacketBatch::kMaxBurst);
+    if (!pool_->AllocBulk(pkts, burst)) {
+      // The fill ring is short of buffers now; the next Refill() catches up.
+      return;
+    }
+
+    uint32_t idx;
+    uint32_t n = q->sock.fill.Reserve(burst, &idx);
+    for (uint32_t i = 0; i < n; i++) {
+      q->sock.fill.at(idx + i) =
+          pkts[i]->head_data<char *>() - umem_base_ - kXdpHeadroom;
+    }
+    q->sock.fill.Submit(n);
+
+    if (n < burst) {
+      bess::Packet::Free(pkts + n, burst - n);
+      return;
+    }
+    cnt -= burst;
+  }
+}
+
+void AFXDPPort::ReapTx(Queue *q) {
+  uint32_t idx;
+  uint32_t n = q->sock.comp.Peek(q->sock.comp.size(), &idx);
+  if (n == 0) {
+    return;
+  }
+  q->sock.comp.Release(n);
+
+  // Completions come in submission order, so there is no need to look at
+  // the addresses.
+  bess::Packet *pkts[bess::PacketBatch::kMaxBurst];
+  uint32_t mask = q->tx_inflight.size() - 1;
+  while (n > 0) {
+    uint32_t burst = std::min(n, bess::PacketBatch::kMaxBurst);
+    for (uint32_t i = 0; i < burst; i++) {
+      pkts[i] = q->tx_inflight[q->tx_head++ & mask];
+    }
+    bess::Packet::Free(pkts, burst);
+    n -= burst;
+  }
+}
+
+int AFXDPPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  Queue *q = queues_[qid].get();
+  uint32_t idx;
+
+  uint32_t n = q->sock.rx.Peek(cnt, &idx);
+  for (uint32_t i = 0; i < n; i++) {
+    const struct xdp_desc &desc = q->sock.rx.at(idx + i);
+    uint64_t addr = (desc.addr & XSK_UNALIGNED_BUF_ADDR_MASK) +
+                    (desc.addr >> XSK_UNALIGNED_BUF_OFFSET_SHIFT);
+    bess::Packet *pkt =
+        reinterpret_cast<bess::Packet *>(umem_base_ + addr - data_offset_);
+    pkt->append(desc.len);
+    pkts[i] = pkt;
+  }
+
+  if (n > 0) {
+    q->sock.rx.Release(n);
+    Refill(q, n);
+  } else if (busy_poll_ || q->sock.fill.NeedsWakeup()) {
+    q->sock.KickRx();
+  }
+
+  return n;
+}
+
+int AFXDPPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
+  Queue *q = queues_[qid].get();
+
+  ReapTx(q);
+
+  uint32_t room = q->tx_inflight.size() - (q->tx_tail - q->tx_head);
+  uint32_t idx;
+  uint32_t n = q->sock.tx.Reserve(std::min<uint32_t>(cnt, room), &idx);
+  uint32_t mask = q->tx_inflight.size() - 1;
+  uint32_t sent = 0;
+
+  for (; sent < n; sent++) {
+    bess::Packet *pkt = pkts[sent];
+    int64_t addr = -1;
+
+    if (pkt->is_linear()) {
+      addr = UmemAddr(pkt->head_data(), pkt->head_len());
+    }
+
+    if (addr < 0) {
+      // Not in the UMEM (or chained): send a linear copy instead.
+      bess::Packet *copy = pool_->Alloc();
+      if (!copy) {
+        break;
+      }
+
+      char *p = static_cast<char *>(copy->append(pkt->total_len()));
+      if (!p) {
+        bess::Packet::Free(copy);
+        break;
+      }
+
+      for (bess::Packet *seg = pkt; seg; seg = seg->next()) {
+        bess::utils::Copy(p, seg->head_data(), seg->head_len());
+        p += seg->head_len();
+      }
+
+      bess::Packet::Free(pkt);
+      pkt = copy;
+      addr = UmemAddr(pkt->head_data(), pkt->head_len());
+    }
+
+    struct xdp_desc &desc = q->sock.tx.at(idx + sent);
+    desc.addr = addr;
+    desc.len = pkt->head_len();
+    desc.options = 0;
+    q->tx_inflight[q->tx_tail++ & mask] = pkt;
+  }
+
+  q->sock.tx.Cancel(n - sent);
+  if (sent > 0) {
+    q->sock.tx.Submit(sent);
+    if (q->sock.tx.NeedsWakeup()) {
+      q->sock.KickTx();
+    }
+  }
+
+  return sent;
+}
+
+Port::LinkStatus AFXDPPort::GetLinkStatus() {
+  // Virtual devices (e.g., veth) have no speed, and report -1 or nothing.
+  int speed = atoi(ReadNetAttr(ifname_, "speed").c_str());
+  std::string duplex = ReadNetAttr(ifname_, "duplex");
+
+  return LinkStatus{
+      .speed = static_cast<uint32_t>(std::max(speed, 0)),
+      .full_duplex = duplex.empty() || duplex == "full",
+      .autoneg = true,
+      .link_up = ReadNetAttr(ifname_, "operstate") == "up",
+  };
+}
+
+ADD_DRIVER(AFXDPPort, "afxdp_port",
+           "AF_XDP sockets on a Linux network interface")
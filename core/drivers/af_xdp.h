@@ -0,0 +1,151 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_DRIVERS_AF_XDP_H_
+#define BESS_DRIVERS_AF_XDP_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../message.h"
+#include "../port.h"
+
+#include "../utils/xsk.h"
+
+/*!
+ * This driver binds a port to a Linux network interface through AF_XDP
+ * sockets, one per queue. Unlike PMDPort, the interface stays with its kernel
+ * driver: an XDP program steers the traffic of the selected queues to BESS,
+ * and all other queues keep feeding the kernel stack.
+ *
+ * The sockets share one UMEM, which is the memory of a BESS PacketPool, so
+ * packets are received into (and, when they come from the same pool, sent
+ * from) Packet buffers directly. With a zero-copy capable driver nothing is
+ * copied at all; otherwise the kernel copies once per packet.
+ */
+class AFXDPPort final : public Port {
+ public:
+  AFXDPPort()
+      : Port(),
+        ifname_(),
+        ifindex_(),
+        start_queue_(),
+        busy_poll_(),
+        node_placement_(UNCONSTRAINED_SOCKET),
+        pool_(),
+        umem_base_(),
+        umem_len_(),
+        data_offset_(),
+        prog_(),
+        queues_(),
+        dropped_base_() {}
+
+  /*!
+   * Attach the XDP program and open one AF_XDP socket per queue.
+   *
+   * PARAMETERS:
+   * * string ifname : interface to bind to.
+   * * uint32 start_queue : first interface queue to take over.
+   * * string mode : XDP attach mode, "drv", "skb", or "" to let the kernel
+   *   choose.
+   * * bool zero_copy / copy : force (or forbid) zero-copy mode.
+   * * uint32 busy_poll_usecs, busy_poll_budget : enable busy polling.
+   */
+  CommandResponse Init(const bess::pb::AFXDPPortArg &arg);
+
+  /*!
+   * Detach the XDP program, close the sockets and free all buffers.
+   */
+  void DeInit() override;
+
+  /*!
+   * Folds in the kernel's per-socket drop counters.
+   */
+  void CollectStats(bool reset) override;
+
+  int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+
+  LinkStatus GetLinkStatus() override;
+
+  placement_constraint GetNodePlacementConstraint() const override {
+    return node_placement_;
+  }
+
+ private:
+  // Kernel headroom in front of every received frame (XDP_PACKET_HEADROOM).
+  static const uint32_t kXdpHeadroom = 256;
+
+  struct Queue {
+    bess::utils::XskSocket sock;
+
+    // Packets handed to the kernel for TX, in submission order.  AF_XDP
+    // completes TX descriptors in order, so completions free from the head.
+    std::vector<bess::Packet *> tx_inflight;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+  };
+
+  // Gives up to `cnt` fresh packets to the kernel for RX.
+  void Refill(Queue *q, uint32_t cnt);
+
+  // Frees the packets whose transmission has completed.
+  void ReapTx(Queue *q);
+
+  // Returns the UMEM address of `data`, or -1 if it is outside the UMEM.
+  int64_t UmemAddr(const void *data, uint32_t len) const {
+    const char *p = static_cast<const char *>(data);
+    if (p < umem_base_ || p + len > umem_base_ + umem_len_) {
+      return -1;
+    }
+    return p - umem_base_;
+  }
+
+  std::string ifname_;
+  int ifindex_;
+  uint32_t start_queue_;
+  bool busy_poll_;
+  placement_constraint node_placement_;
+
+  // The UMEM: the (virtually contiguous) memory of this pool.
+  bess::PacketPool *pool_;
+  char *umem_base_;
+  uint64_t umem_len_;
+
+  // Offset of the packet data from the start of a freshly allocated Packet.
+  uint32_t data_offset_;
+
+  bess::utils::XdpRedirectProgram prog_;
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  // Kernel drop counters cannot be reset, so we remember where we started.
+  uint64_t dropped_base_;
+};
+
+#endif  // BESS_DRIVERS_AF_XDP_H_
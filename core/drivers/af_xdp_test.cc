@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "af_xdp.h"
+
+#include <gtest/gtest.h>
+#include <net/if.h>
+#include <unistd.h>
+
+#include <cerrno>
+
+namespace {
+
+// Init() checks its arguments before touching XDP or the packet pools, so
+// these run without privileges, against the loopback interface.
+class AFXDPPortTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    if (if_nametoindex("lo") == 0) {
+      GTEST_SKIP() << "no loopback interface";
+    }
+
+    port_.num_queues[PACKET_DIR_INC] = 1;
+    port_.num_queues[PACKET_DIR_OUT] = 1;
+    port_.queue_size[PACKET_DIR_INC] = 1024;
+    port_.queue_size[PACKET_DIR_OUT] = 1024;
+    arg_.set_ifname("lo");
+  }
+
+  int InitError() { return port_.Init(arg_).error().code(); }
+
+  AFXDPPort port_;
+  bess::pb::AFXDPPortArg arg_;
+};
+
+TEST_F(AFXDPPortTest, UnknownInterface) {
+  arg_.set_ifname("bess_no_such_if");
+  EXPECT_EQ(ENODEV, InitError());
+}
+
+TEST_F(AFXDPPortTest, BadMode) {
+  arg_.set_mode("hw");
+  EXPECT_EQ(EINVAL, InitError());
+}
+
+TEST_F(AFXDPPortTest, CopyAndZeroCopy) {
+  arg_.set_copy(true);
+  arg_.set_zero_copy(true);
+  EXPECT_EQ(EINVAL, InitError());
+}
+
+TEST_F(AFXDPPortTest, QueueSizeNotPowerOfTwo) {
+  port_.queue_size[PACKET_DIR_INC] = 1000;
+  EXPECT_EQ(EINVAL, InitError());
+
+  port_.queue_size[PACKET_DIR_INC] = 1024;
+  port_.queue_size[PACKET_DIR_OUT] = 0;
+  EXPECT_EQ(EINVAL, InitError());
+}
+
+TEST_F(AFXDPPortTest, QueuesOutOfRange) {
+  if (access("/sys/class/net/lo/queues", R_OK) != 0) {
+    GTEST_SKIP() << "queues of lo are not in sysfs";
+  }
+
+  // lo has a single queue.
+  arg_.set_start_queue(1);
+  EXPECT_EQ(EINVAL, InitError());
+
+  arg_.set_start_queue(0);
+  port_.num_queues[PACKET_DIR_OUT] = 2;
+  EXPECT_EQ(EINVAL, InitError());
+
+  arg_.set_start_queue(0xffffffff);
+  port_.num_queues[PACKET_DIR_OUT] = 1;
+  EXPECT_EQ(EINVAL, InitError());
+}
+
+}  // namespace
@@ -32,17 +32,38 @@
 
 #include "pcap.h"
 
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 #include <algorithm>
 #include <string>
+#include <vector>
 
 #include "../utils/pcap.h"
+#include "../utils/time.h"
 
 CommandResponse PCAPPort::Init(const bess::pb::PCAPPortArg& arg) {
-  if (pcap_handle_.is_initialized()) {
+  if (pcap_handle_.is_initialized() || sock_ >= 0 || replay_file_.is_open()) {
     return CommandFailure(EINVAL, "Device already initialized.");
   }
 
+  if (!arg.replay().empty()) {
+    return InitReplay(arg);
+  }
+
   const std::string dev = arg.dev();
+  if (arg.io_uring()) {
+    CommandResponse err = InitUring(dev);
+    if (err.has_error()) {
+      DeInit();
+    }
+    return err;
+  }
+
   pcap_handle_ = PcapHandle(dev);
 
   if (!pcap_handle_.is_initialized()) {
@@ -56,11 +77,102 @@ CommandResponse PCAPPort::Init(const bess::pb::PCAPPortArg& arg) {
   return CommandSuccess();
 }
 
+CommandResponse PCAPPort::InitUring(const std::string& dev) {
+  unsigned int ifindex = if_nametoindex(dev.c_str());
+  if (ifindex == 0) {
+    return CommandFailure(errno, "Unknown device '%s'", dev.c_str());
+  }
+
+  sock_ = socket(AF_PACKET, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                 htons(ETH_P_ALL));
+  if (sock_ < 0) {
+    return CommandFailure(errno, "socket(AF_PACKET) failed");
+  }
+
+  struct sockaddr_ll sll = {};
+  sll.sll_family = AF_PACKET;
+  sll.sll_protocol = htons(ETH_P_ALL);
+  sll.sll_ifindex = ifindex;
+  if (bind(sock_, reinterpret_cast<struct sockaddr*>(&sll), sizeof(sll)) < 0) {
+    return CommandFailure(errno, "bind(%s) failed", dev.c_str());
+  }
+
+  // libpcap opens the device in promiscuous mode; so do we.
+  struct packet_mreq mreq = {};
+  mreq.mr_ifindex = ifindex;
+  mreq.mr_type = PACKET_MR_PROMISC;
+  if (setsockopt(sock_, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &mreq,
+                 sizeof(mreq)) < 0) {
+    return CommandFailure(errno, "PACKET_ADD_MEMBERSHIP failed");
+  }
+
+  int ret = uring_rx_.Init(current_worker.packet_pool());
+  if (ret >= 0) {
+    ret = uring_tx_.Init();
+  }
+  if (ret < 0) {
+    return CommandFailure(-ret, "io_uring setup failed");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PCAPPort::InitReplay(const bess::pb::PCAPPortArg& arg) {
+  if (arg.speed() < 0) {
+    return CommandFailure(EINVAL, "'speed' must be 0 (no pacing) or positive");
+  }
+
+  std::string err;
+  int ret = replay_file_.Open(arg.replay(), &err);
+  if (ret < 0) {
+    return CommandFailure(-ret, "%s", err.c_str());
+  }
+
+  const std::vector<bess::utils::PcapFile::Record>& records =
+      replay_file_.records();
+  if (records.empty()) {
+    replay_file_.Close();
+    return CommandFailure(EINVAL, "No packets in %s", arg.replay().c_str());
+  }
+
+  replay_loop_ = arg.loop();
+  replay_cycles_per_ns_ = (arg.speed() > 0) ? tsc_hz / 1e9 / arg.speed() : 0;
+
+  // A lap lasts as long as the capture, plus an average gap between the last
+  // packet and the first one of the next lap.
+  uint64_t duration = replay_file_.duration_ns();
+  replay_lap_ns_ =
+      duration + duration / std::max<size_t>(records.size() - 1, 1);
+
+  for (ReplayQueue& q : replay_queues_) {
+    q = {};
+    q.next = &q - replay_queues_;
+  }
+
+  return CommandSuccess();
+}
+
 void PCAPPort::DeInit() {
   pcap_handle_.Reset();
+  replay_file_.Close();
+
+  uring_tx_.Close();
+  uring_rx_.Close();
+  if (sock_ >= 0) {
+    close(sock_);
+    sock_ = -1;
+  }
 }
 
 int PCAPPort::RecvPackets(queue_t qid, bess::Packet** pkts, int cnt) {
+  if (replay_file_.is_open()) {
+    return ReplayPackets(qid, pkts, cnt);
+  }
+
+  if (sock_ >= 0) {
+    return uring_rx_.Recv(sock_, current_worker.packet_pool(), pkts, cnt);
+  }
+
   if (!pcap_handle_.is_initialized()) {
     return 0;
   }
@@ -81,34 +193,118 @@ int PCAPPort::RecvPackets(queue_t qid, bess::Packet** pkts, int cnt) {
       break;
     }
 
-    int copy_len = std::min(caplen, static_cast<int>(pkt->tailroom()));
-    bess::utils::CopyInlined(pkt->append(copy_len), packet, copy_len, true);
+    if (!FillPacket(pkt, packet, caplen)) {
+      bess::Packet::Free(pkt);
+      break;
+    }
+
+    pkts[recv_cnt] = pkt;
+    recv_cnt++;
+  }
 
-    packet += copy_len;
-    caplen -= copy_len;
-    bess::Packet* m = pkt;
+  return recv_cnt;
+}
 
-    int nb_segs = 1;
-    while (caplen > 0) {
-      m->set_next(current_worker.packet_pool()->Alloc());
-      m = m->next();
-      nb_segs++;
+int PCAPPort::ReplayPackets(queue_t qid, bess::Packet** pkts, int cnt) {
+  ReplayQueue& q = replay_queues_[qid];
+  const std::vector<bess::utils::PcapFile::Record>& records =
+      replay_file_.records();
+  const size_t stride = num_queues[PACKET_DIR_INC];
+  uint64_t now = current_worker.current_tsc();
 
-      copy_len = std::min(caplen, static_cast<int>(m->tailroom()));
-      bess::utils::Copy(m->append(copy_len), packet, copy_len, true);
+  if (q.start_tsc == 0) {
+    q.start_tsc = now;
+  }
 
-      packet += copy_len;
-      caplen -= copy_len;
+  // First, find out how many records are due, so as to allocate in bulk.
+  size_t next = q.next;
+  uint64_t lap = q.lap;
+  int due = 0;
+  while (due < cnt) {
+    if (next >= records.size()) {
+      if (!replay_loop_ || qid >= records.size()) {
+        break;
+      }
+      next = qid;
+      lap++;
     }
-    pkt->set_nb_segs(nb_segs);
-    pkts[recv_cnt] = pkt;
-    recv_cnt++;
+
+    if (replay_cycles_per_ns_ > 0) {
+      uint64_t ts_ns = lap * replay_lap_ns_ + records[next].ts_ns;
+      if (now < q.start_tsc + ts_ns * replay_cycles_per_ns_) {
+        break;
+      }
+    }
+
+    next += stride;
+    due++;
   }
 
-  return recv_cnt;
+  if (due == 0 || !current_worker.packet_pool()->AllocBulk(pkts, due)) {
+    return 0;
+  }
+
+  for (int i = 0; i < due; i++) {
+    if (q.next >= records.size()) {
+      q.next = qid;
+      q.lap++;
+    }
+
+    const bess::utils::PcapFile::Record& rec = records[q.next];
+    if (!FillPacket(pkts[i], rec.data, rec.len)) {
+      // Out of buffers for chaining: try again with this record next time.
+      bess::Packet::Free(pkts + i, due - i);
+      return i;
+    }
+    q.next += stride;
+  }
+
+  return due;
+}
+
+bool PCAPPort::FillPacket(bess::Packet* pkt, const u_char* data, int len) {
+  const int total_len = len;
+
+  int copy_len = std::min(len, static_cast<int>(pkt->tailroom()));
+  bess::utils::CopyInlined(pkt->append(copy_len), data, copy_len, true);
+
+  data += copy_len;
+  len -= copy_len;
+  bess::Packet* m = pkt;
+
+  int nb_segs = 1;
+  while (len > 0) {
+    bess::Packet* seg = current_worker.packet_pool()->Alloc();
+    if (!seg) {
+      pkt->set_nb_segs(nb_segs);
+      return false;
+    }
+    m->set_next(seg);
+    m = seg;
+    nb_segs++;
+
+    copy_len = std::min(len, static_cast<int>(m->tailroom()));
+    bess::utils::Copy(m->append(copy_len), data, copy_len, true);
+
+    data += copy_len;
+    len -= copy_len;
+  }
+  pkt->set_nb_segs(nb_segs);
+  pkt->set_total_len(total_len);
+  return true;
 }
 
 int PCAPPort::SendPackets(queue_t, bess::Packet** pkts, int cnt) {
+  if (replay_file_.is_open()) {
+    bess::Packet::Free(pkts, cnt);
+    return cnt;
+  }
+
+  if (sock_ >= 0) {
+    // Unsent packets (ring full) are left to the caller, like any other port.
+    return uring_tx_.Send(sock_, current_worker.packet_pool(), pkts, cnt);
+  }
+
   if (!pcap_handle_.is_initialized()) {
     CHECK(0);  // raise an error
   }
@@ -37,14 +37,40 @@
 
 #include <glog/logging.h>
 
+#include <string>
+
+#include "../utils/io_uring.h"
+#include "../utils/pcap_file.h"
 #include "../utils/pcap_handle.h"
 
 // Port to connect to a device via PCAP.
 // (Not recommended because PCAP is slow :-)
 // This driver is experimental. Currently does not support mbuf chaining and
 // needs more tests!
+//
+// With io_uring set, the port skips libpcap and uses an AF_PACKET socket
+// bound to the device, with batched io_uring receive and send. Frames that do
+// not fit in a single packet buffer are dropped in that mode.
+//
+// With replay set, the port replays a pcap or pcapng file instead, as
+// received traffic: once or in a loop, as fast as possible or paced by the
+// capture timestamps (optionally sped up or slowed down). With several RX
+// queues, queue q replays records q, q + n, q + 2n, ... on its own schedule.
+// Packets sent to the port in this mode are dropped.
 class PCAPPort final : public Port {
  public:
+  PCAPPort()
+      : Port(),
+        pcap_handle_(),
+        sock_(-1),
+        uring_rx_(),
+        uring_tx_(),
+        replay_file_(),
+        replay_loop_(),
+        replay_cycles_per_ns_(),
+        replay_lap_ns_(),
+        replay_queues_() {}
+
   CommandResponse Init(const bess::pb::PCAPPortArg &arg);
 
   void DeInit() override;
@@ -54,8 +80,36 @@ class PCAPPort final : public Port {
   int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
 
  private:
+  // Per-RX queue replay position and schedule
+  struct ReplayQueue {
+    size_t next;         // Index of the next record to replay
+    uint64_t lap;        // Number of times the file was replayed in full
+    uint64_t start_tsc;  // When the queue was first polled, 0 before
+  };
+
   void GatherData(unsigned char *data, bess::Packet *pkt);
+  CommandResponse InitUring(const std::string &dev);
+  CommandResponse InitReplay(const bess::pb::PCAPPortArg &arg);
+
+  // Copies len bytes into pkt, chaining more packets as needed. Returns false
+  // if the pool runs out; the caller still owns (and frees) pkt.
+  bool FillPacket(bess::Packet *pkt, const u_char *data, int len);
+
+  int ReplayPackets(queue_t qid, bess::Packet **pkts, int cnt);
+
   PcapHandle pcap_handle_;
+
+  // AF_PACKET socket for io_uring mode, -1 otherwise.
+  int sock_;
+  bess::utils::UringPacketReceiver uring_rx_;
+  bess::utils::UringPacketSender uring_tx_;
+
+  // Replay mode, if the file is open
+  bess::utils::PcapFile replay_file_;
+  bool replay_loop_;
+  double replay_cycles_per_ns_;  // 0 for no pacing
+  uint64_t replay_lap_ns_;       // Time between two laps of a loop
+  ReplayQueue replay_queues_[MAX_QUEUES_PER_DIR];
 };
 
 #endif  // BESS_DRIVERS_PCAP_H_
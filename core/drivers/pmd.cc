@@ -32,11 +32,14 @@
 
 #include "pmd.h"
 
+#include <arpa/inet.h>
 #include <net/if.h>
+#include <poll.h>
 #include <sys/ioctl.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <bitset>
 #include <vector>
 
 #include <rte_bus.h>
@@ -44,11 +47,15 @@
 #include <rte_dev.h>
 #include <rte_ethdev.h>
 #include <rte_flow.h>
+#include <rte_interrupts.h>
 #include <rte_pci.h>
 #include <rte_string_fns.h>
+#include <rte_time.h>
 
 #include "../utils/ether.h"
 #include "../utils/format.h"
+#include "../utils/rss_reta.h"
+#include "../utils/time.h"
 
 // TODO: Replace with one time initialized key during InitDriver?
 static uint8_t rss_key[40] = {0xD8, 0x2A, 0x6C, 0x5A, 0xDD, 0x3B, 0x9D, 0x1E,
@@ -374,6 +381,337 @@ CommandResponse flow_create(dpdk_port_t port_id, const uint32_t &flow_profile) {
   return err;
 }
 
+const PortCommands PMDPort::cmds = {
+    {"add_flow_rule", "PMDPortFlowRuleArg",
+     PORT_CMD_FUNC(&PMDPort::CommandAddFlowRule), PortCommand::THREAD_SAFE},
+    {"delete_flow_rule", "PMDPortDeleteFlowRuleArg",
+     PORT_CMD_FUNC(&PMDPort::CommandDeleteFlowRule), PortCommand::THREAD_SAFE},
+    {"list_flow_rules", "EmptyArg",
+     PORT_CMD_FUNC(&PMDPort::CommandListFlowRules), PortCommand::THREAD_SAFE},
+    {"get_xstats", "PMDPortGetXstatsArg",
+     PORT_CMD_FUNC(&PMDPort::CommandGetXstats), PortCommand::THREAD_SAFE},
+    {"get_rss", "EmptyArg", PORT_CMD_FUNC(&PMDPort::CommandGetRss),
+     PortCommand::THREAD_SAFE},
+    {"set_rss", "PMDPortRssConfig", PORT_CMD_FUNC(&PMDPort::CommandSetRss),
+     PortCommand::THREAD_SAFE},
+    {"set_rss_rebalancer", "PMDPortRssRebalancerArg",
+     PORT_CMD_FUNC(&PMDPort::CommandSetRssRebalancer),
+     PortCommand::THREAD_SAFE},
+};
+
+// Names for RTE_ETH_RSS_* hash types. Composite types come first, so that
+// get_rss reports "ip" rather than each of its bits.
+static const struct {
+  const char *name;
+  uint64_t rss_hf;
+} kRssTypes[] = {
+    {"ip", RTE_ETH_RSS_IP},
+    {"udp", RTE_ETH_RSS_UDP},
+    {"tcp", RTE_ETH_RSS_TCP},
+    {"sctp", RTE_ETH_RSS_SCTP},
+    {"eth", RTE_ETH_RSS_ETH},
+    {"vlan", RTE_ETH_RSS_VLAN},
+    {"ipv4", RTE_ETH_RSS_IPV4},
+    {"ipv6", RTE_ETH_RSS_IPV6},
+    {"gtpu", RTE_ETH_RSS_GTPU},
+    {"l3-src-only", RTE_ETH_RSS_L3_SRC_ONLY},
+    {"l3-dst-only", RTE_ETH_RSS_L3_DST_ONLY},
+    {"l4-src-only", RTE_ETH_RSS_L4_SRC_ONLY},
+    {"l4-dst-only", RTE_ETH_RSS_L4_DST_ONLY},
+};
+
+// Parses a hash type name (or "0x..." mask) into *rss_hf. Returns false if
+// the name is unknown.
+static bool parse_rss_type(const std::string &name, uint64_t *rss_hf) {
+  if (name.compare(0, 2, "0x") == 0) {
+    char *end;
+    *rss_hf = strtoull(name.c_str(), &end, 16);
+    return name.size() > 2 && *end == '\0';
+  }
+  for (const auto &t : kRssTypes) {
+    if (name == t.name) {
+      *rss_hf = t.rss_hf;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Parses "addr/len" (or "addr", for a host) into an address and a mask of 4
+// (IPv4) or 16 (IPv6) bytes. Returns AF_INET, AF_INET6, or 0 if invalid.
+static int parse_ip_prefix(const std::string &str, uint8_t *addr,
+                           uint8_t *mask) {
+  std::string ip = str;
+  long len = -1;
+
+  size_t slash = str.find('/');
+  if (slash != std::string::npos) {
+    char *end;
+    ip = str.substr(0, slash);
+    len = strtol(str.c_str() + slash + 1, &end, 10);
+    if (*end != '\0' || end == str.c_str() + slash + 1 || len < 0) {
+      return 0;
+    }
+  }
+
+  int family;
+  if (inet_pton(AF_INET, ip.c_str(), addr) == 1) {
+    family = AF_INET;
+  } else if (inet_pton(AF_INET6, ip.c_str(), addr) == 1) {
+    family = AF_INET6;
+  } else {
+    return 0;
+  }
+
+  const int bits = (family == AF_INET) ? 32 : 128;
+  if (len > bits) {
+    return 0;
+  } else if (len < 0) {
+    len = bits;
+  }
+
+  memset(mask, 0, bits / 8);
+  for (int i = 0; i < len; i++) {
+    mask[i / 8] |= 0x80 >> (i % 8);
+  }
+  for (int i = 0; i < bits / 8; i++) {
+    addr[i] &= mask[i];
+  }
+  return family;
+}
+
+// rte_flow pattern and actions of a flow rule, along with the item specs,
+// masks and action configurations they point to.
+struct FlowRuleSpec {
+  rte_flow_attr attr = {};
+
+  rte_flow_item_eth eth = {};
+  rte_flow_item_eth eth_mask = {};
+  rte_flow_item_ipv4 ipv4 = {};
+  rte_flow_item_ipv4 ipv4_mask = {};
+  rte_flow_item_ipv6 ipv6 = {};
+  rte_flow_item_ipv6 ipv6_mask = {};
+  rte_flow_item_udp udp = {};
+  rte_flow_item_udp udp_mask = {};
+  rte_flow_item_tcp tcp = {};
+  rte_flow_item_tcp tcp_mask = {};
+  rte_flow_item_gtp gtp = {};
+  rte_flow_item_gtp gtp_mask = {};
+
+  rte_flow_action_mark mark = {};
+  rte_flow_action_queue queue = {};
+  rte_flow_action_rss rss = {};
+  uint16_t rss_queues[MAX_QUEUES_PER_DIR] = {};
+  rte_flow_action_count count = {};
+
+  std::vector<rte_flow_item> items;
+  std::vector<rte_flow_action> actions;
+
+  FlowRuleSpec() = default;
+  DISALLOW_COPY_AND_ASSIGN(FlowRuleSpec);
+};
+
+static const uint16_t kGtpuPort = 2152;
+
+// Translates a flow rule into rte_flow terms, with a COUNT action if
+// `count` is set.
+static CommandResponse build_flow_rule(const bess::pb::PMDPortFlowRuleArg &arg,
+                                       int num_rxq, bool count,
+                                       FlowRuleSpec *spec) {
+  uint8_t src[16], src_mask[16], dst[16], dst_mask[16];
+  int family = 0;
+
+  if (!arg.src_ip().empty()) {
+    family = parse_ip_prefix(arg.src_ip(), src, src_mask);
+    if (family == 0) {
+      return CommandFailure(EINVAL, "Invalid src_ip '%s'",
+                            arg.src_ip().c_str());
+    }
+  }
+
+  if (!arg.dst_ip().empty()) {
+    int dst_family = parse_ip_prefix(arg.dst_ip(), dst, dst_mask);
+    if (dst_family == 0) {
+      return CommandFailure(EINVAL, "Invalid dst_ip '%s'",
+                            arg.dst_ip().c_str());
+    }
+    if (family != 0 && family != dst_family) {
+      return CommandFailure(EINVAL, "src_ip and dst_ip are not of the same "
+                                    "IP version");
+    }
+    family = dst_family;
+  }
+
+  const bool has_teid = arg.gtpu_teid_match_case() ==
+                        bess::pb::PMDPortFlowRuleArg::kGtpuTeid;
+  const bool gtpu = arg.gtpu() || arg.gtpu_msg_type() || has_teid;
+
+  uint32_t ip_proto = arg.ip_proto();
+  if (gtpu) {
+    if (ip_proto != 0 && ip_proto != IPPROTO_UDP) {
+      return CommandFailure(EINVAL, "GTP-U is over UDP (ip_proto 17)");
+    }
+    ip_proto = IPPROTO_UDP;
+  }
+
+  if (arg.src_port() > UINT16_MAX || arg.dst_port() > UINT16_MAX ||
+      arg.ip_proto() > UINT8_MAX || arg.ether_type() > UINT16_MAX ||
+      arg.gtpu_msg_type() > UINT8_MAX) {
+    return CommandFailure(EINVAL, "Match field out of range");
+  }
+
+  const bool ports = arg.src_port() || arg.dst_port() || gtpu;
+  if ((arg.src_port() || arg.dst_port()) && ip_proto != IPPROTO_TCP &&
+      ip_proto != IPPROTO_UDP) {
+    return CommandFailure(EINVAL, "Ports need ip_proto 6 (TCP) or 17 (UDP)");
+  }
+
+  if (family == 0 && ip_proto != 0) {
+    family = (arg.ether_type() == RTE_ETHER_TYPE_IPV6) ? AF_INET6 : AF_INET;
+  }
+
+  if (family != 0 && arg.ether_type() != 0 &&
+      arg.ether_type() != ((family == AF_INET) ? RTE_ETHER_TYPE_IPV4
+                                               : RTE_ETHER_TYPE_IPV6)) {
+    return CommandFailure(EINVAL, "ether_type does not match the IP fields");
+  }
+
+  spec->attr.ingress = 1;
+  spec->attr.priority = arg.priority();
+
+  auto add_item = [spec](rte_flow_item_type type, const void *item_spec,
+                         const void *item_mask) {
+    spec->items.push_back({type, item_spec, nullptr, item_mask});
+  };
+
+  if (family == 0 && arg.ether_type() != 0) {
+    spec->eth.hdr.ether_type = rte_cpu_to_be_16(arg.ether_type());
+    spec->eth_mask.hdr.ether_type = 0xffff;
+    add_item(RTE_FLOW_ITEM_TYPE_ETH, &spec->eth, &spec->eth_mask);
+  } else {
+    add_item(RTE_FLOW_ITEM_TYPE_ETH, nullptr, nullptr);
+  }
+
+  if (family == AF_INET) {
+    if (!arg.src_ip().empty()) {
+      memcpy(&spec->ipv4.hdr.src_addr, src, 4);
+      memcpy(&spec->ipv4_mask.hdr.src_addr, src_mask, 4);
+    }
+    if (!arg.dst_ip().empty()) {
+      memcpy(&spec->ipv4.hdr.dst_addr, dst, 4);
+      memcpy(&spec->ipv4_mask.hdr.dst_addr, dst_mask, 4);
+    }
+    if (ip_proto != 0) {
+      spec->ipv4.hdr.next_proto_id = ip_proto;
+      spec->ipv4_mask.hdr.next_proto_id = 0xff;
+    }
+    add_item(RTE_FLOW_ITEM_TYPE_IPV4, &spec->ipv4, &spec->ipv4_mask);
+  } else if (family == AF_INET6) {
+    if (!arg.src_ip().empty()) {
+      memcpy(&spec->ipv6.hdr.src_addr, src, 16);
+      memcpy(&spec->ipv6_mask.hdr.src_addr, src_mask, 16);
+    }
+    if (!arg.dst_ip().empty()) {
+      memcpy(&spec->ipv6.hdr.dst_addr, dst, 16);
+      memcpy(&spec->ipv6_mask.hdr.dst_addr, dst_mask, 16);
+    }
+    if (ip_proto != 0) {
+      spec->ipv6.hdr.proto = ip_proto;
+      spec->ipv6_mask.hdr.proto = 0xff;
+    }
+    add_item(RTE_FLOW_ITEM_TYPE_IPV6, &spec->ipv6, &spec->ipv6_mask);
+  }
+
+  if (ports) {
+    uint16_t dst_port = arg.dst_port() ?: (gtpu ? kGtpuPort : 0);
+    if (ip_proto == IPPROTO_UDP) {
+      spec->udp.hdr.src_port = rte_cpu_to_be_16(arg.src_port());
+      spec->udp.hdr.dst_port = rte_cpu_to_be_16(dst_port);
+      spec->udp_mask.hdr.src_port = arg.src_port() ? 0xffff : 0;
+      spec->udp_mask.hdr.dst_port = dst_port ? 0xffff : 0;
+      add_item(RTE_FLOW_ITEM_TYPE_UDP, &spec->udp, &spec->udp_mask);
+    } else {
+      spec->tcp.hdr.src_port = rte_cpu_to_be_16(arg.src_port());
+      spec->tcp.hdr.dst_port = rte_cpu_to_be_16(dst_port);
+      spec->tcp_mask.hdr.src_port = arg.src_port() ? 0xffff : 0;
+      spec->tcp_mask.hdr.dst_port = dst_port ? 0xffff : 0;
+      add_item(RTE_FLOW_ITEM_TYPE_TCP, &spec->tcp, &spec->tcp_mask);
+    }
+  }
+
+  if (gtpu) {
+    if (arg.gtpu_msg_type() != 0) {
+      spec->gtp.hdr.msg_type = arg.gtpu_msg_type();
+      spec->gtp_mask.hdr.msg_type = 0xff;
+    }
+    if (has_teid) {
+      spec->gtp.hdr.teid = rte_cpu_to_be_32(arg.gtpu_teid());
+      spec->gtp_mask.hdr.teid = 0xffffffff;
+    }
+    add_item(RTE_FLOW_ITEM_TYPE_GTPU, &spec->gtp, &spec->gtp_mask);
+  }
+
+  add_item(RTE_FLOW_ITEM_TYPE_END, nullptr, nullptr);
+
+  if (arg.mark() != 0) {
+    spec->mark.id = arg.mark();
+    spec->actions.push_back({RTE_FLOW_ACTION_TYPE_MARK, &spec->mark});
+  }
+
+  switch (arg.action_case()) {
+    case bess::pb::PMDPortFlowRuleArg::kQueue:
+      if (arg.queue() >= static_cast<uint32_t>(num_rxq)) {
+        return CommandFailure(EINVAL, "No RX queue %u", arg.queue());
+      }
+      spec->queue.index = arg.queue();
+      spec->actions.push_back({RTE_FLOW_ACTION_TYPE_QUEUE, &spec->queue});
+      break;
+
+    case bess::pb::PMDPortFlowRuleArg::kRss:
+      if (arg.rss_queues_size() > 0) {
+        if (arg.rss_queues_size() > num_rxq) {
+          return CommandFailure(EINVAL, "Too many RSS queues (%d, max %d)",
+                                arg.rss_queues_size(), num_rxq);
+        }
+        std::bitset<MAX_QUEUES_PER_DIR> seen;
+        for (uint32_t qid : arg.rss_queues()) {
+          if (qid >= static_cast<uint32_t>(num_rxq)) {
+            return CommandFailure(EINVAL, "No RX queue %u", qid);
+          }
+          if (seen.test(qid)) {
+            return CommandFailure(EINVAL, "Duplicate RSS queue %u", qid);
+          }
+          seen.set(qid);
+          spec->rss_queues[spec->rss.queue_num++] = qid;
+        }
+      } else {
+        for (int qid = 0; qid < num_rxq; qid++) {
+          spec->rss_queues[spec->rss.queue_num++] = qid;
+        }
+      }
+      // Hash types and key are left to the PMD.
+      spec->rss.func = RTE_ETH_HASH_FUNCTION_DEFAULT;
+      spec->rss.queue = spec->rss_queues;
+      spec->actions.push_back({RTE_FLOW_ACTION_TYPE_RSS, &spec->rss});
+      break;
+
+    case bess::pb::PMDPortFlowRuleArg::kDrop:
+      spec->actions.push_back({RTE_FLOW_ACTION_TYPE_DROP, nullptr});
+      break;
+
+    default:
+      return CommandFailure(EINVAL,
+                            "Specify an action: 'queue', 'rss' or 'drop'");
+  }
+
+  if (count) {
+    spec->actions.push_back({RTE_FLOW_ACTION_TYPE_COUNT, &spec->count});
+  }
+  spec->actions.push_back({RTE_FLOW_ACTION_TYPE_END, nullptr});
+
+  return CommandSuccess();
+}
+
 CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   dpdk_port_t ret_port_id = DPDK_PORT_UNKNOWN;
 
@@ -423,11 +761,29 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   if (arg.loopback()) {
     eth_conf.lpbk_mode = 1;
   }
+  if (arg.rx_interrupt()) {
+    eth_conf.intr_conf.rxq = 1;
+  }
   if (arg.hwcksum()) {
     eth_conf.rxmode.offloads = RTE_ETH_RX_OFFLOAD_IPV4_CKSUM |
                                RTE_ETH_RX_OFFLOAD_UDP_CKSUM |
                                RTE_ETH_RX_OFFLOAD_TCP_CKSUM;
   }
+  if (arg.hw_timestamp()) {
+    err = ConfigureRxTimestamp(ret_port_id, dev_info, num_rxq, &eth_conf);
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+
+  // Have flow rule marks (see add_flow_rule) delivered with packets. Not all
+  // PMDs implement the negotiation; those deliver marks anyway, if at all.
+  uint64_t rx_metadata = RTE_ETH_RX_METADATA_USER_MARK;
+  ret = rte_eth_rx_metadata_negotiate(ret_port_id, &rx_metadata);
+  if (ret != 0 && ret != -ENOTSUP) {
+    LOG(WARNING) << "rte_eth_rx_metadata_negotiate() failed: "
+                 << rte_strerror(-ret);
+  }
 
   ret = rte_eth_dev_configure(ret_port_id, num_rxq, num_txq, &eth_conf);
   if (ret != 0) {
@@ -567,6 +923,13 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
   }
   dpdk_port_id_ = ret_port_id;
 
+  if (rx_timestamp_ != RxTimestamp::kNone) {
+    err = StartRxTimestamp();
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+
   int numa_node = arg.socket_case() == bess::pb::PMDPortArg::kSocketId
                       ? sid
                       : rte_eth_dev_socket_id(ret_port_id);
@@ -578,8 +941,13 @@ CommandResponse PMDPort::Init(const bess::pb::PMDPortArg &arg) {
 
   // Reset hardware stat counters, as they may still contain previous data
   CollectStats(true);
+  InitQueueXstats();
+
+  rss_interval_ = {1, 0};
+  rss_threshold_ = 1.2;
 
   driver_ = dev_info.driver_name ? dev_info.driver_name : "unknown";
+  rx_interrupt_ = arg.rx_interrupt();
 
   if (arg.flow_profiles_size() > 0) {
     for (int i = 0; i < arg.flow_profiles_size(); ++i) {
@@ -640,6 +1008,11 @@ restart:
 }
 
 void PMDPort::DeInit() {
+  rss_rebalancer_.Terminate();
+  DestroyFlowRules();
+  if (rx_timestamp_ == RxTimestamp::kIeee1588) {
+    rte_eth_timesync_disable(dpdk_port_id_);
+  }
   rte_eth_dev_stop(dpdk_port_id_);
 
   if (hot_plugged_) {
@@ -676,9 +1049,141 @@ void PMDPort::DeInit() {
   }
 }
 
+CommandResponse PMDPort::CommandAddFlowRule(
+    const bess::pb::PMDPortFlowRuleArg &arg) {
+  struct rte_flow *flow = nullptr;
+  struct rte_flow_error err = {};
+  bool counted = true;
+
+  // Not all NICs can count hits: fall back to a rule without a counter.
+  for (bool count : {true, false}) {
+    FlowRuleSpec spec;
+    CommandResponse ret =
+        build_flow_rule(arg, num_queues[PACKET_DIR_INC], count, &spec);
+    if (ret.has_error()) {
+      return ret;
+    }
+
+    flow = rte_flow_create(dpdk_port_id_, &spec.attr, spec.items.data(),
+                           spec.actions.data(), &err);
+    if (flow) {
+      counted = count;
+      break;
+    }
+  }
+
+  if (!flow) {
+    return CommandFailure(rte_errno, "rte_flow_create() failed: %s",
+                          err.message ?: rte_strerror(rte_errno));
+  }
+
+  uint64_t id = next_flow_rule_id_++;
+  flow_rules_[id] = {flow, arg, counted};
+
+  bess::pb::PMDPortAddFlowRuleResponse resp;
+  resp.set_id(id);
+  return CommandSuccess(resp);
+}
+
+CommandResponse PMDPort::CommandDeleteFlowRule(
+    const bess::pb::PMDPortDeleteFlowRuleArg &arg) {
+  auto it = flow_rules_.find(arg.id());
+  if (it == flow_rules_.end()) {
+    return CommandFailure(ENOENT, "No flow rule %" PRIu64, arg.id());
+  }
+
+  struct rte_flow_error err = {};
+  int ret = rte_flow_destroy(dpdk_port_id_, it->second.flow, &err);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_flow_destroy() failed: %s",
+                          err.message ?: rte_strerror(-ret));
+  }
+
+  flow_rules_.erase(it);
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::CommandListFlowRules(const bess::pb::EmptyArg &) {
+  bess::pb::PMDPortListFlowRulesResponse resp;
+
+  for (const auto &it : flow_rules_) {
+    const FlowRule &rule = it.second;
+    bess::pb::PMDPortListFlowRulesResponse::Rule *r = resp.add_rules();
+    r->set_id(it.first);
+    *r->mutable_rule() = rule.arg;
+
+    if (!rule.counted) {
+      continue;
+    }
+
+    struct rte_flow_action count[] = {
+        {RTE_FLOW_ACTION_TYPE_COUNT, nullptr},
+        {RTE_FLOW_ACTION_TYPE_END, nullptr},
+    };
+    struct rte_flow_query_count stats = {};
+    struct rte_flow_error err = {};
+    if (rte_flow_query(dpdk_port_id_, rule.flow, count, &stats, &err) == 0) {
+      r->set_counted(true);
+      r->set_packets(stats.hits_set ? stats.hits : 0);
+      r->set_bytes(stats.bytes_set ? stats.bytes : 0);
+    }
+  }
+
+  return CommandSuccess(resp);
+}
+
+void PMDPort::DestroyFlowRules() {
+  for (const auto &it : flow_rules_) {
+    struct rte_flow_error err = {};
+    if (rte_flow_destroy(dpdk_port_id_, it.second.flow, &err) != 0) {
+      LOG(WARNING) << "rte_flow_destroy() failed for flow rule " << it.first
+                   << ": " << (err.message ?: "unknown error");
+    }
+  }
+  flow_rules_.clear();
+}
+
+void PMDPort::InitQueueXstats() {
+  // Generic names that ethdev (or the PMD itself) uses for per-queue counters.
+  // Not every device has all of them; missing ones stay zero.
+  static const struct {
+    packet_dir_t dir;
+    const char *fmt;
+    uint64_t QueueCounters::*counter;
+  } kQueueXstats[] = {
+      {PACKET_DIR_INC, "rx_q%hhu_packets", &QueueCounters::packets},
+      {PACKET_DIR_INC, "rx_q%hhu_bytes", &QueueCounters::bytes},
+      {PACKET_DIR_INC, "rx_q%hhu_errors", &QueueCounters::dropped},
+      {PACKET_DIR_OUT, "tx_q%hhu_packets", &QueueCounters::packets},
+      {PACKET_DIR_OUT, "tx_q%hhu_bytes", &QueueCounters::bytes},
+  };
+
+  queue_xstats_.clear();
+  queue_xstat_ids_.clear();
+
+  for (const auto &x : kQueueXstats) {
+    for (queue_t qid = 0; qid < num_queues[x.dir]; qid++) {
+      std::string name = bess::utils::Format(x.fmt, qid);
+      uint64_t id;
+      if (rte_eth_xstats_get_id_by_name(dpdk_port_id_, name.c_str(), &id) ==
+          0) {
+        queue_xstats_.push_back({x.dir, qid, x.counter});
+        queue_xstat_ids_.push_back(id);
+      }
+    }
+  }
+  queue_xstat_values_.resize(queue_xstat_ids_.size());
+
+  port_stats_.inc_queues.assign(num_queues[PACKET_DIR_INC], QueueCounters());
+  port_stats_.out_queues.assign(num_queues[PACKET_DIR_OUT], QueueCounters());
+}
+
 void PMDPort::CollectStats(bool reset) {
+  std::lock_guard<std::mutex> lock(xstats_mutex_);
+
   if (reset) {
     rte_eth_stats_reset(dpdk_port_id_);
+    rte_eth_xstats_reset(dpdk_port_id_);
     return;
   }
 
@@ -709,11 +1214,559 @@ void PMDPort::CollectStats(bool reset) {
   port_stats_.inc.bytes = stats.ibytes;
   port_stats_.out.packets = stats.opackets;
   port_stats_.out.bytes = stats.obytes;
+
+  int n = queue_xstat_ids_.size();
+  if (n == 0) {
+    return;
+  }
+  ret = rte_eth_xstats_get_by_id(dpdk_port_id_, queue_xstat_ids_.data(),
+                                 queue_xstat_values_.data(), n);
+  if (ret != n) {
+    VLOG(1) << "rte_eth_xstats_get_by_id(" << static_cast<int>(dpdk_port_id_)
+            << ") returned " << ret << ", expected " << n;
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    const QueueXstat &x = queue_xstats_[i];
+    auto &queues = (x.dir == PACKET_DIR_INC) ? port_stats_.inc_queues
+                                             : port_stats_.out_queues;
+    queues[x.qid].*x.counter = queue_xstat_values_[i];
+  }
+}
+
+CommandResponse PMDPort::CommandGetXstats(
+    const bess::pb::PMDPortGetXstatsArg &arg) {
+  int n = rte_eth_xstats_get_names(dpdk_port_id_, nullptr, 0);
+  if (n < 0) {
+    return CommandFailure(-n, "rte_eth_xstats_get_names() failed");
+  }
+
+  std::vector<rte_eth_xstat_name> names(n);
+  std::vector<rte_eth_xstat> xstats(n);
+  int ret = rte_eth_xstats_get_names(dpdk_port_id_, names.data(), n);
+  if (ret < 0 || ret > n) {
+    return CommandFailure(ret < 0 ? -ret : EAGAIN,
+                          "rte_eth_xstats_get_names() failed");
+  }
+  {
+    std::lock_guard<std::mutex> lock(xstats_mutex_);
+    ret = rte_eth_xstats_get(dpdk_port_id_, xstats.data(), n);
+  }
+  if (ret < 0 || ret > n) {
+    return CommandFailure(ret < 0 ? -ret : EAGAIN,
+                          "rte_eth_xstats_get() failed");
+  }
+
+  bess::pb::PMDPortGetXstatsResponse resp;
+  for (int i = 0; i < ret; i++) {
+    const rte_eth_xstat &x = xstats[i];
+    if (x.id >= names.size() || (arg.nonzero() && x.value == 0)) {
+      continue;
+    }
+
+    const char *name = names[x.id].name;
+    bool match = arg.filter_size() == 0;
+    for (const auto &f : arg.filter()) {
+      if (strstr(name, f.c_str())) {
+        match = true;
+        break;
+      }
+    }
+    if (!match) {
+      continue;
+    }
+
+    auto *xstat = resp.add_xstats();
+    xstat->set_name(name);
+    xstat->set_value(x.value);
+  }
+
+  return CommandSuccess(resp);
+}
+
+int PMDPort::GetReta(std::vector<uint16_t> *reta) {
+  rte_eth_dev_info dev_info;
+  int ret = get_eth_dev_info(dpdk_port_id_, &dev_info);
+  if (ret != 0) {
+    return ret;
+  }
+  if (dev_info.reta_size == 0) {
+    return -ENOTSUP;
+  }
+
+  std::vector<rte_eth_rss_reta_entry64> conf(
+      (dev_info.reta_size + RTE_ETH_RETA_GROUP_SIZE - 1) /
+      RTE_ETH_RETA_GROUP_SIZE);
+  for (auto &group : conf) {
+    group.mask = ~0ULL;
+  }
+  ret = rte_eth_dev_rss_reta_query(dpdk_port_id_, conf.data(),
+                                   dev_info.reta_size);
+  if (ret != 0) {
+    return ret;
+  }
+
+  reta->resize(dev_info.reta_size);
+  for (size_t i = 0; i < reta->size(); i++) {
+    (*reta)[i] = conf[i / RTE_ETH_RETA_GROUP_SIZE]
+                     .reta[i % RTE_ETH_RETA_GROUP_SIZE];
+  }
+  return 0;
+}
+
+int PMDPort::SetReta(const std::vector<uint16_t> &reta) {
+  std::vector<rte_eth_rss_reta_entry64> conf(
+      (reta.size() + RTE_ETH_RETA_GROUP_SIZE - 1) / RTE_ETH_RETA_GROUP_SIZE);
+  for (size_t i = 0; i < reta.size(); i++) {
+    auto &group = conf[i / RTE_ETH_RETA_GROUP_SIZE];
+    group.mask |= 1ULL << (i % RTE_ETH_RETA_GROUP_SIZE);
+    group.reta[i % RTE_ETH_RETA_GROUP_SIZE] = reta[i];
+  }
+  return rte_eth_dev_rss_reta_update(dpdk_port_id_, conf.data(), reta.size());
+}
+
+CommandResponse PMDPort::CommandGetRss(const bess::pb::EmptyArg &) {
+  rte_eth_dev_info dev_info;
+  int ret = get_eth_dev_info(dpdk_port_id_, &dev_info);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_info_get() failed");
+  }
+
+  bess::pb::PMDPortRssConfig resp;
+
+  std::vector<uint16_t> reta;
+  {
+    std::lock_guard<std::mutex> lock(rss_mutex_);
+    ret = GetReta(&reta);
+  }
+  if (ret == 0) {
+    for (uint16_t q : reta) {
+      resp.add_reta(q);
+    }
+  } else if (ret != -ENOTSUP) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_reta_query() failed");
+  }
+
+  std::vector<uint8_t> key(dev_info.hash_key_size);
+  rte_eth_rss_conf rss_conf = {};
+  rss_conf.rss_key = key.empty() ? nullptr : key.data();
+  rss_conf.rss_key_len = key.size();
+  ret = rte_eth_dev_rss_hash_conf_get(dpdk_port_id_, &rss_conf);
+  if (ret == 0) {
+    resp.set_key(key.data(), key.size());
+    uint64_t rest = rss_conf.rss_hf;
+    for (const auto &t : kRssTypes) {
+      if ((rest & t.rss_hf) == t.rss_hf) {
+        resp.add_hash_types(t.name);
+        rest &= ~t.rss_hf;
+      }
+    }
+    if (rest) {
+      resp.add_hash_types(bess::utils::Format("0x%" PRIx64, rest));
+    }
+  } else if (ret != -ENOTSUP) {
+    return CommandFailure(-ret, "rte_eth_dev_rss_hash_conf_get() failed");
+  }
+
+  return CommandSuccess(resp);
+}
+
+CommandResponse PMDPort::CommandSetRss(const bess::pb::PMDPortRssConfig &arg) {
+  rte_eth_dev_info dev_info;
+  int ret = get_eth_dev_info(dpdk_port_id_, &dev_info);
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_eth_dev_info_get() failed");
+  }
+
+  uint32_t num_rxq = num_queues[PACKET_DIR_INC];
+  std::vector<uint16_t> reta;
+
+  if (arg.reta_size() > 0 && arg.queues_size() > 0) {
+    return CommandFailure(EINVAL, "specify either 'reta' or 'queues'");
+  } else if (arg.reta_size() > 0) {
+    if (static_cast<uint32_t>(arg.reta_size()) != dev_info.reta_size) {
+      return CommandFailure(EINVAL, "'reta' must have %hu entries",
+                            dev_info.reta_size);
+    }
+    for (uint32_t q : arg.reta()) {
+      if (q >= num_rxq) {
+        return CommandFailure(EINVAL, "queue %u is not in [0,%u)", q, num_rxq);
+      }
+      reta.push_back(q);
+    }
+  } else if (arg.queues_size() > 0) {
+    for (uint32_t q : arg.queues()) {
+      if (q >= num_rxq) {
+        return CommandFailure(EINVAL, "queue %u is not in [0,%u)", q, num_rxq);
+      }
+    }
+    for (uint16_t i = 0; i < dev_info.reta_size; i++) {
+      reta.push_back(arg.queues(i % arg.queues_size()));
+    }
+  }
+
+  if (!reta.empty() && dev_info.reta_size == 0) {
+    return CommandFailure(ENOTSUP, "Device has no redirection table");
+  }
+
+  if (!arg.key().empty() || arg.hash_types_size() > 0) {
+    std::vector<uint8_t> key(dev_info.hash_key_size);
+    rte_eth_rss_conf rss_conf = {};
+    rss_conf.rss_key = key.empty() ? nullptr : key.data();
+    rss_conf.rss_key_len = key.size();
+    ret = rte_eth_dev_rss_hash_conf_get(dpdk_port_id_, &rss_conf);
+    if (ret != 0) {
+      return CommandFailure(-ret, "rte_eth_dev_rss_hash_conf_get() failed");
+    }
+
+    if (!arg.key().empty()) {
+      if (arg.key().size() != key.size()) {
+        return CommandFailure(EINVAL, "'key' must be %zu bytes long",
+                              key.size());
+      }
+      memcpy(key.data(), arg.key().data(), key.size());
+    }
+
+    if (arg.hash_types_size() > 0) {
+      rss_conf.rss_hf = 0;
+      for (const auto &name : arg.hash_types()) {
+        uint64_t rss_hf;
+        if (!parse_rss_type(name, &rss_hf)) {
+          return CommandFailure(EINVAL, "Unknown hash type '%s'",
+                                name.c_str());
+        }
+        rss_conf.rss_hf |= rss_hf;
+      }
+      // Like default_eth_conf(), ignore what the device cannot hash on.
+      rss_conf.rss_hf &= dev_info.flow_type_rss_offloads |
+                         RTE_ETH_RSS_LEVEL_MASK | RTE_ETH_RSS_L3_SRC_ONLY |
+                         RTE_ETH_RSS_L3_DST_ONLY | RTE_ETH_RSS_L4_SRC_ONLY |
+                         RTE_ETH_RSS_L4_DST_ONLY;
+    }
+
+    ret = rte_eth_dev_rss_hash_update(dpdk_port_id_, &rss_conf);
+    if (ret != 0) {
+      return CommandFailure(-ret, "rte_eth_dev_rss_hash_update() failed");
+    }
+  }
+
+  if (!reta.empty()) {
+    std::lock_guard<std::mutex> lock(rss_mutex_);
+    ret = SetReta(reta);
+    if (ret != 0) {
+      return CommandFailure(-ret, "rte_eth_dev_rss_reta_update() failed");
+    }
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::CommandSetRssRebalancer(
+    const bess::pb::PMDPortRssRebalancerArg &arg) {
+  if (!arg.enable()) {
+    rss_rebalancer_.Terminate();
+    rss_rebalancer_.Reset();
+    return CommandSuccess();
+  }
+
+  if (num_queues[PACKET_DIR_INC] < 2) {
+    return CommandFailure(EINVAL, "Port has only one RX queue");
+  }
+  std::vector<uint16_t> reta;
+  int ret = GetReta(&reta);
+  if (ret != 0) {
+    return CommandFailure(-ret, "Cannot read the redirection table");
+  }
+
+  double interval = arg.interval() ?: 1.0;
+  if (interval < 0.001) {
+    return CommandFailure(EINVAL, "'interval' must be at least 1ms");
+  }
+  double threshold = arg.threshold() ?: 1.2;
+  if (threshold < 1.0) {
+    return CommandFailure(EINVAL, "'threshold' must be at least 1.0");
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(rss_mutex_);
+    rss_interval_.tv_sec = static_cast<time_t>(interval);
+    rss_interval_.tv_nsec =
+        static_cast<long>((interval - rss_interval_.tv_sec) * 1e9);
+    rss_threshold_ = threshold;
+    rss_max_moves_ = arg.max_moves();
+    rss_last_packets_.clear();
+  }
+
+  if (rss_rebalancer_.Done()) {
+    rss_rebalancer_.Terminate();
+    rss_rebalancer_.Reset();
+  }
+  // If already running, it picks up the new parameters by itself.
+  if (!rss_rebalancer_.Start() && errno != EINVAL) {
+    return CommandFailure(errno, "Failed to start the rebalancer thread");
+  }
+
+  return CommandSuccess();
+}
+
+void PMDPort::ReadRxQueuePackets(std::vector<uint64_t> *packets) {
+  queue_t num_rxq = num_queues[PACKET_DIR_INC];
+  std::vector<uint64_t> ids;
+  std::vector<queue_t> qids;
+
+  packets->assign(num_rxq, 0);
+
+  for (size_t i = 0; i < queue_xstats_.size(); i++) {
+    const QueueXstat &x = queue_xstats_[i];
+    if (x.dir == PACKET_DIR_INC && x.counter == &QueueCounters::packets) {
+      ids.push_back(queue_xstat_ids_[i]);
+      qids.push_back(x.qid);
+    }
+  }
+
+  if (ids.size() == num_rxq) {
+    std::vector<uint64_t> values(ids.size());
+    int n = ids.size();
+    int ret;
+    {
+      std::lock_guard<std::mutex> lock(xstats_mutex_);
+      ret = rte_eth_xstats_get_by_id(dpdk_port_id_, ids.data(), values.data(),
+                                     n);
+    }
+    if (ret == n) {
+      for (int i = 0; i < n; i++) {
+        (*packets)[qids[i]] = values[i];
+      }
+      return;
+    }
+  }
+
+  // The device has no per-queue counters: count what PortInc/QueueInc got.
+  for (queue_t qid = 0; qid < num_rxq; qid++) {
+    const BatchHistogram &hist = queue_stats[PACKET_DIR_INC][qid].actual_hist;
+    for (size_t i = 0; i < hist.size(); i++) {
+      (*packets)[qid] += i * hist[i];
+    }
+  }
+}
+
+void PMDPort::RebalanceRss() {
+  std::vector<uint64_t> packets;
+  ReadRxQueuePackets(&packets);
+  uint64_t now = rdtsc();
+
+  std::lock_guard<std::mutex> lock(rss_mutex_);
+
+  // A counter going backwards was reset: start over from the new values
+  bool reset = false;
+  for (size_t q = 0; q < packets.size() && q < rss_last_packets_.size(); q++) {
+    reset |= packets[q] < rss_last_packets_[q];
+  }
+
+  if (!reset && rss_last_packets_.size() == packets.size() &&
+      now > rss_last_tsc_) {
+    double secs = static_cast<double>(now - rss_last_tsc_) / tsc_hz;
+    std::vector<double> rates(packets.size());
+    for (size_t q = 0; q < packets.size(); q++) {
+      rates[q] = (packets[q] - rss_last_packets_[q]) / secs;
+    }
+
+    std::vector<uint16_t> reta;
+    if (GetReta(&reta) == 0) {
+      size_t moved = bess::utils::RebalanceReta(&reta, rates, rss_threshold_,
+                                                rss_max_moves_);
+      if (moved > 0) {
+        int ret = SetReta(reta);
+        if (ret != 0) {
+          LOG(WARNING) << name() << ": rte_eth_dev_rss_reta_update() failed: "
+                       << rte_strerror(-ret);
+        } else {
+          VLOG(1) << name() << ": moved " << moved << " RSS buckets";
+        }
+      }
+    }
+  }
+
+  rss_last_packets_ = packets;
+  rss_last_tsc_ = now;
+}
+
+void PMDPortRssRebalancer::Run() {
+  while (true) {
+    struct timespec interval;
+    {
+      std::lock_guard<std::mutex> lock(owner_->rss_mutex_);
+      interval = owner_->rss_interval_;
+    }
+
+    ppoll(nullptr, 0, &interval, Sigmask());
+    if (IsExitRequested()) {
+      return;
+    }
+
+    owner_->RebalanceRss();
+  }
+}
+
+CommandResponse PMDPort::ConfigureRxTimestamp(dpdk_port_t port_id,
+                                              const rte_eth_dev_info &dev_info,
+                                              int num_rxq,
+                                              rte_eth_conf *eth_conf) {
+  int ret = bess::Packet::RegisterRxTimestamp();
+  if (ret != 0) {
+    return CommandFailure(-ret, "rte_mbuf_dyn_rx_timestamp_register() failed");
+  }
+
+  // Offloaded timestamps are useless without rte_eth_read_clock() to convert
+  // them, so check for it before the PMD starts attaching them to packets
+  uint64_t ticks;
+  if ((dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP) &&
+      rte_eth_read_clock(port_id, &ticks) != -ENOTSUP) {
+    eth_conf->rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+    rx_timestamp_ = RxTimestamp::kOffload;
+  } else if (num_rxq > 1) {
+    // Workers polling different queues would race for the one latched
+    // timestamp of the port
+    LOG(WARNING) << "Port " << name() << " has IEEE 1588 RX timestamps only,"
+                 << " which need a single RX queue; using software timestamps";
+    rx_timestamp_ = RxTimestamp::kNone;
+  } else {
+    // Can only be enabled once the device is started
+    rx_timestamp_ = RxTimestamp::kIeee1588;
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse PMDPort::StartRxTimestamp() {
+  if (rx_timestamp_ == RxTimestamp::kIeee1588) {
+    int ret = rte_eth_timesync_enable(dpdk_port_id_);
+    if (ret != 0) {
+      LOG(WARNING) << "Port " << name() << " has no hardware RX timestamps ("
+                   << rte_strerror(-ret) << "), using software timestamps";
+      rx_timestamp_ = RxTimestamp::kNone;
+      return CommandSuccess();
+    }
+  }
+
+  // Estimate the clock rate over a short interval to begin with. Each RX
+  // queue then refines it whenever it re-anchors its clock.
+  RxClock clock = {};
+  SyncRxClock(&clock);
+  usleep(10000);
+  SyncRxClock(&clock);
+
+  if (clock.ns_per_tick <= 0.0) {
+    LOG(WARNING) << "Port " << name() << " cannot read the clock of its RX"
+                 << " timestamps, using software timestamps";
+    if (rx_timestamp_ == RxTimestamp::kIeee1588) {
+      rte_eth_timesync_disable(dpdk_port_id_);
+      rx_timestamp_ = RxTimestamp::kNone;
+    } else {
+      // The offload stays on until the port is reconfigured
+      rx_timestamp_ = RxTimestamp::kStrip;
+    }
+    return CommandSuccess();
+  }
+
+  for (RxClock &rx_clock : rx_clocks_) {
+    rx_clock = clock;
+  }
+
+  return CommandSuccess();
+}
+
+int PMDPort::ReadDeviceClock(uint64_t *ticks) {
+  if (rx_timestamp_ == RxTimestamp::kOffload) {
+    return rte_eth_read_clock(dpdk_port_id_, ticks);
+  }
+
+  struct timespec ts;
+  int ret = rte_eth_timesync_read_time(dpdk_port_id_, &ts);
+  if (ret == 0) {
+    *ticks = rte_timespec_to_ns(&ts);
+  }
+  return ret;
+}
+
+void PMDPort::SyncRxClock(RxClock *clock) {
+  uint64_t ticks;
+  uint64_t before = rdtsc();
+  int ret = ReadDeviceClock(&ticks);
+  uint64_t after = rdtsc();
+
+  // Re-anchor every 100ms, or retry in a second if the clock is unreadable
+  if (ret != 0) {
+    clock->next_sync_tsc = after + tsc_hz;
+    return;
+  }
+  clock->next_sync_tsc = after + tsc_hz / 10;
+
+  uint64_t host_ns = tsc_to_ns(before + (after - before) / 2);
+
+  if (clock->host_ns != 0 && ticks > clock->dev_ticks) {
+    double ns_per_tick = static_cast<double>(host_ns - clock->host_ns) /
+                         (ticks - clock->dev_ticks);
+    // Smooth out the jitter of reading the two clocks
+    clock->ns_per_tick = (clock->ns_per_tick > 0.0)
+                             ? 0.9 * clock->ns_per_tick + 0.1 * ns_per_tick
+                             : ns_per_tick;
+  }
+
+  clock->dev_ticks = ticks;
+  clock->host_ns = host_ns;
+}
+
+void PMDPort::ConvertRxTimestamps(queue_t qid, bess::Packet **pkts, int cnt) {
+  if (rx_timestamp_ == RxTimestamp::kStrip) {
+    for (int i = 0; i < cnt; i++) {
+      pkts[i]->clear_rx_timestamp();
+    }
+    return;
+  }
+
+  RxClock *clock = &rx_clocks_[qid];
+
+  if (rdtsc() >= clock->next_sync_tsc) {
+    SyncRxClock(clock);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    uint64_t ticks;
+
+    if (rx_timestamp_ == RxTimestamp::kOffload) {
+      if (!pkt->has_rx_timestamp()) {
+        continue;
+      }
+      ticks = pkt->rx_timestamp();
+    } else {
+      const rte_mbuf *m = reinterpret_cast<const rte_mbuf *>(pkt);
+      struct timespec ts;
+      if (!(m->ol_flags & RTE_MBUF_F_RX_IEEE1588_TMST) ||
+          rte_eth_timesync_read_rx_timestamp(dpdk_port_id_, &ts,
+                                             m->timesync) != 0) {
+        continue;
+      }
+      ticks = rte_timespec_to_ns(&ts);
+    }
+
+    // Timestamps may well predate the anchor
+    int64_t delta = static_cast<int64_t>(ticks - clock->dev_ticks);
+    pkt->set_rx_timestamp(clock->host_ns +
+                          static_cast<int64_t>(delta * clock->ns_per_tick));
+  }
 }
 
 int PMDPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
-  return rte_eth_rx_burst(dpdk_port_id_, qid,
-                          reinterpret_cast<rte_mbuf **>(pkts), cnt);
+  int recv = rte_eth_rx_burst(dpdk_port_id_, qid,
+                              reinterpret_cast<rte_mbuf **>(pkts), cnt);
+
+  if (rx_timestamp_ != RxTimestamp::kNone && recv > 0) {
+    ConvertRxTimestamps(qid, pkts, recv);
+  }
+
+  return recv;
 }
 
 int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
@@ -728,6 +1781,23 @@ int PMDPort::SendPackets(queue_t qid, bess::Packet **pkts, int cnt) {
   return sent;
 }
 
+int PMDPort::RxInterruptCtl(queue_t qid, bool add, void *data) {
+  if (!rx_interrupt_) {
+    return -ENOTSUP;
+  }
+  return rte_eth_dev_rx_intr_ctl_q(
+      dpdk_port_id_, qid, RTE_EPOLL_PER_THREAD,
+      add ? RTE_INTR_EVENT_ADD : RTE_INTR_EVENT_DEL, data);
+}
+
+int PMDPort::EnableRxInterrupt(queue_t qid, bool enable) {
+  if (!rx_interrupt_) {
+    return -ENOTSUP;
+  }
+  return enable ? rte_eth_dev_rx_intr_enable(dpdk_port_id_, qid)
+                : rte_eth_dev_rx_intr_disable(dpdk_port_id_, qid);
+}
+
 Port::LinkStatus PMDPort::GetLinkStatus() {
   rte_eth_link status = {};
   // rte_eth_link_get() may block up to 9 seconds, so use _nowait() variant.
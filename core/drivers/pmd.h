@@ -33,14 +33,19 @@
 #ifndef BESS_DRIVERS_PMD_H_
 #define BESS_DRIVERS_PMD_H_
 
+#include <map>
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <rte_config.h>
 #include <rte_errno.h>
 #include <rte_ethdev.h>
+#include <rte_flow.h>
 
 #include "../module.h"
 #include "../port.h"
+#include "../utils/syscallthread.h"
 
 typedef uint16_t dpdk_port_t;
 
@@ -49,13 +54,45 @@ typedef uint16_t dpdk_port_t;
  * This driver binds a port to a device using DPDK.
  * This is the recommended driver for performance.
  */
+class PMDPort;
+
+// Periodically rebalances the RSS redirection table of a PMDPort.
+// We promise to block only in ppoll(), and check IsExitRequested()
+// afterward, using the Sigmask() result as the signal mask.
+class PMDPortRssRebalancer final : public bess::utils::SyscallThreadPfuncs {
+ public:
+  explicit PMDPortRssRebalancer(PMDPort *owner) : owner_(owner) {}
+  void Run() override;
+
+ private:
+  PMDPort *owner_;
+};
+
 class PMDPort final : public Port {
  public:
+  static const PortCommands cmds;
+
   PMDPort()
       : Port(),
         dpdk_port_id_(DPDK_PORT_UNKNOWN),
         hot_plugged_(false),
-        node_placement_(UNCONSTRAINED_SOCKET) {}
+        node_placement_(UNCONSTRAINED_SOCKET),
+        rx_interrupt_(false),
+        rx_timestamp_(RxTimestamp::kNone),
+        rx_clocks_(),
+        flow_rules_(),
+        next_flow_rule_id_(1),
+        queue_xstats_(),
+        queue_xstat_ids_(),
+        queue_xstat_values_(),
+        xstats_mutex_(),
+        rss_mutex_(),
+        rss_rebalancer_(this),
+        rss_interval_(),
+        rss_threshold_(),
+        rss_max_moves_(),
+        rss_last_packets_(),
+        rss_last_tsc_() {}
 
   void InitDriver() override;
 
@@ -131,6 +168,13 @@ class PMDPort final : public Port {
 
   CommandResponse UpdateConf(const Conf &conf) override;
 
+  /*!
+   * RX interrupts are only available if the port was created with
+   * `rx_interrupt` set.
+   */
+  int RxInterruptCtl(queue_t qid, bool add, void *data) override;
+  int EnableRxInterrupt(queue_t qid, bool enable) override;
+
   /*!
    * Get any placement constraints that need to be met when receiving from this
    * port.
@@ -139,7 +183,99 @@ class PMDPort final : public Port {
     return node_placement_;
   }
 
+  /*!
+   * Hardware flow rules (rte_flow): match on L2-L4 and GTP-U header fields,
+   * then steer to a queue, spread with RSS, or drop, optionally marking the
+   * packets. Each rule also gets a hit counter if the NIC supports it.
+   */
+  CommandResponse CommandAddFlowRule(const bess::pb::PMDPortFlowRuleArg &arg);
+  CommandResponse CommandDeleteFlowRule(
+      const bess::pb::PMDPortDeleteFlowRuleArg &arg);
+  CommandResponse CommandListFlowRules(const bess::pb::EmptyArg &arg);
+
+  /*!
+   * Reads the device's extended statistics, optionally filtered by name.
+   */
+  CommandResponse CommandGetXstats(const bess::pb::PMDPortGetXstatsArg &arg);
+
+  /*!
+   * RSS redirection table, hash key and hash types, and the optional
+   * rebalancer thread that keeps adjusting the table.
+   */
+  CommandResponse CommandGetRss(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandSetRss(const bess::pb::PMDPortRssConfig &arg);
+  CommandResponse CommandSetRssRebalancer(
+      const bess::pb::PMDPortRssRebalancerArg &arg);
+
  private:
+  friend class PMDPortRssRebalancer;
+
+  // Where hardware RX timestamps come from (see PMDPortArg.hw_timestamp)
+  enum class RxTimestamp {
+    kNone = 0,
+    kOffload,   // RTE_ETH_RX_OFFLOAD_TIMESTAMP, as rte_eth_read_clock() ticks
+    kIeee1588,  // rte_eth_timesync_read_rx_timestamp(), PTP frames only.
+                // The device latches one RX timestamp at a time, for the
+                // whole port, so this is only used with a single RX queue.
+    kStrip,     // Offload enabled, but its clock turned out unusable: the
+                // unconverted timestamps of the PMD are removed
+  };
+
+  // Maps the device clock to tsc_to_ns(). Each RX queue has its own, so that
+  // the worker polling it can keep it in sync without locking.
+  struct RxClock {
+    uint64_t dev_ticks;
+    uint64_t host_ns;
+    double ns_per_tick;
+    uint64_t next_sync_tsc;
+  };
+
+  struct FlowRule {
+    struct rte_flow *flow;
+    bess::pb::PMDPortFlowRuleArg arg;
+    bool counted;  // Has a COUNT action, for rte_flow_query()
+  };
+
+  // A per-queue xstat that CollectStats() copies into port_stats_.
+  struct QueueXstat {
+    packet_dir_t dir;
+    queue_t qid;
+    uint64_t QueueCounters::*counter;
+  };
+
+  void DestroyFlowRules();
+
+  // Looks up the xstat IDs of the per-queue counters once, so that
+  // CollectStats() only needs a single rte_eth_xstats_get_by_id() call.
+  void InitQueueXstats();
+
+  // Reads and writes the whole RSS redirection table. Return 0 or -errno.
+  int GetReta(std::vector<uint16_t> *reta);
+  int SetReta(const std::vector<uint16_t> &reta);
+
+  // Packets received so far on each RX queue. The counters go backwards when
+  // the port stats are reset.
+  void ReadRxQueuePackets(std::vector<uint64_t> *packets);
+
+  // One step of the rebalancer thread.
+  void RebalanceRss();
+
+  // Sets up hardware RX timestamps, before and after the device is started.
+  // Falls back to software timestamps (kNone) where they cannot work.
+  CommandResponse ConfigureRxTimestamp(dpdk_port_t port_id,
+                                       const rte_eth_dev_info &dev_info,
+                                       int num_rxq, rte_eth_conf *eth_conf);
+  CommandResponse StartRxTimestamp();
+
+  // Reads the clock that RX timestamps are in. Returns 0 or -errno.
+  int ReadDeviceClock(uint64_t *ticks);
+
+  // Re-anchors 'clock' to the current time, and refines its rate.
+  void SyncRxClock(RxClock *clock);
+
+  // Converts the hardware timestamps of received packets.
+  void ConvertRxTimestamps(queue_t qid, bess::Packet **pkts, int cnt);
+
   /*!
    * The DPDK port ID number (set after binding).
    */
@@ -157,6 +293,33 @@ class PMDPort final : public Port {
   placement_constraint node_placement_;
 
   std::string driver_;  // ixgbe, i40e, ...
+
+  bool rx_interrupt_;
+
+  RxTimestamp rx_timestamp_;
+  RxClock rx_clocks_[MAX_QUEUES_PER_DIR];
+
+  // Rules added with add_flow_rule, by ID
+  std::map<uint64_t, FlowRule> flow_rules_;
+  uint64_t next_flow_rule_id_;
+
+  std::vector<QueueXstat> queue_xstats_;
+  std::vector<uint64_t> queue_xstat_ids_;  // parallel to queue_xstats_
+  std::vector<uint64_t> queue_xstat_values_;
+
+  // Serializes reading and resetting the device counters: the rebalancer
+  // thread reads them while CollectStats() reads or resets them.
+  std::mutex xstats_mutex_;
+
+  // Serializes redirection table updates, and protects the rss_* fields
+  // below, which the rebalancer thread uses.
+  std::mutex rss_mutex_;
+  PMDPortRssRebalancer rss_rebalancer_;
+  struct timespec rss_interval_;
+  double rss_threshold_;
+  uint32_t rss_max_moves_;
+  std::vector<uint64_t> rss_last_packets_;
+  uint64_t rss_last_tsc_;
 };
 
 #endif  // BESS_DRIVERS_PMD_H_
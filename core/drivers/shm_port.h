@@ -0,0 +1,215 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_DRIVERS_SHM_PORT_H_
+#define BESS_DRIVERS_SHM_PORT_H_
+
+#include <sys/un.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "../message.h"
+#include "../packet_pool.h"
+#include "../port.h"
+
+#include "../utils/shm_ring.h"
+#include "../utils/syscallthread.h"
+
+class ShmPort;
+
+// Accepts peers and runs the handshake with them.
+// We promise to block only in ppoll(), and check IsExitRequested()
+// afterward, using the Sigmask() result as the signal mask.
+class ShmPortAcceptThread final : public bess::utils::SyscallThreadPfuncs {
+ public:
+  explicit ShmPortAcceptThread(ShmPort *owner) : owner_(owner) {}
+  void Run() override;
+
+ private:
+  // Sets up the shared memory for a newly accepted peer on `sock`.
+  // Returns false (and leaves `sock` open) if the handshake failed.
+  bool Handshake(int sock);
+
+  ShmPort *owner_;
+};
+
+/*!
+ * This driver exchanges packets with a local process (e.g., a containerized
+ * network function) through shared memory, without copies and without any
+ * kernel module.
+ *
+ * Packet buffers come from a ShmPacketPool (a "region"), whose data buffers
+ * (but not the Packet objects) the peer maps after a handshake over a UNIX
+ * socket; descriptor rings in both directions carry the buffers back and
+ * forth. See utils/shm_ring.h for the protocol, and for a minimal peer
+ * implementation.
+ *
+ * Ports that name the same region share its pool, so packets received from
+ * one peer can be sent to another one zero-copy. Packets from elsewhere are
+ * copied into the region once. Only one peer can be connected at a time.
+ */
+class ShmPort final : public Port {
+ public:
+  ShmPort()
+      : Port(),
+        ring_size_(),
+        num_queues_(),
+        pool_(),
+        accept_thread_(this),
+        listen_fd_(-1),
+        addr_(),
+        conn_(),
+        retired_(),
+        conn_lock_(),
+        rx_(),
+        tx_() {}
+
+  /*!
+   * Create (or join) the region and start listening for a peer.
+   *
+   * PARAMETERS:
+   * * string path : file name to bind the socket to ('@' for abstract).
+   * * uint32 ring_size : entries per descriptor ring (a power of 2).
+   * * string region : name of the packet region to use.
+   * * uint64 region_packets : number of packets, if the region is new.
+   */
+  CommandResponse Init(const bess::pb::ShmPortArg &arg);
+
+  /*!
+   * Disconnect the peer and take back all loaned packets.
+   */
+  void DeInit() override;
+
+  int RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+  int SendPackets(queue_t qid, bess::Packet **pkts, int cnt) override;
+
+  /*!
+   * The link is up while a peer is connected.
+   */
+  LinkStatus GetLinkStatus() override;
+
+ private:
+  friend class ShmPortAcceptThread;
+
+  static const uint32_t kDefaultRingSize = 1024;
+  static const uint64_t kDefaultRegionPackets = (1 << 16) - 1;
+
+  // A connected peer, and the ring area shared with it.
+  struct Connection {
+    int sock;
+    int rings_fd;
+    void *rings;
+    size_t rings_size;
+  };
+
+  // One direction of a queue, used only by the worker polling it.
+  struct Side {
+    // The connection this side works on.  The accept thread reads it, to
+    // know when a dropped connection is no longer in use.
+    std::atomic<Connection *> conn;
+
+    bess::utils::shm::Ring give;  // kFill (RX) or kTx (TX)
+    bess::utils::shm::Ring take;  // kRx (RX) or kComp (TX)
+
+    // Packets loaned to the peer, by loan id, and the ids not in use.
+    std::vector<bess::Packet *> loaned;
+    std::vector<uint32_t> free_ids;
+  };
+
+  // Accept thread: drops the current peer.
+  void Disconnect();
+
+  // Accept thread: frees dropped connections that no side uses anymore (or
+  // all of them).
+  void CollectConnections(bool all);
+
+  // Catches up with a (dis)connection. Returns true if a peer is connected.
+  // Switching connections takes conn_lock_, so that CollectConnections()
+  // never frees one that a side is about to use.
+  bool Sync(Side *s, queue_t qid, bool rx);
+
+  // Takes back all packets loaned through `s`.
+  void Reclaim(Side *s);
+
+  // Loans as many empty buffers as possible through kFill.
+  void Refill(Side *s);
+
+  // Takes back the buffers the peer is done with from kComp.
+  void ReapTx(Side *s);
+
+  // Rebuilds the mbuf fields of a packet that was on loan. The peer only
+  // ever had its data buffer, so this is just what a fresh packet would get.
+  static void ResetLoaned(bess::Packet *pkt);
+
+  // Ends the loan of `id`, and returns the packet, or nullptr if the id is
+  // not on loan.
+  bess::Packet *EndLoan(Side *s, uint32_t id) {
+    if (id >= s->loaned.size() || !s->loaned[id]) {
+      return nullptr;
+    }
+    bess::Packet *pkt = s->loaned[id];
+    s->loaned[id] = nullptr;
+    s->free_ids.push_back(id);
+    ResetLoaned(pkt);
+    return pkt;
+  }
+
+  // Region offset of `len` bytes at `data`, or -1 if outside the region.
+  int64_t RegionOffset(const void *data, uint32_t len) const {
+    const char *p = static_cast<const char *>(data);
+    if (p < pool_->base() || p + len > pool_->base() + pool_->size()) {
+      return -1;
+    }
+    return p - pool_->base();
+  }
+
+  uint32_t ring_size_;
+  uint32_t num_queues_;
+  bess::ShmPacketPool *pool_;
+
+  ShmPortAcceptThread accept_thread_;
+  int listen_fd_;
+  struct sockaddr_un addr_;
+
+  // The connected peer, or nullptr.  Written by the accept thread only.
+  std::atomic<Connection *> conn_;
+
+  // Dropped connections, possibly still in use by some sides.
+  std::vector<Connection *> retired_;
+
+  // Held while a side switches connections, and while retired_ is collected.
+  std::mutex conn_lock_;
+
+  std::vector<std::unique_ptr<Side>> rx_;
+  std::vector<std::unique_ptr<Side>> tx_;
+};
+
+#endif  // BESS_DRIVERS_SHM_PORT_H_
@@ -189,7 +189,16 @@ CommandResponse UnixSocketPort::Init(const bess::pb::UnixSocketPortArg &arg) {
 
   recv_iovecs_.fill({.iov_base = nullptr, .iov_len = 0});
   pkt_recv_vector_.fill(nullptr);
-  ReplenishRecvVector(bess::PacketBatch::kMaxBurst);
+
+  if (arg.io_uring()) {
+    ret = uring_rx_.Init(current_worker.packet_pool());
+    if (ret < 0) {
+      DeInit();
+      return CommandFailure(-ret, "io_uring setup failed");
+    }
+  } else {
+    ReplenishRecvVector(bess::PacketBatch::kMaxBurst);
+  }
 
   return CommandSuccess();
 }
@@ -208,6 +217,8 @@ void UnixSocketPort::DeInit() {
   for (auto *pkt : pkt_recv_vector_) {
     bess::Packet::Free(pkt);
   }
+
+  uring_rx_.Close();
 }
 
 int UnixSocketPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
@@ -220,6 +231,10 @@ int UnixSocketPort::RecvPackets(queue_t qid, bess::Packet **pkts, int cnt) {
     return 0;
   }
 
+  if (uring_rx_.is_initialized()) {
+    return uring_rx_.Recv(client_fd, current_worker.packet_pool(), pkts, cnt);
+  }
+
   uint64_t now_ns = current_worker.current_tsc();
   if (now_ns - last_idle_ns_ < min_rx_interval_ns_) {
     return 0;
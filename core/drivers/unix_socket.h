@@ -45,6 +45,7 @@
 #include "../message.h"
 #include "../port.h"
 
+#include "../utils/io_uring.h"
 #include "../utils/syscallthread.h"
 
 class UnixSocketPort;
@@ -81,13 +82,15 @@ class UnixSocketPort final : public Port {
         accept_thread_(this),
         listen_fd_(kNotConnectedFd),
         addr_(),
-        client_fd_(kNotConnectedFd) {}
+        client_fd_(kNotConnectedFd),
+        uring_rx_() {}
 
   /*!
    * Initialize the port, ie, open the socket.
    *
    * PARAMETERS:
    * * string path : file name to bind the socket to.
+   * * bool io_uring : receive with io_uring instead of recvmmsg().
    */
   CommandResponse Init(const bess::pb::UnixSocketPortArg &arg);
 
@@ -150,6 +153,13 @@ class UnixSocketPort final : public Port {
   // volatile.
   /* FD for client connection.*/
   volatile int client_fd_;
+
+  /*!
+   * In io_uring mode, a multishot receive fills packets in the background,
+   * and RecvPackets() only harvests them: no system call per poll, so no
+   * need for min_rx_interval_ns_ either.
+   */
+  bess::utils::UringPacketReceiver uring_rx_;
 };
 
 #endif  // BESS_DRIVERS_UNIXSOCKET_H_
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "capture_filter.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#include "../module.h"
+#include "../module_graph.h"
+#include "../utils/time.h"
+
+CaptureFilter::~CaptureFilter() {
+  if (has_filter_) {
+    bess::utils::FreeFilter(&filter_);
+  }
+}
+
+CommandResponse CaptureFilter::Init(const std::string &exp,
+                                    uint32_t sample_every, uint64_t max_pps,
+                                    uint32_t snaplen, uint32_t max_snaplen) {
+  if (max_pps > kMaxPps) {
+    return CommandFailure(EINVAL, "max_pps must be at most %lu", kMaxPps);
+  }
+
+  if (!exp.empty()) {
+    filter_.exp = exp;
+    int ret = bess::utils::CompileFilter(&filter_);
+    if (ret == -EINVAL) {
+      return CommandFailure(EINVAL, "BPF compilation error");
+    } else if (ret < 0) {
+      return CommandFailure(-ret, "BPF JIT compilation error");
+    }
+    has_filter_ = true;
+  }
+
+  sample_every_ = sample_every ? sample_every : 1;
+  max_pps_ = max_pps;
+  snaplen_ = (snaplen && snaplen < max_snaplen) ? snaplen : max_snaplen;
+
+  // Allow bursts of one full batch.
+  bucket_size_ = tsc_hz * bess::PacketBatch::kMaxBurst;
+
+  uint64_t now = rdtsc();
+  for (WorkerState &state : state_) {
+    state.countdown = 0;
+    state.tokens = bucket_size_;
+    state.last_tsc = now;
+  }
+
+  return CommandSuccess();
+}
+
+int CaptureFilter::Select(const bess::PacketBatch *batch, bess::Packet **out) {
+  WorkerState *state = &state_[current_worker.wid()];
+  int cnt = batch->cnt();
+  int n = 0;
+
+  if (max_pps_) {
+    // Refill the bucket once per batch.  Capping the elapsed time at one
+    // second keeps the product below 2^64.
+    uint64_t now = rdtsc();
+    uint64_t elapsed = std::min(now - state->last_tsc, tsc_hz);
+    state->last_tsc = now;
+    state->tokens = std::min(state->tokens + elapsed * max_pps_, bucket_size_);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    if (has_filter_ &&
+        !bess::utils::MatchFilter(filter_, pkt->head_data<u_char *>(),
+                                  pkt->total_len(), pkt->head_len())) {
+      continue;
+    }
+
+    if (state->countdown > 0) {
+      state->countdown--;
+      continue;
+    }
+    state->countdown = sample_every_ - 1;
+
+    if (max_pps_) {
+      if (state->tokens < tsc_hz) {
+        continue;
+      }
+      state->tokens -= tsc_hz;
+    }
+
+    out[n++] = pkt;
+  }
+
+  return n;
+}
+
+std::vector<bool> CaptureWorkers(const bess::Gate *gate) {
+  std::vector<bool> wids(Worker::kMaxWorkers, false);
+  if (gate && gate->module()) {
+    wids = gate->module()->active_workers();
+  }
+  if (std::none_of(wids.begin(), wids.end(), [](bool b) { return b; })) {
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      wids[wid] = is_worker_active(wid);
+    }
+  }
+  return wids;
+}
+
+namespace {
+
+std::mutex capture_writers_mutex;
+std::map<bess::utils::CaptureWriter *, const bess::Gate *> capture_writers;
+
+}  // namespace
+
+void RegisterCaptureWriter(const bess::Gate *gate,
+                           bess::utils::CaptureWriter *writer) {
+  std::lock_guard<std::mutex> lock(capture_writers_mutex);
+  capture_writers[writer] = gate;
+}
+
+void UnregisterCaptureWriter(bess::utils::CaptureWriter *writer) {
+  std::lock_guard<std::mutex> lock(capture_writers_mutex);
+  capture_writers.erase(writer);
+}
+
+void AllocCaptureRings() {
+  std::lock_guard<std::mutex> lock(capture_writers_mutex);
+  if (capture_writers.empty()) {
+    return;
+  }
+
+  // Only CheckSchedulingConstraints keeps active_workers() up to date, and a
+  // plain resume (e.g., after AddWorker) does not go through it.
+  ModuleGraph::PropagateActiveWorker();
+  for (const auto &it : capture_writers) {
+    it.first->AllocRings(CaptureWorkers(it.second));
+  }
+}
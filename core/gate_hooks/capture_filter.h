@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_GATE_HOOKS_CAPTURE_FILTER_
+#define BESS_GATE_HOOKS_CAPTURE_FILTER_
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../gate.h"
+#include "../message.h"
+#include "../packet.h"
+#include "../pktbatch.h"
+#include "../utils/bpf.h"
+#include "../utils/capture_ring.h"
+#include "../worker.h"
+
+// CaptureFilter picks the packets of a batch that a capture hook (Tcpdump,
+// Pcapng) should dump, before anything is copied or written:
+//  1. an optional pcap-filter(7) expression, run through the BPF JIT,
+//  2. optional 1-in-N sampling of the packets that passed the filter,
+//  3. an optional per-worker rate limit (token bucket, in packets/s).
+// It also keeps the snap length, i.e., how many bytes of each packet to dump.
+class CaptureFilter {
+ public:
+  // Upper bound for `max_pps`, which keeps the token bucket from overflowing.
+  static constexpr uint64_t kMaxPps = 1000000000;
+
+  CaptureFilter()
+      : filter_(),
+        has_filter_(false),
+        sample_every_(1),
+        max_pps_(0),
+        snaplen_(0),
+        bucket_size_(0),
+        state_() {}
+
+  ~CaptureFilter();
+
+  // `snaplen` == 0 means whole packets (up to `max_snaplen`).
+  CommandResponse Init(const std::string &exp, uint32_t sample_every,
+                       uint64_t max_pps, uint32_t snaplen,
+                       uint32_t max_snaplen);
+
+  // True if Select() may drop packets; if not, hooks can skip it.
+  bool active() const {
+    return has_filter_ || sample_every_ > 1 || max_pps_ > 0;
+  }
+
+  // Stores in `out` the packets of `batch` to capture, and returns how many.
+  // Only call this from a worker thread.
+  int Select(const bess::PacketBatch *batch, bess::Packet **out);
+
+  // Number of bytes of `pkt` to dump.
+  uint32_t CaptureLen(const bess::Packet *pkt) const {
+    uint32_t len = pkt->head_len();
+    return len < snaplen_ ? len : snaplen_;
+  }
+
+  uint32_t snaplen() const { return snaplen_; }
+
+ private:
+  struct alignas(64) WorkerState {
+    uint64_t countdown;  // packets to skip before the next sample
+    uint64_t tokens;     // in units of 1/tsc_hz packets
+    uint64_t last_tsc;
+  };
+
+  bess::utils::Filter filter_;
+  bool has_filter_;
+  uint64_t sample_every_;
+  uint64_t max_pps_;
+  uint32_t snaplen_;
+  uint64_t bucket_size_;
+
+  std::array<WorkerState, Worker::kMaxWorkers> state_;
+};
+
+// The workers that may run the hooks of `gate`, i.e., those attached to its
+// module, for which capture hooks set up their rings in async mode. If no
+// worker is attached yet (e.g., the pipeline is still being built), these are
+// all existing workers.
+std::vector<bool> CaptureWorkers(const bess::Gate *gate);
+
+// Workers launched or attached to the module after an async capture hook was
+// installed need rings too.  Hooks register their CaptureWriter here once it
+// runs, and unregister it before it goes away; AllocCaptureRings() then sets
+// up the missing rings of all registered writers.  It is called on the
+// control path by the "setup_capture_rings" resume hook, i.e., while all
+// workers are paused.
+void RegisterCaptureWriter(const bess::Gate *gate,
+                           bess::utils::CaptureWriter *writer);
+void UnregisterCaptureWriter(bess::utils::CaptureWriter *writer);
+void AllocCaptureRings();
+
+#endif  // BESS_GATE_HOOKS_CAPTURE_FILTER_
@@ -42,6 +42,7 @@
 
 #include "../message.h"
 #include "../utils/common.h"
+#include "../utils/pcap.h"
 #include "../utils/pcapng.h"
 #include "../utils/time.h"
 
@@ -88,12 +89,24 @@ void BytesToHexDump(const void *src, size_t len, char *dst) {
 
 const std::string Pcapng::kName = "PcapNg";
 
+const GateHookCommands Pcapng::cmds = {
+    {"get_stats", "EmptyArg", GATE_HOOK_CMD_FUNC(&Pcapng::CommandGetStats),
+     GateHookCommand::THREAD_SAFE}};
+
 Pcapng::Pcapng()
     : bess::GateHook(Pcapng::kName, "pcapng", Pcapng::kPriority),
+      filter_(),
       opener_(),
+      writer_(),
       attrs_(),
       attr_template_() {}
 
+Pcapng::~Pcapng() {
+  if (writer_) {
+    UnregisterCaptureWriter(writer_.get());
+  }
+}
+
 // Send the initialization data on the FIFO, once it's open.
 bool PcapngOpener::InitFifo(int fd) {
   SectionHeaderBlock shb = {
@@ -112,7 +125,7 @@ bool PcapngOpener::InitFifo(int fd) {
       .tot_len = sizeof(idb) + sizeof(uint32_t),
       .link_type = InterfaceDescriptionBlock::kEthernet,
       .reserved = 0,
-      .snap_len = 1518,
+      .snap_len = snaplen_,
   };
 
   uint32_t idb_tot_len = idb.tot_len;
@@ -132,6 +145,12 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
   Module *m = gate->module();
   std::string tmpl;
 
+  size_t ring_size = arg.ring_size() ? arg.ring_size()
+                                      : bess::utils::CaptureRing::kDefaultSize;
+  if (arg.async() && (ring_size & (ring_size - 1)) != 0) {
+    return CommandFailure(EINVAL, "ring_size must be a power of 2");
+  }
+
   size_t i = 0;
   for (const auto &it : m->all_attrs()) {
     tmpl += it.name + " = ";
@@ -161,6 +180,14 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
 
   attr_template_ = std::vector<char>(tmpl.begin(), tmpl.end());
 
+  CommandResponse err =
+      filter_.Init(arg.filter(), arg.sample_every(), arg.max_pps(),
+                   arg.snaplen(), PCAP_SNAPLEN);
+  if (err.error().code() != 0) {
+    return err;
+  }
+  opener_.set_snaplen(filter_.snaplen());
+
   int ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
@@ -170,9 +197,32 @@ CommandResponse Pcapng::Init(const bess::Gate *gate,
     return CommandFailure(-errno, "Failed to open FIFO");
   }
 
+  if (arg.async()) {
+    writer_.reset(new bess::utils::CaptureWriter(&opener_, Worker::kMaxWorkers,
+                                                 ring_size));
+    writer_->AllocRings(CaptureWorkers(gate));
+    if (!writer_->Start()) {
+      writer_.reset();
+      return CommandFailure(errno, "Failed to start writer thread");
+    }
+    RegisterCaptureWriter(gate, writer_.get());
+  }
+
   return CommandSuccess();
 }
 
+CommandResponse Pcapng::CommandGetStats(const bess::pb::EmptyArg &) {
+  if (!writer_) {
+    return CommandFailure(ENOTSUP, "statistics are only kept in async mode");
+  }
+
+  bess::pb::CaptureCommandGetStatsResponse r;
+  r.set_packets(writer_->records());
+  r.set_bytes(writer_->bytes());
+  r.set_dropped(writer_->dropped());
+  return CommandSuccess(r);
+}
+
 void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
   int fd;
   uint32_t gen;
@@ -181,6 +231,19 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
     return;
   }
 
+  bess::Packet *const *pkts = batch->pkts();
+  int cnt = batch->cnt();
+  bess::Packet *selected[bess::PacketBatch::kMaxBurst];
+
+  if (filter_.active()) {
+    cnt = filter_.Select(batch, selected);
+    pkts = selected;
+  }
+
+  if (cnt == 0) {
+    return;
+  }
+
   struct timeval tv;
 
   gettimeofday(&tv, nullptr);
@@ -188,8 +251,19 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
   uint64_t ts = tv.tv_sec * 1000000 + tv.tv_usec;
   uint16_t comment_size = static_cast<uint16_t>(attr_template_.size());
 
-  for (int i = 0; i < batch->cnt(); i++) {
-    bess::Packet *pkt = batch->pkts()[i];
+  bess::utils::CaptureRing *ring = nullptr;
+  if (writer_) {
+    ring = writer_->GetRing(current_worker.wid());
+    if (!ring) {
+      // This worker got attached after the hook was set up.
+      writer_->CountMissed(cnt);
+      return;
+    }
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    uint32_t len = filter_.CaptureLen(pkt);
 
     Option opt_comment = {
         .code = Option::kComment,
@@ -215,12 +289,12 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
         .type = EnhancedPacketBlock::kType,
         .tot_len = static_cast<uint32_t>(
             sizeof(epb) + sizeof(uint32_t) +
-            RoundUp<uint32_t>(pkt->head_len(), 4) + sizeof(opt_comment) +
+            RoundUp<uint32_t>(len, 4) + sizeof(opt_comment) +
             RoundUp<uint32_t>(comment_size, 4) + sizeof(opt_end)),
         .interface_id = 0,
         .timestamp_high = static_cast<uint32_t>(ts >> 32),
         .timestamp_low = static_cast<uint32_t>(ts),
-        .captured_len = static_cast<uint32_t>(pkt->head_len()),
+        .captured_len = len,
         .orig_len = static_cast<uint32_t>(pkt->total_len()),
     };
 
@@ -230,8 +304,8 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
 
     struct iovec vec[8] = {
         {&epb, sizeof(epb)},
-        {pkt->head_data(), static_cast<size_t>(pkt->head_len())},
-        {&padding, static_cast<size_t>(PadSize(pkt->head_len(), 4))},
+        {pkt->head_data(), len},
+        {&padding, PadSize<uint32_t>(len, 4)},
 
         {&opt_comment, sizeof(opt_comment)},
         {attr_template_.data(), comment_size},
@@ -240,6 +314,11 @@ void Pcapng::ProcessBatch(const bess::PacketBatch *batch) {
 
         {&epb_tot_len, sizeof(epb_tot_len)}};
 
+    if (ring) {
+      ring->Push(vec, 8);
+      continue;
+    }
+
     int ret = writev(fd, vec, 8);
     if (ret < 0) {
       if (errno == EPIPE) {
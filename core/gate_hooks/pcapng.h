@@ -33,29 +33,44 @@
 #ifndef BESS_GATE_HOOKS_PCAPNG_
 #define BESS_GATE_HOOKS_PCAPNG_
 
+#include <memory>
+
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_ring.h"
 #include "../utils/fifo_opener.h"
+#include "capture_filter.h"
 
 class PcapngOpener final : public bess::utils::FifoOpener {
  public:
-  PcapngOpener() : FifoOpener() {}
+  PcapngOpener() : FifoOpener(), snaplen_(1518) {}
   bool InitFifo(int fd) override;
+
+  // The snap length to announce in the Interface Description Block.
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
 };
 
 // Pcapng dumps copies of the packets seen by a gate (data + metadata) in
-// pcapng format.  Useful for debugging.
+// pcapng format.  Useful for debugging.  Like Tcpdump, it can hand the
+// FIFO writes off to a CaptureWriter thread (async mode).
 class Pcapng final : public bess::GateHook {
  public:
   Pcapng();
 
-  virtual ~Pcapng(){};
+  virtual ~Pcapng();
+
+  static const GateHookCommands cmds;
 
   CommandResponse Init(const bess::Gate *, const bess::pb::PcapngArg &);
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  CommandResponse CommandGetStats(const bess::pb::EmptyArg &);
+
   static constexpr uint16_t kPriority = 2;
   static const std::string kName;
 
@@ -69,9 +84,16 @@ class Pcapng final : public bess::GateHook {
     size_t tmpl_offset;
   };
 
+  // Picks the packets to dump, and how much of each.
+  CaptureFilter filter_;
+
   // The opener instance for the FIFO for the captured packets.
   PcapngOpener opener_;
 
+  // Only in async mode.  Declared after opener_ so that the writer thread is
+  // stopped before the opener goes away.
+  std::unique_ptr<bess::utils::CaptureWriter> writer_;
+
   // List of attributes to dump.
   std::vector<Attr> attrs_;
   // Preallocated string with attribute names and values.  For each packet,
@@ -45,21 +45,45 @@
 
 const std::string Tcpdump::kName = "TcpDump";
 
+const GateHookCommands Tcpdump::cmds = {
+    {"get_stats", "EmptyArg", GATE_HOOK_CMD_FUNC(&Tcpdump::CommandGetStats),
+     GateHookCommand::THREAD_SAFE}};
+
 bool TcpdumpOpener::InitFifo(int fd) {
-  static const struct pcap_hdr hdr = {
+  const struct pcap_hdr hdr = {
       .magic_number = PCAP_MAGIC_NUMBER,
       .version_major = PCAP_VERSION_MAJOR,
       .version_minor = PCAP_VERSION_MINOR,
       .thiszone = PCAP_THISZONE,
       .sigfigs = PCAP_SIGFIGS,
-      .snaplen = PCAP_SNAPLEN,
+      .snaplen = snaplen_,
       .network = PCAP_NETWORK,
   };
   return write(fd, &hdr, sizeof(hdr)) == sizeof(hdr);
 }
 
-CommandResponse Tcpdump::Init(const bess::Gate *,
+Tcpdump::~Tcpdump() {
+  if (writer_) {
+    UnregisterCaptureWriter(writer_.get());
+  }
+}
+
+CommandResponse Tcpdump::Init(const bess::Gate *gate,
                               const bess::pb::TcpdumpArg &arg) {
+  size_t ring_size = arg.ring_size() ? arg.ring_size()
+                                      : bess::utils::CaptureRing::kDefaultSize;
+  if (arg.async() && (ring_size & (ring_size - 1)) != 0) {
+    return CommandFailure(EINVAL, "ring_size must be a power of 2");
+  }
+
+  CommandResponse err =
+      filter_.Init(arg.filter(), arg.sample_every(), arg.max_pps(),
+                   arg.snaplen(), PCAP_SNAPLEN);
+  if (err.error().code() != 0) {
+    return err;
+  }
+  opener_.set_snaplen(filter_.snaplen());
+
   int ret = opener_.Init(arg.fifo(), arg.reconnect());
   if (ret < 0) {
     return CommandFailure(-errno, "inappropriate reinitialization");
@@ -69,9 +93,32 @@ CommandResponse Tcpdump::Init(const bess::Gate *,
     return CommandFailure(-errno, "Failed to open FIFO");
   }
 
+  if (arg.async()) {
+    writer_.reset(new bess::utils::CaptureWriter(&opener_, Worker::kMaxWorkers,
+                                                 ring_size));
+    writer_->AllocRings(CaptureWorkers(gate));
+    if (!writer_->Start()) {
+      writer_.reset();
+      return CommandFailure(errno, "Failed to start writer thread");
+    }
+    RegisterCaptureWriter(gate, writer_.get());
+  }
+
   return CommandSuccess();
 }
 
+CommandResponse Tcpdump::CommandGetStats(const bess::pb::EmptyArg &) {
+  if (!writer_) {
+    return CommandFailure(ENOTSUP, "statistics are only kept in async mode");
+  }
+
+  bess::pb::CaptureCommandGetStatsResponse r;
+  r.set_packets(writer_->records());
+  r.set_bytes(writer_->bytes());
+  r.set_dropped(writer_->dropped());
+  return CommandSuccess(r);
+}
+
 void Tcpdump::ProcessBatch(const bess::PacketBatch *batch) {
   int fd;
   uint32_t gen;
@@ -80,20 +127,48 @@ void Tcpdump::ProcessBatch(const bess::PacketBatch *batch) {
     return;
   }
 
+  bess::Packet *const *pkts = batch->pkts();
+  int cnt = batch->cnt();
+  bess::Packet *selected[bess::PacketBatch::kMaxBurst];
+
+  if (filter_.active()) {
+    cnt = filter_.Select(batch, selected);
+    pkts = selected;
+  }
+
+  if (cnt == 0) {
+    return;
+  }
+
   struct timeval tv;
   gettimeofday(&tv, nullptr);
 
-  for (int i = 0; i < batch->cnt(); i++) {
-    bess::Packet *pkt = batch->pkts()[i];
+  bess::utils::CaptureRing *ring = nullptr;
+  if (writer_) {
+    ring = writer_->GetRing(current_worker.wid());
+    if (!ring) {
+      // This worker got attached after the hook was set up.
+      writer_->CountMissed(cnt);
+      return;
+    }
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = pkts[i];
+    uint32_t len = filter_.CaptureLen(pkt);
     struct pcap_rec_hdr rec = {
         .ts_sec = (uint32_t)tv.tv_sec,
         .ts_usec = (uint32_t)tv.tv_usec,
-        .incl_len = (uint32_t)pkt->head_len(),
+        .incl_len = len,
         .orig_len = (uint32_t)pkt->total_len(),
     };
 
-    struct iovec vec[2] = {{&rec, sizeof(rec)},
-                           {pkt->head_data(), (size_t)pkt->head_len()}};
+    struct iovec vec[2] = {{&rec, sizeof(rec)}, {pkt->head_data(), len}};
+
+    if (ring) {
+      ring->Push(vec, 2);
+      continue;
+    }
 
     int ret = writev(fd, vec, 2);
     if (ret < 0) {
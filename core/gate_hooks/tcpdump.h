@@ -33,35 +33,60 @@
 #ifndef BESS_GATE_HOOKS_TCPDUMP_
 #define BESS_GATE_HOOKS_TCPDUMP_
 
+#include <memory>
+
 #include "../message.h"
 #include "../module.h"
 
+#include "../utils/capture_ring.h"
 #include "../utils/fifo_opener.h"
+#include "../utils/pcap.h"
+#include "capture_filter.h"
 
 class TcpdumpOpener final : public bess::utils::FifoOpener {
  public:
-  TcpdumpOpener() : FifoOpener() {}
+  TcpdumpOpener() : FifoOpener(), snaplen_(PCAP_SNAPLEN) {}
   bool InitFifo(int fd) override;
+
+  // The snap length to announce in the file header.
+  void set_snaplen(uint32_t snaplen) { snaplen_ = snaplen; }
+
+ private:
+  uint32_t snaplen_;
 };
 
 // Tcpdump dumps copies of the packets seen by a gate. Useful for debugging.
+// In async mode, workers only copy the packets into per-worker rings and a
+// CaptureWriter thread does the FIFO writes.
 class Tcpdump final : public bess::GateHook {
  public:
   Tcpdump()
       : bess::GateHook(Tcpdump::kName, "tcpdump", Tcpdump::kPriority),
-        opener_() {}
+        filter_(),
+        opener_(),
+        writer_() {}
 
-  virtual ~Tcpdump() {}
+  virtual ~Tcpdump();
+
+  static const GateHookCommands cmds;
 
   CommandResponse Init(const bess::Gate *, const bess::pb::TcpdumpArg &);
 
   void ProcessBatch(const bess::PacketBatch *batch);
 
+  CommandResponse CommandGetStats(const bess::pb::EmptyArg &);
+
   static constexpr uint16_t kPriority = 1;
   static const std::string kName;
 
  private:
+  CaptureFilter filter_;
+
   TcpdumpOpener opener_;
+
+  // Only in async mode.  Declared after opener_ so that the writer thread is
+  // stopped before the opener goes away.
+  std::unique_ptr<bess::utils::CaptureWriter> writer_;
 };
 
 #endif  // BESS_GATE_HOOKS_TCPDUMP_
@@ -49,6 +49,7 @@
 #include "message.h"
 #include "metadata.h"
 #include "packet_pool.h"
+#include "utils/time.h"
 #include "worker.h"
 
 using bess::gate_idx_t;
@@ -322,6 +323,32 @@ class alignas(64) Module {
     return std::accumulate(deadends_.begin(), deadends_.end(), 0);
   }
 
+#ifdef BESS_MODULE_PROFILE
+  // Per-worker time spent in this module: its RunTask() (if it is a task
+  // module), or its ProcessBatch() including input gate hooks and output gate
+  // processing. Only available if built with MODULE_PROFILE=1.
+  struct alignas(64) Profile {
+    uint64_t cycles;
+    uint64_t batches;  // # of RunTask()/ProcessBatch() calls
+    uint64_t packets;
+  };
+
+  const Profile &profile(int wid) const { return profile_[wid]; }
+
+  void ResetProfile() { profile_.fill({}); }
+
+  // Accounts a call that started at 'start' and handled 'packets' packets.
+  // Returns the current TSC, so that calls can be timed back to back.
+  uint64_t AccountProfile(int wid, uint64_t start, uint64_t packets) {
+    uint64_t now = rdtsc();
+    Profile &p = profile_[wid];
+    p.cycles += now - start;
+    p.batches++;
+    p.packets += packets;
+    return now;
+  }
+#endif
+
   // Compute placement constraints based on the current module and all
   // downstream modules (i.e., modules connected to out ports.
   placement_constraint ComputePlacementConstraints(
@@ -440,6 +467,10 @@ class alignas(64) Module {
   std::vector<bess::OGate *> ogates_;
   std::array<uint64_t, Worker::kMaxWorkers> deadends_;
 
+#ifdef BESS_MODULE_PROFILE
+  std::array<Profile, Worker::kMaxWorkers> profile_ = {};
+#endif
+
  protected:
   // Set of active workers accessing this module.
   std::vector<bool> active_workers_;
@@ -415,4 +415,32 @@ void ModuleGraph::PropagateActiveWorker() {
       }
     }
   }
+
+  // Stealable leaves may run on any of the work-stealing workers, so every
+  // module their tasks reach is accessed by all of these workers.
+  std::vector<int> stealing_wids;
+  for (int i = 0; i < Worker::kMaxWorkers; i++) {
+    if (workers[i] &&
+        dynamic_cast<bess::WorkStealingScheduler *>(workers[i]->scheduler())) {
+      stealing_wids.push_back(i);
+    }
+  }
+  if (stealing_wids.empty()) {
+    return;
+  }
+  for (auto *leaf : bess::WorkStealingScheduler::stealable_leaves()) {
+    Task *task = leaf->task();
+    if (!task) {
+      continue;
+    }
+    task->AddActiveWorker(stealing_wids[0]);
+    for (auto &pair : all_modules_) {
+      Module *m = pair.second;
+      if (m->HaveVisitedWorker(task)) {
+        for (int wid : stealing_wids) {
+          m->active_workers_[wid] = true;
+        }
+      }
+    }
+  }
 }
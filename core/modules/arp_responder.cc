@@ -32,36 +32,217 @@
 
 #include "arp_responder.h"
 
-#include "../utils/arp.h"
+#include <cstring>
+
+#include "../utils/checksum.h"
 
-using bess::utils::Arp;
 using bess::utils::be16_t;
+using bess::utils::CalculateSum;
+using bess::utils::FoldChecksum;
+using bess::utils::Ipv4;
+
+// The all-nodes multicast address, to which duplicate address detection
+// probes are answered
+static const uint8_t kAllNodes[16] = {0xff, 0x02, 0, 0, 0, 0, 0, 0,
+                                      0,    0,    0, 0, 0, 0, 0, 1};
+static const uint8_t kAllNodesMac[6] = {0x33, 0x33, 0, 0, 0, 1};
+static const uint8_t kUnspecified[16] = {};
+
+// Reduces a 64-bit one's complement sum to 32 bits
+static inline uint32_t ReduceSum(uint64_t sum) {
+  sum = (sum >> 32) + (sum & 0xFFFFFFFF);
+  return sum + (sum >> 32);
+}
 
 const Commands ArpResponder::cmds = {
     {"add", "ArpResponderArg", MODULE_CMD_FUNC(&ArpResponder::CommandAdd),
      Command::THREAD_UNSAFE}};
 
 CommandResponse ArpResponder::CommandAdd(const bess::pb::ArpResponderArg &arg) {
-  be32_t ip_addr;
-  arp_entry entry;
+  Ethernet::Address mac_addr;
 
   if (!arg.ip().length()) {
     return CommandFailure(EINVAL, "IP address is missing");
   }
-  if (!bess::utils::ParseIpv4Address(arg.ip(), &ip_addr)) {
-    return CommandFailure(EINVAL, "Invalid IP Address: %s", arg.ip().c_str());
-  }
 
-  if (!entry.mac_addr.FromString(arg.mac_addr())) {
+  if (!mac_addr.FromString(arg.mac_addr())) {
     return CommandFailure(EINVAL, "Invalid MAC Address: %s",
                           arg.mac_addr().c_str());
   }
 
+  if (arg.ip().find(':') != std::string::npos) {
+    return AddIpv6(arg, mac_addr);
+  }
+  return AddIpv4(arg, mac_addr);
+}
+
+CommandResponse ArpResponder::AddIpv4(const bess::pb::ArpResponderArg &arg,
+                                      const Ethernet::Address &mac_addr) {
+  be32_t ip_addr;
+  arp_entry entry = {};
+
+  if (!bess::utils::ParseIpv4Address(arg.ip(), &ip_addr)) {
+    return CommandFailure(EINVAL, "Invalid IP Address: %s", arg.ip().c_str());
+  }
+
+  entry.mac_addr = mac_addr;
   entry.ip_addr = ip_addr;
-  entries_[ip_addr] = entry;
+
+  ArpReply &reply = entry.reply;
+  reply.eth.src_addr = mac_addr;
+  reply.eth.ether_type = be16_t(Ethernet::Type::kArp);
+  reply.arp.hw_addr = be16_t(Arp::HardwareAddress::kEthernet);
+  reply.arp.proto_addr = be16_t(Ethernet::Type::kIpv4);
+  reply.arp.hw_addr_length = Ethernet::Address::kSize;
+  reply.arp.proto_addr_length = sizeof(be32_t);
+  reply.arp.opcode = be16_t(Arp::Opcode::kReply);
+  reply.arp.sender_hw_addr = mac_addr;
+  reply.arp.sender_ip_addr = ip_addr;
+
+  if (!entries_.Insert(ip_addr, entry)) {
+    return CommandFailure(ENOMEM, "Not enough space");
+  }
+  return CommandSuccess();
+}
+
+CommandResponse ArpResponder::AddIpv6(const bess::pb::ArpResponderArg &arg,
+                                      const Ethernet::Address &mac_addr) {
+  nd_entry entry = {};
+  Ipv6Key key;
+
+  if (!bess::utils::ParseIpv6Address(arg.ip(), entry.ip_addr) ||
+      entry.ip_addr[0] == 0xff) {
+    return CommandFailure(EINVAL, "Invalid IP Address: %s", arg.ip().c_str());
+  }
+
+  entry.mac_addr = mac_addr;
+
+  const uint16_t len = sizeof(Ndp) + sizeof(NdpLinkAddrOption);
+  NdpAdvert &advert = entry.advert;
+  advert.eth.src_addr = mac_addr;
+  advert.eth.ether_type = be16_t(Ethernet::Type::kIpv6);
+  advert.ip.vtc_flow = be32_t(6 << 28);
+  advert.ip.payload_length = be16_t(len);
+  advert.ip.next_header = Ipv4::Proto::kIcmpv6;
+  advert.ip.hop_limit = 255;
+  memcpy(advert.ip.src, entry.ip_addr, sizeof(advert.ip.src));
+  advert.ndp.type = Ndp::Type::kNeighborAdvertisement;
+  memcpy(advert.ndp.target, entry.ip_addr, sizeof(advert.ndp.target));
+  advert.option.type = Ndp::Option::kTargetLinkAddr;
+  advert.option.length = sizeof(NdpLinkAddrOption) / 8;
+  advert.option.addr = mac_addr;
+
+  entry.sum = ReduceSum(uint64_t{CalculateSum(advert.ip.src, 16)} +
+                        be32_t(len).raw_value() +
+                        be32_t(Ipv4::Proto::kIcmpv6).raw_value() +
+                        CalculateSum(&advert.ndp, len));
+
+  memcpy(key.words, entry.ip_addr, sizeof(key.words));
+  if (!entries6_.Insert(key, entry)) {
+    return CommandFailure(ENOMEM, "Not enough space");
+  }
   return CommandSuccess();
 }
 
+bool ArpResponder::ReplyArp(bess::Packet *pkt) {
+  if (pkt->head_len() < static_cast<int>(sizeof(ArpReply))) {
+    return false;
+  }
+
+  ArpReply *request = pkt->head_data<ArpReply *>();
+  if (request->arp.opcode != be16_t(Arp::Opcode::kRequest)) {
+    // TODO(galsagie) When learn is added, learn SRC MAC from replies here.
+    // Other opcodes are not handled yet.
+    return false;
+  }
+
+  // TODO(galsagie) When learn is added, learn SRC MAC here
+
+  // Try to find target IP in cache, if exists convert request to reply
+  const auto *it = entries_.Find(request->arp.target_ip_addr);
+  if (!it) {
+    // TODO(galsagie) Optinally emit packet to next module here
+    return false;
+  }
+
+  Ethernet::Address eth_dst = request->eth.src_addr;
+  Ethernet::Address target_hw_addr = request->arp.sender_hw_addr;
+  be32_t target_ip_addr = request->arp.sender_ip_addr;
+
+  *request = it->second.reply;
+  request->eth.dst_addr = eth_dst;
+  request->arp.target_hw_addr = target_hw_addr;
+  request->arp.target_ip_addr = target_ip_addr;
+  return true;
+}
+
+bool ArpResponder::ReplyNdp(bess::Packet *pkt) {
+  const size_t hdr_len = sizeof(Ethernet) + sizeof(Ipv6);
+  if (!pkt->is_linear() ||
+      pkt->head_len() < static_cast<int>(hdr_len + sizeof(Ndp))) {
+    return false;
+  }
+
+  Ethernet *eth = pkt->head_data<Ethernet *>();
+  Ipv6 *ip = reinterpret_cast<Ipv6 *>(eth + 1);
+  Ndp *ndp = reinterpret_cast<Ndp *>(ip + 1);
+  size_t len = ip->payload_length.value();
+
+  // Validation of RFC 4861 7.1.1 (the options are not needed)
+  if (ip->next_header != Ipv4::Proto::kIcmpv6 || ip->hop_limit != 255 ||
+      ndp->type != Ndp::Type::kNeighborSolicitation || ndp->code != 0 ||
+      len < sizeof(Ndp) ||
+      hdr_len + len > static_cast<size_t>(pkt->head_len())) {
+    return false;
+  }
+
+  uint64_t sum = uint64_t{CalculateSum(ip->src, 32)} + be32_t(len).raw_value() +
+                 be32_t(Ipv4::Proto::kIcmpv6).raw_value() +
+                 CalculateSum(ndp, len);
+  if (FoldChecksum(ReduceSum(sum)) != 0) {
+    return false;
+  }
+
+  Ipv6Key key;
+  memcpy(key.words, ndp->target, sizeof(key.words));
+  const auto *it = entries6_.Find(key);
+  if (!it) {
+    return false;
+  }
+  const nd_entry &entry = it->second;
+
+  // Duplicate address detection probes come from the unspecified address,
+  // and are answered to all nodes without the solicited flag (7.2.4)
+  bool dad = memcmp(ip->src, kUnspecified, sizeof(kUnspecified)) == 0;
+  Ethernet::Address eth_dst = eth->src_addr;
+  uint8_t ip_dst[16];
+  memcpy(ip_dst, dad ? kAllNodes : ip->src, sizeof(ip_dst));
+  if (dad) {
+    eth_dst = Ethernet::Address(kAllNodesMac);
+  }
+  be32_t flags(dad ? Ndp::Flag::kOverride
+                   : (Ndp::Flag::kSolicited | Ndp::Flag::kOverride));
+
+  int old_len = pkt->head_len();
+  if (old_len < static_cast<int>(sizeof(NdpAdvert))) {
+    if (!pkt->append(sizeof(NdpAdvert) - old_len)) {
+      return false;
+    }
+  } else {
+    pkt->trim(old_len - sizeof(NdpAdvert));
+  }
+
+  NdpAdvert *advert = pkt->head_data<NdpAdvert *>();
+  *advert = entry.advert;
+  advert->eth.dst_addr = eth_dst;
+  memcpy(advert->ip.dst, ip_dst, sizeof(ip_dst));
+  advert->ndp.flags = flags;
+  advert->ndp.checksum =
+      FoldChecksum(ReduceSum(uint64_t{entry.sum} + CalculateSum(ip_dst, 16) +
+                             flags.raw_value()));
+  return true;
+}
+
 void ArpResponder::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
@@ -69,41 +250,19 @@ void ArpResponder::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     bess::Packet *pkt = batch->pkts()[i];
 
     Ethernet *eth = pkt->head_data<Ethernet *>();
-    if (eth->ether_type != be16_t(Ethernet::Type::kArp)) {
-      // Currently drop all non ARP packets
-      DropPacket(ctx, pkt);
-      continue;
+    bool reply;
+    if (eth->ether_type == be16_t(Ethernet::Type::kArp)) {
+      reply = ReplyArp(pkt);
+    } else if (eth->ether_type == be16_t(Ethernet::Type::kIpv6)) {
+      reply = ReplyNdp(pkt);
+    } else {
+      // Currently drop all other packets
+      reply = false;
     }
 
-    Arp *arp = reinterpret_cast<Arp *>(eth + 1);
-    if (arp->opcode == be16_t(Arp::Opcode::kRequest)) {
-      // TODO(galsagie) When learn is added, learn SRC MAC here
-
-      // Try to find target IP in cache, if exists convert request to reply
-      auto it = entries_.find(arp->target_ip_addr);
-      if (it != entries_.end()) {
-        const struct arp_entry &entry = it->second;
-        arp->opcode = be16_t(Arp::Opcode::kReply);
-
-        eth->dst_addr = eth->src_addr;
-        eth->src_addr = entry.mac_addr;
-
-        arp->target_hw_addr = arp->sender_hw_addr;
-        arp->sender_hw_addr = entry.mac_addr;
-
-        arp->target_ip_addr = arp->sender_ip_addr;
-        arp->sender_ip_addr = entry.ip_addr;
-        EmitPacket(ctx, pkt, 0);
-      } else {
-        // Did not find an ARP entry in cache, drop packet
-        // TODO(galsagie) Optinally emit packet to next module here
-        DropPacket(ctx, pkt);
-      }
-    } else if (arp->opcode == be16_t(Arp::Opcode::kReply)) {
-      // TODO(galsagie) When learn is added, learn SRC MAC here
-      DropPacket(ctx, pkt);
+    if (reply) {
+      EmitPacket(ctx, pkt, 0);
     } else {
-      // TODO(galsagie) Other opcodes are not handled yet.
       DropPacket(ctx, pkt);
     }
   }
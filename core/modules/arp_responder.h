@@ -33,27 +33,67 @@
 #ifndef BESS_MODULES_ARP_RESPONDER_H_
 #define BESS_MODULES_ARP_RESPONDER_H_
 
-#include <map>
+#include <rte_hash_crc.h>
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/arp.h"
+#include "../utils/cuckoo_map.h"
 #include "../utils/endian.h"
 #include "../utils/ether.h"
 #include "../utils/ip.h"
+#include "../utils/ndp.h"
 
+using bess::utils::Arp;
 using bess::utils::be32_t;
 using bess::utils::Ethernet;
+using bess::utils::Ipv6;
+using bess::utils::Ndp;
+using bess::utils::NdpLinkAddrOption;
+
+// An ARP reply, as sent by ArpResponder
+struct [[gnu::packed]] ArpReply {
+  Ethernet eth;
+  Arp arp;
+};
+
+// A Neighbor Advertisement with the target link-layer address option, as sent
+// by ArpResponder
+struct [[gnu::packed]] NdpAdvert {
+  Ethernet eth;
+  Ipv6 ip;
+  Ndp ndp;
+  NdpLinkAddrOption option;
+};
+
+static_assert(sizeof(NdpAdvert) == 86, "struct NdpAdvert is incorrect");
 
 // ARP cache entry struct which keeps mapping between IP and MAC
 struct arp_entry {
   Ethernet::Address mac_addr;
   be32_t ip_addr;
   uint64_t time;  // timestamp used to expire cache entries (in milliseconds)
+
+  // The reply to requests for ip_addr, but for the target (requester) fields
+  ArpReply reply;
+};
+
+// Neighbor cache entry for IPv6 addresses
+struct nd_entry {
+  Ethernet::Address mac_addr;
+  uint8_t ip_addr[16];
+
+  // The advertisement in response to solicitations for ip_addr, but for the
+  // destination addresses, flags and checksum. sum is the (32-bit, not
+  // inverted) checksum of its constant part and pseudo header.
+  NdpAdvert advert;
+  uint32_t sum;
 };
 
 // ARP Responder module
-// Answer ARP requests from an internal configurable cache
-// Currently drops non ARP packets
+// Answer ARP requests and IPv6 Neighbor Solicitations from an internal
+// configurable cache
+// Currently drops other packets
 class ArpResponder final : public Module {
  public:
   static const gate_idx_t kNumIGates = 1;
@@ -66,8 +106,49 @@ class ArpResponder final : public Module {
   CommandResponse CommandAdd(const bess::pb::ArpResponderArg &arg);
 
  private:
+  struct Ipv4Hash {
+    bess::utils::HashResult operator()(const be32_t &addr) const {
+      return crc32c_sse42_u32(addr.raw_value(), 0);
+    }
+  };
+
+  // An IPv6 address, as two 64-bit words in network order
+  struct Ipv6Key {
+    uint64_t words[2];
+
+    struct Hash {
+      bess::utils::HashResult operator()(const Ipv6Key &key) const {
+        return crc32c_sse42_u64(key.words[1],
+                                crc32c_sse42_u64(key.words[0], 0));
+      }
+    };
+
+    struct EqualTo {
+      bool operator()(const Ipv6Key &lhs, const Ipv6Key &rhs) const {
+        return ((lhs.words[0] ^ rhs.words[0]) |
+                (lhs.words[1] ^ rhs.words[1])) == 0;
+      }
+    };
+  };
+
+  CommandResponse AddIpv4(const bess::pb::ArpResponderArg &arg,
+                          const Ethernet::Address &mac_addr);
+  CommandResponse AddIpv6(const bess::pb::ArpResponderArg &arg,
+                          const Ethernet::Address &mac_addr);
+
+  // Turns the ARP request *pkt into a reply. Returns false if it should be
+  // dropped instead.
+  bool ReplyArp(bess::Packet *pkt);
+
+  // Turns the Neighbor Solicitation *pkt into an advertisement. Returns false
+  // if it is not a valid solicitation for one of entries6_.
+  bool ReplyNdp(bess::Packet *pkt);
+
   // Mapping between IP (key) and its ARP entry (MAC Address)
-  std::map<be32_t, struct arp_entry> entries_;
+  bess::utils::CuckooMap<be32_t, struct arp_entry, Ipv4Hash> entries_;
+  bess::utils::CuckooMap<Ipv6Key, struct nd_entry, Ipv6Key::Hash,
+                         Ipv6Key::EqualTo>
+      entries6_;
 };
 
 #endif  // BESS_MODULES_ARP_RESPONDER_H_
@@ -42,13 +42,70 @@
 #include "../utils/bpf.h"
 #include "bpf.h"
 
+using bess::metadata::Attribute;
+using bess::utils::EbpfMap;
+using bess::utils::EbpfMapSpec;
+
 /* -------------------------------------------------------------------------
  * Module code begins from here
  * ------------------------------------------------------------------------- */
 
-/* Note: bpf_filter will return SNAPLEN if matched, and 0 if unmatched. */
 /* Note: unmatched packets are sent to gate 0 */
-#define SNAPLEN 0xffff
+
+// What eBPF programs get in r1
+struct EbpfContext {
+  uint64_t data;
+  uint64_t data_end;
+  uint32_t len;
+  uint32_t wid;
+};
+
+// Helpers of eBPF programs, in addition to the map ones
+static const int32_t kEbpfGetAttr = 0x1000;
+static const int32_t kEbpfSetAttr = 0x1001;
+
+struct EbpfHelperArg {
+  const Module *module;
+  bess::Packet *pkt;
+};
+
+// Returns a pointer to metadata attribute `idx` of the packet, or nullptr
+// if there is no such attribute or it is not used downstream
+static uint8_t *EbpfAttr(const EbpfHelperArg *arg, uint64_t idx,
+                         bool write) {
+  const std::vector<Attribute> &attrs = arg->module->all_attrs();
+  if (idx >= attrs.size() ||
+      (write && attrs[idx].mode == Attribute::AccessMode::kRead)) {
+    return nullptr;
+  }
+
+  bess::metadata::mt_offset_t offset = arg->module->attr_offset(idx);
+  if (!bess::metadata::IsValidOffset(offset)) {
+    return nullptr;
+  }
+  return _ptr_attr_with_offset<uint8_t>(offset, arg->pkt);
+}
+
+static uint64_t EbpfGetAttr(void *arg, uint64_t idx, uint64_t, uint64_t,
+                            uint64_t, uint64_t) {
+  const EbpfHelperArg *a = static_cast<const EbpfHelperArg *>(arg);
+  const uint8_t *attr = EbpfAttr(a, idx, false);
+  uint64_t val = 0;
+  if (attr) {
+    memcpy(&val, attr, a->module->all_attrs()[idx].size);
+  }
+  return val;
+}
+
+static uint64_t EbpfSetAttr(void *arg, uint64_t idx, uint64_t val, uint64_t,
+                            uint64_t, uint64_t) {
+  const EbpfHelperArg *a = static_cast<const EbpfHelperArg *>(arg);
+  uint8_t *attr = EbpfAttr(a, idx, true);
+  if (attr) {
+    memcpy(attr, &val, a->module->all_attrs()[idx].size);
+  }
+  return 0;
+}
 
 const Commands BPF::cmds = {
     {"add", "BPFArg", MODULE_CMD_FUNC(&BPF::CommandAdd),
@@ -57,27 +114,160 @@ const Commands BPF::cmds = {
      Command::THREAD_UNSAFE},
     {"clear", "EmptyArg", MODULE_CMD_FUNC(&BPF::CommandClear),
      Command::THREAD_UNSAFE},
+    {"get_map", "BPFCommandGetMapArg", MODULE_CMD_FUNC(&BPF::CommandGetMap),
+     Command::THREAD_UNSAFE},
     {"get_initial_arg", "EmptyArg", MODULE_CMD_FUNC(&BPF::GetInitialArg),
      Command::THREAD_SAFE}};
 
 CommandResponse BPF::Init(const bess::pb::BPFArg &arg) {
+  merged_ = arg.merged();
+  if (arg.has_ebpf()) {
+    if (arg.filters_size() > 0) {
+      return CommandFailure(EINVAL, "'filters' and 'ebpf' are exclusive");
+    }
+    return LoadEbpf(arg.ebpf());
+  }
   return CommandAdd(arg);
 }
 
+CommandResponse BPF::LoadEbpf(const bess::pb::BPFArg::Ebpf &arg) {
+  std::vector<EbpfMapSpec> maps;
+  for (const auto &m : arg.maps()) {
+    for (const EbpfMapSpec &spec : maps) {
+      if (spec.name == m.name()) {
+        return CommandFailure(EINVAL, "Duplicate map '%s'", m.name().c_str());
+      }
+    }
+    maps.push_back({m.name(),
+                    m.hash() ? EbpfMapSpec::kHash : EbpfMapSpec::kArray,
+                    m.key_size(), m.value_size(), m.max_entries()});
+  }
+
+  for (const auto &a : arg.attrs()) {
+    if (a.size() != 1 && a.size() != 2 && a.size() != 4 && a.size() != 8) {
+      return CommandFailure(EINVAL, "attr '%s': 'size' must be 1, 2, 4 or 8",
+                            a.name().c_str());
+    }
+    Attribute::AccessMode mode = a.write() ? Attribute::AccessMode::kWrite
+                                           : Attribute::AccessMode::kRead;
+    int ret = AddMetadataAttr(a.name(), a.size(), mode);
+    if (ret < 0) {
+      return CommandFailure(-ret, "attr '%s': add_metadata_attr() failed",
+                            a.name().c_str());
+    }
+  }
+
+  bess::utils::Error err =
+      ebpf_.Load(arg.code(), maps,
+                 {{kEbpfGetAttr, EbpfGetAttr}, {kEbpfSetAttr, EbpfSetAttr}});
+  if (err.first != 0) {
+    return CommandFailure(err.first, "eBPF: %s", err.second.c_str());
+  }
+
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (!is_worker_active(wid)) {
+      continue;
+    }
+    CommandResponse ret = CreateEbpfMaps(wid);
+    if (ret.has_error()) {
+      for (auto &maps : ebpf_maps_) {
+        maps.clear();
+      }
+      return ret;
+    }
+  }
+
+  ebpf_arg_ = arg;
+  ebpf_loaded_ = true;
+  return CommandSuccess();
+}
+
+CommandResponse BPF::CreateEbpfMaps(int wid) {
+  std::vector<EbpfMap> *maps = &ebpf_maps_[wid];
+  if (maps->size() == ebpf_.maps().size()) {
+    return CommandSuccess();
+  }
+
+  bess::utils::Error err = ebpf_.CreateMaps(maps);
+  if (err.first != 0) {
+    return CommandFailure(err.first, "eBPF: worker %d: %s", wid,
+                          err.second.c_str());
+  }
+  return CommandSuccess();
+}
+
+int BPF::OnEvent(bess::Event e) {
+  if (e != bess::Event::PreResume) {
+    return -ENOTSUP;
+  }
+
+  if (!ebpf_loaded_) {
+    return 0;
+  }
+
+  // Workers launched or attached after the program was loaded
+  const std::vector<bool> &actives = active_workers();
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (actives[wid]) {
+      CommandResponse ret = CreateEbpfMaps(wid);
+      if (ret.has_error()) {
+        LOG(ERROR) << name() << ": " << ret.error().errmsg()
+                   << ", dropping its packets";
+      }
+    }
+  }
+  return 0;
+}
+
 void BPF::DeInit() {
   for (auto &filter : filters_) {
-#ifdef __x86_64
-    munmap(reinterpret_cast<void *>(filter.func), filter.mmap_size);
-#else
-    pcap_freecode(&filter.il_code);
-#endif
+    bess::utils::FreeFilter(&filter);
   }
 
   filters_.clear();
+
+  if (merged_filter_.func) {
+    bess::utils::FreeMultiFilter(&merged_filter_);
+  }
+
+  ebpf_loaded_ = false;
+  for (auto &maps : ebpf_maps_) {
+    maps.clear();
+  }
+}
+
+CommandResponse BPF::CompileMergedFilter(
+    const std::vector<bess::utils::Filter> &filters,
+    bess::utils::MultiFilter *mf) {
+  *mf = {};
+  if (!merged_ || filters.size() < 2) {
+    return CommandSuccess();
+  }
+
+  int ret = bess::utils::CompileMultiFilter(filters, mf);
+  if (ret == -EINVAL) {
+    return CommandFailure(EINVAL, "BPF compilation error");
+  } else if (ret < 0) {
+    return CommandFailure(-ret, "BPF JIT compilation error");
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse BPF::UpdateMergedFilter() {
+  if (merged_filter_.func) {
+    bess::utils::FreeMultiFilter(&merged_filter_);
+  }
+
+  return CompileMergedFilter(filters_, &merged_filter_);
 }
 
 CommandResponse BPF::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::BPFArg r;
+  r.set_merged(merged_);
+  if (ebpf_loaded_) {
+    *r.mutable_ebpf() = ebpf_arg_;
+  }
   for (auto f : filters_) {
     auto *f_pb = r.add_filters();
     f_pb->set_priority(f.priority);
@@ -88,9 +278,19 @@ CommandResponse BPF::GetInitialArg(const bess::pb::EmptyArg &) {
 }
 
 CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
+  if (ebpf_loaded_ && arg.filters_size() > 0) {
+    return CommandFailure(EINVAL, "Cannot add filters to an eBPF program");
+  }
+
+  // Everything is compiled before anything changes, so that a bad filter
+  // leaves the module as it was.
+  std::vector<bess::utils::Filter> added;
+  CommandResponse err;
+
   for (const auto &f : arg.filters()) {
     if (f.gate() < 0 || f.gate() >= MAX_GATES) {
-      return CommandFailure(EINVAL, "Invalid gate");
+      err = CommandFailure(EINVAL, "Invalid gate");
+      break;
     }
 
     bess::utils::Filter filter;
@@ -98,39 +298,44 @@ CommandResponse BPF::CommandAdd(const bess::pb::BPFArg &arg) {
     filter.gate = f.gate();
     filter.exp = f.filter();
 
-    struct bpf_program il;
-    pcap_t *pc = pcap_open_dead(DLT_EN10MB, SNAPLEN);
-    if (!pc) {
-      return CommandFailure(ENOMEM, "pcap_open_dead failed");
-    }
-    int ret = pcap_compile(pc, &il, filter.exp.c_str(),
-                           1,  // optimize (IL only)
-                           PCAP_NETMASK_UNKNOWN);
-    pcap_close(pc);
-    if (ret == -1) {
-      return CommandFailure(EINVAL, "BPF compilation error");
+    int ret = bess::utils::CompileFilter(&filter);
+    if (ret == -EINVAL) {
+      err = CommandFailure(EINVAL, "BPF compilation error");
+      break;
+    } else if (ret < 0) {
+      err = CommandFailure(-ret, "BPF JIT compilation error");
+      break;
     }
 
-#ifdef __x86_64
-    filter.func =
-        bess::utils::bpf_jit_compile(il.bf_insns, il.bf_len, &filter.mmap_size);
-    pcap_freecode(&il);
-    if (!filter.func) {
-      return CommandFailure(ENOMEM, "BPF JIT compilation error");
-    }
-#else
-    filter.il_code = il;
-#endif
+    added.push_back(filter);
+  }
 
-    filters_.push_back(filter);
+  std::vector<bess::utils::Filter> filters;
+  bess::utils::MultiFilter merged = {};
+
+  if (!err.has_error()) {
+    filters = filters_;
+    filters.insert(filters.end(), added.begin(), added.end());
+    std::sort(filters.begin(), filters.end(),
+              [](const bess::utils::Filter &a, const bess::utils::Filter &b) {
+                // descending order of priority number
+                return b.priority < a.priority;
+              });
+    err = CompileMergedFilter(filters, &merged);
   }
 
-  std::sort(filters_.begin(), filters_.end(),
-            [](const bess::utils::Filter &a, const bess::utils::Filter &b) {
-              // descending order of priority number
-              return b.priority < a.priority;
-            });
+  if (err.has_error()) {
+    for (auto &filter : added) {
+      bess::utils::FreeFilter(&filter);
+    }
+    return err;
+  }
 
+  if (merged_filter_.func) {
+    bess::utils::FreeMultiFilter(&merged_filter_);
+  }
+  filters_ = std::move(filters);
+  merged_filter_ = merged;
   return CommandSuccess();
 }
 
@@ -143,13 +348,14 @@ CommandResponse BPF::CommandDelete(const bess::pb::BPFArg &arg) {
     for (auto i = filters_.begin(); i != filters_.end(); ++i) {
       if (f.priority() == i->priority && f.gate() == i->gate &&
           f.filter() == i->exp) {
+        bess::utils::FreeFilter(&*i);
         filters_.erase(i);
         break;
       }
     }
   }
 
-  return CommandSuccess();
+  return UpdateMergedFilter();
 }
 
 CommandResponse BPF::CommandClear(const bess::pb::EmptyArg &) {
@@ -157,15 +363,30 @@ CommandResponse BPF::CommandClear(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
-inline bool BPF::Match(const bess::utils::Filter &filter, u_char *pkt,
-                       u_int wirelen, u_int buflen) {
-#ifdef __x86_64
-  int ret = filter.func(pkt, wirelen, buflen);
-#else
-  int ret = bpf_filter(filter.il_code.bf_insns, pkt, wirelen, buflen);
-#endif
+CommandResponse BPF::CommandGetMap(const bess::pb::BPFCommandGetMapArg &arg) {
+  const std::vector<EbpfMapSpec> &specs = ebpf_.maps();
+  size_t idx = 0;
+  while (idx < specs.size() && specs[idx].name != arg.name()) {
+    idx++;
+  }
+  if (!ebpf_loaded_ || idx == specs.size()) {
+    return CommandFailure(ENOENT, "No map '%s'", arg.name().c_str());
+  }
 
-  return ret != 0;
+  const EbpfMapSpec &spec = specs[idx];
+  bess::pb::BPFCommandGetMapResponse r;
+  for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+    if (ebpf_maps_[wid].empty()) {
+      continue;
+    }
+    ebpf_maps_[wid][idx].ForEach([&](const uint8_t *key, const uint8_t *val) {
+      auto *entry = r.add_entries();
+      entry->set_wid(wid);
+      entry->set_key(key, spec.key_size);
+      entry->set_value(val, spec.value_size);
+    });
+  }
+  return CommandSuccess(r);
 }
 
 void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
@@ -176,8 +397,8 @@ void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
 
-    if (Match(filter, pkt->head_data<u_char *>(), pkt->total_len(),
-              pkt->head_len())) {
+    if (bess::utils::MatchFilter(filter, pkt->head_data<u_char *>(),
+                                 pkt->total_len(), pkt->head_len())) {
       EmitPacket(ctx, pkt, filter.gate);
     } else {
       EmitPacket(ctx, pkt);
@@ -185,15 +406,71 @@ void BPF::ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch) {
   }
 }
 
+void BPF::ProcessBatchMerged(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+
+    int gate = bess::utils::MatchMultiFilter(
+        merged_filter_, pkt->head_data<u_char *>(), pkt->total_len(),
+        pkt->head_len());
+    EmitPacket(ctx, pkt, gate < 0 ? 0 : gate);
+  }
+}
+
+void BPF::ProcessBatchEbpf(Context *ctx, bess::PacketBatch *batch) {
+  std::vector<EbpfMap> *maps = &ebpf_maps_[ctx->wid];
+  if (unlikely(maps->size() != ebpf_.maps().size())) {
+    // Could not be created for this worker (see OnEvent())
+    for (int i = 0; i < batch->cnt(); i++) {
+      DropPacket(ctx, batch->pkts()[i]);
+    }
+    return;
+  }
+
+  EbpfContext ebpf_ctx;
+  ebpf_ctx.wid = ctx->wid;
+  EbpfHelperArg helper_arg = {this, nullptr};
+
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint8_t *data = pkt->head_data<uint8_t *>();
+    size_t size = pkt->head_len();
+
+    ebpf_ctx.data = reinterpret_cast<uintptr_t>(data);
+    ebpf_ctx.data_end = ebpf_ctx.data + size;
+    ebpf_ctx.len = pkt->total_len();
+    helper_arg.pkt = pkt;
+
+    uint64_t gate;
+    if (ebpf_.Run(maps, &ebpf_ctx, sizeof(ebpf_ctx), data, size, &helper_arg,
+                  &gate) &&
+        gate < MAX_GATES) {
+      EmitPacket(ctx, pkt, gate);
+    } else {
+      DropPacket(ctx, pkt);
+    }
+  }
+}
+
 void BPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   int n_filters = filters_.size();
 
-  if (n_filters == 0) {
+  if (ebpf_loaded_) {
+    ProcessBatchEbpf(ctx, batch);
+    return;
+  } else if (n_filters == 0) {
     RunNextModule(ctx, batch);
     return;
   } else if (n_filters == 1) {
     ProcessBatch1Filter(ctx, batch);
     return;
+  } else if (merged_filter_.func) {
+    ProcessBatchMerged(ctx, batch);
+    return;
   }
 
   // slow version for general cases
@@ -205,8 +482,8 @@ void BPF::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     // high priority filters are checked first
     for (const bess::utils::Filter &filter : filters_) {
-      if (Match(filter, pkt->head_data<uint8_t *>(), pkt->total_len(),
-                pkt->head_len())) {
+      if (bess::utils::MatchFilter(filter, pkt->head_data<uint8_t *>(),
+                                   pkt->total_len(), pkt->head_len())) {
         gate = filter.gate;
         break;
       }
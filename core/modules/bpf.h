@@ -40,6 +40,7 @@
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../utils/bpf.h"
+#include "../utils/ebpf.h"
 
 class BPF final : public Module {
  public:
@@ -54,17 +55,48 @@ class BPF final : public Module {
 
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
+  int OnEvent(bess::Event e) override;
+
   CommandResponse GetInitialArg(const bess::pb::EmptyArg &);
   CommandResponse CommandAdd(const bess::pb::BPFArg &arg);
   CommandResponse CommandDelete(const bess::pb::BPFArg &arg);
   CommandResponse CommandClear(const bess::pb::EmptyArg &arg);
+  CommandResponse CommandGetMap(const bess::pb::BPFCommandGetMapArg &arg);
 
  private:
-  static bool Match(const bess::utils::Filter &, u_char *, u_int, u_int);
-
   void ProcessBatch1Filter(Context *ctx, bess::PacketBatch *batch);
+  void ProcessBatchMerged(Context *ctx, bess::PacketBatch *batch);
+  void ProcessBatchEbpf(Context *ctx, bess::PacketBatch *batch);
+
+  CommandResponse LoadEbpf(const bess::pb::BPFArg::Ebpf &arg);
+
+  // Creates the maps of worker wid, unless it has them already
+  CommandResponse CreateEbpfMaps(int wid);
+
+  // Compiles the merged program of `filters` into *mf, or leaves it empty if
+  // not merged_ or there are fewer than two filters
+  CommandResponse CompileMergedFilter(
+      const std::vector<bess::utils::Filter> &filters,
+      bess::utils::MultiFilter *mf);
+
+  // Recompiles merged_filter_ from filters_, if merged_
+  CommandResponse UpdateMergedFilter();
 
   std::vector<bess::utils::Filter> filters_;
+
+  bool merged_ = false;
+  bess::utils::MultiFilter merged_filter_ = {};
+
+  // The eBPF program, if any, which replaces the filters. Metadata attribute
+  // i of the module is attrs[i] of ebpf_arg_.
+  bool ebpf_loaded_ = false;
+  bess::pb::BPFArg::Ebpf ebpf_arg_;
+  bess::utils::EbpfProgram ebpf_;
+
+  // Maps of each worker, created in the control path: when the program is
+  // loaded for the workers that exist, and before resuming for those
+  // attached later. A worker without them (if that failed) drops packets.
+  std::vector<bess::utils::EbpfMap> ebpf_maps_[Worker::kMaxWorkers];
 };
 
 #endif  // BESS_MODULES_BPF_H_
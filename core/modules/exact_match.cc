@@ -32,6 +32,7 @@
 
 #include "exact_match.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -135,6 +136,20 @@ CommandResponse ExactMatch::Init(const bess::pb::ExactMatchArg &arg) {
     }
   }
 
+  if (arg.flow_marks()) {
+    if (arg.flow_marks() > kMaxFlowMarks) {
+      return CommandFailure(EINVAL, "'flow_marks' must be at most %u",
+                            kMaxFlowMarks);
+    }
+    flow_mark_attr_ =
+        AddMetadataAttr("flow_mark", sizeof(uint32_t),
+                        bess::metadata::Attribute::AccessMode::kRead);
+    if (flow_mark_attr_ < 0) {
+      return CommandFailure(-flow_mark_attr_, "add_metadata_attr() failed");
+    }
+    marks_.resize(arg.flow_marks(), nullptr);
+  }
+
   default_gate_ = DROP_GATE;
   table_.Init(arg.entries());
   return CommandSuccess();
@@ -164,6 +179,7 @@ CommandResponse ExactMatch::GetInitialArg(const bess::pb::EmptyArg &) {
       ret_mask->set_value_bin(ptr, f.size);
     }
   }
+  r.set_flow_marks(marks_.size());
   return CommandSuccess(r);
 }
 
@@ -180,6 +196,7 @@ CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
     rule_t *rule = r.add_rules();
 
     rule->set_gate(value.gate);
+    ExactMatchRuleFields fields;
     for (size_t i = 0; i < table_.num_fields(); i++) {
       const ExactMatchField &f = table_.get_field(i);
       bess::pb::FieldData *field = rule->add_fields();
@@ -187,6 +204,11 @@ CommandResponse ExactMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
       // See GetInitialArg above for why we only set_value_bin here.
       const char *ptr = reinterpret_cast<const char *>(&key.u64_arr[0]);
       field->set_value_bin(ptr + f.pos, f.size);
+      fields.emplace_back(ptr + f.pos, ptr + f.pos + f.size);
+    }
+    auto it = rule_marks_.find(fields);
+    if (it != rule_marks_.end()) {
+      rule->set_mark(it->second);
     }
   }
   std::sort(r.mutable_rules()->begin(), r.mutable_rules()->end(),
@@ -244,7 +266,64 @@ Error ExactMatch::AddRule(const bess::pb::ExactMatchCommandAddArg &arg) {
       return err;
   }
 
-  return table_.AddRule(t, rule);
+  uint32_t mark = arg.mark();
+  auto it = rule_marks_.find(rule);
+  if (mark) {
+    if (mark >= marks_.size()) {
+      return std::make_pair(
+          EINVAL, bess::utils::Format("mark %u is not in [1,%zu)", mark,
+                                      marks_.size()));
+    }
+    if (marks_[mark] && (it == rule_marks_.end() || it->second != mark)) {
+      return std::make_pair(
+          EEXIST, bess::utils::Format("mark %u is already in use", mark));
+    }
+  }
+
+  if ((err = table_.AddRule(t, rule)).first != 0) {
+    return err;
+  }
+
+  if (it != rule_marks_.end()) {
+    UnsetMark(it->second);
+    rule_marks_.erase(it);
+  }
+  if (mark) {
+    ACCESS_ONCE(marks_[mark]) = new ValueTuple(t);
+    rule_marks_.emplace(rule, mark);
+  }
+  return err;
+}
+
+void ExactMatch::UnsetMark(uint32_t mark) {
+  ValueTuple *v = marks_[mark];
+  if (v) {
+    ACCESS_ONCE(marks_[mark]) = nullptr;
+    FreeRetiredMarks(false);
+    retired_marks_.emplace_back(tsc_to_ns(rdtsc()), v);
+  }
+}
+
+// Frees the retired entries past their grace period, or all of them (only
+// when no worker can be running the module).
+void ExactMatch::FreeRetiredMarks(bool all) {
+  uint64_t now_ns = tsc_to_ns(rdtsc());
+  auto keep = retired_marks_.begin();
+  for (auto &r : retired_marks_) {
+    if (all || now_ns - r.first >= kMarkGraceNs) {
+      delete r.second;
+    } else {
+      *keep++ = r;
+    }
+  }
+  retired_marks_.erase(keep, retired_marks_.end());
+}
+
+void ExactMatch::ClearMarks() {
+  for (const auto &kv : rule_marks_) {
+    UnsetMark(kv.second);
+  }
+  rule_marks_.clear();
 }
 
 // Uses an ExactMatchConfig to restore this module's runtime config.
@@ -254,6 +333,7 @@ CommandResponse ExactMatch::SetRuntimeConfig(
     const bess::pb::ExactMatchConfig &arg) {
   default_gate_ = arg.default_gate();
   table_.ClearRules();
+  ClearMarks();
 
   for (auto i = 0; i < arg.rules_size(); i++) {
     Error ret = AddRule(arg.rules(i));
@@ -314,9 +394,32 @@ void ExactMatch::setValues(bess::Packet *pkt, ExactMatchKey &action) {
 void ExactMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t default_gate;
   ExactMatchKey keys[bess::PacketBatch::kMaxBurst] __ymm_aligned;
+  bess::PacketBatch unmarked;
 
   default_gate = ACCESS_ONCE(default_gate_);
 
+  // Packets carrying a known mark skip key extraction and the hash lookup.
+  if (flow_mark_attr_ >= 0) {
+    bess::metadata::mt_offset_t offset = attr_offset(flow_mark_attr_);
+    if (bess::metadata::IsValidOffset(offset)) {
+      unmarked.clear();
+      int cnt = batch->cnt();
+      for (int i = 0; i < cnt; i++) {
+        bess::Packet *pkt = batch->pkts()[i];
+        uint32_t mark = _get_attr_with_offset<uint32_t>(offset, pkt);
+        ValueTuple *v =
+            (mark < marks_.size()) ? ACCESS_ONCE(marks_[mark]) : nullptr;
+        if (v) {
+          setValues(pkt, v->action);
+          EmitPacket(ctx, pkt, v->gate);
+        } else {
+          unmarked.add(pkt);
+        }
+      }
+      batch = &unmarked;
+    }
+  }
+
   const auto buffer_fn = [&](bess::Packet *pkt, const ExactMatchField &f) {
     int attr_id = f.attr_id;
     if (attr_id >= 0) {
@@ -331,7 +434,7 @@ void ExactMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int icnt = 0;
   for (int lcnt = 0; lcnt < cnt; lcnt = lcnt + icnt) {
-    icnt = ((cnt - lcnt) >= 64) ? 64 : cnt - lcnt;
+    icnt = std::min(cnt - lcnt, bess::utils::kMaxBulkLookup);
     ValueTuple *res[icnt];
     uint64_t hit_mask = table_.Find(keys + lcnt, res, icnt);
 
@@ -414,11 +517,18 @@ CommandResponse ExactMatch::CommandDelete(
     return CommandFailure(ret.first, "%s", ret.second.c_str());
   }
 
+  auto it = rule_marks_.find(rule);
+  if (it != rule_marks_.end()) {
+    UnsetMark(it->second);
+    rule_marks_.erase(it);
+  }
+
   return CommandSuccess();
 }
 
 CommandResponse ExactMatch::CommandClear(const bess::pb::EmptyArg &) {
   table_.ClearRules();
+  ClearMarks();
   return CommandSuccess();
 }
 
@@ -430,6 +540,12 @@ CommandResponse ExactMatch::CommandSetDefaultGate(
 
 void ExactMatch::DeInit() {
   table_.DeInit();
+  for (ValueTuple *v : marks_) {
+    delete v;
+  }
+  FreeRetiredMarks(true);
+  marks_.clear();
+  rule_marks_.clear();
 }
 
 ADD_MODULE(ExactMatch, "em", "Multi-field classifier with an exact match table")
@@ -37,6 +37,9 @@
 #include <rte_config.h>
 #include <rte_hash_crc.h>
 
+#include <map>
+#include <vector>
+
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 #include "../utils/exact_match_table.h"
@@ -75,6 +78,9 @@ class ExactMatch final : public Module {
  public:
   static const gate_idx_t kNumOGates = MAX_GATES;
 
+  // Largest flow mark table (the "flow_marks" argument)
+  static const uint32_t kMaxFlowMarks = 1 << 20;
+
   static const Commands cmds;
 
   ExactMatch()
@@ -84,7 +90,11 @@ class ExactMatch final : public Module {
         total_value_size_(),
         num_values_(),
         values_(),
-        table_() {
+        table_(),
+        flow_mark_attr_(-1),
+        marks_(),
+        rule_marks_(),
+        retired_marks_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -245,6 +255,9 @@ class ExactMatch final : public Module {
     return std::make_pair(0, bess::utils::Format("Success"));
   }
   void setValues(bess::Packet *pkt, ExactMatchKey &action);
+  void UnsetMark(uint32_t mark);
+  void ClearMarks();
+  void FreeRetiredMarks(bool all);
 
   gate_idx_t default_gate_;
   bool empty_masks_;  // mainly for GetInitialArg
@@ -258,6 +271,19 @@ class ExactMatch final : public Module {
   size_t num_values_;
   ExactMatchField values_[MAX_FIELDS];
   ExactMatchTable<ValueTuple> table_;
+
+  // Fast path for packets pre-classified by a NIC rte_flow MARK (or anything
+  // else that writes the "flow_mark" attribute). marks_[m] is the value of the
+  // rule added with mark m, or nullptr. Mark 0 is never used.
+  int flow_mark_attr_;
+  std::vector<ValueTuple *> marks_;
+  std::map<ExactMatchRuleFields, uint32_t> rule_marks_;
+  // Entries unlinked from marks_ that workers may still be reading, with the
+  // time (in ns) they were unlinked. Commands free them once they are older
+  // than kMarkGraceNs, long after any worker has finished the batch that
+  // read them.
+  static const uint64_t kMarkGraceNs = 1000000000ull;
+  std::vector<std::pair<uint64_t, ValueTuple *>> retired_marks_;
 };
 
 #endif  // BESS_MODULES_EXACTMATCH_H_
@@ -402,23 +402,47 @@ CommandResponse FlowGen::UpdateBaseAddresses() {
   port_src_base_ = l4->src_port.value();
   port_dst_base_ = l4->dst_port.value();
 
+  ip_csum_base_ = bess::utils::CalculateIpv4Checksum(*ip);
+  if (l4_proto_ == Ipv4::Proto::kUdp) {
+    l4_csum_base_ = bess::utils::CalculateIpv4UdpChecksum(*ip, *l4);
+  } else {
+    l4_csum_base_ = bess::utils::CalculateIpv4TcpChecksum(
+        *ip, *reinterpret_cast<Tcp *>(l4));
+  }
+
   return CommandSuccess();
 }
 
-bess::Packet *FlowGen::FillUdpPacket(struct flow *f) {
-  bess::Packet *pkt;
+// Returns the checksum increment (see utils/checksum.h) from the template to
+// the addresses and ports of flow 'f'. The IPv4 header part is in 'ip_inc'.
+static inline uint32_t AddressIncrement(const flow *f, uint32_t ip_src_base,
+                                        uint32_t ip_dst_base,
+                                        uint16_t port_src_base,
+                                        uint16_t port_dst_base,
+                                        uint32_t *ip_inc) {
+  using bess::utils::ChecksumIncrement16;
+  using bess::utils::ChecksumIncrement32;
+
+  *ip_inc = ChecksumIncrement32(be32_t(ip_src_base).raw_value(),
+                                f->src_ip.raw_value()) +
+            ChecksumIncrement32(be32_t(ip_dst_base).raw_value(),
+                                f->dst_ip.raw_value());
+
+  // The addresses are also part of the L4 pseudo header
+  return *ip_inc +
+         ChecksumIncrement16(be16_t(port_src_base).raw_value(),
+                             f->src_port.raw_value()) +
+         ChecksumIncrement16(be16_t(port_dst_base).raw_value(),
+                             f->dst_port.raw_value());
+}
 
+void FlowGen::FillUdpPacket(bess::Packet *pkt, struct flow *f) {
   int size = template_size_;
 
-  if (!(pkt = current_worker.packet_pool()->Alloc())) {
-    return nullptr;
-  }
-
-  char *p = pkt->buffer<char *>() + SNBUF_HEADROOM;
+  char *p = pkt->head_data<char *>();
   Ethernet *eth = reinterpret_cast<Ethernet *>(p);
   Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
 
-  pkt->set_data_off(SNBUF_HEADROOM);
   pkt->set_total_len(size);
   pkt->set_data_len(size);
   bess::utils::Copy(p, tmpl_, size, true);
@@ -431,22 +455,21 @@ bess::Packet *FlowGen::FillUdpPacket(struct flow *f) {
   udp->src_port = f->src_port;
   udp->dst_port = f->dst_port;
 
-  udp->checksum = bess::utils::CalculateIpv4UdpChecksum(*ip, *udp);
-  ip->checksum = bess::utils::CalculateIpv4Checksum(*ip);
+  // Only the addresses and ports differ from the template
+  uint32_t ip_inc;
+  uint32_t l4_inc = AddressIncrement(f, ip_src_base_, ip_dst_base_,
+                                     port_src_base_, port_dst_base_, &ip_inc);
 
-  return pkt;
+  udp->checksum =
+      bess::utils::UpdateChecksumWithIncrement(l4_csum_base_, l4_inc) ?: 0xFFFF;
+  ip->checksum =
+      bess::utils::UpdateChecksumWithIncrement(ip_csum_base_, ip_inc);
 }
 
-bess::Packet *FlowGen::FillTcpPacket(struct flow *f) {
-  bess::Packet *pkt;
-
+void FlowGen::FillTcpPacket(bess::Packet *pkt, struct flow *f) {
   int size = template_size_;
 
-  if (!(pkt = current_worker.packet_pool()->Alloc())) {
-    return nullptr;
-  }
-
-  char *p = pkt->buffer<char *>() + SNBUF_HEADROOM;
+  char *p = pkt->head_data<char *>();
 
   Ethernet *eth = reinterpret_cast<Ethernet *>(p);
   Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
@@ -454,12 +477,12 @@ bess::Packet *FlowGen::FillTcpPacket(struct flow *f) {
   bess::utils::Copy(p, tmpl_, size, true);
 
   // SYN or FIN?
-  if (f->first_pkt || f->packets_left <= 1) {
+  bool is_control = f->first_pkt || f->packets_left <= 1;
+  if (is_control) {
     pkt->set_total_len(60);  // eth + ip + tcp
     pkt->set_data_len(60);   // eth + ip + tcp
     ip->length = be16_t(40);
   } else {
-    pkt->set_data_off(SNBUF_HEADROOM);
     pkt->set_total_len(size);
     pkt->set_data_len(size);
   }
@@ -480,13 +503,35 @@ bess::Packet *FlowGen::FillTcpPacket(struct flow *f) {
 
   tcp->flags = tcp_flags;
   tcp->seq_num = be32_t(f->next_seq_no);
-  tcp->checksum = bess::utils::CalculateIpv4TcpChecksum(*ip, *tcp);
-  ip->checksum = bess::utils::CalculateIpv4Checksum(*ip);
+
+  if (is_control) {
+    tcp->checksum = bess::utils::CalculateIpv4TcpChecksum(*ip, *tcp);
+    ip->checksum = bess::utils::CalculateIpv4Checksum(*ip);
+  } else {
+    // Data packets differ from the template only in the addresses, ports,
+    // sequence number, and flags (which share a 16-bit word with the offset)
+    const Tcp *tmpl_tcp = reinterpret_cast<const Tcp *>(
+        tmpl_ + (reinterpret_cast<char *>(tcp) - p));
+    uint16_t old_word, new_word;
+    memcpy(&old_word, &tmpl_tcp->flags - 1, sizeof(old_word));
+    memcpy(&new_word, &tcp->flags - 1, sizeof(new_word));
+
+    uint32_t ip_inc;
+    uint32_t l4_inc =
+        AddressIncrement(f, ip_src_base_, ip_dst_base_, port_src_base_,
+                         port_dst_base_, &ip_inc) +
+        bess::utils::ChecksumIncrement32(tmpl_tcp->seq_num.raw_value(),
+                                         tcp->seq_num.raw_value()) +
+        bess::utils::ChecksumIncrement16(old_word, new_word);
+
+    tcp->checksum =
+        bess::utils::UpdateChecksumWithIncrement(l4_csum_base_, l4_inc);
+    ip->checksum =
+        bess::utils::UpdateChecksumWithIncrement(ip_csum_base_, ip_inc);
+  }
 
   f->next_seq_no +=
       f->first_pkt ? 1 : size - (sizeof(*eth) + sizeof(*ip) + sizeof(*tcp));
-
-  return pkt;
 }
 
 void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
@@ -495,11 +540,23 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
   batch->clear();
   const int burst = ACCESS_ONCE(burst_);
 
-  while (batch->cnt() < burst && !events_.empty()) {
+  // Nothing is due yet: do not bother allocating packets
+  if (events_.empty() || now < events_.top().first) {
+    return;
+  }
+
+  bess::Packet **pkts = batch->pkts();
+  if (!current_worker.packet_pool()->AllocBulk(pkts, burst)) {
+    return;
+  }
+
+  int cnt = 0;
+
+  while (cnt < burst && !events_.empty()) {
     uint64_t t = events_.top().first;
     struct flow *f = events_.top().second;
     if (!f || now < t)
-      return;
+      break;
 
     events_.pop();
 
@@ -509,14 +566,10 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    bess::Packet *pkt = nullptr;
     if (l4_proto_ == Ipv4::Proto::kUdp) {
-      pkt = FillUdpPacket(f);
+      FillUdpPacket(pkts[cnt++], f);
     } else if (l4_proto_ == Ipv4::Proto::kTcp) {
-      pkt = FillTcpPacket(f);
-    }
-    if (pkt) {
-      batch->add(pkt);
+      FillTcpPacket(pkts[cnt++], f);
     }
 
     if (f->first_pkt) {
@@ -528,6 +581,9 @@ void FlowGen::GeneratePackets(Context *ctx, bess::PacketBatch *batch) {
 
     events_.emplace(t + static_cast<uint64_t>(1e9 / flow_pps_), f);
   }
+
+  bess::Packet::Free(pkts + cnt, burst - cnt);
+  batch->set_cnt(cnt);
 }
 
 struct task_result FlowGen::RunTask(Context *ctx, bess::PacketBatch *batch,
@@ -118,8 +118,8 @@ class FlowGen final : public Module {
   void PopulateInitialFlows();
 
   CommandResponse UpdateBaseAddresses();
-  bess::Packet *FillUdpPacket(struct flow *f);
-  bess::Packet *FillTcpPacket(struct flow *f);
+  void FillUdpPacket(bess::Packet *pkt, struct flow *f);
+  void FillTcpPacket(bess::Packet *pkt, struct flow *f);
   void GeneratePackets(Context *ctx, bess::PacketBatch *batch);
 
   CommandResponse ProcessArguments(const bess::pb::FlowGenArg &arg);
@@ -170,6 +170,10 @@ class FlowGen final : public Module {
   uint16_t port_src_base_;
   uint16_t port_dst_base_;
 
+  /* checksums of the template, to be updated incrementally per packet */
+  uint16_t ip_csum_base_;
+  uint16_t l4_csum_base_;
+
   struct {
     double alpha;
     double inversed_alpha; /* 1.0 / alpha */
@@ -0,0 +1,145 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtpu_classify.h"
+
+#include <cstring>
+
+#include "../utils/ether.h"
+#include "../utils/format.h"
+#include "../utils/gtpu_parse.h"
+
+using bess::utils::EtherTypeForIpVersion;
+using bess::utils::Ethernet;
+using bess::utils::GtpuHeaderOffsets;
+using bess::utils::ParseGtpuHeaders;
+
+static inline int is_valid_gate(gate_idx_t gate) {
+  return (gate < MAX_GATES || gate == DROP_GATE);
+}
+
+const Commands GtpuClassify::cmds = {
+    {"add", "GtpuClassifyCommandAddArg",
+     MODULE_CMD_FUNC(&GtpuClassify::CommandAdd), Command::THREAD_UNSAFE},
+    {"delete", "GtpuClassifyCommandDeleteArg",
+     MODULE_CMD_FUNC(&GtpuClassify::CommandDelete), Command::THREAD_UNSAFE},
+    {"clear", "GtpuClassifyCommandClearArg",
+     MODULE_CMD_FUNC(&GtpuClassify::CommandClear), Command::THREAD_UNSAFE},
+    {"set_default_gate", "GtpuClassifyCommandSetDefaultGateArg",
+     MODULE_CMD_FUNC(&GtpuClassify::CommandSetDefaultGate),
+     Command::THREAD_SAFE}};
+
+CommandResponse GtpuClassify::Init(const bess::pb::GtpuClassifyArg &arg) {
+  for (const auto &rule : arg.rules()) {
+    CommandResponse err = CommandAdd(rule);
+    if (err.error().code() != 0) {
+      return err;
+    }
+  }
+  return CommandSuccess();
+}
+
+void GtpuClassify::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    GtpuHeaderOffsets off;
+
+    if (!ParseGtpuHeaders(pkt->head_data(), pkt->head_len(), &off)) {
+      EmitPacket(ctx, pkt, default_gate);
+      continue;
+    }
+
+    const auto *entry = rules_.Find(off.teid);
+    if (!entry) {
+      EmitPacket(ctx, pkt, default_gate);
+      continue;
+    }
+
+    if (entry->second.decap) {
+      // The new head is at least 36 bytes (IPv4 + UDP + GTP-U) past the old
+      // one, so the two Ethernet headers never overlap.
+      Ethernet *eth = pkt->head_data<Ethernet *>();
+      Ethernet *new_eth =
+          static_cast<Ethernet *>(pkt->adj(off.inner - sizeof(Ethernet)));
+      memcpy(new_eth, eth, sizeof(Ethernet));
+      new_eth->ether_type = EtherTypeForIpVersion(off.inner_version);
+    }
+
+    EmitPacket(ctx, pkt, entry->second.gate);
+  }
+}
+
+std::string GtpuClassify::GetDesc() const {
+  return bess::utils::Format("%zu tunnels", rules_.Count());
+}
+
+CommandResponse GtpuClassify::CommandAdd(
+    const bess::pb::GtpuClassifyCommandAddArg &arg) {
+  gate_idx_t gate = arg.gate();
+
+  if (!is_valid_gate(gate)) {
+    return CommandFailure(EINVAL, "Invalid gate: %hu", gate);
+  }
+
+  if (!rules_.Insert(arg.teid(), {gate, arg.decap()})) {
+    return CommandFailure(ENOMEM, "no room for TEID 0x%x", arg.teid());
+  }
+  return CommandSuccess();
+}
+
+CommandResponse GtpuClassify::CommandDelete(
+    const bess::pb::GtpuClassifyCommandDeleteArg &arg) {
+  if (!rules_.Remove(arg.teid())) {
+    return CommandFailure(ENOENT, "TEID 0x%x doesn't exist", arg.teid());
+  }
+  return CommandSuccess();
+}
+
+CommandResponse GtpuClassify::CommandClear(
+    const bess::pb::GtpuClassifyCommandClearArg &) {
+  rules_.Clear();
+  return CommandSuccess();
+}
+
+CommandResponse GtpuClassify::CommandSetDefaultGate(
+    const bess::pb::GtpuClassifyCommandSetDefaultGateArg &arg) {
+  gate_idx_t gate = arg.gate();
+
+  if (!is_valid_gate(gate)) {
+    return CommandFailure(EINVAL, "Invalid gate: %hu", gate);
+  }
+
+  default_gate_ = gate;
+  return CommandSuccess();
+}
+
+ADD_MODULE(GtpuClassify, "gtpu_classify",
+           "fused GTP-U parser, TEID classifier and decapsulator")
@@ -18,34 +18,133 @@
 #include "utils/udp.h"
 /* for gtp header */
 #include "utils/gtp.h"
+/* for HasIpv6Packet() and ParseGtpuExtHeaders() */
+#include "utils/gtpu_parse.h"
 /* for GetDesc() */
 #include "utils/format.h"
 #include <rte_jhash.h>
 /*----------------------------------------------------------------------------------*/
+using bess::utils::be16_t;
+using bess::utils::EtherTypeForIpVersion;
 using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
+using bess::utils::GtpuPscInfo;
+using bess::utils::HasIpv6Packet;
 using bess::utils::Ipv4;
+using bess::utils::Ipv6;
+using bess::utils::ParseGtpuExtHeaders;
 using bess::utils::Udp;
 /*----------------------------------------------------------------------------------*/
-void GtpuDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+/* Export the QoS fields of the PDU session container (if any) as metadata,
+ * so that QoS flow classification needs no second parse.
+ */
+void GtpuDecap::set_psc_attrs(bess::Packet *p, const GtpuPscInfo &info) {
+  set_attr<uint8_t>(this, qfi_attr, p, info.qfi);
+  set_attr<uint8_t>(this, pdu_type_attr, p, info.pdu_type);
+  set_attr<uint8_t>(this, rqi_attr, p, info.rqi);
+}
+/*----------------------------------------------------------------------------------*/
+/* Strip the outer headers up to gtph and the GTP-U header itself, whose
+ * length comes from the bounded extension header walk. The Ethernet header
+ * is moved forward; the inner packet may be IPv4 or IPv6, so fix up the
+ * Ethernet type too. Returns false if the GTP-U header is malformed or
+ * runs past the packet.
+ */
+template <bool kExportPsc>
+inline bool GtpuDecap::strip_outer(bess::Packet *p, Ethernet *eth,
+                                   const Gtpv1 *gtph, size_t outer_len) {
+  const uint8_t *gtp = reinterpret_cast<const uint8_t *>(gtph);
+  size_t off = gtp - p->head_data<const uint8_t *>();
+  size_t gtp_len;
+  GtpuPscInfo info;
+
+  if (unlikely(off >= static_cast<size_t>(p->head_len()) ||
+               !ParseGtpuExtHeaders(gtp, p->head_len() - off, &info,
+                                    &gtp_len)))
+    return false;
+
+  if (kExportPsc)
+    set_psc_attrs(p, info);
+
+  Ethernet *new_eth = static_cast<Ethernet *>(p->adj(outer_len + gtp_len));
+  if (unlikely(!new_eth))
+    return false;
+  memcpy(new_eth, eth, sizeof(*eth));
+  new_eth->ether_type =
+      EtherTypeForIpVersion(*reinterpret_cast<uint8_t *>(new_eth + 1) >> 4);
+  return true;
+}
+/*----------------------------------------------------------------------------------*/
+template <bool kExportPsc>
+inline bool GtpuDecap::decap_ipv4(bess::Packet *p) {
+  /* Trim iph->ihl<<2 + sizeof(Udp) + size of Gtpv1 header
+   */
+  Ethernet *eth = p->head_data<Ethernet *>();
+  Ipv4 *iph = (Ipv4 *)((uint8_t *)eth + sizeof(*eth));
+  size_t outer_len = (iph->header_length << 2) + sizeof(Udp);
+  Gtpv1 *gtph = (Gtpv1 *)((uint8_t *)iph + outer_len);
+  return strip_outer<kExportPsc>(p, eth, gtph, outer_len);
+}
+/*----------------------------------------------------------------------------------*/
+template <bool kExportPsc>
+inline bool GtpuDecap::decap_ipv6(bess::Packet *p) {
+  /* Trim sizeof(Ipv6) + sizeof(Udp) + size of Gtpv1 header. Outer IPv6
+   * extension headers are not supported.
+   */
+  Ethernet *eth = p->head_data<Ethernet *>();
+  size_t outer_len = sizeof(Ipv6) + sizeof(Udp);
+  Gtpv1 *gtph = (Gtpv1 *)((uint8_t *)eth + sizeof(*eth) + outer_len);
+  return strip_outer<kExportPsc>(p, eth, gtph, outer_len);
+}
+/*----------------------------------------------------------------------------------*/
+/* Decapsulate the batch in place. Packets with a malformed GTP-U header are
+ * dropped and the batch is compacted over them.
+ */
+template <bool kExportPsc>
+void GtpuDecap::decap_batch(Context *ctx, bess::PacketBatch *batch) {
   int cnt = batch->cnt();
+  int out = 0;
+  bool has_ipv6 = HasIpv6Packet(batch);
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *p = batch->pkts()[i];
-    /* Trim iph->ihl<<2 + sizeof(Udp) + size of Gtpv1 header
-     */
-    Ethernet *eth = p->head_data<Ethernet *>();
-    Ipv4 *iph = (Ipv4 *)((uint8_t *)eth + sizeof(*eth));
-    Gtpv1 *gtph =
-        (Gtpv1 *)((uint8_t *)iph + (iph->header_length << 2) + sizeof(Udp));
-    // Don't swap lines 44 with 42, otherwise gtph->header_length()
-    // gets overwritten by ethh!!
-    auto *new_p = batch->pkts()[i]->adj((iph->header_length << 2) +
-                                        sizeof(Udp) + gtph->header_length());
-    memcpy(new_p, eth, sizeof(*eth));
+    bool ok;
+
+    if (likely(!has_ipv6) ||
+        p->head_data<Ethernet *>()->ether_type != be16_t(Ethernet::kIpv6))
+      ok = decap_ipv4<kExportPsc>(p);
+    else
+      ok = decap_ipv6<kExportPsc>(p);
+
+    if (likely(ok))
+      batch->pkts()[out++] = p;
+    else
+      DropPacket(ctx, p);
   }
+  batch->set_cnt(out);
+}
+/*----------------------------------------------------------------------------------*/
+void GtpuDecap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  /* Only walk the extension headers if someone downstream reads them */
+  using bess::metadata::IsValidOffset;
+  if (IsValidOffset(attr_offset(qfi_attr)) ||
+      IsValidOffset(attr_offset(pdu_type_attr)) ||
+      IsValidOffset(attr_offset(rqi_attr)))
+    decap_batch<true>(ctx, batch);
+  else
+    decap_batch<false>(ctx, batch);
 
   RunNextModule(ctx, batch);
 }
 /*----------------------------------------------------------------------------------*/
+CommandResponse GtpuDecap::Init(const bess::pb::EmptyArg &) {
+  using AccessMode = bess::metadata::Attribute::AccessMode;
+  qfi_attr = AddMetadataAttr("qfi", sizeof(uint8_t), AccessMode::kWrite);
+  pdu_type_attr =
+      AddMetadataAttr("pdu_type", sizeof(uint8_t), AccessMode::kWrite);
+  rqi_attr = AddMetadataAttr("rqi", sizeof(uint8_t), AccessMode::kWrite);
+
+  return CommandSuccess();
+}
+/*----------------------------------------------------------------------------------*/
 ADD_MODULE(GtpuDecap, "gtpu_decap", "first version of gtpu decap module")
@@ -7,13 +7,34 @@
 /*----------------------------------------------------------------------------------*/
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/ether.h"
+#include "../utils/gtp.h"
+#include "../utils/gtpu_parse.h"
 #include <rte_hash.h>
 /*----------------------------------------------------------------------------------*/
 class GtpuDecap final : public Module {
  public:
   GtpuDecap() { max_allowed_workers_ = Worker::kMaxWorkers; }
 
+  CommandResponse Init(const bess::pb::EmptyArg &arg);
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
+
+ private:
+  template <bool kExportPsc>
+  void decap_batch(Context *ctx, bess::PacketBatch *batch);
+  template <bool kExportPsc>
+  bool decap_ipv4(bess::Packet *p);
+  template <bool kExportPsc>
+  bool decap_ipv6(bess::Packet *p);
+  template <bool kExportPsc>
+  bool strip_outer(bess::Packet *p, bess::utils::Ethernet *eth,
+                   const bess::utils::Gtpv1 *gtph, size_t outer_len);
+  void set_psc_attrs(bess::Packet *p, const bess::utils::GtpuPscInfo &info);
+
+  /* PDU session container fields, 0 if there is none */
+  int qfi_attr = -1;
+  int pdu_type_attr = -1;
+  int rqi_attr = -1;
 };
 /*----------------------------------------------------------------------------------*/
 #endif  // BESS_MODULES_GTPUDECAP_H_
@@ -24,51 +24,94 @@ using bess::utils::be32_t;
 using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
 using bess::utils::Ipv4;
+using bess::utils::Ipv6;
 using bess::utils::ToIpv4Address;
 using bess::utils::Udp;
 
 enum { DEFAULT_GATE = 0, FORWARD_GATE };
 /*----------------------------------------------------------------------------------*/
-bool GtpuEcho::process_echo_request(bess::Packet *p) {
-  Ethernet *eth = p->head_data<Ethernet *>();
-  Ipv4 *iph = (Ipv4 *)((unsigned char *)eth + sizeof(Ethernet));
-  Udp *udp = (Udp *)((unsigned char *)iph + (iph->header_length << 2));
-  Gtpv1 *gtph = (Gtpv1 *)((unsigned char *)udp + sizeof(Udp));
-  struct gtpu_recovery_ie_t *recovery_ie = NULL;
-
-  /* re-use space (if available) left in Ethernet padding for recovery_ie */
-  if ((p->total_len() - (sizeof(Ethernet) + iph->length.value())) >
+/* Find room for the Recovery IE: re-use space (if available) left in the
+ * Ethernet padding after the ip_len bytes long IP packet, otherwise append
+ * it to the frame.
+ */
+static struct gtpu_recovery_ie_t *reserve_recovery_ie(bess::Packet *p,
+                                                      Gtpv1 *gtph,
+                                                      size_t ip_len) {
+  if ((p->total_len() - (sizeof(Ethernet) + ip_len)) >
       sizeof(struct gtpu_recovery_ie_t)) {
-    recovery_ie = (struct gtpu_recovery_ie_t *)((char *)gtph + sizeof(Gtpv1) +
-                                                gtph->length.value());
-  } else {
-    /* otherwise prepend payload to the frame */
-    recovery_ie = (struct gtpu_recovery_ie_t *)p->append(
-        sizeof(struct gtpu_recovery_ie_t));
-    if (recovery_ie == NULL) {
-      LOG(WARNING) << "Couldn't append " << sizeof(struct gtpu_recovery_ie_t)
-                   << " bytes to mbuf";
-      return false;
-    }
+    return (struct gtpu_recovery_ie_t *)((char *)gtph + sizeof(Gtpv1) +
+                                         gtph->length.value());
   }
 
+  /* otherwise prepend payload to the frame */
+  struct gtpu_recovery_ie_t *recovery_ie =
+      (struct gtpu_recovery_ie_t *)p->append(sizeof(struct gtpu_recovery_ie_t));
+  if (recovery_ie == NULL) {
+    LOG(WARNING) << "Couldn't append " << sizeof(struct gtpu_recovery_ie_t)
+                 << " bytes to mbuf";
+  }
+  return recovery_ie;
+}
+/*----------------------------------------------------------------------------------*/
+/* Turn the request into a response, and swap the UDP ports */
+static void make_echo_response(Gtpv1 *gtph, Udp *udp,
+                               struct gtpu_recovery_ie_t *recovery_ie) {
   gtph->type = GTPU_ECHO_RESPONSE;
   gtph->length =
       be16_t(gtph->length.value() + sizeof(struct gtpu_recovery_ie_t));
   recovery_ie->type = GTPU_ECHO_RECOVERY;
   recovery_ie->restart_cntr = 0;
 
+  /* Swap src and dst UDP ports */
+  std::swap(udp->src_port, udp->dst_port);
+  udp->length = be16_t(udp->length.value() + sizeof(struct gtpu_recovery_ie_t));
+  /* Reset checksum. This will be computed by next module in line */
+  udp->checksum = 0;
+}
+/*----------------------------------------------------------------------------------*/
+bool GtpuEcho::process_echo_request(bess::Packet *p) {
+  Ethernet *eth = p->head_data<Ethernet *>();
+  if (eth->ether_type == be16_t(Ethernet::kIpv6))
+    return process_echo_request_ipv6(p);
+
+  Ipv4 *iph = (Ipv4 *)((unsigned char *)eth + sizeof(Ethernet));
+  Udp *udp = (Udp *)((unsigned char *)iph + (iph->header_length << 2));
+  Gtpv1 *gtph = (Gtpv1 *)((unsigned char *)udp + sizeof(Udp));
+  struct gtpu_recovery_ie_t *recovery_ie =
+      reserve_recovery_ie(p, gtph, iph->length.value());
+  if (recovery_ie == NULL)
+    return false;
+
+  make_echo_response(gtph, udp, recovery_ie);
+
   /* Swap src and dest IP addresses */
   std::swap(iph->src, iph->dst);
   iph->length = be16_t(iph->length.value() + sizeof(struct gtpu_recovery_ie_t));
   /* Reset checksum. This will be computed by next module in line */
   iph->checksum = 0;
+  return true;
+}
+/*----------------------------------------------------------------------------------*/
+bool GtpuEcho::process_echo_request_ipv6(bess::Packet *p) {
+  Ethernet *eth = p->head_data<Ethernet *>();
+  Ipv6 *iph = (Ipv6 *)((unsigned char *)eth + sizeof(Ethernet));
+  /* Outer IPv6 extension headers are not supported */
+  if (iph->next_header != Ipv4::kUdp)
+    return false;
 
-  /* Swap src and dst UDP ports */
-  std::swap(udp->src_port, udp->dst_port);
-  udp->length = be16_t(udp->length.value() + sizeof(struct gtpu_recovery_ie_t));
-  /* Reset checksum. This will be computed by next module in line */
-  udp->checksum = 0;
+  Udp *udp = (Udp *)(iph + 1);
+  Gtpv1 *gtph = (Gtpv1 *)((unsigned char *)udp + sizeof(Udp));
+  struct gtpu_recovery_ie_t *recovery_ie = reserve_recovery_ie(
+      p, gtph, sizeof(Ipv6) + iph->payload_length.value());
+  if (recovery_ie == NULL)
+    return false;
+
+  make_echo_response(gtph, udp, recovery_ie);
+
+  /* Swap src and dest IP addresses */
+  std::swap(iph->src, iph->dst);
+  iph->payload_length =
+      be16_t(iph->payload_length.value() + sizeof(struct gtpu_recovery_ie_t));
   return true;
 }
 /*----------------------------------------------------------------------------------*/
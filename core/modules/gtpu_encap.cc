@@ -29,6 +29,7 @@ using bess::utils::Gtpv1;
 using bess::utils::Gtpv1PDUSessExt;
 using bess::utils::Gtpv1SeqPDUExt;
 using bess::utils::Ipv4;
+using bess::utils::Ipv6;
 using bess::utils::ToIpv4Address;
 using bess::utils::Udp;
 
@@ -80,8 +81,44 @@ struct [[gnu::packed]] PacketTemplate {
   }
 };
 static PacketTemplate outer_ip_template;
+
+// Same for an IPv6 outer header (N3 over IPv6)
+struct [[gnu::packed]] PacketTemplate6 {
+  Ipv6 iph;
+  Udp udph;
+  Gtpv1 gtph;
+  Gtpv1SeqPDUExt speh;
+  Gtpv1PDUSessExt psch;
+
+  PacketTemplate6() {
+    const PacketTemplate &t = outer_ip_template;
+    udph = t.udph;
+    gtph = t.gtph;
+    speh = t.speh;
+    psch = t.psch;
+    iph.vtc_flow = (be32_t)(6 << 28);
+    iph.payload_length = (be16_t)0;  // to fill in
+    iph.next_header = IPPROTO_UDP;
+    iph.hop_limit = 64;
+    memset(iph.src, 0, sizeof(iph.src));  // to fill in
+    memset(iph.dst, 0, sizeof(iph.dst));  // to fill in
+  }
+};
+static PacketTemplate6 outer_ip6_template;
+
+/* Type of Service (IPv4) or Traffic Class (IPv6) of the inner packet */
+static inline uint8_t inner_tos(const Ipv4 *iphIn) {
+  if (iphIn->version == 6)
+    return reinterpret_cast<const Ipv6 *>(iphIn)->traffic_class();
+  return iphIn->type_of_service;
+}
 /*----------------------------------------------------------------------------------*/
 void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  if (ipv6) {
+    ProcessBatchIpv6(ctx, batch);
+    return;
+  }
+
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
@@ -125,7 +162,7 @@ void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
     /* get Type of Service from IP packet */
     Ipv4 *iphIn = (Ipv4 *)((unsigned char *)eth + sizeof(Ethernet));
-    uint8_t type_of_service = iphIn->type_of_service;
+    uint8_t type_of_service = inner_tos(iphIn);
 
     /* pre-allocate space for encaped header(s) */
     char *new_p = static_cast<char *>(p->prepend(encap_size));
@@ -136,8 +173,9 @@ void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       continue;
     }
 
-    /* setting Ethernet header */
+    /* setting Ethernet header (the inner packet may be IPv6) */
     memcpy(new_p, eth, sizeof(Ethernet));
+    ((Ethernet *)new_p)->ether_type = (be16_t)(Ethernet::kIpv4);
 
     /* get pointers to header offsets */
     Ipv4 *iph = (Ipv4 *)(new_p + sizeof(Ethernet));
@@ -183,13 +221,87 @@ void GtpuEncap::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   }
 }
 /*----------------------------------------------------------------------------------*/
+void GtpuEncap::ProcessBatchIpv6(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
+
+  for (int i = 0; i < cnt; i++) {
+    bess::Packet *p = batch->pkts()[i];
+
+    uint8_t at_pdu_type =
+        get_attr_with_offset<uint8_t>(attr_offset(pdu_type_attr), p);
+    uint8_t at_qfi = get_attr_with_offset<uint8_t>(attr_offset(qfi_attr), p);
+    uint32_t at_tout_teid =
+        get_attr_with_offset<uint32_t>(attr_offset(tout_teid), p);
+    uint16_t at_tout_uport =
+        get_attr_with_offset<uint16_t>(attr_offset(tout_uport), p);
+    const uint8_t *at_tout_sip6 =
+        ptr_attr_with_offset<uint8_t>(attr_offset(tout_sip6_attr), p);
+    const uint8_t *at_tout_dip6 =
+        ptr_attr_with_offset<uint8_t>(attr_offset(tout_dip6_attr), p);
+
+    if (at_tout_sip6 == NULL || at_tout_dip6 == NULL) {
+      /* nobody upstream sets the tunnel addresses */
+      EmitPacket(ctx, p, DEFAULT_GATE);
+      continue;
+    }
+
+    uint16_t pkt_len = p->total_len() - sizeof(Ethernet);
+    Ethernet *eth = p->head_data<Ethernet *>();
+
+    Ipv4 *iphIn = (Ipv4 *)((unsigned char *)eth + sizeof(Ethernet));
+    uint8_t type_of_service = inner_tos(iphIn);
+
+    char *new_p = static_cast<char *>(p->prepend(encap_size));
+    if (new_p == NULL) {
+      EmitPacket(ctx, p, DEFAULT_GATE);
+      DLOG(INFO) << "prepend() failed!";
+      continue;
+    }
+
+    memcpy(new_p, eth, sizeof(Ethernet));
+    ((Ethernet *)new_p)->ether_type = (be16_t)(Ethernet::kIpv6);
+
+    Ipv6 *iph = (Ipv6 *)(new_p + sizeof(Ethernet));
+    Udp *udph = (Udp *)((uint8_t *)iph + offsetof(PacketTemplate6, udph));
+    Gtpv1 *gtph = (Gtpv1 *)((uint8_t *)iph + offsetof(PacketTemplate6, gtph));
+    Gtpv1PDUSessExt *psch =
+        (Gtpv1PDUSessExt *)((uint8_t *)iph + offsetof(PacketTemplate6, psch));
+
+    bess::utils::Copy(iph, &outer_ip6_template, encap_size);
+
+    if (add_psc) {
+      gtph->ex = 1;
+      psch->qfi = at_qfi;
+      psch->pdu_type = at_pdu_type;
+    }
+
+    uint16_t gtplen =
+        pkt_len + encap_size - sizeof(Gtpv1) - sizeof(Udp) - sizeof(Ipv6);
+    uint16_t udplen = gtplen + sizeof(Gtpv1) + sizeof(Udp);
+
+    gtph->length = (be16_t)(gtplen);
+    gtph->teid = (be32_t)(at_tout_teid);
+
+    /* The UDP checksum stays zero, as RFC 6935 permits for tunnels */
+    udph->length = (be16_t)(udplen);
+    udph->src_port = udph->dst_port = (be16_t)(at_tout_uport);
+
+    iph->payload_length = (be16_t)(udplen);
+    iph->vtc_flow = (be32_t)((6 << 28) | (type_of_service << 20));
+    memcpy(iph->src, at_tout_sip6, sizeof(iph->src));
+    memcpy(iph->dst, at_tout_dip6, sizeof(iph->dst));
+
+    EmitPacket(ctx, p, FORWARD_GATE);
+  }
+}
+/*----------------------------------------------------------------------------------*/
 CommandResponse GtpuEncap::Init(const bess::pb::GtpuEncapArg &arg) {
   add_psc = arg.add_psc();
-  if (add_psc)
-    encap_size = sizeof(outer_ip_template);
-  else
-    encap_size = sizeof(outer_ip_template) - sizeof(Gtpv1SeqPDUExt) -
-                 sizeof(Gtpv1SeqPDUExt);
+  ipv6 = arg.ipv6();
+  encap_size =
+      ipv6 ? sizeof(outer_ip6_template) : sizeof(outer_ip_template);
+  if (!add_psc)
+    encap_size -= sizeof(Gtpv1SeqPDUExt) + sizeof(Gtpv1PDUSessExt);
 
   using AccessMode = bess::metadata::Attribute::AccessMode;
   pdu_type_attr = AddMetadataAttr("action", sizeof(uint8_t), AccessMode::kRead);
@@ -208,6 +320,12 @@ CommandResponse GtpuEncap::Init(const bess::pb::GtpuEncapArg &arg) {
   DLOG(INFO) << "tout_uport: " << tout_uport;
   qfi_attr = AddMetadataAttr("qfi", sizeof(uint8_t), AccessMode::kRead);
   DLOG(INFO) << "qfi_attr: " << qfi_attr;
+  if (ipv6) {
+    tout_sip6_attr = AddMetadataAttr("tunnel_out_src_ip6addr", 16,
+                                     AccessMode::kRead);
+    tout_dip6_attr = AddMetadataAttr("tunnel_out_dst_ip6addr", 16,
+                                     AccessMode::kRead);
+  }
 
   return CommandSuccess();
 }
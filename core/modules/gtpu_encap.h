@@ -20,7 +20,10 @@ class GtpuEncap final : public Module {
   CommandResponse Init(const bess::pb::GtpuEncapArg &arg);
 
  private:
+  void ProcessBatchIpv6(Context *ctx, bess::PacketBatch *batch);
+
   bool add_psc;
+  bool ipv6;
   int encap_size;
   int pdu_type_attr = -1;
   int qfi_attr = -1;
@@ -28,6 +31,8 @@ class GtpuEncap final : public Module {
   int tout_dip_attr = -1;
   int tout_teid = -1;
   int tout_uport = -1;
+  int tout_sip6_attr = -1;
+  int tout_dip6_attr = -1;
 };
 /*----------------------------------------------------------------------------------*/
 #endif  // BESS_MODULES_GTPUENCAP_H_
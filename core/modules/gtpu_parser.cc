@@ -14,10 +14,16 @@
 #include "utils/tcp.h"
 /* for gtp header */
 #include "utils/gtp.h"
+/* for HasIpv6Packet() and ParseGtpuExtHeaders() */
+#include "utils/gtpu_parse.h"
 /*----------------------------------------------------------------------------------*/
 using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
+using bess::utils::GtpuPscInfo;
+using bess::utils::HasIpv6Packet;
 using bess::utils::Ipv4;
+using bess::utils::Ipv6;
+using bess::utils::ParseGtpuExtHeaders;
 using bess::utils::Tcp;
 using bess::utils::Udp;
 
@@ -42,87 +48,246 @@ void GtpuParser::set_gtp_parsing_attrs(be32_t *sip, be32_t *dip, be16_t *sp,
   set_attr<uint8_t>(this, proto_id, p, *protoid);
 }
 /*----------------------------------------------------------------------------------*/
-void GtpuParser::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
-  int cnt = batch->cnt();
+static const uint32_t _const_val = 0xFFFFFFFFu;
+/*----------------------------------------------------------------------------------*/
+/* Zero the attribute if addr is NULL, so that packets without an IPv6
+ * address there do not carry a stale one downstream
+ */
+void GtpuParser::set_ipv6_attr(int attr_id, const uint8_t *addr,
+                               bess::Packet *p) {
+  uint8_t *val = ptr_attr_with_offset<uint8_t>(attr_offset(attr_id), p);
+  if (!val)
+    return;
+  if (addr)
+    memcpy(val, addr, kIpv6AddrLen);
+  else
+    memset(val, 0, kIpv6AddrLen);
+}
+/*----------------------------------------------------------------------------------*/
+/* iph is the inner (or untunneled) IPv6 header, NULL for IPv4 packets */
+void GtpuParser::set_ipv6_attrs(const Ipv6 *iph, const Ipv6 *tunnel_iph,
+                                bess::Packet *p) {
+  set_ipv6_attr(src_ip6_id, iph ? iph->src : NULL, p);
+  set_ipv6_attr(dst_ip6_id, iph ? iph->dst : NULL, p);
+  set_ipv6_attr(tunnel_ip6_dst_id, tunnel_iph ? tunnel_iph->dst : NULL, p);
+}
+/*----------------------------------------------------------------------------------*/
+/* Inner (or untunneled) IPv6 packet. IPv6 extension headers are not walked,
+ * so ports are only reported if TCP or UDP immediately follows.
+ */
+void GtpuParser::parse_inner_ipv6(Ipv6 *iph, Ipv6 *tunnel_iph, be32_t *teid,
+                                  be32_t *tipd, bess::Packet *p) {
+  be16_t *sp = (be16_t *)&_const_val;
+  be16_t *dp = (be16_t *)&_const_val;
+
+  if (iph->next_header == Ipv4::kTcp) {
+    Tcp *tcph = (Tcp *)(iph + 1);
+    sp = &tcph->src_port;
+    dp = &tcph->dst_port;
+  } else if (iph->next_header == Ipv4::kUdp) {
+    Udp *udph = (Udp *)(iph + 1);
+    sp = &udph->src_port;
+    dp = &udph->dst_port;
+  }
+
+  set_gtp_parsing_attrs((be32_t *)&_const_val, (be32_t *)&_const_val, sp, dp,
+                        teid, tipd, &iph->next_header, p);
+  set_ipv6_attrs(iph, tunnel_iph, p);
+}
+/*----------------------------------------------------------------------------------*/
+/* QFI, PDU type and RQI from the PDU session container; all 0 for packets
+ * that carry no container
+ */
+void GtpuParser::set_psc_attrs(const GtpuPscInfo &info, bess::Packet *p) {
+  set_attr<uint8_t>(this, qfi_id, p, info.qfi);
+  set_attr<uint8_t>(this, pdu_type_id, p, info.pdu_type);
+  set_attr<uint8_t>(this, rqi_id, p, info.rqi);
+}
+/*----------------------------------------------------------------------------------*/
+/* Length of the GTP-U header at gtph including its extension headers, found
+ * with the bounded walk; 0 if the header is malformed or runs past the
+ * packet.
+ */
+size_t GtpuParser::gtpu_header_length(const Gtpv1 *gtph, bess::Packet *p,
+                                      GtpuPscInfo *info) {
+  const uint8_t *gtp = reinterpret_cast<const uint8_t *>(gtph);
+  size_t off = gtp - p->head_data<const uint8_t *>();
+  size_t gtp_len;
+
+  if (unlikely(off >= static_cast<size_t>(p->head_len()) ||
+               !ParseGtpuExtHeaders(gtp, p->head_len() - off, info,
+                                    &gtp_len)))
+    return 0;
+  return gtp_len;
+}
+/*----------------------------------------------------------------------------------*/
+inline bool GtpuParser::parse_ipv4(Ipv4 *iph, bess::Packet *p,
+                                   bool export_psc) {
   Tcp *tcph = NULL;
   Udp *udph = NULL;
   Gtpv1 *gtph = NULL;
-  Ipv4 *iph = NULL;
+  GtpuPscInfo info = {};
+  bool inner_ipv6 = false;
+
+  switch (iph->protocol) {
+    case Ipv4::kTcp:
+      tcph = (Tcp *)((char *)iph + (iph->header_length << 2));
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, &tcph->src_port,
+                            &tcph->dst_port, (be32_t *)&_const_val,
+                            (be32_t *)&_const_val, &iph->protocol, p);
+      break;
+    case Ipv4::kUdp:
+      udph = (Udp *)((char *)iph + (iph->header_length << 2));
+      if (udph->dst_port == (be16_t)(UDP_PORT_GTPU)) {
+        Ipv4 *old_iph = iph;
+        gtph = (Gtpv1 *)(udph + 1);
+        be32_t teid = (be32_t)gtph->teid.value();
+        size_t gtp_len = gtpu_header_length(gtph, p, &info);
+        if (unlikely(!gtp_len))
+          return false;
+        /* reuse iph, tcph, and udph for innser headers too */
+        iph = (Ipv4 *)((char *)gtph + gtp_len);
+        if (iph->version == 6) {
+          parse_inner_ipv6((Ipv6 *)iph, NULL, &teid, &old_iph->dst, p);
+          inner_ipv6 = true;
+          break;
+        }
+        parse_inner_ipv4(iph, &teid, &old_iph->dst, p);
+      } else {
+        set_gtp_parsing_attrs(&iph->src, &iph->dst, &udph->src_port,
+                              &udph->dst_port, (be32_t *)&_const_val,
+                              (be32_t *)&_const_val, &iph->protocol, p);
+      }
+      break;
+    case Ipv4::kIcmp:
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
+                            (be16_t *)&_const_val, (be32_t *)&_const_val,
+                            (be32_t *)&_const_val, &iph->protocol, p);
+      break;
+    case Ipv4::kEsp:
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
+                            (be16_t *)&_const_val, (be32_t *)&_const_val,
+                            (be32_t *)&_const_val, &iph->protocol, p);
+      break;
+    default:
+      /* nothing here at the moment */
+      break;
+  }
+  if (!inner_ipv6)
+    set_ipv6_attrs(NULL, NULL, p);
+  if (export_psc)
+    set_psc_attrs(info, p);
+  return true;
+}
+/*----------------------------------------------------------------------------------*/
+inline void GtpuParser::parse_inner_ipv4(Ipv4 *iph, be32_t *teid, be32_t *tipd,
+                                         bess::Packet *p) {
+  Tcp *tcph = NULL;
+  Udp *udph = NULL;
+
+  switch (iph->protocol) {
+    case Ipv4::kTcp:
+      tcph = (Tcp *)((char *)iph + (iph->header_length << 2));
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, &tcph->src_port,
+                            &tcph->dst_port, teid, tipd, &iph->protocol, p);
+      break;
+    case Ipv4::kUdp:
+      udph = (Udp *)((char *)iph + (iph->header_length << 2));
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, &udph->src_port,
+                            &udph->dst_port, teid, tipd, &iph->protocol, p);
+      break;
+    case Ipv4::kEsp:
+      // ESP has no ports, encrypted payload
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
+                            (be16_t *)&_const_val, teid, tipd, &iph->protocol,
+                            p);
+      break;
+    default:
+      set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
+                            (be16_t *)&_const_val, teid, tipd, &iph->protocol,
+                            p);
+      break;
+  }
+}
+/*----------------------------------------------------------------------------------*/
+/* IPv6 outer header (N3 over IPv6) or untunneled IPv6 */
+bool GtpuParser::parse_ipv6(Ipv6 *iph, bess::Packet *p, bool export_psc) {
+  Udp *udph = (Udp *)(iph + 1);
+  GtpuPscInfo info = {};
+
+  if (iph->next_header != Ipv4::kUdp ||
+      udph->dst_port != (be16_t)(UDP_PORT_GTPU)) {
+    parse_inner_ipv6(iph, NULL, (be32_t *)&_const_val, (be32_t *)&_const_val,
+                     p);
+    if (export_psc)
+      set_psc_attrs(info, p);
+    return true;
+  }
+
+  Gtpv1 *gtph = (Gtpv1 *)(udph + 1);
+  be32_t teid = (be32_t)gtph->teid.value();
+  size_t gtp_len = gtpu_header_length(gtph, p, &info);
+  if (unlikely(!gtp_len))
+    return false;
+  Ipv4 *inner = (Ipv4 *)((char *)gtph + gtp_len);
+  if (inner->version == 6) {
+    parse_inner_ipv6((Ipv6 *)inner, iph, &teid, (be32_t *)&_const_val, p);
+  } else {
+    parse_inner_ipv4(inner, &teid, (be32_t *)&_const_val, p);
+    set_ipv6_attrs(NULL, iph, p);
+  }
+  if (export_psc)
+    set_psc_attrs(info, p);
+  return true;
+}
+/*----------------------------------------------------------------------------------*/
+void GtpuParser::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  int cnt = batch->cnt();
   Ethernet *eth = NULL;
-  static const uint32_t _const_val = 0xFFFFFFFFu;
+
+  /* Only export the PDU session container if someone downstream reads it */
+  using bess::metadata::IsValidOffset;
+  bool export_psc = IsValidOffset(attr_offset(qfi_id)) ||
+                    IsValidOffset(attr_offset(pdu_type_id)) ||
+                    IsValidOffset(attr_offset(rqi_id));
+
+  /* IPv4-only batches (the common case) skip the IPv6 checks */
+  if (likely(!HasIpv6Packet(batch))) {
+    for (int i = 0; i < cnt; i++) {
+      bess::Packet *p = batch->pkts()[i];
+      eth = p->head_data<Ethernet *>();
+      if (eth->ether_type != (be16_t)(Ethernet::kIpv4) &&
+          eth->ether_type != (be16_t)(Ethernet::kArp)) {
+        EmitPacket(ctx, p, DEFAULT_GATE);
+        continue;
+      }
+
+      if (likely(parse_ipv4((Ipv4 *)(eth + 1), p, export_psc)))
+        EmitPacket(ctx, p, FORWARD_GATE);
+      else
+        DropPacket(ctx, p);
+    }
+    return;
+  }
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *p = batch->pkts()[i];
+    bool ok;
     eth = p->head_data<Ethernet *>();
-    if (eth->ether_type != (be16_t)(Ethernet::kIpv4) &&
-        eth->ether_type != (be16_t)(Ethernet::kArp)) {
+    if (eth->ether_type == (be16_t)(Ethernet::kIpv6)) {
+      ok = parse_ipv6((Ipv6 *)(eth + 1), p, export_psc);
+    } else if (eth->ether_type == (be16_t)(Ethernet::kIpv4) ||
+               eth->ether_type == (be16_t)(Ethernet::kArp)) {
+      ok = parse_ipv4((Ipv4 *)(eth + 1), p, export_psc);
+    } else {
       EmitPacket(ctx, p, DEFAULT_GATE);
       continue;
     }
 
-    iph = (Ipv4 *)(eth + 1);
-    switch (iph->protocol) {
-      case Ipv4::kTcp:
-        tcph = (Tcp *)((char *)iph + (iph->header_length << 2));
-        set_gtp_parsing_attrs(&iph->src, &iph->dst, &tcph->src_port,
-                              &tcph->dst_port, (be32_t *)&_const_val,
-                              (be32_t *)&_const_val, &iph->protocol, p);
-        break;
-      case Ipv4::kUdp:
-        udph = (Udp *)((char *)iph + (iph->header_length << 2));
-        if (udph->dst_port == (be16_t)(UDP_PORT_GTPU)) {
-          Ipv4 *old_iph = iph;
-          gtph = (Gtpv1 *)(udph + 1);
-          be32_t teid = (be32_t)gtph->teid.value();
-          /* reuse iph, tcph, and udph for innser headers too */
-          iph = (Ipv4 *)((char *)gtph + gtph->header_length());
-          switch (iph->protocol) {
-            case Ipv4::kTcp:
-              tcph = (Tcp *)((char *)iph + (iph->header_length << 2));
-              set_gtp_parsing_attrs(&iph->src, &iph->dst, &tcph->src_port,
-                                    &tcph->dst_port, (be32_t *)&teid,
-                                    &old_iph->dst, &iph->protocol, p);
-              break;
-            case Ipv4::kUdp:
-              udph = (Udp *)((char *)iph + (iph->header_length << 2));
-              set_gtp_parsing_attrs(&iph->src, &iph->dst, &udph->src_port,
-                                    &udph->dst_port, (be32_t *)&teid,
-                                    &old_iph->dst, &iph->protocol, p);
-              break;
-            case Ipv4::kEsp:
-              // ESP has no ports, encrypted payload
-              set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
-                                    (be16_t *)&_const_val, (be32_t *)&teid,
-                                    &old_iph->dst, &iph->protocol, p);
-              break;
-            default:
-              set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
-                                    (be16_t *)&_const_val, (be32_t *)&teid,
-                                    &old_iph->dst, &iph->protocol, p);
-              break;
-          }
-        } else {
-          set_gtp_parsing_attrs(&iph->src, &iph->dst, &udph->src_port,
-                                &udph->dst_port, (be32_t *)&_const_val,
-                                (be32_t *)&_const_val, &iph->protocol, p);
-        }
-        break;
-      case Ipv4::kIcmp:
-        set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
-                              (be16_t *)&_const_val, (be32_t *)&_const_val,
-                              (be32_t *)&_const_val, &iph->protocol, p);
-        break;
-      case Ipv4::kEsp:
-        set_gtp_parsing_attrs(&iph->src, &iph->dst, (be16_t *)&_const_val,
-                              (be16_t *)&_const_val, (be32_t *)&_const_val,
-                              (be32_t *)&_const_val, &iph->protocol, p);
-        break;
-      default:
-        /* nothing here at the moment */
-        break;
-    }
-
-    EmitPacket(ctx, p, FORWARD_GATE);
+    if (likely(ok))
+      EmitPacket(ctx, p, FORWARD_GATE);
+    else
+      DropPacket(ctx, p);
   }
 }
 /*----------------------------------------------------------------------------------*/
@@ -138,6 +303,14 @@ CommandResponse GtpuParser::Init(const bess::pb::EmptyArg &) {
   tunnel_ip4_dst_id =
       AddMetadataAttr("tunnel_ipv4_dst", sizeof(uint32_t), AccessMode::kWrite);
   proto_id = AddMetadataAttr("ip_proto", sizeof(uint8_t), AccessMode::kWrite);
+  src_ip6_id = AddMetadataAttr("src_ip6", kIpv6AddrLen, AccessMode::kWrite);
+  dst_ip6_id = AddMetadataAttr("dst_ip6", kIpv6AddrLen, AccessMode::kWrite);
+  tunnel_ip6_dst_id =
+      AddMetadataAttr("tunnel_ipv6_dst", kIpv6AddrLen, AccessMode::kWrite);
+  qfi_id = AddMetadataAttr("qfi", sizeof(uint8_t), AccessMode::kWrite);
+  pdu_type_id =
+      AddMetadataAttr("pdu_type", sizeof(uint8_t), AccessMode::kWrite);
+  rqi_id = AddMetadataAttr("rqi", sizeof(uint8_t), AccessMode::kWrite);
 
   return CommandSuccess();
 }
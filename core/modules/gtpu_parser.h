@@ -8,6 +8,12 @@
 #include "../module.h"
 /* for endian types */
 #include "utils/endian.h"
+/* for gtp header */
+#include "utils/gtp.h"
+/* for GtpuPscInfo */
+#include "utils/gtpu_parse.h"
+/* for ip headers */
+#include "utils/ip.h"
 using bess::utils::be16_t;
 using bess::utils::be32_t;
 /*----------------------------------------------------------------------------------*/
@@ -21,6 +27,11 @@ typedef struct EpcMetadata {
   be16_t inner_l4_dport;
   be32_t teid;
 } EpcMetadata;
+/**
+ * Size of the src_ip6, dst_ip6 and tunnel_ipv6_dst attributes, which hold
+ * addresses in network order
+ */
+static const size_t kIpv6AddrLen = 16;
 /*----------------------------------------------------------------------------------*/
 class GtpuParser final : public Module {
  public:
@@ -36,6 +47,19 @@ class GtpuParser final : public Module {
   void set_gtp_parsing_attrs(be32_t *sip, be32_t *dip, be16_t *sp, be16_t *dp,
                              be32_t *teid, be32_t *tipd, uint8_t *protoid,
                              bess::Packet *p);
+  void set_ipv6_attr(int attr_id, const uint8_t *addr, bess::Packet *p);
+  void set_ipv6_attrs(const bess::utils::Ipv6 *iph,
+                      const bess::utils::Ipv6 *tunnel_iph, bess::Packet *p);
+  void set_psc_attrs(const bess::utils::GtpuPscInfo &info, bess::Packet *p);
+  /* header walkers; false if the packet has a malformed GTP-U header */
+  size_t gtpu_header_length(const bess::utils::Gtpv1 *gtph, bess::Packet *p,
+                            bess::utils::GtpuPscInfo *info);
+  bool parse_ipv4(bess::utils::Ipv4 *iph, bess::Packet *p, bool export_psc);
+  void parse_inner_ipv4(bess::utils::Ipv4 *iph, be32_t *teid, be32_t *tipd,
+                        bess::Packet *p);
+  bool parse_ipv6(bess::utils::Ipv6 *iph, bess::Packet *p, bool export_psc);
+  void parse_inner_ipv6(bess::utils::Ipv6 *iph, bess::utils::Ipv6 *tunnel_iph,
+                        be32_t *teid, be32_t *tipd, bess::Packet *p);
   int src_ip_id = -1;
   int dst_ip_id = -1;
   int src_port_id = -1;
@@ -43,6 +67,14 @@ class GtpuParser final : public Module {
   int teid_id = -1;
   int tunnel_ip4_dst_id = -1;
   int proto_id = -1;
+  /* only written for IPv6 packets */
+  int src_ip6_id = -1;
+  int dst_ip6_id = -1;
+  int tunnel_ip6_dst_id = -1;
+  /* PDU session container fields, 0 if there is none */
+  int qfi_id = -1;
+  int pdu_type_id = -1;
+  int rqi_id = -1;
 };
 /*----------------------------------------------------------------------------------*/
 #endif  // BESS_MODULES_GTPUPARSER_H_
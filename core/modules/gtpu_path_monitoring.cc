@@ -20,9 +20,30 @@ using bess::utils::Ethernet;
 using bess::utils::Gtpv1;
 using bess::utils::Gtpv1SeqPDUExt;
 using bess::utils::Ipv4;
+using bess::utils::Ipv6;
 using bess::utils::ToIpv4Address;
+using bess::utils::ToIpv6Address;
 using bess::utils::Udp;
 
+// gNB addresses are kept as raw bytes: 4 (IPv4, host order) or 16 (IPv6,
+// network order)
+static std::string Ipv4Key(uint32_t addr) {
+  return std::string(reinterpret_cast<const char *>(&addr), sizeof(addr));
+}
+
+static std::string Ipv6Key(const uint8_t *addr) {
+  return std::string(reinterpret_cast<const char *>(addr), 16);
+}
+
+static std::string KeyToString(const std::string &key) {
+  if (key.size() == 16) {
+    return ToIpv6Address(reinterpret_cast<const uint8_t *>(key.data()));
+  }
+  uint32_t addr;
+  memcpy(&addr, key.data(), sizeof(addr));
+  return ToIpv4Address(static_cast<be32_t>(addr));
+}
+
 const Commands GtpuPathMonitoring::cmds = {
     {"add", "GtpuPathMonitoringCommandAddDeleteArg",
      MODULE_CMD_FUNC(&GtpuPathMonitoring::CommandAdd), Command::THREAD_SAFE},
@@ -50,8 +71,12 @@ void GtpuPathMonitoring::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     }
 
     Ethernet *eth = pkt->head_data<Ethernet *>();
+    bool ipv6 = eth->ether_type == be16_t(Ethernet::kIpv6);
     Ipv4 *iph = (Ipv4 *)((unsigned char *)eth + sizeof(Ethernet));
-    Udp *udp = (Udp *)((unsigned char *)iph + (iph->header_length << 2));
+    Ipv6 *ip6h = (Ipv6 *)iph;
+    /* Outer IPv6 extension headers are not supported */
+    Udp *udp = ipv6 ? (Udp *)(ip6h + 1)
+                    : (Udp *)((unsigned char *)iph + (iph->header_length << 2));
     Gtpv1 *gtph = (Gtpv1 *)((unsigned char *)udp + sizeof(Udp));
     Gtpv1SeqPDUExt *speh =
         (Gtpv1SeqPDUExt *)((unsigned char *)gtph + sizeof(Gtpv1));
@@ -62,18 +87,30 @@ void GtpuPathMonitoring::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       speh->seqnum = static_cast<be16_t>(m_seqNumber);
 
       for (auto it : m_dstIp) {
+        /* Only probe gNBs of the same address family as the request */
+        if (it.first.size() != (ipv6 ? 16 : sizeof(uint32_t))) {
+          continue;
+        }
         m_storedData[it.first][m_seqNumber] = tsc_to_ns(rdtsc());
         bess::Packet *newPkt = bess::Packet::copy(pkt);
         Ethernet *newEth = newPkt->head_data<Ethernet *>();
-        Ipv4 *newIph = (Ipv4 *)((unsigned char *)newEth + sizeof(Ethernet));
-        newIph->dst = static_cast<be32_t>(it.first);
+        if (ipv6) {
+          Ipv6 *newIph = (Ipv6 *)((unsigned char *)newEth + sizeof(Ethernet));
+          memcpy(newIph->dst, it.first.data(), sizeof(newIph->dst));
+        } else {
+          Ipv4 *newIph = (Ipv4 *)((unsigned char *)newEth + sizeof(Ethernet));
+          uint32_t dst;
+          memcpy(&dst, it.first.data(), sizeof(dst));
+          newIph->dst = static_cast<be32_t>(dst);
+        }
         EmitPacket(ctx, newPkt);
       }
 
       m_seqNumber++;
 
     } else if (gtpuType == GTPU_ECHO_RESPONSE) {
-      uint32_t srcIp = iph->src.value();
+      std::string srcIp =
+          ipv6 ? Ipv6Key(ip6h->src) : Ipv4Key(iph->src.value());
       uint16_t seqNumber = speh->seqnum.value();
       auto it = m_storedData.find(srcIp);
       if (it != m_storedData.end()) {
@@ -112,7 +149,7 @@ void GtpuPathMonitoring::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
       }
 
       LOG(INFO) << "type:" << +gtpuType
-                << ", srcIp:" << ToIpv4Address(static_cast<be32_t>(srcIp))
+                << ", srcIp:" << KeyToString(srcIp)
                 << ", seqNumber:" << seqNumber << ", latency:["
                 << m_latency[srcIp].m_min << ", " << m_latency[srcIp].m_mean
                 << ", " << m_latency[srcIp].m_max << "]";
@@ -129,7 +166,13 @@ CommandResponse GtpuPathMonitoring::CommandReadStats(
   bess::pb::GtpuPathMonitoringCommandReadResponse resp;
   for (auto &element : m_latency) {
     bess::pb::GtpuPathMonitoringCommandReadResponse::Statistic stat;
-    stat.set_gnb_ip(element.first);
+    if (element.first.size() == 16) {
+      stat.set_gnb_ip6(element.first);
+    } else {
+      uint32_t addr;
+      memcpy(&addr, element.first.data(), sizeof(addr));
+      stat.set_gnb_ip(addr);
+    }
     stat.set_count(element.second.m_count);
     stat.set_latency_min(element.second.m_min);
     stat.set_latency_mean(element.second.m_mean);
@@ -153,9 +196,27 @@ CommandResponse GtpuPathMonitoring::Init(const bess::pb::EmptyArg &) {
   return CommandSuccess();
 }
 
+CommandResponse GtpuPathMonitoring::GnbKey(
+    const bess::pb::GtpuPathMonitoringCommandAddDeleteArg &arg,
+    std::string *key) {
+  if (arg.gnb_ip6().empty()) {
+    *key = Ipv4Key(arg.gnb_ip());
+  } else if (arg.gnb_ip6().size() == 16) {
+    *key = arg.gnb_ip6();
+  } else {
+    return CommandFailure(EINVAL, "gnb_ip6 must be 16 bytes long");
+  }
+  return CommandSuccess();
+}
+
 CommandResponse GtpuPathMonitoring::CommandAdd(
     const bess::pb::GtpuPathMonitoringCommandAddDeleteArg &arg) {
-  uint32_t dst = arg.gnb_ip();
+  std::string dst;
+  CommandResponse err = GnbKey(arg, &dst);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
   auto it = m_dstIp.find(dst);
   if (it == m_dstIp.end()) {
     m_dstIp.emplace(dst, 1);
@@ -168,11 +229,15 @@ CommandResponse GtpuPathMonitoring::CommandAdd(
 
 CommandResponse GtpuPathMonitoring::CommandDelete(
     const bess::pb::GtpuPathMonitoringCommandAddDeleteArg &arg) {
-  uint32_t dst = arg.gnb_ip();
+  std::string dst;
+  CommandResponse err = GnbKey(arg, &dst);
+  if (err.error().code() != 0) {
+    return err;
+  }
+
   auto it = m_dstIp.find(dst);
   if (it == m_dstIp.end()) {
-    LOG(ERROR) << "Address " << ToIpv4Address(static_cast<be32_t>(dst))
-               << " is not known";
+    LOG(ERROR) << "Address " << KeyToString(dst) << " is not known";
   } else {
     if (it->second == 1) {
       m_dstIp.erase(dst);
@@ -9,6 +9,7 @@
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
 
+#include <string>
 #include <unordered_map>
 #include <vector>
 
@@ -45,10 +46,17 @@ class GtpuPathMonitoring final : public Module {
 
   void Clear();
 
-  std::unordered_map<uint32_t, std::unordered_map<uint16_t, uint64_t>>
+  // gNB address of an add/delete command, as a key of the maps below
+  CommandResponse GnbKey(
+      const bess::pb::GtpuPathMonitoringCommandAddDeleteArg &arg,
+      std::string *key);
+
+  // gNB addresses are 4 (IPv4, host order) or 16 (IPv6) raw bytes
+  std::unordered_map<std::string, std::unordered_map<uint16_t, uint64_t>>
       m_storedData;  // Store timestamp {dst_IP, {sequence_number, latency}}
-  std::unordered_map<uint32_t, Values> m_latency;  // Store latency per dstIp
-  std::unordered_map<uint32_t, uint32_t>
+  std::unordered_map<std::string, Values>
+      m_latency;  // Store latency per dstIp
+  std::unordered_map<std::string, uint32_t>
       m_dstIp;              // GTP Tunnel destination {gNB IP, counter}
   uint16_t m_seqNumber{0};  // gtpu echo sequence number
 };
@@ -68,8 +68,8 @@ bess::Packet *IPFrag::FragmentPkt(Context *ctx, bess::Packet *p) {
     /* fragment the IPV4 packet */
     res = rte_ipv4_fragment_packet(
         m, &frag_tbl[0], BATCH_SIZE,
-        eth_mtu - RTE_ETHER_CRC_LEN - RTE_ETHER_HDR_LEN, m->pool,
-        indirect_pktmbuf_pool->pool());
+        eth_mtu - RTE_ETHER_CRC_LEN - RTE_ETHER_HDR_LEN,
+        current_worker.packet_pool()->pool(), indirect_pktmbuf_pool->pool());
 
     if (unlikely(res < 0)) {
       EmitPacket(ctx, p, DEFAULT_GATE);
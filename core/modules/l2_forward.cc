@@ -34,6 +34,10 @@
 #include "l2_forward.h"
 
 #include <rte_hash_crc.h>
+#include <rte_prefetch.h>
+
+#include <algorithm>
+#include <cstdlib>
 
 #include "../utils/endian.h"
 #include "../utils/simd.h"
@@ -41,6 +45,8 @@
 #define MAX_TABLE_SIZE (1048576 * 64)
 #define DEFAULT_TABLE_SIZE 1024
 #define MAX_BUCKET_SIZE 4
+#define DEFAULT_AGE_SEC 300
+#define AGING_SLOTS_PER_BATCH 16
 
 typedef uint64_t mac_addr_t;
 
@@ -58,8 +64,9 @@ static int is_power_of_2(uint64_t n) {
  *        less than equal to MAX_TABLE_SIZE (2^30)
  * @bucket: number of slots per hash value. must be power of 2, greater than 0,
  *        and less than equal to MAX_BUCKET_SIZE (4)
+ * @learn: whether to keep track of when learned entries were last seen
  */
-static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
+int l2_init(struct l2_table *l2tbl, int size, int bucket, bool learn) {
   if (size <= 0 || size > MAX_TABLE_SIZE || !is_power_of_2(size)) {
     return -EINVAL;
   }
@@ -72,12 +79,27 @@ static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
     return -EINVAL;
   }
 
-  l2tbl->table = new (std::nothrow) l2_entry[size * bucket]{};
+  size_t slots = static_cast<size_t>(size) * bucket;
+  size_t bytes = std::max(slots * sizeof(struct l2_entry), size_t{64});
+
+  l2tbl->table = static_cast<struct l2_entry *>(aligned_alloc(64, bytes));
 
   if (l2tbl->table == nullptr) {
     return -ENOMEM;
   }
 
+  memset(l2tbl->table, 0, bytes);
+
+  l2tbl->last_seen = nullptr;
+  if (learn) {
+    l2tbl->last_seen = new (std::nothrow) uint32_t[slots]();
+    if (l2tbl->last_seen == nullptr) {
+      free(l2tbl->table);
+      l2tbl->table = nullptr;
+      return -ENOMEM;
+    }
+  }
+
   l2tbl->size = size;
   l2tbl->bucket = bucket;
 
@@ -91,18 +113,20 @@ static int l2_init(struct l2_table *l2tbl, int size, int bucket) {
   return 0;
 }
 
-static int l2_deinit(struct l2_table *l2tbl) {
+int l2_deinit(struct l2_table *l2tbl) {
   if (l2tbl == nullptr || l2tbl->table == nullptr || l2tbl->size == 0 ||
       l2tbl->bucket == 0) {
     return -EINVAL;
   }
 
-  delete[] l2tbl->table;
+  free(l2tbl->table);
+  delete[] l2tbl->last_seen;
   *l2tbl = {};
   return 0;
 }
 
-static uint32_t l2_ib_to_offset(struct l2_table *l2tbl, int index, int bucket) {
+static uint32_t l2_ib_to_offset(const struct l2_table *l2tbl, int index,
+                                int bucket) {
   return index * l2tbl->bucket + bucket;
 }
 
@@ -129,7 +153,7 @@ const union {
                    0x8000ffffFFFFffffull, 0x8000ffffFFFFffffull}};
 
 // Do not call these functions directly. Use find_index() instead. See below.
-static inline int find_index_avx(uint64_t addr, uint64_t *table) {
+static inline int find_index_avx(uint64_t addr, const uint64_t *table) {
   DCHECK(reinterpret_cast<uintptr_t>(table) % 32 == 0);
   __m256d _addr = (__m256d)_mm256_set1_epi64x(addr | (1ull << 63));
   __m256d _table = _mm256_load_pd((double *)table);
@@ -139,7 +163,7 @@ static inline int find_index_avx(uint64_t addr, uint64_t *table) {
   return __builtin_ffs(_mm256_movemask_pd(cmp));
 }
 #else
-static inline int find_index_basic(uint64_t addr, uint64_t *table) {
+static inline int find_index_basic(uint64_t addr, const uint64_t *table) {
   for (int i = 0; i < 4; i++) {
     if ((addr | (1ull << 63)) == (table[i] & 0x8000ffffFFFFffffull)) {
       return i + 1;
@@ -152,7 +176,7 @@ static inline int find_index_basic(uint64_t addr, uint64_t *table) {
 
 // Finds addr from a 4-way bucket *table and returns its index + 1.
 // Returns zero if not found.
-static inline int find_index(uint64_t addr, uint64_t *table, const uint64_t) {
+static inline int find_index(uint64_t addr, const uint64_t *table) {
 #if __AVX__
   return find_index_avx(addr, table);
 #else
@@ -160,12 +184,11 @@ static inline int find_index(uint64_t addr, uint64_t *table, const uint64_t) {
 #endif
 }
 
-static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
-                          gate_idx_t *gate) {
+int l2_find(const struct l2_table *l2tbl, uint64_t addr, gate_idx_t *gate) {
   size_t i;
   int ret = -ENOENT;
   uint32_t hash, idx1, offset;
-  struct l2_entry *tbl = l2tbl->table;
+  const struct l2_entry *tbl = l2tbl->table;
 
   hash = l2_hash(addr);
   idx1 = l2_hash_to_index(hash, l2tbl->size);
@@ -173,7 +196,7 @@ static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
   offset = l2_ib_to_offset(l2tbl, idx1, 0);
 
   if (l2tbl->bucket == 4) {
-    int tmp1 = find_index(addr, &tbl[offset].entry, l2tbl->count);
+    int tmp1 = find_index(addr, &tbl[offset].entry);
     if (tmp1) {
       *gate = tbl[offset + tmp1 - 1].gate;
       return 0;
@@ -182,7 +205,7 @@ static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
     idx1 = l2_alt_index(hash, l2tbl->size_power, idx1);
     offset = l2_ib_to_offset(l2tbl, idx1, 0);
 
-    int tmp2 = find_index(addr, &tbl[offset].entry, l2tbl->count);
+    int tmp2 = find_index(addr, &tbl[offset].entry);
 
     if (tmp2) {
       *gate = tbl[offset + tmp2 - 1].gate;
@@ -216,11 +239,53 @@ static inline int l2_find(struct l2_table *l2tbl, uint64_t addr,
   return ret;
 }
 
-static int l2_find_offset(struct l2_table *l2tbl, uint64_t addr,
+void l2_find_bulk(const struct l2_table *l2tbl, const uint64_t *addrs,
+                  int cnt, gate_idx_t *gates, gate_idx_t default_gate) {
+  uint32_t offsets1[bess::PacketBatch::kMaxBurst];
+  uint32_t offsets2[bess::PacketBatch::kMaxBurst];
+  const struct l2_entry *tbl = l2tbl->table;
+
+  if (l2tbl->bucket != 4 || cnt > bess::PacketBatch::kMaxBurst) {
+    for (int i = 0; i < cnt; i++) {
+      if (l2_find(l2tbl, addrs[i], &gates[i]) != 0) {
+        gates[i] = default_gate;
+      }
+    }
+    return;
+  }
+
+  // Hashes all addresses and prefetches both of their buckets first (the
+  // CRC32 instructions of different addresses are pipelined), ...
+  for (int i = 0; i < cnt; i++) {
+    uint32_t hash = l2_hash(addrs[i]);
+    uint32_t idx1 = l2_hash_to_index(hash, l2tbl->size);
+    uint32_t idx2 = l2_alt_index(hash, l2tbl->size_power, idx1);
+
+    offsets1[i] = l2_ib_to_offset(l2tbl, idx1, 0);
+    offsets2[i] = l2_ib_to_offset(l2tbl, idx2, 0);
+    rte_prefetch0(&tbl[offsets1[i]]);
+    rte_prefetch0(&tbl[offsets2[i]]);
+  }
+
+  // ... so that the buckets are likely in the cache by the time they are
+  // compared against.
+  for (int i = 0; i < cnt; i++) {
+    int tmp1 = find_index(addrs[i], &tbl[offsets1[i]].entry);
+    if (tmp1) {
+      gates[i] = tbl[offsets1[i] + tmp1 - 1].gate;
+      continue;
+    }
+
+    int tmp2 = find_index(addrs[i], &tbl[offsets2[i]].entry);
+    gates[i] = tmp2 ? tbl[offsets2[i] + tmp2 - 1].gate : default_gate;
+  }
+}
+
+static int l2_find_offset(const struct l2_table *l2tbl, uint64_t addr,
                           uint32_t *offset_out) {
   size_t i;
   uint32_t hash, idx1, offset;
-  struct l2_entry *tbl = l2tbl->table;
+  const struct l2_entry *tbl = l2tbl->table;
 
   hash = l2_hash(addr);
   idx1 = l2_hash_to_index(hash, l2tbl->size);
@@ -290,11 +355,14 @@ static int l2_find_slot(struct l2_table *l2tbl, mac_addr_t addr, uint32_t *idx,
       if (!tbl[offset2].occupied) {
         /* move offset1 to offset2 */
         tbl[offset2] = tbl[offset1];
+        if (l2tbl->last_seen) {
+          l2tbl->last_seen[offset2] = l2tbl->last_seen[offset1];
+        }
         /* clear offset1 */
         tbl[offset1].occupied = 0;
 
         *idx = idx1;
-        *bucket = 0;
+        *bucket = i;
         return 0;
       }
     }
@@ -304,8 +372,8 @@ static int l2_find_slot(struct l2_table *l2tbl, mac_addr_t addr, uint32_t *idx,
   return -ENOMEM;
 }
 
-static int l2_add_entry(struct l2_table *l2tbl, mac_addr_t addr,
-                        gate_idx_t gate) {
+int l2_add_entry(struct l2_table *l2tbl, mac_addr_t addr, gate_idx_t gate,
+                 uint32_t last_seen) {
   uint32_t offset;
   uint32_t index;
   uint32_t bucket;
@@ -327,11 +395,14 @@ static int l2_add_entry(struct l2_table *l2tbl, mac_addr_t addr,
   l2tbl->table[offset].addr = addr;
   l2tbl->table[offset].gate = gate;
   l2tbl->table[offset].occupied = 1;
+  if (l2tbl->last_seen) {
+    l2tbl->last_seen[offset] = last_seen;
+  }
   l2tbl->count++;
   return 0;
 }
 
-static int l2_del_entry(struct l2_table *l2tbl, uint64_t addr) {
+int l2_del_entry(struct l2_table *l2tbl, uint64_t addr) {
   uint32_t offset = 0xFFFFFFFF;
 
   if (l2_find_offset(l2tbl, addr, &offset)) {
@@ -341,6 +412,9 @@ static int l2_del_entry(struct l2_table *l2tbl, uint64_t addr) {
   l2tbl->table[offset].addr = 0;
   l2tbl->table[offset].gate = 0;
   l2tbl->table[offset].occupied = 0;
+  if (l2tbl->last_seen) {
+    l2tbl->last_seen[offset] = 0;
+  }
   l2tbl->count--;
   return 0;
 }
@@ -352,6 +426,11 @@ static int l2_flush(struct l2_table *l2tbl) {
 
   memset(l2tbl->table, 0,
          sizeof(struct l2_entry) * l2tbl->size * l2tbl->bucket);
+  if (l2tbl->last_seen) {
+    memset(l2tbl->last_seen, 0,
+           sizeof(uint32_t) * l2tbl->size * l2tbl->bucket);
+  }
+  l2tbl->count = 0;
 
   return 0;
 }
@@ -551,8 +630,9 @@ const Commands L2Forward::cmds = {
      MODULE_CMD_FUNC(&L2Forward::CommandDelete), Command::THREAD_UNSAFE},
     {"set_default_gate", "L2ForwardCommandSetDefaultGateArg",
      MODULE_CMD_FUNC(&L2Forward::CommandSetDefaultGate), Command::THREAD_SAFE},
+    // Not thread safe with learn, where workers add entries
     {"lookup", "L2ForwardCommandLookupArg",
-     MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_SAFE},
+     MODULE_CMD_FUNC(&L2Forward::CommandLookup), Command::THREAD_UNSAFE},
     {"populate", "L2ForwardCommandPopulateArg",
      MODULE_CMD_FUNC(&L2Forward::CommandPopulate), Command::THREAD_UNSAFE},
 };
@@ -571,7 +651,14 @@ CommandResponse L2Forward::Init(const bess::pb::L2ForwardArg &arg) {
     bucket = MAX_BUCKET_SIZE;
   }
 
-  ret = l2_init(&l2_table_, size, bucket);
+  learn_ = arg.learn();
+  age_sec_ = arg.age_sec() ?: DEFAULT_AGE_SEC;
+  learn_rate_ = arg.learn_rate();
+  if (learn_) {
+    max_allowed_workers_ = 1;
+  }
+
+  ret = l2_init(&l2_table_, size, bucket, learn_);
 
   if (ret != 0) {
     return CommandFailure(-ret,
@@ -589,21 +676,81 @@ void L2Forward::DeInit() {
 
 void L2Forward::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t default_gate = ACCESS_ONCE(default_gate_);
+  uint64_t addrs[bess::PacketBatch::kMaxBurst];
+  gate_idx_t gates[bess::PacketBatch::kMaxBurst];
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
-    bess::Packet *snb = batch->pkts()[i];
-
-    gate_idx_t out_gate;
     // read destination MAC address (first 6 bytes)
     // NOTE: assumes little endian
-    int ret = l2_find(&l2_table_,
-                      *(snb->head_data<uint64_t *>()) & 0x0000ffffffffffff,
-                      &out_gate);
-    if (ret != 0) {
-      EmitPacket(ctx, snb, default_gate);
-    } else {
-      EmitPacket(ctx, snb, out_gate);
+    addrs[i] =
+        *(batch->pkts()[i]->head_data<uint64_t *>()) & 0x0000ffffffffffff;
+  }
+
+  l2_find_bulk(&l2_table_, addrs, cnt, gates, default_gate);
+
+  if (learn_) {
+    Learn(ctx, batch);
+  }
+
+  for (int i = 0; i < cnt; i++) {
+    EmitPacket(ctx, batch->pkts()[i], gates[i]);
+  }
+}
+
+void L2Forward::Learn(Context *ctx, bess::PacketBatch *batch) {
+  // In seconds; 0 in last_seen marks entries added by commands, which never
+  // expire
+  uint32_t now = ctx->current_ns / 1000000000 + 1;
+  gate_idx_t igate = ctx->current_igate;
+
+  if (now != learn_sec_) {
+    learn_sec_ = now;
+    learn_budget_ = learn_rate_ ?: UINT32_MAX;
+  }
+
+  int cnt = batch->cnt();
+  for (int i = 0; i < cnt; i++) {
+    // source MAC address (bytes 6-11)
+    uint64_t addr = *(batch->pkts()[i]->head_data<uint64_t *>(4)) >> 16;
+    uint32_t offset;
+
+    if (addr & 1) {
+      continue;  // not learning multicast and broadcast addresses
+    }
+
+    if (l2_find_offset(&l2_table_, addr, &offset) == 0) {
+      uint32_t &last_seen = l2_table_.last_seen[offset];
+      if (last_seen == 0) {
+        continue;
+      }
+      // avoid dirtying cache lines if nothing changed
+      if (last_seen != now) {
+        last_seen = now;
+      }
+      if (l2_table_.table[offset].gate != igate) {
+        l2_table_.table[offset].gate = igate;
+      }
+    } else if (learn_budget_ > 0 &&
+               l2_add_entry(&l2_table_, addr, igate, now) == 0) {
+      learn_budget_--;
+    }
+  }
+
+  Age(now);
+}
+
+void L2Forward::Age(uint32_t now) {
+  // Both are powers of 2
+  uint64_t mask = l2_table_.size * l2_table_.bucket - 1;
+
+  for (int i = 0; i < AGING_SLOTS_PER_BATCH; i++) {
+    uint64_t offset = aging_cursor_;
+    aging_cursor_ = (aging_cursor_ + 1) & mask;
+
+    uint32_t last_seen = l2_table_.last_seen[offset];
+    if (last_seen != 0 && now - last_seen > age_sec_) {
+      l2_del_entry(&l2_table_, l2_table_.table[offset].addr);
     }
   }
 }
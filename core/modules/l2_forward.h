@@ -40,7 +40,7 @@
 #error this code assumes little endian architecture (x86)
 #endif
 
-struct alignas(32) l2_entry {
+struct l2_entry {
   union {
     struct {
       uint64_t addr : 48;
@@ -51,21 +51,49 @@ struct alignas(32) l2_entry {
   };
 };
 
+static_assert(sizeof(struct l2_entry) == 8, "struct l2_entry is incorrect");
+
 struct l2_table {
-  struct l2_entry *table;
+  struct l2_entry *table;  // 64-byte aligned: a bucket is in one cache line
+  uint32_t *last_seen;     // per slot, if learning: see L2Forward::Learn()
   uint64_t size;
   uint64_t size_power;
   uint64_t bucket;
   uint64_t count;
 };
 
+// The forwarding table. Addresses are the 6 bytes of a MAC address, read as
+// a little endian integer.
+int l2_init(struct l2_table *l2tbl, int size, int bucket, bool learn = false);
+int l2_deinit(struct l2_table *l2tbl);
+int l2_add_entry(struct l2_table *l2tbl, uint64_t addr, gate_idx_t gate,
+                 uint32_t last_seen = 0);
+int l2_del_entry(struct l2_table *l2tbl, uint64_t addr);
+int l2_find(const struct l2_table *l2tbl, uint64_t addr, gate_idx_t *gate);
+
+// Looks up cnt addresses at once, setting gates[i] to default_gate for those
+// that are not found. Faster than l2_find() one by one, since the cache
+// misses of the lookups overlap.
+void l2_find_bulk(const struct l2_table *l2tbl, const uint64_t *addrs,
+                  int cnt, gate_idx_t *gates, gate_idx_t default_gate);
+
 class L2Forward final : public Module {
  public:
+  static const gate_idx_t kNumIGates = MAX_GATES;
   static const gate_idx_t kNumOGates = MAX_GATES;
 
   static const Commands cmds;
 
-  L2Forward() : Module(), l2_table_(), default_gate_() {
+  L2Forward()
+      : Module(),
+        l2_table_(),
+        default_gate_(),
+        learn_(),
+        age_sec_(),
+        learn_rate_(),
+        learn_budget_(),
+        learn_sec_(),
+        aging_cursor_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -84,8 +112,23 @@ class L2Forward final : public Module {
       const bess::pb::L2ForwardCommandPopulateArg &arg);
 
  private:
+  // Learns the source addresses of the batch, which came in from
+  // ctx->current_igate, and expires some of the old ones.
+  void Learn(Context *ctx, bess::PacketBatch *batch);
+
+  // Removes the learned entries among the next few slots of the table that
+  // have not been seen for age_sec_.
+  void Age(uint32_t now);
+
   struct l2_table l2_table_;
   gate_idx_t default_gate_;
+
+  bool learn_;
+  uint32_t age_sec_;
+  uint32_t learn_rate_;    // new addresses per second, 0 for no limit
+  uint32_t learn_budget_;  // new addresses left to learn in learn_sec_
+  uint32_t learn_sec_;
+  uint64_t aging_cursor_;  // the next slot Age() checks
 };
 
 #endif  // BESS_MODULES_L2FORWARD_H_
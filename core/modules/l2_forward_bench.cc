@@ -0,0 +1,117 @@
+// Copyright (c) 2016-2017, Nefeli Networks, Inc.
+// All rights reserved.
+//
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+
+// Benchmarks for the forwarding table of L2Forward.
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glog/logging.h>
+
+#include "l2_forward.h"
+
+static const int kBatchSize = 32;
+
+// Fills a table of 2 * state.range(0) slots half full with random unicast
+// addresses, and shuffles them to look up in random order.
+class L2TableFixture : public benchmark::Fixture {
+ public:
+  L2TableFixture() : table_(), addrs_() {}
+
+  virtual void SetUp(benchmark::State &state) {
+    const size_t n = state.range(0);
+    std::mt19937_64 rng(0);
+
+    CHECK_EQ(l2_init(&table_, n / 2, 4), 0);
+
+    addrs_.clear();
+    while (addrs_.size() < n) {
+      // 48-bit unicast: the multicast bit is bit 0 of the first (low) byte
+      uint64_t addr = rng() & 0xffffffffffffull & ~1ull;
+      if (l2_add_entry(&table_, addr, addrs_.size() % 64) == 0) {
+        addrs_.push_back(addr);
+      }
+    }
+
+    std::shuffle(addrs_.begin(), addrs_.end(), rng);
+  }
+
+  virtual void TearDown(benchmark::State &) { l2_deinit(&table_); }
+
+ protected:
+  struct l2_table table_;
+  std::vector<uint64_t> addrs_;
+};
+
+// Benchmarks l2_find() for each packet of a batch, as L2Forward used to do.
+BENCHMARK_DEFINE_F(L2TableFixture, Find)(benchmark::State &state) {
+  const size_t n = state.range(0);
+  gate_idx_t gates[kBatchSize];
+  size_t i = 0;
+
+  while (state.KeepRunning()) {
+    for (int j = 0; j < kBatchSize; j++) {
+      if (l2_find(&table_, addrs_[i + j], &gates[j]) != 0) {
+        gates[j] = DROP_GATE;
+      }
+    }
+    benchmark::DoNotOptimize(gates);
+
+    i = (i + kBatchSize) % n;
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(L2TableFixture, Find)->Arg(1 << 10)->Arg(1 << 20);
+
+// Benchmarks l2_find_bulk() on whole batches.
+BENCHMARK_DEFINE_F(L2TableFixture, FindBulk)(benchmark::State &state) {
+  const size_t n = state.range(0);
+  gate_idx_t gates[kBatchSize];
+  size_t i = 0;
+
+  while (state.KeepRunning()) {
+    l2_find_bulk(&table_, &addrs_[i], kBatchSize, gates, DROP_GATE);
+    benchmark::DoNotOptimize(gates);
+
+    i = (i + kBatchSize) % n;
+  }
+
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+
+BENCHMARK_REGISTER_F(L2TableFixture, FindBulk)->Arg(1 << 10)->Arg(1 << 20);
+
+BENCHMARK_MAIN();
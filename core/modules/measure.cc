@@ -74,14 +74,26 @@ CommandResponse Measure::Init(const bess::pb::MeasureArg &arg) {
   uint64_t quotient =
       (latency_ns_max + latency_ns_resolution - 1) / latency_ns_resolution;
 
-  if (quotient > rtt_hist_.max_num_buckets() / 2) {
+  // Linear buckets, or log-linear ones as in HDR histograms
+  int sub_bucket_bits = 0;
+  size_t num_buckets = quotient;
+  if (arg.latency_significant_digits()) {
+    if (arg.latency_significant_digits() > 5) {
+      return CommandFailure(EINVAL,
+                            "'latency_significant_digits' must be [1, 5]");
+    }
+    sub_bucket_bits =
+        decltype(rtt_hist_)::SubBucketBits(arg.latency_significant_digits());
+    num_buckets = decltype(rtt_hist_)::NumLogBuckets(quotient, sub_bucket_bits);
+  }
+
+  if (num_buckets > rtt_hist_.max_num_buckets() / 2) {
     return CommandFailure(E2BIG,
                           "excessive latency_ns_max / latency_ns_resolution");
   }
 
-  size_t num_buckets = quotient;
-  rtt_hist_.Resize(num_buckets, latency_ns_resolution);
-  jitter_hist_.Resize(num_buckets, latency_ns_resolution);
+  rtt_hist_.Resize(num_buckets, latency_ns_resolution, sub_bucket_bits);
+  jitter_hist_.Resize(num_buckets, latency_ns_resolution, sub_bucket_bits);
 
   if (arg.offset()) {
     offset_ = arg.offset();
@@ -100,6 +112,8 @@ CommandResponse Measure::Init(const bess::pb::MeasureArg &arg) {
     jitter_sample_prob_ = kDefaultIpDvSampleProb;
   }
 
+  hw_timestamp_ = arg.hw_timestamp();
+
   mcs_lock_init(&lock_);
   return CommandSuccess();
 }
@@ -115,9 +129,16 @@ void Measure::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     if (attr_id_ != -1)
       pkt_time = get_attr<uint64_t>(this, attr_id_, batch->pkts()[i]);
     if (pkt_time || IsTimestamped(batch->pkts()[i], offset, &pkt_time)) {
+      // With hardware timestamps, this is the one-way latency up to the NIC
+      uint64_t arrival_ns = now_ns;
+      if (hw_timestamp_ && batch->pkts()[i]->has_rx_timestamp()) {
+        arrival_ns = batch->pkts()[i]->rx_timestamp();
+        hw_cnt_++;
+      }
+
       uint64_t diff;
-      if (now_ns >= pkt_time) {
-        diff = now_ns - pkt_time;
+      if (arrival_ns >= pkt_time) {
+        diff = arrival_ns - pkt_time;
       } else {
         // The magic number matched, but timestamp doesn't seem correct
         continue;
@@ -157,15 +178,18 @@ static void SetHistogram(
 void Measure::Clear() {
   // vector initialization is expensive thus should be out of critical section
   decltype(rtt_hist_) new_rtt_hist(rtt_hist_.num_buckets(),
-                                   rtt_hist_.bucket_width());
+                                   rtt_hist_.bucket_width(),
+                                   rtt_hist_.sub_bucket_bits());
   decltype(jitter_hist_) new_jitter_hist(jitter_hist_.num_buckets(),
-                                         jitter_hist_.bucket_width());
+                                         jitter_hist_.bucket_width(),
+                                         jitter_hist_.sub_bucket_bits());
 
   // Use move semantics to minimize critical section
   mcslock_node_t mynode;
   mcs_lock(&lock_, &mynode);
   pkt_cnt_ = 0;
   bytes_cnt_ = 0;
+  hw_cnt_ = 0;
   rtt_hist_ = std::move(new_rtt_hist);
   jitter_hist_ = std::move(new_jitter_hist);
   mcs_unlock(&lock_, &mynode);
@@ -204,6 +228,7 @@ CommandResponse Measure::CommandGetSummary(
   r.set_timestamp(get_epoch_time());
   r.set_packets(pkt_cnt_);
   r.set_bits((bytes_cnt_ + pkt_cnt_ * 24) * 8);
+  r.set_hw_timestamped(hw_cnt_);
   const auto &rtt = rtt_hist_.Summarize(latency_percentiles);
   const auto &jitter = jitter_hist_.Summarize(jitter_percentiles);
 
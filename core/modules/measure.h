@@ -51,8 +51,10 @@ class Measure final : public Module {
         last_rtt_ns_(),
         offset_(),
         attr_id_(-1),
+        hw_timestamp_(),
         pkt_cnt_(),
-        bytes_cnt_() {
+        bytes_cnt_(),
+        hw_cnt_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -79,9 +81,11 @@ class Measure final : public Module {
   std::atomic<std::uint64_t> last_rtt_ns_;
   size_t offset_;  // in bytes
   int attr_id_;
+  bool hw_timestamp_;  // use hardware RX timestamps as arrival time
 
   std::atomic<std::uint64_t> pkt_cnt_;
   std::atomic<std::uint64_t> bytes_cnt_;
+  std::atomic<std::uint64_t> hw_cnt_;  // measured with hardware timestamps
   mcslock lock_;
 };
 
@@ -82,6 +82,15 @@ CommandResponse PortInc::Init(const bess::pb::PortIncArg &arg) {
     prefetch_ = 1;
   }
 
+  if (arg.flow_mark()) {
+    flow_mark_attr_ =
+        AddMetadataAttr("flow_mark", sizeof(uint32_t),
+                        bess::metadata::Attribute::AccessMode::kWrite);
+    if (flow_mark_attr_ < 0) {
+      return CommandFailure(-flow_mark_attr_, "add_metadata_attr() failed");
+    }
+  }
+
   ret = port_->AcquireQueues(reinterpret_cast<const module *>(this),
                              PACKET_DIR_INC, nullptr, 0);
   if (ret < 0) {
@@ -95,6 +104,7 @@ CommandResponse PortInc::GetInitialArg(const bess::pb::EmptyArg &) {
   bess::pb::PortIncArg arg;
   arg.set_port(port_->name());
   arg.set_prefetch(prefetch_);
+  arg.set_flow_mark(flow_mark_attr_ >= 0);
   return CommandSuccess(arg);
 }
 
@@ -135,6 +145,10 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
   p->queue_stats[PACKET_DIR_INC][qid].actual_hist[cnt]++;
   p->queue_stats[PACKET_DIR_INC][qid].diff_hist[burst - cnt]++;
   if (cnt == 0) {
+    // Let an idle worker sleep until this queue gets packets.
+    if (current_worker.idle_policy().rx_interrupt) {
+      current_worker.AddRxInterruptQueue(p, qid);
+    }
     return {.block = true, .packets = 0, .bits = 0};
   }
 
@@ -155,6 +169,15 @@ struct task_result PortInc::RunTask(Context *ctx, bess::PacketBatch *batch,
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
+  if (flow_mark_attr_ >= 0) {
+    bess::metadata::mt_offset_t offset = attr_offset(flow_mark_attr_);
+    for (uint32_t i = 0; i < cnt; i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+      uint32_t mark = pkt->has_flow_mark() ? pkt->flow_mark() : 0;
+      set_attr_with_offset<uint32_t>(offset, pkt, mark);
+    }
+  }
+
   RunNextModule(ctx, batch);
 
   return {.block = false,
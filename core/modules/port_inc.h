@@ -43,7 +43,8 @@ class PortInc final : public Module {
 
   static const Commands cmds;
 
-  PortInc() : Module(), port_(), prefetch_(), burst_() {
+  PortInc()
+      : Module(), port_(), prefetch_(), burst_(), flow_mark_attr_(-1) {
     is_task_ = true;
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
@@ -65,6 +66,8 @@ class PortInc final : public Module {
   Port *port_;
   int prefetch_;
   int burst_;
+  // "flow_mark" attribute id, or -1 if the NIC mark is not exported.
+  int flow_mark_attr_;
 };
 
 #endif  // BESS_MODULES_PORTINC_H_
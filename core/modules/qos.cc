@@ -9,6 +9,7 @@
 #include "utils/format.h"
 
 #include <rte_cycles.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -119,22 +120,20 @@ void Qos::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     if (attr_id < 0) {
       offset = field.offset;
     } else {
-      offset = bess::Packet::mt_offset_to_databuf_offset(attr_offset(attr_id));
+      offset = attr_offset(attr_id);
     }
 
     for (int j = 0; j < cnt; j++) {
       pkt = batch->pkts()[j];
-      char *buf_addr = pkt->buffer<char *>();
 
       /* for offset-based attrs we use relative offset */
-      if (attr_id < 0) {
-        buf_addr += pkt->data_off();
-      }
+      const char *buf_addr = (attr_id < 0) ? pkt->head_data<const char *>()
+                                           : pkt->metadata<const char *>();
 
       char *key = reinterpret_cast<char *>(keys[j].u64_arr) + pos;
 
       *(reinterpret_cast<uint64_t *>(key)) =
-          *(reinterpret_cast<uint64_t *>(buf_addr + offset));
+          *(reinterpret_cast<const uint64_t *>(buf_addr + offset));
 
       size_t len = reinterpret_cast<size_t>(total_key_size_ / sizeof(uint64_t));
 
@@ -146,7 +145,7 @@ void Qos::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int icnt = 0;
   for (int lcnt = 0; lcnt < cnt; lcnt = lcnt + icnt) {
-    icnt = ((cnt - lcnt) >= 64) ? 64 : cnt - lcnt;
+    icnt = std::min(cnt - lcnt, bess::utils::kMaxBulkLookup);
     value *val[icnt];
     uint64_t hit_mask = table_.Find(keys + lcnt, val, icnt);
 
@@ -105,6 +105,10 @@ CommandResponse Queue::Init(const bess::pb::QueueArg &arg) {
 
   burst_ = bess::PacketBatch::kMaxBurst;
 
+  if (arg.stealable()) {
+    tasks()[tid]->GetTC()->set_stealable(true);
+  }
+
   if (arg.backpressure()) {
     VLOG(1) << "Backpressure enabled for " << name() << "::Queue";
     backpressure_ = true;
@@ -139,6 +143,7 @@ CommandResponse Queue::GetRuntimeConfig(const bess::pb::EmptyArg &) {
   ret.set_size(size_);
   ret.set_prefetch(prefetch_);
   ret.set_backpressure(backpressure_);
+  ret.set_stealable(tasks()[0]->GetTC()->stealable());
   return CommandSuccess(ret);
 }
 
@@ -60,6 +60,15 @@ CommandResponse QueueInc::Init(const bess::pb::QueueIncArg &arg) {
   if (arg.prefetch()) {
     prefetch_ = 1;
   }
+
+  if (arg.flow_mark()) {
+    flow_mark_attr_ =
+        AddMetadataAttr("flow_mark", sizeof(uint32_t),
+                        bess::metadata::Attribute::AccessMode::kWrite);
+    if (flow_mark_attr_ < 0) {
+      return CommandFailure(-flow_mark_attr_, "add_metadata_attr() failed");
+    }
+  }
   node_constraints_ = port_->GetNodePlacementConstraint();
   tid = RegisterTask((void *)(uintptr_t)qid_);
   if (tid == INVALID_TASK_ID)
@@ -127,6 +136,15 @@ struct task_result QueueInc::RunTask(Context *ctx, bess::PacketBatch *batch,
     p->queue_stats[PACKET_DIR_INC][qid].bytes += received_bytes;
   }
 
+  if (flow_mark_attr_ >= 0) {
+    bess::metadata::mt_offset_t offset = attr_offset(flow_mark_attr_);
+    for (uint32_t i = 0; i < cnt; i++) {
+      bess::Packet *pkt = batch->pkts()[i];
+      uint32_t mark = pkt->has_flow_mark() ? pkt->flow_mark() : 0;
+      set_attr_with_offset<uint32_t>(offset, pkt, mark);
+    }
+  }
+
   RunNextModule(ctx, batch);
 
   return {.block = false,
@@ -43,7 +43,13 @@ class QueueInc final : public Module {
 
   static const Commands cmds;
 
-  QueueInc() : Module(), port_(), qid_(), prefetch_(), burst_() {}
+  QueueInc()
+      : Module(),
+        port_(),
+        qid_(),
+        prefetch_(),
+        burst_(),
+        flow_mark_attr_(-1) {}
 
   CommandResponse Init(const bess::pb::QueueIncArg &arg);
   void DeInit() override;
@@ -61,6 +67,8 @@ class QueueInc final : public Module {
   queue_t qid_;
   int prefetch_;
   int burst_;
+  // "flow_mark" attribute id, or -1 if the NIC mark is not exported.
+  int flow_mark_attr_;
 };
 
 #endif  // BESS_MODULES_QUEUEINC_H_
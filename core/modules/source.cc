@@ -32,6 +32,9 @@
 
 #include "source.h"
 
+#include "../utils/time.h"
+#include "timestamp.h"
+
 const Commands Source::cmds = {
     {"set_pkt_size", "SourceCommandSetPktSizeArg",
      MODULE_CMD_FUNC(&Source::CommandSetPktSize), Command::THREAD_SAFE},
@@ -57,6 +60,73 @@ CommandResponse Source::Init(const bess::pb::SourceArg &arg) {
 
   burst_ = bess::PacketBatch::kMaxBurst;
 
+  if (arg.template_().length() > 0) {
+    return InitTemplate(arg);
+  }
+
+  return CommandSuccess();
+}
+
+CommandResponse Source::InitTemplate(const bess::pb::SourceArg &arg) {
+  using bess::utils::Error;
+
+  Error err = tmpl_.SetTemplate(arg.template_().data(),
+                                arg.template_().length());
+  if (err.first != 0) {
+    return CommandFailure(err.first, "'template': %s", err.second.c_str());
+  }
+
+  std::vector<size_t> sizes;
+  std::vector<uint32_t> weights;
+  if (arg.imix_size() > 0) {
+    for (const auto &entry : arg.imix()) {
+      sizes.push_back(entry.size());
+      weights.push_back(entry.weight());
+    }
+  } else if (arg.pkt_size() > 0) {
+    sizes.push_back(arg.pkt_size());
+    weights.push_back(1);
+  }
+
+  if (!sizes.empty()) {
+    err = tmpl_.SetImix(sizes, weights);
+    if (err.first != 0) {
+      return CommandFailure(err.first, "'imix': %s", err.second.c_str());
+    }
+  }
+
+  if (tmpl_.max_size() > SNBUF_DATA) {
+    return CommandFailure(EINVAL, "Packets must be no larger than %d bytes",
+                          SNBUF_DATA);
+  }
+
+  for (const auto &field : arg.fields()) {
+    err = tmpl_.AddField(
+        {field.offset(), field.size(), static_cast<uint32_t>(field.step()),
+         field.count()});
+    if (err.first != 0) {
+      return CommandFailure(err.first, "'fields': %s", err.second.c_str());
+    }
+  }
+
+  if (arg.seq_offset() > 0) {
+    err = tmpl_.SetSequence(arg.seq_offset());
+    if (err.first != 0) {
+      return CommandFailure(err.first, "'seq_offset': %s",
+                            err.second.c_str());
+    }
+  }
+
+  if (arg.timestamp_offset() > 0) {
+    err = tmpl_.SetTimestamp(arg.timestamp_offset(), Timestamp::kMarker);
+    if (err.first != 0) {
+      return CommandFailure(err.first, "'timestamp_offset': %s",
+                            err.second.c_str());
+    }
+  }
+
+  pkt_size_ = tmpl_.max_size();
+
   return CommandSuccess();
 }
 
@@ -73,6 +143,11 @@ CommandResponse Source::CommandSetBurst(
 
 CommandResponse Source::CommandSetPktSize(
     const bess::pb::SourceCommandSetPktSizeArg &arg) {
+  if (!tmpl_.empty()) {
+    return CommandFailure(EINVAL,
+                          "Packet sizes of a template are set with 'imix'");
+  }
+
   uint64_t val = arg.pkt_size();
   if (val == 0 || val > SNBUF_DATA) {
     return CommandFailure(EINVAL, "Invalid packet size");
@@ -91,6 +166,10 @@ struct task_result Source::RunTask(Context *ctx, bess::PacketBatch *batch,
   const int pkt_size = ACCESS_ONCE(pkt_size_);
   const uint32_t burst = ACCESS_ONCE(burst_);
 
+  if (!tmpl_.empty()) {
+    return RunTemplate(ctx, batch, burst);
+  }
+
   if (current_worker.packet_pool()->AllocBulk(batch->pkts(), burst, pkt_size)) {
     batch->set_cnt(burst);
     RunNextModule(ctx, batch);  // it's fine to call this function with cnt==0
@@ -102,5 +181,37 @@ struct task_result Source::RunTask(Context *ctx, bess::PacketBatch *batch,
   return {.block = true, .packets = 0, .bits = 0};
 }
 
+struct task_result Source::RunTemplate(Context *ctx, bess::PacketBatch *batch,
+                                       uint32_t burst) {
+  const int pkt_overhead = 24;
+
+  if (!current_worker.packet_pool()->AllocBulk(batch->pkts(), burst)) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  void *bufs[bess::PacketBatch::kMaxBurst];
+  uint16_t sizes[bess::PacketBatch::kMaxBurst];
+
+  for (uint32_t i = 0; i < burst; i++) {
+    bufs[i] = batch->pkts()[i]->head_data();
+  }
+
+  // We don't use ctx->current_ns here for better accuracy (as in Timestamp)
+  uint64_t bytes = tmpl_.Fill(bufs, sizes, burst, tsc_to_ns(rdtsc()));
+
+  for (uint32_t i = 0; i < burst; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    pkt->set_data_len(sizes[i]);
+    pkt->set_total_len(sizes[i]);
+  }
+
+  batch->set_cnt(burst);
+  RunNextModule(ctx, batch);
+
+  return {.block = false,
+          .packets = burst,
+          .bits = (bytes + pkt_overhead * burst) * 8};
+}
+
 ADD_MODULE(Source, "source",
-           "infinitely generates packets with uninitialized data")
+           "infinitely generates packets, uninitialized or from a template")
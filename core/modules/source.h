@@ -30,11 +30,12 @@
 // ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 // POSSIBILITY OF SUCH DAMAGE.
 
-#ifndef BESS_MODULES_FLOWGEN_H_
-#define BESS_MODULES_FLOWGEN_H_
+#ifndef BESS_MODULES_SOURCE_H_
+#define BESS_MODULES_SOURCE_H_
 
 #include "../module.h"
 #include "../pb/module_msg.pb.h"
+#include "../utils/packet_template.h"
 
 class Source final : public Module {
  public:
@@ -42,7 +43,7 @@ class Source final : public Module {
 
   static const Commands cmds;
 
-  Source() : Module(), pkt_size_(), burst_() { is_task_ = true; }
+  Source() : Module(), pkt_size_(), burst_(), tmpl_() { is_task_ = true; }
 
   CommandResponse Init(const bess::pb::SourceArg &arg);
 
@@ -55,8 +56,16 @@ class Source final : public Module {
       const bess::pb::SourceCommandSetPktSizeArg &arg);
 
  private:
+  CommandResponse InitTemplate(const bess::pb::SourceArg &arg);
+
+  struct task_result RunTemplate(Context *ctx, bess::PacketBatch *batch,
+                                 uint32_t burst);
+
   int pkt_size_;
   int burst_;
+
+  // If not empty, packets are generated out of this template
+  bess::utils::PacketTemplate tmpl_;
 };
 
-#endif  // BESS_MODULES_FLOWGEN_H_
+#endif  // BESS_MODULES_SOURCE_H_
@@ -33,6 +33,7 @@
 
 #include "../utils/checksum.h"
 #include "../utils/ether.h"
+#include "../utils/icmp.h"
 #include "../utils/ip.h"
 #include "../utils/tcp.h"
 #include "../utils/udp.h"
@@ -45,47 +46,133 @@ const Commands StaticNAT::cmds = {
     {"set_runtime_config", "EmptyArg",
      MODULE_CMD_FUNC(&StaticNAT::SetRuntimeConfig), Command::THREAD_SAFE}};
 
-CommandResponse StaticNAT::Init(const bess::pb::StaticNATArg &arg) {
+// IPv6 addresses are handled as 128-bit integers in host order, so that
+// ranges can be compared and translated with plain arithmetic.
+static inline unsigned __int128 LoadIpv6(const uint8_t *addr) {
+  bess::utils::be64_t hi, lo;
+  memcpy(&hi, addr, sizeof(hi));
+  memcpy(&lo, addr + sizeof(hi), sizeof(lo));
+  return (static_cast<unsigned __int128>(hi.value()) << 64) | lo.value();
+}
+
+static inline void StoreIpv6(unsigned __int128 val, uint8_t *addr) {
+  bess::utils::be64_t hi(val >> 64), lo(static_cast<uint64_t>(val));
+  memcpy(addr, &hi, sizeof(hi));
+  memcpy(addr + sizeof(hi), &lo, sizeof(lo));
+}
+
+CommandResponse StaticNAT::AddPair(
+    const bess::pb::StaticNATArg::AddressRangePair &pb_pair) {
   using bess::utils::ParseIpv4Address;
 
-  for (const auto &pb_pair : arg.pairs()) {
-    be32_t int_start, int_end;
-    if (!ParseIpv4Address(pb_pair.int_range().start(), &int_start)) {
-      return CommandFailure(EINVAL, "invalid IP address %s",
-                            pb_pair.int_range().start().c_str());
-    }
-    if (!ParseIpv4Address(pb_pair.int_range().end(), &int_end)) {
-      return CommandFailure(EINVAL, "invalid IP address %s",
-                            pb_pair.int_range().end().c_str());
-    }
-    if (int_start > int_end) {
-      return CommandFailure(EINVAL, "invalid internal IP address range");
-    }
+  be32_t int_start, int_end;
+  if (!ParseIpv4Address(pb_pair.int_range().start(), &int_start)) {
+    return CommandFailure(EINVAL, "invalid IP address %s",
+                          pb_pair.int_range().start().c_str());
+  }
+  if (!ParseIpv4Address(pb_pair.int_range().end(), &int_end)) {
+    return CommandFailure(EINVAL, "invalid IP address %s",
+                          pb_pair.int_range().end().c_str());
+  }
+  if (int_start > int_end) {
+    return CommandFailure(EINVAL, "invalid internal IP address range");
+  }
 
-    be32_t ext_start, ext_end;
-    if (!ParseIpv4Address(pb_pair.ext_range().start(), &ext_start)) {
-      return CommandFailure(EINVAL, "invalid IP address %s",
-                            pb_pair.ext_range().start().c_str());
-    }
-    if (!ParseIpv4Address(pb_pair.ext_range().end(), &ext_end)) {
-      return CommandFailure(EINVAL, "invalid IP address %s",
-                            pb_pair.ext_range().end().c_str());
-    }
-    if (ext_start > ext_end) {
-      return CommandFailure(EINVAL, "invalid external IP address range");
-    }
+  be32_t ext_start, ext_end;
+  if (!ParseIpv4Address(pb_pair.ext_range().start(), &ext_start)) {
+    return CommandFailure(EINVAL, "invalid IP address %s",
+                          pb_pair.ext_range().start().c_str());
+  }
+  if (!ParseIpv4Address(pb_pair.ext_range().end(), &ext_end)) {
+    return CommandFailure(EINVAL, "invalid IP address %s",
+                          pb_pair.ext_range().end().c_str());
+  }
+  if (ext_start > ext_end) {
+    return CommandFailure(EINVAL, "invalid external IP address range");
+  }
 
-    if (int_end.value() == 0xffffffff || ext_end.value() == 0xffffffff) {
-      return CommandFailure(EINVAL, "cannot map broadcast address");
-    }
+  if (int_end.value() == 0xffffffff || ext_end.value() == 0xffffffff) {
+    return CommandFailure(EINVAL, "cannot map broadcast address");
+  }
+
+  if (int_end - int_start != ext_end - ext_start) {
+    return CommandFailure(EINVAL, "internal/external address ranges differ");
+  }
+
+  uint32_t diff = ext_start.value() - int_start.value();
+  if (!ranges_[kForward].Insert(int_start.value(), int_end.value(), diff)) {
+    return CommandFailure(EINVAL, "overlapping internal address range %s-%s",
+                          pb_pair.int_range().start().c_str(),
+                          pb_pair.int_range().end().c_str());
+  }
+  if (!ranges_[kReverse].Insert(ext_start.value(), ext_end.value(), -diff)) {
+    return CommandFailure(EINVAL, "overlapping external address range %s-%s",
+                          pb_pair.ext_range().start().c_str(),
+                          pb_pair.ext_range().end().c_str());
+  }
+
+  pairs_.push_back({.int_addr = int_start.value(),
+                    .ext_addr = ext_start.value(),
+                    .size = int_end.value() - int_start.value() + 1});
 
-    if (int_end - int_start != ext_end - ext_start) {
-      return CommandFailure(EINVAL, "internal/external address ranges differ");
+  return CommandSuccess();
+}
+
+CommandResponse StaticNAT::AddPair6(
+    const bess::pb::StaticNATArg::AddressRangePair &pb_pair) {
+  using bess::utils::ParseIpv6Address;
+
+  const std::string *addrs[] = {
+      &pb_pair.int_range().start(), &pb_pair.int_range().end(),
+      &pb_pair.ext_range().start(), &pb_pair.ext_range().end()};
+  Ipv6Addr vals[4];
+
+  for (int i = 0; i < 4; i++) {
+    uint8_t addr[16];
+    if (!ParseIpv6Address(*addrs[i], addr)) {
+      return CommandFailure(EINVAL, "invalid IPv6 address %s",
+                            addrs[i]->c_str());
     }
+    vals[i] = LoadIpv6(addr);
+  }
 
-    pairs_.push_back({.int_addr = int_start.value(),
-                      .ext_addr = ext_start.value(),
-                      .size = int_end.value() - int_start.value() + 1});
+  Ipv6Addr int_start = vals[0], int_end = vals[1];
+  Ipv6Addr ext_start = vals[2], ext_end = vals[3];
+  if (int_start > int_end) {
+    return CommandFailure(EINVAL, "invalid internal IP address range");
+  }
+  if (ext_start > ext_end) {
+    return CommandFailure(EINVAL, "invalid external IP address range");
+  }
+  if (int_end - int_start != ext_end - ext_start) {
+    return CommandFailure(EINVAL, "internal/external address ranges differ");
+  }
+
+  Ipv6Addr diff = ext_start - int_start;
+  if (!ranges6_[kForward].Insert(int_start, int_end, diff)) {
+    return CommandFailure(EINVAL, "overlapping internal address range %s-%s",
+                          addrs[0]->c_str(), addrs[1]->c_str());
+  }
+  if (!ranges6_[kReverse].Insert(ext_start, ext_end, -diff)) {
+    return CommandFailure(EINVAL, "overlapping external address range %s-%s",
+                          addrs[2]->c_str(), addrs[3]->c_str());
+  }
+
+  pairs6_.push_back({.int_addr = int_start,
+                     .ext_addr = ext_start,
+                     .last = int_end - int_start});
+
+  return CommandSuccess();
+}
+
+CommandResponse StaticNAT::Init(const bess::pb::StaticNATArg &arg) {
+  for (const auto &pb_pair : arg.pairs()) {
+    // IPv6 ranges are told apart by their notation
+    bool ipv6 = pb_pair.int_range().start().find(':') != std::string::npos;
+    CommandResponse err = ipv6 ? AddPair6(pb_pair) : AddPair(pb_pair);
+    if (err.error().code() != 0) {
+      return err;
+    }
   }
 
   return CommandSuccess();
@@ -93,6 +180,7 @@ CommandResponse StaticNAT::Init(const bess::pb::StaticNATArg &arg) {
 
 CommandResponse StaticNAT::GetInitialArg(const bess::pb::EmptyArg &) {
   using bess::utils::ToIpv4Address;
+  using bess::utils::ToIpv6Address;
 
   bess::pb::StaticNATArg resp;
   for (const auto &pair : pairs_) {
@@ -100,11 +188,28 @@ CommandResponse StaticNAT::GetInitialArg(const bess::pb::EmptyArg &) {
 
     auto *int_range = pb_pair->mutable_int_range();
     int_range->set_start(ToIpv4Address(be32_t(pair.int_addr)));
-    int_range->set_end(ToIpv4Address(be32_t(pair.int_addr + pair.size)));
+    int_range->set_end(ToIpv4Address(be32_t(pair.int_addr + pair.size - 1)));
 
     auto *ext_range = pb_pair->mutable_ext_range();
     ext_range->set_start(ToIpv4Address(be32_t(pair.ext_addr)));
-    ext_range->set_end(ToIpv4Address(be32_t(pair.ext_addr + pair.size)));
+    ext_range->set_end(ToIpv4Address(be32_t(pair.ext_addr + pair.size - 1)));
+  }
+
+  for (const auto &pair : pairs6_) {
+    auto *pb_pair = resp.add_pairs();
+    uint8_t addr[16];
+
+    auto *int_range = pb_pair->mutable_int_range();
+    StoreIpv6(pair.int_addr, addr);
+    int_range->set_start(ToIpv6Address(addr));
+    StoreIpv6(pair.int_addr + pair.last, addr);
+    int_range->set_end(ToIpv6Address(addr));
+
+    auto *ext_range = pb_pair->mutable_ext_range();
+    StoreIpv6(pair.ext_addr, addr);
+    ext_range->set_start(ToIpv6Address(addr));
+    StoreIpv6(pair.ext_addr + pair.last, addr);
+    ext_range->set_end(ToIpv6Address(addr));
   }
 
   return CommandSuccess(resp);
@@ -145,30 +250,85 @@ static inline void UpdateChecksum(bess::utils::Ipv4 *ip, uint32_t incr) {
   }
 }
 
+// Updates the L4 checksum of an IPv6 packet, which covers the addresses
+// through the pseudo header. Extension headers are not skipped.
+static inline void UpdateChecksum6(bess::utils::Ipv6 *ip, uint32_t incr) {
+  using IpProto = bess::utils::Ipv4::Proto;
+
+  void *l4 = ip + 1;
+  IpProto proto = static_cast<IpProto>(ip->next_header);
+
+  if (proto == IpProto::kTcp) {
+    auto *tcp = static_cast<bess::utils::Tcp *>(l4);
+    tcp->checksum =
+        bess::utils::UpdateChecksumWithIncrement(tcp->checksum, incr);
+  } else if (proto == IpProto::kUdp) {
+    // A zero checksum is allowed for tunnels (rfc6935) and must stay so.
+    // Otherwise, 0 must not be written (rfc8200).
+    auto *udp = static_cast<bess::utils::Udp *>(l4);
+    if (udp->checksum != 0) {
+      udp->checksum =
+          bess::utils::UpdateChecksumWithIncrement(udp->checksum, incr)
+              ?: 0xffff;
+    }
+  } else if (proto == IpProto::kIcmpv6) {
+    auto *icmp = static_cast<bess::utils::Icmp *>(l4);
+    icmp->checksum =
+        bess::utils::UpdateChecksumWithIncrement(icmp->checksum, incr);
+  }
+}
+
+template <StaticNAT::Direction dir>
+inline void StaticNAT::TranslateIpv6(bess::utils::Ipv6 *ip) {
+  uint8_t *addr = (dir == kForward) ? ip->src : ip->dst;
+  Ipv6Addr old_addr = LoadIpv6(addr);
+
+  const Ipv6Addr *diff = ranges6_[dir].Find(old_addr);
+  if (!diff) {
+    return;
+  }
+
+  uint8_t new_addr[16];
+  StoreIpv6(old_addr + *diff, new_addr);
+
+  uint32_t incr = 0;
+  for (size_t i = 0; i < sizeof(new_addr); i += sizeof(uint32_t)) {
+    uint32_t old_word, new_word;
+    memcpy(&old_word, addr + i, sizeof(old_word));
+    memcpy(&new_word, new_addr + i, sizeof(new_word));
+    incr += bess::utils::ChecksumIncrement32(old_word, new_word);
+  }
+
+  UpdateChecksum6(ip, incr);
+  memcpy(addr, new_addr, sizeof(new_addr));
+}
+
 template <StaticNAT::Direction dir>
 inline void StaticNAT::DoProcessBatch(Context *ctx, bess::PacketBatch *batch) {
+  using bess::utils::Ethernet;
+
   gate_idx_t ogate_idx = dir == kForward ? 1 : 0;
   int cnt = batch->cnt();
 
   for (int i = 0; i < cnt; i++) {
     bess::Packet *pkt = batch->pkts()[i];
-    auto *eth = pkt->head_data<bess::utils::Ethernet *>();
+    auto *eth = pkt->head_data<Ethernet *>();
+
+    if (eth->ether_type == be16_t(Ethernet::kIpv6)) {
+      TranslateIpv6<dir>(reinterpret_cast<bess::utils::Ipv6 *>(eth + 1));
+      EmitPacket(ctx, pkt, ogate_idx);
+      continue;
+    }
+
     auto *ip = reinterpret_cast<bess::utils::Ipv4 *>(eth + 1);
 
     be32_t &addr_be = (dir == kForward) ? ip->src : ip->dst;
-    uint32_t addr = addr_be.value();
-
-    for (const auto &pair : pairs_) {
-      uint32_t start_addr = (dir == kForward) ? pair.int_addr : pair.ext_addr;
-      if (start_addr <= addr && addr < start_addr + pair.size) {
-        uint32_t diff = (dir == kForward) ? (pair.ext_addr - pair.int_addr)
-                                          : (pair.int_addr - pair.ext_addr);
-        be32_t new_addr_be = be32_t(addr + diff);
-        UpdateChecksum(ip, bess::utils::ChecksumIncrement32(
-                               addr_be.raw_value(), new_addr_be.raw_value()));
-        addr_be = new_addr_be;
-        break;
-      }
+    const uint32_t *diff = ranges_[dir].Find(addr_be.value());
+    if (diff) {
+      be32_t new_addr_be = be32_t(addr_be.value() + *diff);
+      UpdateChecksum(ip, bess::utils::ChecksumIncrement32(
+                             addr_be.raw_value(), new_addr_be.raw_value()));
+      addr_be = new_addr_be;
     }
 
     // If there is no matching address pair, forward without NAT.
@@ -39,6 +39,8 @@
 #include <vector>
 
 #include "../utils/endian.h"
+#include "../utils/interval_map.h"
+#include "../utils/ip.h"
 
 using bess::utils::be16_t;
 using bess::utils::be32_t;
@@ -63,16 +65,36 @@ class StaticNAT : public Module {
   void ProcessBatch(Context *ctx, bess::PacketBatch *batch) override;
 
  private:
+  typedef unsigned __int128 Ipv6Addr;  // in host order
+
   struct NatPair {
     uint32_t int_addr;  // start address of internal address
     uint32_t ext_addr;  // start address of external address
     uint32_t size;      // [start_addr, start_addr + size) will be used
   };
 
+  struct NatPair6 {
+    Ipv6Addr int_addr;  // start address of internal address
+    Ipv6Addr ext_addr;  // start address of external address
+    Ipv6Addr last;      // [start_addr, start_addr + last] will be used
+  };
+
+  CommandResponse AddPair(const bess::pb::StaticNATArg::AddressRangePair &pb);
+  CommandResponse AddPair6(const bess::pb::StaticNATArg::AddressRangePair &pb);
+
   template <Direction dir>
   void DoProcessBatch(Context *ctx, bess::PacketBatch *batch);
 
+  template <Direction dir>
+  void TranslateIpv6(bess::utils::Ipv6 *ip);
+
   std::vector<NatPair> pairs_;
+  std::vector<NatPair6> pairs6_;
+
+  // Address ranges of either side, mapped to the difference to add to an
+  // address to translate it. Indexed by direction.
+  bess::utils::IntervalMap<uint32_t, uint32_t> ranges_[2];
+  bess::utils::IntervalMap<Ipv6Addr, Ipv6Addr> ranges6_[2];
 };
 
 #endif  // BESS_MODULES_STATIC_NAT_H_
@@ -74,6 +74,7 @@ CommandResponse Timestamp::Init(const bess::pb::TimestampArg &arg) {
     using AccessMode = bess::metadata::Attribute::AccessMode;
     attr_id_ = AddMetadataAttr(attr_name, sizeof(uint64_t), AccessMode::kWrite);
   }
+  hw_timestamp_ = arg.hw_timestamp();
   return CommandSuccess();
 }
 
@@ -84,10 +85,15 @@ void Timestamp::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
 
   int cnt = batch->cnt();
   for (int i = 0; i < cnt; i++) {
+    bess::Packet *pkt = batch->pkts()[i];
+    uint64_t time = now_ns;
+    if (hw_timestamp_ && pkt->has_rx_timestamp())
+      time = pkt->rx_timestamp();
+
     if (attr_id_ != -1)
-      set_attr<uint64_t>(this, attr_id_, batch->pkts()[i], now_ns);
+      set_attr<uint64_t>(this, attr_id_, pkt, time);
     else
-      timestamp_packet(batch->pkts()[i], offset, now_ns);
+      timestamp_packet(pkt, offset, time);
   }
 
   RunNextModule(ctx, batch);
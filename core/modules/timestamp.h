@@ -41,7 +41,7 @@ class Timestamp final : public Module {
   using MarkerType = uint32_t;
   static const MarkerType kMarker = 0x54C5BE55;
 
-  Timestamp() : Module(), offset_(), attr_id_(-1) {
+  Timestamp() : Module(), offset_(), attr_id_(-1), hw_timestamp_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
   }
 
@@ -52,6 +52,7 @@ class Timestamp final : public Module {
  private:
   size_t offset_;
   int attr_id_;
+  bool hw_timestamp_;
 };
 
 #endif  // BESS_MODULES_TIMESTAMP_H_
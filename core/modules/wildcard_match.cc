@@ -32,6 +32,7 @@
 
 #include "wildcard_match.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -170,6 +171,19 @@ CommandResponse WildcardMatch::Init(const bess::pb::WildcardMatchArg &arg) {
 
   total_value_size_ = align_ceil(size_acc, sizeof(uint64_t));
 
+  if (arg.flow_marks()) {
+    if (arg.flow_marks() > kMaxFlowMarks) {
+      return CommandFailure(EINVAL, "'flow_marks' must be at most %u",
+                            kMaxFlowMarks);
+    }
+    flow_mark_attr_ = AddMetadataAttr("flow_mark", sizeof(uint32_t),
+                                      Attribute::AccessMode::kRead);
+    if (flow_mark_attr_ < 0) {
+      return CommandFailure(-flow_mark_attr_, "add_metadata_attr() failed");
+    }
+    marks_.resize(arg.flow_marks(), nullptr);
+  }
+
   return CommandSuccess();
 }
 
@@ -193,66 +207,73 @@ inline gate_idx_t WildcardMatch::LookupEntry(const wm_hkey_t &key,
 
   /* if lookup was successful, then set values (if possible) */
   if (result.ogate != default_gate_) {
-    size_t num_values_ = values_.size();
-    for (size_t i = 0; i < num_values_; i++) {
-      int value_size = values_[i].size;
-      int value_pos = values_[i].pos;
-      int value_off = values_[i].offset;
-      int value_attr_id = values_[i].attr_id;
-      uint8_t *data = pkt->head_data<uint8_t *>() + value_off;
-
-      DLOG(INFO) << "off: " << value_off << ", sz: " << value_size;
-
-      if (value_attr_id < 0) { /* if it is offset-based */
-        memcpy(data, reinterpret_cast<uint8_t *>(&result.keyv) + value_pos,
-               value_size);
-      } else { /* if it is attribute-based */
-        typedef struct {
-          uint8_t bytes[bess::metadata::kMetadataAttrMaxSize];
-        } value_t;
-        uint8_t *buf = (uint8_t *)&result.keyv + value_pos;
-
-        DLOG(INFO) << "Setting value " << std::hex
-                   << *(reinterpret_cast<uint64_t *>(buf))
-                   << " for attr_id: " << value_attr_id
-                   << " of size: " << value_size
-                   << " at value_pos: " << value_pos;
-
-        switch (value_size) {
-          case 1:
-            set_attr<uint8_t>(this, value_attr_id, pkt, *((uint8_t *)buf));
-            break;
-          case 2:
-            set_attr<uint16_t>(this, value_attr_id, pkt,
-                               *((uint16_t *)((uint8_t *)buf)));
-            break;
-          case 4:
-            set_attr<uint32_t>(this, value_attr_id, pkt,
-                               *((uint32_t *)((uint8_t *)buf)));
-            break;
-          case 8:
-            set_attr<uint64_t>(this, value_attr_id, pkt,
-                               *((uint64_t *)((uint8_t *)buf)));
-            break;
-          default: {
-            void *mt_ptr =
-                _ptr_attr_with_offset<value_t>(attr_offset(value_attr_id), pkt);
-            bess::utils::CopySmall(mt_ptr, buf, value_size);
-          } break;
-        }
+    SetValues(pkt, result.keyv);
+  }
+  return result.ogate;
+}
+
+inline void WildcardMatch::SetValues(bess::Packet *pkt,
+                                     const wm_hkey_t &keyv) {
+  size_t num_values_ = values_.size();
+  for (size_t i = 0; i < num_values_; i++) {
+    int value_size = values_[i].size;
+    int value_pos = values_[i].pos;
+    int value_off = values_[i].offset;
+    int value_attr_id = values_[i].attr_id;
+    const uint8_t *buf = reinterpret_cast<const uint8_t *>(&keyv) + value_pos;
+
+    DLOG(INFO) << "off: " << value_off << ", sz: " << value_size;
+    if (value_attr_id < 0) { /* if it is offset-based */
+      memcpy(pkt->head_data<uint8_t *>() + value_off, buf, value_size);
+    } else { /* if it is attribute-based */
+      typedef struct {
+        uint8_t bytes[bess::metadata::kMetadataAttrMaxSize];
+      } value_t;
+
+      DLOG(INFO) << "Setting value " << std::hex
+                 << *(reinterpret_cast<const uint64_t *>(buf))
+                 << " for attr_id: " << value_attr_id
+                 << " of size: " << value_size
+                 << " at value_pos: " << value_pos;
+
+      switch (value_size) {
+        case 1:
+          set_attr<uint8_t>(this, value_attr_id, pkt, *((const uint8_t *)buf));
+          break;
+        case 2:
+          set_attr<uint16_t>(this, value_attr_id, pkt,
+                             *((const uint16_t *)buf));
+          break;
+        case 4:
+          set_attr<uint32_t>(this, value_attr_id, pkt,
+                             *((const uint32_t *)buf));
+          break;
+        case 8:
+          set_attr<uint64_t>(this, value_attr_id, pkt,
+                             *((const uint64_t *)buf));
+          break;
+        default: {
+          void *mt_ptr =
+              _ptr_attr_with_offset<value_t>(attr_offset(value_attr_id), pkt);
+          bess::utils::CopySmall(mt_ptr, buf, value_size);
+        } break;
       }
     }
   }
-  return result.ogate;
 }
 
 inline bool WildcardMatch::LookupBulkEntry(wm_hkey_t *key, gate_idx_t def_gate,
-                                           int packeti, gate_idx_t *Outgate,
-                                           int cnt, bess::PacketBatch *batch) {
-  bess::Packet *pkt = nullptr;
+                                           gate_idx_t *Outgate, int cnt,
+                                           bess::PacketBatch *batch) {
+  using bess::utils::kMaxBulkLookup;
+
+  // One hit mask word per kMaxBulkLookup packets, since that is as many keys
+  // as a single hash table lookup can take.
+  static const int kHitmaskWords =
+      (bess::PacketBatch::kMaxBurst + kMaxBulkLookup - 1) / kMaxBulkLookup;
+
   struct WmData *result[cnt];
-  uint64_t prev_hitmask = 0;
-  uint64_t hitmask = 0;
+  uint64_t prev_hitmask[kHitmaskWords] = {};
   wm_hkey_t key_masked[cnt];
   WmData *entry[cnt];
   wm_hkey_t **key_ptr[cnt];
@@ -263,79 +284,33 @@ inline bool WildcardMatch::LookupBulkEntry(wm_hkey_t *key, gate_idx_t def_gate,
     const auto &ht = tuple->ht;
     mask_bulk(key, key_masked, (void **)key_ptr, tuple->mask, cnt,
               total_key_size_);
-    int num = ht->lookup_bulk_data((const void **)key_ptr, cnt, &hitmask,
-                                   (void **)entry);
-    if (num == 0)
-      continue;
 
-    for (int init = 0; (init < cnt) && (num); init++) {
-      if ((hitmask & ((uint64_t)1 << init))) {
-        if ((prev_hitmask & ((uint64_t)1 << init)) == 0)
-          result[init] = entry[init];
-        else if ((prev_hitmask & ((uint64_t)1 << init)) &&
-                 (entry[init]->priority >= result[init]->priority)) {
+    for (int lcnt = 0; lcnt < cnt; lcnt += kMaxBulkLookup) {
+      int icnt = std::min(cnt - lcnt, kMaxBulkLookup);
+      uint64_t hitmask = 0;
+      int num = ht->lookup_bulk_data((const void **)(key_ptr + lcnt), icnt,
+                                     &hitmask, (void **)(entry + lcnt));
+      if (num <= 0)
+        continue;
+
+      uint64_t &prev = prev_hitmask[lcnt / kMaxBulkLookup];
+      for (uint64_t m = hitmask; m; m &= m - 1) {
+        int j = __builtin_ctzll(m);
+        int init = lcnt + j;
+        if ((prev & ((uint64_t)1 << j)) == 0 ||
+            entry[init]->priority >= result[init]->priority) {
           result[init] = entry[init];
         }
-
-        num--;
       }
+      prev |= hitmask;
     }
-    prev_hitmask = prev_hitmask | hitmask;
   }
 
   for (int init = 0; init < cnt; init++) {
     /* if lookup was successful, then set values (if possible) */
-    if (prev_hitmask && (prev_hitmask & ((uint64_t)1 << init))) {
-      pkt = batch->pkts()[packeti + init];
-      size_t num_values_ = values_.size();
-      for (size_t i = 0; i < num_values_; i++) {
-        int value_size = values_[i].size;
-        int value_pos = values_[i].pos;
-        int value_off = values_[i].offset;
-        int value_attr_id = values_[i].attr_id;
-        uint8_t *data = pkt->head_data<uint8_t *>() + value_off;
-
-        DLOG(INFO) << "off: " << value_off << ", sz: " << value_size;
-        if (value_attr_id < 0) { /* if it is offset-based */
-          memcpy(data,
-                 reinterpret_cast<uint8_t *>(&result[init]->keyv) + value_pos,
-                 value_size);
-        } else { /* if it is attribute-based */
-          typedef struct {
-            uint8_t bytes[bess::metadata::kMetadataAttrMaxSize];
-          } value_t;
-          uint8_t *buf = (uint8_t *)&result[init]->keyv + value_pos;
-
-          DLOG(INFO) << "Setting value " << std::hex
-                     << *(reinterpret_cast<uint64_t *>(buf))
-                     << " for attr_id: " << value_attr_id
-                     << " of size: " << value_size
-                     << " at value_pos: " << value_pos;
-
-          switch (value_size) {
-            case 1:
-              set_attr<uint8_t>(this, value_attr_id, pkt, *((uint8_t *)buf));
-              break;
-            case 2:
-              set_attr<uint16_t>(this, value_attr_id, pkt,
-                                 *((uint16_t *)((uint8_t *)buf)));
-              break;
-            case 4:
-              set_attr<uint32_t>(this, value_attr_id, pkt,
-                                 *((uint32_t *)((uint8_t *)buf)));
-              break;
-            case 8:
-              set_attr<uint64_t>(this, value_attr_id, pkt,
-                                 *((uint64_t *)((uint8_t *)buf)));
-              break;
-            default: {
-              void *mt_ptr = _ptr_attr_with_offset<value_t>(
-                  attr_offset(value_attr_id), pkt);
-              bess::utils::CopySmall(mt_ptr, buf, value_size);
-            } break;
-          }
-        }
-      }
+    if (prev_hitmask[init / kMaxBulkLookup] &
+        ((uint64_t)1 << (init % kMaxBulkLookup))) {
+      SetValues(batch->pkts()[init], result[init]->keyv);
       Outgate[init] = result[init]->ogate;
     } else
       Outgate[init] = def_gate;
@@ -346,6 +321,29 @@ inline bool WildcardMatch::LookupBulkEntry(wm_hkey_t *key, gate_idx_t def_gate,
 void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
   gate_idx_t default_gate;
   wm_hkey_t keys[bess::PacketBatch::kMaxBurst] __ymm_aligned;
+  bess::PacketBatch unmarked;
+
+  // Packets carrying a known mark skip key extraction and the tuple lookups.
+  if (flow_mark_attr_ >= 0) {
+    bess::metadata::mt_offset_t offset = attr_offset(flow_mark_attr_);
+    if (bess::metadata::IsValidOffset(offset)) {
+      unmarked.clear();
+      for (int i = 0; i < batch->cnt(); i++) {
+        bess::Packet *pkt = batch->pkts()[i];
+        uint32_t mark = _get_attr_with_offset<uint32_t>(offset, pkt);
+        const WmData *data =
+            (mark < marks_.size()) ? ACCESS_ONCE(marks_[mark]) : nullptr;
+        if (data) {
+          SetValues(pkt, data->keyv);
+          EmitPacket(ctx, pkt, data->ogate);
+        } else {
+          unmarked.add(pkt);
+        }
+      }
+      batch = &unmarked;
+    }
+  }
+
   int cnt = batch->cnt();
   gate_idx_t Outgate[cnt];
 
@@ -362,38 +360,26 @@ void WildcardMatch::ProcessBatch(Context *ctx, bess::PacketBatch *batch) {
     if (attr_id < 0) {
       offset = field.offset;
     } else {
-      offset = bess::Packet::mt_offset_to_databuf_offset(attr_offset(attr_id));
+      offset = attr_offset(attr_id);
     }
 
     for (int j = 0; j < cnt; j++) {
-      char *buf_addr = batch->pkts()[j]->buffer<char *>();
+      bess::Packet *pkt = batch->pkts()[j];
 
       /* for offset-based attrs we use relative offset */
-      if (attr_id < 0) {
-        buf_addr += batch->pkts()[j]->data_off();
-      }
+      const char *buf_addr = (attr_id < 0) ? pkt->head_data<const char *>()
+                                           : pkt->metadata<const char *>();
 
       char *key = reinterpret_cast<char *>(keys[j].u64_arr) + pos;
 
       *(reinterpret_cast<uint64_t *>(key)) =
-          *(reinterpret_cast<uint64_t *>(buf_addr + offset));
+          *(reinterpret_cast<const uint64_t *>(buf_addr + offset));
     }
   }
 
-  if (cnt > 64) {
-    int icnt = 0;
-    for (int lcnt = 0; lcnt < cnt; lcnt = lcnt + icnt) {
-      icnt = ((cnt - lcnt) >= 64) ? 64 : cnt - lcnt;
-      LookupBulkEntry(&keys[lcnt], default_gate, lcnt, Outgate, icnt, batch);
-      for (int j = 0; j < icnt; j++) {
-        EmitPacket(ctx, batch->pkts()[j + lcnt], Outgate[j]);
-      }
-    }
-  } else {
-    LookupBulkEntry(keys, default_gate, 0, Outgate, cnt, batch);
-    for (int j = 0; j < cnt; j++) {
-      EmitPacket(ctx, batch->pkts()[j], Outgate[j]);
-    }
+  LookupBulkEntry(keys, default_gate, Outgate, cnt, batch);
+  for (int j = 0; j < cnt; j++) {
+    EmitPacket(ctx, batch->pkts()[j], Outgate[j]);
   }
 }
 
@@ -581,6 +567,21 @@ CommandResponse WildcardMatch::CommandAdd(
 
   data.priority = priority;
   data.ogate = gate;
+
+  uint32_t flow_mark = arg.mark();
+  std::string rule_id = RuleId(key, mask);
+  auto it = rule_marks_.find(rule_id);
+  if (flow_mark) {
+    if (flow_mark >= marks_.size()) {
+      return CommandFailure(EINVAL, "mark %u is not in [1,%zu)", flow_mark,
+                            marks_.size());
+    }
+    if (marks_[flow_mark] &&
+        (it == rule_marks_.end() || it->second != flow_mark)) {
+      return CommandFailure(EEXIST, "mark %u is already in use", flow_mark);
+    }
+  }
+
   int idx = FindTuple(&mask);
   if (idx < 0) {
     idx = AddTuple(&mask);
@@ -592,6 +593,15 @@ CommandResponse WildcardMatch::CommandAdd(
   int ret = tuples_[idx].ht->insert_dpdk(&key, data_t);
   if (ret < 0)
     return CommandFailure(EINVAL, "failed to add a rule");
+
+  if (it != rule_marks_.end()) {
+    UnsetMark(it->second);
+    rule_marks_.erase(it);
+  }
+  if (flow_mark) {
+    ACCESS_ONCE(marks_[flow_mark]) = new WmData(data);
+    rule_marks_.emplace(rule_id, flow_mark);
+  }
   return CommandSuccess();
 }
 
@@ -615,6 +625,12 @@ CommandResponse WildcardMatch::CommandDelete(
     return CommandFailure(-ret, "failed to delete a rule");
   }
 
+  auto it = rule_marks_.find(RuleId(key, mask));
+  if (it != rule_marks_.end()) {
+    UnsetMark(it->second);
+    rule_marks_.erase(it);
+  }
+
   return CommandSuccess();
 }
 
@@ -632,6 +648,45 @@ void WildcardMatch::Clear() {
       tuple.occupied = 0;
     }
   }
+  ClearMarks();
+}
+
+std::string WildcardMatch::RuleId(const wm_hkey_t &key,
+                                  const wm_hkey_t &mask) const {
+  std::string id(reinterpret_cast<const char *>(&key), total_key_size_);
+  id.append(reinterpret_cast<const char *>(&mask), total_key_size_);
+  return id;
+}
+
+void WildcardMatch::UnsetMark(uint32_t mark) {
+  WmData *data = marks_[mark];
+  if (data) {
+    ACCESS_ONCE(marks_[mark]) = nullptr;
+    FreeRetiredMarks(false);
+    retired_marks_.emplace_back(tsc_to_ns(rdtsc()), data);
+  }
+}
+
+// Frees the retired entries past their grace period, or all of them (only
+// when no worker can be running the module).
+void WildcardMatch::FreeRetiredMarks(bool all) {
+  uint64_t now_ns = tsc_to_ns(rdtsc());
+  auto keep = retired_marks_.begin();
+  for (auto &r : retired_marks_) {
+    if (all || now_ns - r.first >= kMarkGraceNs) {
+      delete r.second;
+    } else {
+      *keep++ = r;
+    }
+  }
+  retired_marks_.erase(keep, retired_marks_.end());
+}
+
+void WildcardMatch::ClearMarks() {
+  for (const auto &kv : rule_marks_) {
+    UnsetMark(kv.second);
+  }
+  rule_marks_.clear();
 }
 
 // Retrieves a WildcardMatchArg that would reconstruct this module.
@@ -646,6 +701,7 @@ CommandResponse WildcardMatch::GetInitialArg(const bess::pb::EmptyArg &) {
     }
     f->set_num_bytes(field.size);
   }
+  resp.set_flow_marks(marks_.size());
   return CommandSuccess(resp);
 }
 
@@ -676,6 +732,10 @@ CommandResponse WildcardMatch::GetRuntimeConfig(const bess::pb::EmptyArg &) {
       rule_t *rule = resp.add_rules();
       rule->set_priority(entry.second.priority);
       rule->set_gate(entry.second.ogate);
+      auto it = rule_marks_.find(RuleId(entry.first, mask));
+      if (it != rule_marks_.end()) {
+        rule->set_mark(it->second);
+      }
 
       uint8_t *entry_data = reinterpret_cast<uint8_t *>(entry.first.u64_arr);
       uint8_t *entry_mask = reinterpret_cast<uint8_t *>(mask.u64_arr);
@@ -743,6 +803,12 @@ void WildcardMatch::DeInit() {
     tuple.ht->DeInit();
     tuple.ht = NULL;
   }
+  for (WmData *data : marks_) {
+    delete data;
+  }
+  FreeRetiredMarks(true);
+  marks_.clear();
+  rule_marks_.clear();
 }
 
 ADD_MODULE(WildcardMatch, "wm",
@@ -38,6 +38,10 @@
 #include <rte_config.h>
 #include <rte_hash_crc.h>
 
+#include <map>
+#include <string>
+#include <vector>
+
 #include "../pb/module_msg.pb.h"
 #include "../utils/cuckoo_map.h"
 
@@ -142,6 +146,9 @@ class WildcardMatch final : public Module {
  public:
   static const gate_idx_t kNumOGates = MAX_GATES;
 
+  // Largest flow mark table (the "flow_marks" argument)
+  static const uint32_t kMaxFlowMarks = 1 << 20;
+
   static const Commands cmds;
 
   WildcardMatch()
@@ -151,7 +158,11 @@ class WildcardMatch final : public Module {
         total_value_size_(),
         fields_(),
         values_(),
-        tuples_() {
+        tuples_(),
+        flow_mark_attr_(-1),
+        marks_(),
+        rule_marks_(),
+        retired_marks_() {
     max_allowed_workers_ = Worker::kMaxWorkers;
     { tuples_.resize(MAX_TUPLES); }
   }
@@ -193,7 +204,12 @@ class WildcardMatch final : public Module {
   gate_idx_t LookupEntry(const wm_hkey_t &key, gate_idx_t def_gate,
                          bess::Packet *pkt);
 
-  bool LookupBulkEntry(wm_hkey_t *key, gate_idx_t def_gate, int i,
+  // Writes the rule values 'keyv' into the packet data or metadata.
+  void SetValues(bess::Packet *pkt, const wm_hkey_t &keyv);
+
+  // Looks up all 'cnt' (up to PacketBatch::kMaxBurst) keys, setting the values
+  // of matching packets and their output gates in 'Outgate'.
+  bool LookupBulkEntry(wm_hkey_t *key, gate_idx_t def_gate,
                        gate_idx_t *Outgate, int cnt, bess::PacketBatch *batch);
 
   CommandResponse AddFieldOne(const bess::pb::Field &field, struct WmField *f,
@@ -208,6 +224,10 @@ class WildcardMatch final : public Module {
   int AddTuple(wm_hkey_t *mask);
   bool DelEntry(int idx, wm_hkey_t *key);
   void Clear();
+  std::string RuleId(const wm_hkey_t &key, const wm_hkey_t &mask) const;
+  void UnsetMark(uint32_t mark);
+  void ClearMarks();
+  void FreeRetiredMarks(bool all);
   gate_idx_t default_gate_;
 
   size_t total_key_size_;   /* a multiple of sizeof(uint64_t) */
@@ -219,6 +239,19 @@ class WildcardMatch final : public Module {
   std::vector<struct WmField> values_;
   std::vector<struct WmTuple> tuples_;  //[MAX_TUPLES];
   std::vector<struct WmData> data_;
+
+  // Fast path for packets pre-classified by a NIC rte_flow MARK (or anything
+  // else that writes the "flow_mark" attribute). marks_[m] is a copy of the
+  // rule added with mark m, or nullptr. Mark 0 is never used.
+  int flow_mark_attr_;
+  std::vector<WmData *> marks_;
+  std::map<std::string, uint32_t> rule_marks_;  // RuleId() -> mark
+  // Entries unlinked from marks_ that workers may still be reading, with the
+  // time (in ns) they were unlinked. Commands free them once they are older
+  // than kMarkGraceNs, long after any worker has finished the batch that
+  // read them.
+  static const uint64_t kMarkGraceNs = 1000000000ull;
+  std::vector<std::pair<uint64_t, WmData *>> retired_marks_;
 };
 
 #endif  // BESS_MODULES_WILDCARDMATCH_H_
@@ -32,6 +32,7 @@
 #include "opts.h"
 
 #include <glog/logging.h>
+#include <rte_config.h>
 
 #include <cstdint>
 #include <regex>
@@ -153,3 +154,28 @@ DEFINE_int32(buffers, 262144,
              " must be a power of 2.");
 static const bool _buffers_dummy [[maybe_unused]] =
     google::RegisterFlagValidator(&FLAGS_buffers, &ValidateBuffersPerSocket);
+
+static bool ValidateBuffersPerWorker(const char *, int32_t value) {
+  return value == 0 || ValidateBuffersPerSocket(nullptr, value);
+}
+DEFINE_int32(worker_buffers, 0,
+             "Specifies how many packet buffers to allocate in a dedicated "
+             "pool for each worker, must be a power of 2. If set to 0, "
+             "workers share the per-socket pools");
+static const bool _worker_buffers_dummy [[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_worker_buffers,
+                                  &ValidateBuffersPerWorker);
+
+static bool ValidateMempoolCacheSize(const char *, int32_t value) {
+  if (value < 0 || value > RTE_MEMPOOL_CACHE_MAX_SIZE) {
+    LOG(ERROR) << "Mempool cache size must be [0, "
+               << RTE_MEMPOOL_CACHE_MAX_SIZE << "]: " << value;
+    return false;
+  }
+  return true;
+}
+DEFINE_int32(mempool_cache_size, 512,
+             "Specifies the per-core cache size of packet pools");
+static const bool _mempool_cache_size_dummy [[maybe_unused]] =
+    google::RegisterFlagValidator(&FLAGS_mempool_cache_size,
+                                  &ValidateMempoolCacheSize);
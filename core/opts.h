@@ -51,6 +51,8 @@ DECLARE_string(modules);
 DECLARE_bool(core_dump);
 DECLARE_bool(no_crashlog);
 DECLARE_int32(buffers);
+DECLARE_int32(worker_buffers);
+DECLARE_int32(mempool_cache_size);
 DECLARE_bool(dpdk);
 DECLARE_string(iova);
 DECLARE_string(allow);
@@ -44,16 +44,37 @@
 
 #include "dpdk.h"
 #include "opts.h"
+#include "packet_pool.h"
 #include "utils/common.h"
+#include "worker.h"
 
 namespace bess {
 
 static struct rte_mempool *pframe_pool[RTE_MAX_NUMA_NODES];
 
+int Packet::rx_timestamp_offset_ = -1;
+uint64_t Packet::rx_timestamp_flag_ = 0;
+
+int Packet::RegisterRxTimestamp() {
+  if (rx_timestamp_flag_) {
+    return 0;
+  }
+
+  int offset;
+  uint64_t flag;
+  if (rte_mbuf_dyn_rx_timestamp_register(&offset, &flag) < 0) {
+    return -rte_errno;
+  }
+
+  rx_timestamp_offset_ = offset;
+  rx_timestamp_flag_ = flag;
+  return 0;
+}
+
 Packet *Packet::copy(const Packet *src) {
   DCHECK(src->is_linear());
 
-  Packet *dst = reinterpret_cast<Packet *>(rte_pktmbuf_alloc(src->pool_));
+  Packet *dst = current_worker.packet_pool()->Alloc();
   if (!dst) {
     return nullptr;  // FAIL.
   }
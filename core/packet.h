@@ -41,6 +41,7 @@
 #include <rte_atomic.h>
 #include <rte_config.h>
 #include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
 
 #include "metadata.h"
 #include "snbuf_layout.h"
@@ -142,6 +143,34 @@ class alignas(64) Packet {
   // single segment and direct?
   int is_simple() const { return is_linear() && RTE_MBUF_DIRECT(&mbuf_); }
 
+  // Did the NIC tag this packet with an rte_flow MARK action?
+  bool has_flow_mark() const { return mbuf_.ol_flags & RTE_MBUF_F_RX_FDIR_ID; }
+
+  // The MARK id set by the NIC. Only meaningful if has_flow_mark().
+  uint32_t flow_mark() const { return mbuf_.hash.fdir.hi; }
+
+  // Did the port attach a hardware RX timestamp? (see PMDPortArg.hw_timestamp)
+  bool has_rx_timestamp() const { return mbuf_.ol_flags & rx_timestamp_flag_; }
+
+  // The hardware RX timestamp, converted by the port to the clock of
+  // tsc_to_ns(). Only meaningful if has_rx_timestamp().
+  uint64_t rx_timestamp() const {
+    return *RTE_MBUF_DYNFIELD(&mbuf_, rx_timestamp_offset_,
+                              const rte_mbuf_timestamp_t *);
+  }
+
+  void set_rx_timestamp(uint64_t ns) {
+    *RTE_MBUF_DYNFIELD(&mbuf_, rx_timestamp_offset_, rte_mbuf_timestamp_t *) =
+        ns;
+    mbuf_.ol_flags |= rx_timestamp_flag_;
+  }
+
+  void clear_rx_timestamp() { mbuf_.ol_flags &= ~rx_timestamp_flag_; }
+
+  // Registers the dynamic mbuf field and flag for RX timestamps, shared by
+  // all ports. Returns 0 or -errno.
+  static int RegisterRxTimestamp();
+
   void reset() { rte_pktmbuf_reset(&mbuf_); }
 
   void *prepend(uint16_t len) {
@@ -178,7 +207,8 @@ class alignas(64) Packet {
     DCHECK_EQ(ret, 0);
   }
 
-  // Duplicate a new Packet object, allocated from the same PacketPool as src.
+  // Duplicate a new Packet object, allocated from the packet pool of the
+  // calling worker (see Worker::packet_pool()).
   // Returns nullptr if memory allocation failed
   static Packet *copy(const Packet *src);
 
@@ -314,6 +344,10 @@ class alignas(64) Packet {
   char headroom_[SNBUF_HEADROOM];
   char data_[SNBUF_DATA];
 
+  // See RegisterRxTimestamp(). The flag is 0 until then.
+  static int rx_timestamp_offset_;
+  static uint64_t rx_timestamp_flag_;
+
   friend class PacketPool;
 };
 
@@ -5,6 +5,9 @@
 #include "packet_pool.h"
 
 #include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
 
 #include <rte_errno.h>
 #include <rte_mempool.h>
@@ -38,6 +41,23 @@ void DoMunmap(rte_mempool_memhdr *memhdr, void *) {
 }  // namespace
 
 PacketPool *PacketPool::default_pools_[RTE_MAX_NUMA_NODES];
+PacketPool *PacketPool::worker_pools_[RTE_MAX_LCORE];
+
+PacketPool *PacketPool::Create(size_t capacity, int sid) {
+  if (FLAGS_m == 0) {
+    LOG(WARNING) << "Hugepage is disabled! Creating PlainPacketPool for "
+                 << capacity << " packets on node " << sid;
+    return new PlainPacketPool(capacity, sid);
+  } else if (FLAGS_dpdk) {
+    LOG(INFO) << "Creating DpdkPacketPool for " << capacity
+              << " packets on node " << sid;
+    return new DpdkPacketPool(capacity, sid);
+  } else {
+    LOG(INFO) << "Creating BessPacketPool for " << capacity
+              << " packets on node " << sid;
+    return new BessPacketPool(capacity, sid);
+  }
+}
 
 void PacketPool::CreateDefaultPools(size_t capacity) {
   InitDpdk(FLAGS_dpdk ? FLAGS_m : 0);
@@ -45,25 +65,32 @@ void PacketPool::CreateDefaultPools(size_t capacity) {
   rte_dump_physmem_layout(stdout);
 
   for (int sid : NumaNodeIds()) {
-    if (FLAGS_m == 0) {
-      LOG(WARNING) << "Hugepage is disabled! Creating PlainPacketPool for "
-                   << capacity << " packets on node " << sid;
-      default_pools_[sid] = new PlainPacketPool(capacity, sid);
-    } else if (FLAGS_dpdk) {
-      LOG(INFO) << "Creating DpdkPacketPool for " << capacity
-                << " packets on node " << sid;
-      default_pools_[sid] = new DpdkPacketPool(capacity, sid);
-    } else {
-      LOG(INFO) << "Creating BessPacketPool for " << capacity
-                << " packets on node " << sid;
-      default_pools_[sid] = new BessPacketPool(capacity, sid);
-    }
+    default_pools_[sid] = Create(capacity, sid);
     CHECK(default_pools_[sid])
         << "Packet pool allocation on node " << sid << " failed!";
   }
 }
 
-PacketPool::PacketPool(size_t capacity, int socket_id) {
+PacketPool *PacketPool::GetOrCreateWorkerPool(int wid, int node,
+                                              size_t capacity) {
+  CHECK(wid >= 0 && wid < RTE_MAX_LCORE);
+
+  PacketPool *pool = worker_pools_[wid];
+  if (pool) {
+    LOG_IF(WARNING, pool->socket_id() != node)
+        << "Worker " << wid << " reuses its packet pool on node "
+        << pool->socket_id() << " from node " << node;
+    return pool;
+  }
+
+  LOG(INFO) << "Creating a dedicated packet pool for worker " << wid;
+  pool = Create(capacity, node);
+  worker_pools_[wid] = pool;
+  return pool;
+}
+
+PacketPool::PacketPool(size_t capacity, int socket_id)
+    : socket_id_(socket_id), high_watermark_(), alloc_failures_() {
   if (!IsDpdkInitialized()) {
     InitDpdk(0);
   }
@@ -73,8 +100,11 @@ PacketPool::PacketPool(size_t capacity, int socket_id) {
 
   LOG(INFO) << name_ << " requests for " << capacity << " packets";
 
+  // DPDK requires the cache to be no larger than capacity / 1.5
+  size_t cache_size = std::min(static_cast<size_t>(FLAGS_mempool_cache_size),
+                               capacity * 2 / 3);
   pool_ = rte_mempool_create_empty(name_.c_str(), capacity, sizeof(Packet),
-                                   capacity > 1024 ? kMaxCacheSize : 0,
+                                   capacity > 1024 ? cache_size : 0,
                                    sizeof(PoolPrivate), socket_id, 0);
   if (!pool_) {
     LOG(FATAL) << "rte_mempool_create() failed: " << rte_strerror(rte_errno)
@@ -94,6 +124,7 @@ PacketPool::~PacketPool() {
 
 bool PacketPool::AllocBulk(Packet **pkts, size_t count, size_t len) {
   if (rte_mempool_get_bulk(pool_, reinterpret_cast<void **>(pkts), count) < 0) {
+    alloc_failures_.fetch_add(1, std::memory_order_relaxed);
     return false;
   }
 
@@ -232,6 +263,97 @@ BessPacketPool::BessPacketPool(size_t capacity, int socket_id)
   PostPopulate();
 }
 
+ShmPacketPool::ShmPacketPool(size_t capacity, int socket_id)
+    : PacketPool(capacity, socket_id),
+      pinned_(),
+      fd_(-1),
+      base_(),
+      size_() {
+  pool_->flags |= MEMPOOL_F_NO_IOVA_CONTIG;
+
+  // The Packet objects (mbuf header, metadata and all) stay private, in plain
+  // anonymous memory as in PlainPacketPool.
+  size_t page_shift = __builtin_ffs(getpagesize());
+  size_t min_chunk_size, align;
+  size_t obj_bytes = rte_mempool_op_calc_mem_size_default(
+      pool_, pool_->size, page_shift, &min_chunk_size, &align);
+
+  void *objs = mmap(nullptr, obj_bytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (objs == MAP_FAILED) {
+    PLOG(FATAL) << "mmap()";
+  }
+
+  // Only the data buffers go in the memfd. Try hugepages first. The size must
+  // be a multiple of the hugepage size.
+  size_t size = pool_->size * kBufSize;
+  const size_t huge_size = 2 * 1024 * 1024;
+  size_t huge_bytes = (size + huge_size - 1) & ~(huge_size - 1);
+  void *addr = MAP_FAILED;
+
+  fd_ = memfd_create(name_.c_str(), MFD_CLOEXEC | MFD_HUGETLB);
+  if (fd_ >= 0 && ftruncate(fd_, huge_bytes) == 0) {
+    addr = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, fd_, 0);
+  }
+
+  if (addr != MAP_FAILED) {
+    size = huge_bytes;
+  } else {
+    LOG(INFO) << name_ << ": no hugepages for a memfd, using plain pages";
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+    fd_ = memfd_create(name_.c_str(), MFD_CLOEXEC);
+    if (fd_ < 0) {
+      PLOG(FATAL) << "memfd_create()";
+    }
+    if (ftruncate(fd_, size) < 0) {
+      PLOG(FATAL) << "ftruncate()";
+    }
+    addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED) {
+      PLOG(FATAL) << "mmap()";
+    }
+  }
+
+  base_ = static_cast<char *>(addr);
+  size_ = size;
+
+  // No error check, as we do not provide a guarantee that memory is pinned.
+  pinned_ = mlock(objs, obj_bytes) == 0 && mlock(addr, size) == 0;
+
+  int ret = rte_mempool_populate_iova(pool_, static_cast<char *>(objs),
+                                  RTE_BAD_IOVA, obj_bytes, DoMunmap, nullptr);
+  if (ret < static_cast<ssize_t>(pool_->size)) {
+    LOG(WARNING) << "rte_mempool_populate_iova() returned " << ret
+                 << " (rte_errno=" << rte_errno << ", "
+                 << rte_strerror(rte_errno) << ")";
+  }
+
+  PostPopulate();
+  rte_mempool_obj_iter(pool_, AttachBuf, this);
+}
+
+ShmPacketPool::~ShmPacketPool() {
+  // The Packet objects go away with the mempool (DoMunmap())
+  if (base_) {
+    munmap(base_, size_);
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+void ShmPacketPool::AttachBuf(rte_mempool *, void *arg, void *mbuf,
+                              unsigned index) {
+  auto *pp = static_cast<ShmPacketPool *>(arg);
+  auto *m = static_cast<struct rte_mbuf *>(mbuf);
+
+  m->buf_addr = pp->buf(index);
+  m->buf_iova = RTE_BAD_IOVA;
+}
+
 DpdkPacketPool::DpdkPacketPool(size_t capacity, int socket_id)
     : PacketPool(capacity, socket_id) {
   int ret = rte_mempool_populate_default(pool_);
@@ -260,27 +382,38 @@ static Packet *paddr_to_snb_memchunk(struct rte_mempool_memhdr *chunk,
   return nullptr;
 }
 
-Packet *PacketPool::from_paddr(phys_addr_t paddr) {
-  for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
-    struct rte_mempool *pool;
-    struct rte_mempool_memhdr *chunk;
+static Packet *paddr_to_snb_pool(PacketPool *pp, phys_addr_t paddr) {
+  struct rte_mempool_memhdr *chunk;
 
-    if (!default_pools_[i]) {
+  STAILQ_FOREACH(chunk, &pp->pool()->mem_list, next) {
+    Packet *pkt = paddr_to_snb_memchunk(chunk, paddr);
+    if (!pkt) {
       continue;
     }
-    pool = default_pools_[i]->pool();
-    STAILQ_FOREACH(chunk, &pool->mem_list, next) {
-      Packet *pkt = paddr_to_snb_memchunk(chunk, paddr);
-      if (!pkt) {
-        continue;
+    if (pkt->paddr() != paddr) {
+      LOG(ERROR) << "pkt->immutable.paddr corruption: pkt=" << pkt
+                 << ", pkt->immutable.paddr=" << pkt->paddr()
+                 << " (!= " << paddr << ")";
+      return nullptr;
+    }
+    return pkt;
+  }
+  return nullptr;
+}
+
+Packet *PacketPool::from_paddr(phys_addr_t paddr) {
+  for (int i = 0; i < RTE_MAX_NUMA_NODES; i++) {
+    if (default_pools_[i]) {
+      if (Packet *pkt = paddr_to_snb_pool(default_pools_[i], paddr)) {
+        return pkt;
       }
-      if (pkt->paddr() != paddr) {
-        LOG(ERROR) << "pkt->immutable.paddr corruption: pkt=" << pkt
-                   << ", pkt->immutable.paddr=" << pkt->paddr()
-                   << " (!= " << paddr << ")";
-        return nullptr;
+    }
+  }
+  for (int i = 0; i < RTE_MAX_LCORE; i++) {
+    if (worker_pools_[i]) {
+      if (Packet *pkt = paddr_to_snb_pool(worker_pools_[i], paddr)) {
+        return pkt;
       }
-      return pkt;
     }
   }
   return nullptr;
@@ -5,6 +5,10 @@
 #ifndef BESS_PACKET_POOL_H_
 #define BESS_PACKET_POOL_H_
 
+#include <atomic>
+
+#include <rte_ring.h>
+
 #include "memory.h"
 #include "packet.h"
 
@@ -25,6 +29,12 @@
 //     failed. The memory region will be contiguous in most cases,
 //     but not so if 2MB hugepages are used and scattered. MLX4/5 drivers
 //     will fail in this case.
+//
+// ShmPacketPool     memfd pages      O        X         X          O
+//   : Packet data buffers live in a memfd (hugepages if available, plain
+//     pages otherwise), apart from the Packet objects. Other processes can map
+//     the buffers through fd(), to exchange packets without copying (see
+//     ShmPort), but never see the mbuf headers or metadata.
 
 namespace bess {
 
@@ -37,6 +47,14 @@ class PacketPool {
 
   static void CreateDefaultPools(size_t capacity = kDefaultCapacity);
 
+  // Dedicated pool of worker 'wid', or nullptr if it has none.
+  static PacketPool *GetWorkerPool(int wid) { return worker_pools_[wid]; }
+
+  // Returns the dedicated pool of worker 'wid', creating it on 'node' if it
+  // does not exist yet. Pools outlive their workers, since packets allocated
+  // from them may still be in flight, and are reused if the worker comes back.
+  static PacketPool *GetOrCreateWorkerPool(int wid, int node, size_t capacity);
+
   // socket_id == -1 means "I don't care".
   PacketPool(size_t capacity = kDefaultCapacity, int socket_id = -1);
   virtual ~PacketPool();
@@ -53,6 +71,8 @@ class PacketPool {
       pkt->data_len_ = len;
 
       // TODO: sanity check
+    } else {
+      alloc_failures_.fetch_add(1, std::memory_order_relaxed);
     }
     return pkt;
   }
@@ -67,6 +87,37 @@ class PacketPool {
   // The number of available packets in the pool. Approximate by nature.
   size_t Size() const { return rte_mempool_avail_count(pool_); }
 
+  // Samples the number of packets taken out of the backing ring (in use, or
+  // sitting in per-core caches) for high_watermark(). Cheap enough to be
+  // called periodically from the datapath, by any number of workers.
+  void UpdateWatermark() {
+    size_t in_use = pool_->populated_size -
+                    rte_ring_count(static_cast<rte_ring *>(pool_->pool_data));
+    size_t cur = high_watermark_.load(std::memory_order_relaxed);
+    while (in_use > cur &&
+           !high_watermark_.compare_exchange_weak(cur, in_use,
+                                                  std::memory_order_relaxed)) {
+    }
+  }
+
+  // The highest occupancy seen by UpdateWatermark() since the last reset.
+  size_t high_watermark() const {
+    return high_watermark_.load(std::memory_order_relaxed);
+  }
+
+  // The number of failed Alloc()/AllocBulk() calls since the last reset.
+  uint64_t alloc_failures() const {
+    return alloc_failures_.load(std::memory_order_relaxed);
+  }
+
+  void ResetStats() {
+    high_watermark_ = 0;
+    alloc_failures_ = 0;
+  }
+
+  // Node (NUMA socket) this pool was requested on, or -1.
+  int socket_id() const { return socket_id_; }
+
   // Note: It would be ideal to not expose this
   rte_mempool *pool() { return pool_; }
 
@@ -78,7 +129,6 @@ class PacketPool {
 
  protected:
   static const size_t kDefaultCapacity = (1 << 16) - 1;  // 64k - 1
-  static const size_t kMaxCacheSize = 512;               // per-core cache size
 
   // Child classes are expected to call this function in their constructor
   void PostPopulate();
@@ -87,9 +137,20 @@ class PacketPool {
   rte_mempool *pool_;
 
  private:
+  // Creates a pool of the kind selected by the command line flags.
+  static PacketPool *Create(size_t capacity, int socket_id);
+
+  int socket_id_;
+
+  std::atomic<size_t> high_watermark_;
+  std::atomic<uint64_t> alloc_failures_;
+
   // Default per-node packet pools
   static PacketPool *default_pools_[RTE_MAX_NUMA_NODES];
 
+  // Dedicated per-worker packet pools (worker ID == lcore ID)
+  static PacketPool *worker_pools_[RTE_MAX_LCORE];
+
   friend class Packet;
 };
 
@@ -127,6 +188,38 @@ class DpdkPacketPool : public PacketPool {
   virtual bool IsPinned() override { return true; }
 };
 
+class ShmPacketPool : public PacketPool {
+ public:
+  // Bytes of each packet's buffer (headroom and data) in the region.
+  static const size_t kBufSize = SNBUF_HEADROOM + SNBUF_DATA;
+
+  ShmPacketPool(size_t capacity = kDefaultCapacity, int socket_id = -1);
+  virtual ~ShmPacketPool();
+
+  virtual bool IsVirtuallyContiguous() override { return true; }
+  virtual bool IsPhysicallyContiguous() override { return false; }
+  virtual bool IsPinned() override { return pinned_; }
+
+  // The memfd backing the packet buffers, and where (and how much of) it is
+  // mapped. The Packet objects themselves are not in it.
+  int fd() const { return fd_; }
+  char *base() const { return base_; }
+  size_t size() const { return size_; }
+
+  // The buffer of the `index`-th Packet object.
+  char *buf(size_t index) const { return base_ + index * kBufSize; }
+
+ private:
+  // Points the mbuf at its buffer in the memfd.
+  static void AttachBuf(rte_mempool *mp, void *arg, void *mbuf,
+                        unsigned index);
+
+  bool pinned_;
+  int fd_;
+  char *base_;
+  size_t size_;
+};
+
 }  // namespace bess
 
 #endif  // BESS_PACKET_POOL_H_
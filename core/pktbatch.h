@@ -35,6 +35,14 @@
 
 #include "utils/copy.h"
 
+// Maximum number of packets in a batch. Larger batches amortize per-batch
+// costs (scheduling, gate dispatch, hooks) at high packet rates, at the price
+// of latency and cache footprint. Override at build time with, e.g.,
+// MAX_BURST=256 (see core/Makefile).
+#ifndef BESS_MAX_BURST
+#define BESS_MAX_BURST 64
+#endif
+
 namespace bess {
 
 class Packet;
@@ -73,7 +81,10 @@ class PacketBatch {
     }
   }
 
-  inline static const size_t kMaxBurst = 64;
+  inline static const size_t kMaxBurst = BESS_MAX_BURST;
+  static_assert(kMaxBurst > 0 && kMaxBurst <= 256 &&
+                    (kMaxBurst & (kMaxBurst - 1)) == 0,
+                "kMaxBurst must be a power of 2, up to 256");
 
  private:
   int cnt_;
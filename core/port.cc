@@ -44,9 +44,12 @@
 #include <string>
 
 #include "message.h"
+#include "worker.h"
 
 std::map<std::string, Port *> PortBuilder::all_ports_;
 
+const PortCommands Port::cmds;
+
 Port *PortBuilder::CreatePort(const std::string &name) const {
   Port *p = port_generator_();
   p->set_name(name);
@@ -130,14 +133,35 @@ bool PortBuilder::RegisterPortClass(
     std::function<Port *()> port_generator, const std::string &class_name,
     const std::string &name_template, const std::string &help_text,
     std::function<CommandResponse(Port *, const google::protobuf::Any &)>
-        init_func) {
+        init_func,
+    const PortCommands &cmds) {
   all_port_builders_holder().emplace(
       std::piecewise_construct, std::forward_as_tuple(class_name),
       std::forward_as_tuple(port_generator, class_name, name_template,
-                            help_text, init_func));
+                            help_text, init_func, cmds));
   return true;
 }
 
+CommandResponse PortBuilder::RunCommand(
+    Port *p, const std::string &user_cmd,
+    const google::protobuf::Any &arg) const {
+  for (auto &cmd : cmds_) {
+    if (user_cmd == cmd.cmd) {
+      if (cmd.mt_safe != PortCommand::THREAD_SAFE && is_any_worker_running()) {
+        return CommandFailure(EBUSY,
+                              "There is a running worker and command "
+                              "'%s' is not MT safe",
+                              cmd.cmd.c_str());
+      }
+
+      return cmd.func(p, arg);
+    }
+  }
+
+  return CommandFailure(ENOTSUP, "'%s' does not support command '%s'",
+                        class_name_.c_str(), user_cmd.c_str());
+}
+
 const std::map<std::string, PortBuilder> &PortBuilder::all_port_builders() {
   return all_port_builders_holder();
 }
@@ -173,10 +197,16 @@ Port::PortStats Port::GetPortStats() {
   CollectStats(false);
 
   PortStats ret = port_stats_;
+  ret.inc_queues.resize(num_queues[PACKET_DIR_INC]);
+  ret.out_queues.resize(num_queues[PACKET_DIR_OUT]);
 
   for (queue_t qid = 0; qid < num_queues[PACKET_DIR_INC]; qid++) {
     const QueueStats &inc = queue_stats[PACKET_DIR_INC][qid];
 
+    ret.inc_queues[qid].packets += inc.packets;
+    ret.inc_queues[qid].dropped += inc.dropped;
+    ret.inc_queues[qid].bytes += inc.bytes;
+
     ret.inc.packets += inc.packets;
     ret.inc.dropped += inc.dropped;
     ret.inc.bytes += inc.bytes;
@@ -187,6 +217,10 @@ Port::PortStats Port::GetPortStats() {
 
   for (queue_t qid = 0; qid < num_queues[PACKET_DIR_OUT]; qid++) {
     const QueueStats &out = queue_stats[PACKET_DIR_OUT][qid];
+
+    ret.out_queues[qid].packets += out.packets;
+    ret.out_queues[qid].dropped += out.dropped;
+    ret.out_queues[qid].bytes += out.bytes;
     ret.out.packets += out.packets;
     ret.out.dropped += out.dropped;
     ret.out.bytes += out.bytes;
@@ -42,7 +42,10 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include "commands.h"
 #include "message.h"
 #include "module.h"
 #include "packet.h"
@@ -89,6 +92,17 @@ static inline port_init_func_t PORT_INIT_FUNC(
   };
 }
 
+template <typename T, typename P>
+static inline port_cmd_func_t PORT_CMD_FUNC(
+    CommandResponse (P::*fn)(const T &)) {
+  return [fn](Port *p, const google::protobuf::Any &arg) {
+    T arg_;
+    arg.UnpackTo(&arg_);
+    auto base_fn = std::mem_fn(fn);
+    return base_fn(static_cast<P *>(p), arg_);
+  };
+}
+
 // A class to generate new Port objects of specific types.  Each instance can
 // generate Port objects of a specific class and specification.  Represents a
 // "driver" of that port.
@@ -100,12 +114,14 @@ class PortBuilder {
 
   PortBuilder(std::function<Port *()> port_generator,
               const std::string &class_name, const std::string &name_template,
-              const std::string &help_text, port_init_func_t init_func)
+              const std::string &help_text, port_init_func_t init_func,
+              const PortCommands &cmds = {})
       : port_generator_(port_generator),
         class_name_(class_name),
         name_template_(name_template),
         help_text_(help_text),
         init_func_(init_func),
+        cmds_(cmds),
         initialized_(false) {}
 
   // Returns a new Port object of the type represented by this PortBuilder
@@ -137,7 +153,8 @@ class PortBuilder {
                                 const std::string &class_name,
                                 const std::string &name_template,
                                 const std::string &help_text,
-                                port_init_func_t init_func);
+                                port_init_func_t init_func,
+                                const PortCommands &cmds = {});
 
   static const std::map<std::string, PortBuilder> &all_port_builders();
 
@@ -148,10 +165,22 @@ class PortBuilder {
   const std::string &help_text() const { return help_text_; }
   bool initialized() const { return initialized_; }
 
+  // (command name, argument type) of each driver-specific command
+  std::vector<std::pair<std::string, std::string>> cmds() const {
+    std::vector<std::pair<std::string, std::string>> ret;
+    for (auto &cmd : cmds_) {
+      ret.push_back(std::make_pair(cmd.cmd, cmd.arg_type));
+    }
+    return ret;
+  }
+
   CommandResponse RunInit(Port *p, const google::protobuf::Any &arg) const {
     return init_func_(p, arg);
   }
 
+  CommandResponse RunCommand(Port *p, const std::string &user_cmd,
+                             const google::protobuf::Any &arg) const;
+
  private:
   // To avoid the static initialization ordering problem, this pseudo-getter
   // function contains the real static all_port_builders class variable and
@@ -174,6 +203,8 @@ class PortBuilder {
 
   port_init_func_t init_func_;  // Initialization function of this Port class
 
+  PortCommands cmds_;  // Driver-specific commands
+
   bool initialized_;  // Has this port class been initialized via
                       // InitPortClass()?
 };
@@ -212,11 +243,25 @@ class Port {
     bool admin_up;
   };
 
+  struct QueueCounters {
+    uint64_t packets;
+    uint64_t dropped;
+    uint64_t bytes;
+  };
+
   struct PortStats {
     QueueStats inc;
     QueueStats out;
+    // Per-queue breakdown of the above. Drivers that keep their own counters
+    // (DRIVER_FLAG_SELF_*_STATS) can fill these in CollectStats().
+    std::vector<QueueCounters> inc_queues;
+    std::vector<QueueCounters> out_queues;
   };
 
+  // Driver-specific commands, run with the PortCommand RPC. Drivers with
+  // commands shadow this with their own.
+  static const PortCommands cmds;
+
   // overide this section to create a new driver -----------------------------
   Port()
       : port_stats_(),
@@ -272,6 +317,19 @@ class Port {
     return CommandFailure(ENOTSUP);
   }
 
+  /*!
+   * Add ('add' == true) or remove RX queue 'qid' to/from the epoll instance of
+   * the calling thread, with 'data' as the event user data. Returns 0 on
+   * success, or a negative errno value (-ENOTSUP if the port cannot raise RX
+   * interrupts).
+   */
+  virtual int RxInterruptCtl(queue_t, bool, void *) { return -ENOTSUP; }
+
+  /*!
+   * Arm ('enable' == true) or disarm the RX interrupt of queue 'qid'.
+   */
+  virtual int EnableRxInterrupt(queue_t, bool) { return -ENOTSUP; }
+
   CommandResponse InitWithGenericArg(const google::protobuf::Any &arg);
 
   PortStats GetPortStats();
@@ -339,6 +397,6 @@ class Port {
 #define ADD_DRIVER(_DRIVER, _NAME_TEMPLATE, _HELP)                       \
   bool __driver__##_DRIVER = PortBuilder::RegisterPortClass(             \
       std::function<Port *()>([]() { return new _DRIVER(); }), #_DRIVER, \
-      _NAME_TEMPLATE, _HELP, PORT_INIT_FUNC(&_DRIVER::Init));
+      _NAME_TEMPLATE, _HELP, PORT_INIT_FUNC(&_DRIVER::Init), _DRIVER::cmds);
 
 #endif  // BESS_PORT_H_
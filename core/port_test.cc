@@ -164,6 +164,28 @@ TEST_F(PortTest, GetPortStats) {
   EXPECT_EQ(0, stats.out.bytes);
 }
 
+// Checks that per-queue software counters show up in the per-queue stats.
+TEST_F(PortTest, GetPortQueueStats) {
+  std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
+  ASSERT_NE(nullptr, p.get());
+  p->num_queues[PACKET_DIR_INC] = 2;
+  p->num_queues[PACKET_DIR_OUT] = 1;
+
+  p->queue_stats[PACKET_DIR_INC][0].packets = 10;
+  p->queue_stats[PACKET_DIR_INC][1].packets = 20;
+  p->queue_stats[PACKET_DIR_INC][1].bytes = 1000;
+  p->queue_stats[PACKET_DIR_OUT][0].dropped = 3;
+
+  Port::PortStats stats = p->GetPortStats();
+  EXPECT_EQ(30, stats.inc.packets);
+  ASSERT_EQ(2, stats.inc_queues.size());
+  EXPECT_EQ(10, stats.inc_queues[0].packets);
+  EXPECT_EQ(20, stats.inc_queues[1].packets);
+  EXPECT_EQ(1000, stats.inc_queues[1].bytes);
+  ASSERT_EQ(1, stats.out_queues.size());
+  EXPECT_EQ(3, stats.out_queues[0].dropped);
+}
+
 // Checks that we can acquire and release queues.
 TEST_F(PortTest, AcquireAndReleaseQueues) {
   std::unique_ptr<Port> p(dummy_port_builder->CreatePort("port1"));
@@ -33,6 +33,8 @@
 #ifndef BESS_SCHEDULER_H_
 #define BESS_SCHEDULER_H_
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <sstream>
 #include <string>
@@ -41,6 +43,7 @@
 #include "module.h"
 #include "traffic_class.h"
 #include "utils/extended_priority_queue.h"
+#include "utils/work_stealing_deque.h"
 #include "worker.h"
 
 namespace bess {
@@ -201,6 +204,17 @@ class Scheduler {
   // towards the root.
   void UnblockTowardsRoot(TrafficClass *c, uint64_t tsc);
 
+  // Called after each ScheduleOnce() that started at 'start' and processed
+  // 'packets' packets. Lets the worker account idle cycles and back off,
+  // see Worker::Idle().
+  void AccountIdle(uint64_t packets, uint64_t start) {
+    if (packets) {
+      current_worker.ResetIdle();
+    } else {
+      checkpoint_ = current_worker.Idle(checkpoint_ - start, checkpoint_);
+    }
+  }
+
   TrafficClass *root_;
 
   RoundRobinTrafficClass *default_rr_class_;
@@ -242,6 +256,7 @@ class DefaultScheduler : public Scheduler {
     for (uint64_t round = 0;; ++round) {
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
+        current_worker.packet_pool()->UpdateWatermark();
         if (current_worker.is_pause_requested()) {
           if (current_worker.BlockWorker()) {
             break;
@@ -249,13 +264,15 @@ class DefaultScheduler : public Scheduler {
         }
       }
 
-      ScheduleOnce(&ctx);
+      uint64_t start = this->checkpoint_;
+      AccountIdle(ScheduleOnce(&ctx), start);
     }
   }
 
-  // Runs the scheduler once.
-  void ScheduleOnce(Context *ctx) {
+  // Runs the scheduler once. Returns the number of packets processed.
+  uint64_t ScheduleOnce(Context *ctx) {
     resource_arr_t usage;
+    uint64_t packets = 0;
 
     // Schedule.
     LeafTrafficClass *leaf = Scheduler::Next(this->checkpoint_);
@@ -272,6 +289,7 @@ class DefaultScheduler : public Scheduler {
 
       // Run.
       auto ret = (*ctx->task)(ctx);
+      packets = ret.packets;
 
       now = rdtsc();
 
@@ -300,6 +318,7 @@ class DefaultScheduler : public Scheduler {
     }
 
     this->checkpoint_ = now;
+    return packets;
   }
 };
 
@@ -329,6 +348,7 @@ class ExperimentalScheduler : public Scheduler {
     for (uint64_t round = 0;; ++round) {
       // Periodic check, to mitigate expensive operations.
       if ((round & accounting_mask) == 0) {
+        current_worker.packet_pool()->UpdateWatermark();
         if (current_worker.is_pause_requested()) {
           if (current_worker.BlockWorker()) {
             break;
@@ -336,13 +356,15 @@ class ExperimentalScheduler : public Scheduler {
         }
       }
 
-      ScheduleOnce(&ctx);
+      uint64_t start = this->checkpoint_;
+      AccountIdle(ScheduleOnce(&ctx), start);
     }
   }
 
-  // Runs the scheduler once.
-  void ScheduleOnce(Context *ctx) {
+  // Runs the scheduler once. Returns the number of packets processed.
+  uint64_t ScheduleOnce(Context *ctx) {
     resource_arr_t usage;
+    uint64_t packets = 0;
 
     // Schedule.
     LeafTrafficClass *leaf = Scheduler::Next(this->checkpoint_);
@@ -358,6 +380,7 @@ class ExperimentalScheduler : public Scheduler {
 
       // Run.
       auto ret = (*ctx->task)(ctx);
+      packets = ret.packets;
       now = rdtsc();
 
       if (ret.packets == 0 && ret.block) {
@@ -393,7 +416,290 @@ class ExperimentalScheduler : public Scheduler {
     }
 
     this->checkpoint_ = now;
+    return packets;
+  }
+};
+
+// A scheduler that, besides its own TC tree, runs the stealable leaves (see
+// LeafTrafficClass::stealable()) shared among all work-stealing workers.
+// Each worker keeps the stealable leaves it currently holds in a lock-free
+// deque.  Every round it runs one leaf from its own tree and one stealable
+// leaf.  The stealable leaf is stolen from a peer if that peer holds more
+// leaves than this worker (or if this worker holds none); otherwise it is the
+// oldest leaf of this worker's own deque.  The leaf is then pushed back onto
+// the deque of the worker that ran it, so that each worker rotates through
+// all the leaves it holds and stealable tasks drift from overloaded workers
+// towards idle ones.
+//
+// A leaf is held by at most one worker at a time, so its task never runs
+// concurrently with itself, but successive runs may happen on different
+// workers.
+class WorkStealingScheduler : public Scheduler {
+ public:
+  static const size_t kDequeSize = 1024;
+
+  explicit WorkStealingScheduler(TrafficClass *root = nullptr)
+      : Scheduler(root), deque_(kDequeSize), next_victim_(), num_stolen_() {}
+
+  virtual ~WorkStealingScheduler() {}
+
+  // Runs the scheduler loop forever.
+  void ScheduleLoop() override {
+    uint64_t now;
+    // How many rounds to go before we do accounting.
+    const uint64_t accounting_mask = 0xff;
+    static_assert(((accounting_mask + 1) & accounting_mask) == 0,
+                  "Accounting mask must be (2^n)-1");
+
+    this->checkpoint_ = now = rdtsc();
+
+    Context ctx = {};
+    ctx.wid = current_worker.wid();
+
+    // The main scheduling, running, accounting loop.
+    for (uint64_t round = 0;; ++round) {
+      // Periodic check, to mitigate expensive operations.
+      if ((round & accounting_mask) == 0) {
+        current_worker.packet_pool()->UpdateWatermark();
+        if (current_worker.is_pause_requested()) {
+          if (current_worker.BlockWorker()) {
+            break;
+          }
+        }
+      }
+
+      uint64_t start = this->checkpoint_;
+      AccountIdle(ScheduleOnce(&ctx), start);
+    }
+  }
+
+  // Runs the scheduler once. Returns the number of packets processed.
+  uint64_t ScheduleOnce(Context *ctx) {
+    bool idle = true;
+    uint64_t packets = 0;
+
+    LeafTrafficClass *leaf = Scheduler::Next(this->checkpoint_);
+    if (leaf) {
+      packets += RunLeaf(ctx, leaf);
+      idle = false;
+    }
+
+    LeafTrafficClass *stolen = StealFromDeeper();
+    if (!stolen) {
+      // Take from the top of our own deque and push back onto the bottom, so
+      // that we rotate through all the leaves we hold.
+      stolen = deque_.Steal();
+    }
+    if (!stolen) {
+      stolen = Steal();
+    }
+
+    if (stolen) {
+      packets += RunLeaf(ctx, stolen);
+      // Cannot fail: we only take leaves from peers holding more than we do,
+      // so our deque never grows beyond what Distribute() put in the deepest
+      // one, and no one else pushes onto it.
+      deque_.Push(stolen);
+      idle = false;
+    }
+
+    if (idle) {
+      ++this->stats_.cnt_idle;
+
+      uint64_t now = rdtsc();
+      this->stats_.cycles_idle += (now - this->checkpoint_);
+      this->checkpoint_ = now;
+    }
+
+    return packets;
+  }
+
+  // The stealable leaves this worker currently holds. For testing.
+  bess::utils::WorkStealingDeque<LeafTrafficClass *> &deque() {
+    return deque_;
+  }
+
+  // Number of leaves this worker has taken from its peers.
+  uint64_t num_stolen() const {
+    return num_stolen_.load(std::memory_order_relaxed);
+  }
+
+  // ----------------------------------------------------------------------
+  // Functions below are invoked by the master thread, and must only be
+  // called while all workers are paused.
+  // ----------------------------------------------------------------------
+
+  // If 'c' is a stealable leaf and there is at least one work-stealing
+  // worker, takes ownership of 'c' and returns true.  'c' will be handed to a
+  // worker by the next call to Redistribute().
+  static bool AddStealable(TrafficClass *c) {
+    if (c->policy() != POLICY_LEAF ||
+        !static_cast<LeafTrafficClass *>(c)->stealable() ||
+        ActivePeers().empty()) {
+      return false;
+    }
+    stealable_leaves_.push_back(static_cast<LeafTrafficClass *>(c));
+    return true;
+  }
+
+  // Returns true if 'c' was removed from the stealable leaves.  The caller
+  // now owns 'c'.
+  static bool RemoveStealable(const TrafficClass *c) {
+    auto it = std::find(stealable_leaves_.begin(), stealable_leaves_.end(), c);
+    if (it == stealable_leaves_.end()) {
+      return false;
+    }
+    stealable_leaves_.erase(it);
+    Distribute(peers_vector(), stealable_leaves_);
+    return true;
+  }
+
+  // Hands out all stealable leaves to the currently active work-stealing
+  // workers in a round-robin fashion.  If no such worker is left, the leaves
+  // go back to the list of orphan TCs.
+  static void Redistribute() {
+    std::vector<WorkStealingScheduler *> peers = ActivePeers();
+    if (peers.empty() && !stealable_leaves_.empty()) {
+      for (LeafTrafficClass *c : stealable_leaves_) {
+        add_tc_to_orphan(c, Worker::kAnyWorker);
+      }
+      stealable_leaves_.clear();
+    }
+    Distribute(peers, stealable_leaves_);
+  }
+
+  // Sets the group of workers that steal from each other and spreads
+  // 'leaves' across their deques.
+  static void Distribute(const std::vector<WorkStealingScheduler *> &peers,
+                         const std::vector<LeafTrafficClass *> &leaves) {
+    CHECK_LE(peers.size(), static_cast<size_t>(Worker::kMaxWorkers));
+    for (auto *s : peers) {
+      s->deque_.Clear();
+    }
+    for (size_t i = 0; i < peers.size(); i++) {
+      peers_[i] = peers[i];
+    }
+    num_peers_ = peers.size();
+
+    if (peers.empty()) {
+      return;
+    }
+    for (size_t i = 0; i < leaves.size(); i++) {
+      CHECK(peers[i % peers.size()]->deque_.Push(leaves[i]));
+    }
+  }
+
+  static const std::vector<LeafTrafficClass *> &stealable_leaves() {
+    return stealable_leaves_;
+  }
+
+  // Work-stealing schedulers of the active workers.
+  static std::vector<WorkStealingScheduler *> ActivePeers() {
+    std::vector<WorkStealingScheduler *> ret;
+    for (int wid = 0; wid < Worker::kMaxWorkers; wid++) {
+      if (!is_worker_active(wid)) {
+        continue;
+      }
+      auto *s =
+          dynamic_cast<WorkStealingScheduler *>(workers[wid]->scheduler());
+      if (s) {
+        ret.push_back(s);
+      }
+    }
+    return ret;
+  }
+
+ private:
+  static std::vector<WorkStealingScheduler *> peers_vector() {
+    return std::vector<WorkStealingScheduler *>(peers_, peers_ + num_peers_);
+  }
+
+  // Tries to take a leaf from the other workers, starting from the one after
+  // the last victim so that thieves do not all gang up on the same worker.
+  LeafTrafficClass *Steal() {
+    size_t n = num_peers_;
+    for (size_t i = 0; i < n; i++) {
+      WorkStealingScheduler *victim = peers_[next_victim_++ % n];
+      if (victim == this) {
+        continue;
+      }
+      if (LeafTrafficClass *leaf = victim->deque_.Steal()) {
+        num_stolen_.fetch_add(1, std::memory_order_relaxed);
+        return leaf;
+      }
+    }
+    return nullptr;
+  }
+
+  // Checks the next peer in round-robin order and takes a leaf from it if it
+  // holds at least two more leaves than we do, which evens out the load
+  // without leaves bouncing back and forth between equally loaded workers.
+  // Only one peer is looked at per round to keep the common case cheap.
+  LeafTrafficClass *StealFromDeeper() {
+    size_t n = num_peers_;
+    if (n < 2) {
+      return nullptr;
+    }
+    WorkStealingScheduler *victim = peers_[next_victim_++ % n];
+    if (victim == this || victim->deque_.Size() < deque_.Size() + 2) {
+      return nullptr;
+    }
+    LeafTrafficClass *leaf = victim->deque_.Steal();
+    if (leaf) {
+      num_stolen_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return leaf;
+  }
+
+  // Runs 'leaf' and returns the number of packets it processed.
+  uint64_t RunLeaf(Context *ctx, LeafTrafficClass *leaf) {
+    resource_arr_t usage;
+
+    ctx->current_tsc = this->checkpoint_;  // Tasks see updated tsc.
+    ctx->current_ns = this->checkpoint_ * this->ns_per_cycle_;
+    current_worker.set_current_tsc(ctx->current_tsc);
+    current_worker.set_current_ns(ctx->current_ns);
+
+    ctx->task = leaf->task();
+    ctx->silent_drops = 0;
+
+    // Run.
+    auto ret = (*ctx->task)(ctx);
+
+    uint64_t now = rdtsc();
+
+    // Account.
+    usage[RESOURCE_COUNT] = 1;
+    usage[RESOURCE_CYCLE] = now - this->checkpoint_;
+    usage[RESOURCE_PACKET] = ret.packets;
+    usage[RESOURCE_BIT] = ret.bits;
+
+    current_worker.incr_silent_drops(ctx->silent_drops);
+
+    // Stealable leaves have no parent, so this only updates their own stats.
+    leaf->FinishAndAccountTowardsRoot(&this->wakeup_queue_, nullptr, usage,
+                                      now);
+
+    this->checkpoint_ = now;
+    return ret.packets;
   }
+
+  bess::utils::WorkStealingDeque<LeafTrafficClass *> deque_;
+
+  // Round-robin cursor over peers_ for picking the next victim.
+  size_t next_victim_;
+
+  // Only written by the owning worker, but may be read by anyone.
+  std::atomic<uint64_t> num_stolen_;
+
+  // All stealable leaves, whichever deque they currently are in.  Only
+  // accessed by the master thread.
+  inline static std::vector<LeafTrafficClass *> stealable_leaves_;
+
+  // The schedulers that steal from each other.  Only updated by the master
+  // thread while all workers are paused.
+  inline static WorkStealingScheduler *peers_[Worker::kMaxWorkers];
+  inline static size_t num_peers_ = 0;
 };
 
 }  // namespace bess
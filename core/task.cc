@@ -36,6 +36,7 @@
 
 #include "gate.h"
 #include "module.h"
+#include "utils/time.h"
 
 // Called when the leaf that owns this task is destroyed.
 void Task::Detach() {
@@ -51,8 +52,16 @@ struct task_result Task::operator()(Context *ctx) const {
   bess::PacketBatch init_batch;
   ClearPacketBatch();
 
+#ifdef BESS_MODULE_PROFILE
+  uint64_t tsc = rdtsc();
+#endif
+
   // Start from the first module (task module)
   struct task_result result = module_->RunTask(ctx, &init_batch, arg_);
+
+#ifdef BESS_MODULE_PROFILE
+  tsc = module_->AccountProfile(ctx->wid, tsc, result.packets);
+#endif
   // next_gate_: Continuously run if modules are chained
   // igates_to_run_ : If next module connection is not chained (merged),
   // check priority to choose which module run next
@@ -78,6 +87,11 @@ struct task_result Task::operator()(Context *ctx) const {
 
     ctx->current_igate = igate->gate_idx();
 
+#ifdef BESS_MODULE_PROFILE
+    // ProcessBatch() may consume the batch.
+    uint64_t cnt = batch->cnt();
+#endif
+
     for (auto &hook : igate->hooks()) {
       hook->ProcessBatch(batch);
     }
@@ -85,6 +99,10 @@ struct task_result Task::operator()(Context *ctx) const {
     Module *m = igate->module();
     m->ProcessBatch(ctx, batch);  // process module
     m->ProcessOGates(ctx);        // process ogates
+
+#ifdef BESS_MODULE_PROFILE
+    tsc = m->AccountProfile(ctx->wid, tsc, cnt);
+#endif
   }
 
   deadend(ctx, &dead_batch_);
@@ -582,7 +582,8 @@ class LeafTrafficClass final : public TrafficClass {
   explicit LeafTrafficClass(const std::string &name, Task *task)
       : TrafficClass(name, POLICY_LEAF, false),
         task_(task),
-        wait_cycles_(kInitialWaitCycles) {
+        wait_cycles_(kInitialWaitCycles),
+        stealable_(false) {
     task_->Attach(this);
   }
 
@@ -599,6 +600,14 @@ class LeafTrafficClass final : public TrafficClass {
 
   void set_wait_cycles(uint64_t wait_cycles) { wait_cycles_ = wait_cycles; }
 
+  // A stealable leaf that is not pinned to a worker is not attached to any
+  // scheduler tree when work-stealing workers exist; instead it is shared by
+  // all of them (see WorkStealingScheduler).  Every module reachable from its
+  // task must therefore be safe to run from multiple workers.
+  bool stealable() const { return stealable_; }
+
+  void set_stealable(bool stealable) { stealable_ = stealable; }
+
   void BlockTowardsRoot() override {
     TrafficClass::BlockTowardsRootSetBlocked(false);
   }
@@ -624,6 +633,8 @@ class LeafTrafficClass final : public TrafficClass {
   Task *task_;
 
   uint64_t wait_cycles_;
+
+  bool stealable_;
 };
 
 class PriorityChildArgs : public TCChildArgs {
@@ -34,6 +34,8 @@
 #include <benchmark/benchmark.h>
 #include <glog/logging.h>
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "module.h"
@@ -60,6 +62,36 @@ class DummyModule : public Module {
   return {.block = false, .packets = 0, .bits = 0};
 }
 
+// A task that burns the given number of cycles (passed as its arg) per run,
+// or acts like an empty queue if that is 0.
+class SpinModule : public Module {
+ public:
+  SpinModule() : Module(), runs_(0) {}
+
+  struct task_result RunTask(Context *, bess::PacketBatch *,
+                             void *arg) override;
+
+  uint64_t runs() const { return runs_.load(); }
+
+ private:
+  std::atomic<uint64_t> runs_;
+};
+
+[[gnu::noinline]] struct task_result SpinModule::RunTask(Context *,
+                                                         bess::PacketBatch *,
+                                                         void *arg) {
+  uint64_t cycles = reinterpret_cast<uintptr_t>(arg);
+  if (cycles == 0) {
+    return {.block = true, .packets = 0, .bits = 0};
+  }
+
+  uint64_t end = rdtsc() + cycles;
+  while (rdtsc() < end) {
+  }
+  runs_.fetch_add(1, std::memory_order_relaxed);
+  return {.block = false, .packets = 1, .bits = 0};
+}
+
 // Performs TC Scheduler init/deinit before/after each test.
 // Sets up a tree for weighted fair benchmarking.
 class TCWeightedFair : public benchmark::Fixture {
@@ -234,6 +266,109 @@ BENCHMARK_REGISTER_F(TCRoundRobin, TCScheduleOnce)
     ->Args({4 << 14})
     ->Complexity();
 
+// Skewed load across state.range(0) workers: 4 busy tasks per worker, all of
+// them initially on worker 0, while the other workers start with nothing to
+// do. With state.range(1) == 0 worker 0 runs all the tasks with the default
+// scheduler; otherwise the tasks are stealable, the workers use the
+// work-stealing scheduler and the idle ones take tasks from worker 0.
+// Reports busy task runs/s and how many times a task was stolen.
+void BM_SkewedLoad(benchmark::State &state) {
+  const int num_workers = state.range(0);
+  const bool stealing = state.range(1);
+  const int kTasksPerWorker = 4;
+  const uintptr_t kBusyCycles = 2000;
+
+  SpinModule *spin = new SpinModule;
+
+  std::vector<LeafTrafficClass *> leaves;
+  for (int i = 0; i < num_workers * kTasksPerWorker; i++) {
+    LeafTrafficClass *c =
+        TrafficClassBuilder::CreateTrafficClass<LeafTrafficClass>(
+            "skewed_" + std::to_string(i),
+            new Task(spin, reinterpret_cast<void *>(kBusyCycles)));
+    c->set_stealable(stealing);
+    leaves.push_back(c);
+  }
+
+  DefaultScheduler *busy = nullptr;
+  std::vector<WorkStealingScheduler *> stealers;
+  if (stealing) {
+    for (int i = 0; i < num_workers; i++) {
+      stealers.push_back(new WorkStealingScheduler());
+    }
+    // Sets up the group of peers with empty deques, then hands all the
+    // leaves to worker 0.
+    WorkStealingScheduler::Distribute(stealers, {});
+    for (auto *c : leaves) {
+      CHECK(stealers[0]->deque().Push(c));
+    }
+  } else {
+    auto *rr = static_cast<RoundRobinTrafficClass *>(
+        CT("skewed_rr", {ROUND_ROBIN}, {}));
+    for (auto *c : leaves) {
+      CHECK(rr->AddChild(c));
+    }
+    busy = new DefaultScheduler(rr);
+  }
+
+  std::atomic<bool> stop(false);
+  std::vector<std::thread> threads;
+  if (stealing) {
+    for (int i = 1; i < num_workers; i++) {
+      threads.emplace_back([&, i]() {
+        Context ctx = {};
+        ctx.wid = i;
+        while (!stop.load(std::memory_order_relaxed)) {
+          stealers[i]->ScheduleOnce(&ctx);
+        }
+      });
+    }
+  }
+
+  Context ctx = {};
+  uint64_t start_runs = spin->runs();
+  while (state.KeepRunning()) {
+    if (stealing) {
+      stealers[0]->ScheduleOnce(&ctx);
+    } else {
+      busy->ScheduleOnce(&ctx);
+    }
+  }
+  state.SetItemsProcessed(spin->runs() - start_runs);
+
+  stop = true;
+  for (auto &t : threads) {
+    t.join();
+  }
+
+  uint64_t stolen = 0;
+  for (auto *s : stealers) {
+    stolen += s->num_stolen();
+  }
+  state.counters["stolen"] = stolen;
+
+  delete busy;
+  for (auto *s : stealers) {
+    delete s;
+  }
+  if (stealing) {
+    WorkStealingScheduler::Distribute({}, {});
+    for (auto *c : leaves) {
+      delete c;
+    }
+  }
+  delete spin;
+
+  TrafficClassBuilder::ClearAll();
+}
+
+BENCHMARK(BM_SkewedLoad)
+    ->Args({2, 0})
+    ->Args({2, 1})
+    ->Args({4, 0})
+    ->Args({4, 1})
+    ->UseRealTime();
+
 }  // namespace
 
 BENCHMARK_MAIN();
@@ -36,6 +36,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "module.h"
 #include "scheduler.h"
@@ -59,6 +60,21 @@ class DummyModule : public Module {
   return {.block = false, .packets = 0, .bits = 0};
 }
 
+// Counts how many times its task has run in the int pointed to by the task
+// argument.
+class CountModule : public Module {
+ public:
+  struct task_result RunTask(Context *, bess::PacketBatch *,
+                             void *arg) override;
+};
+
+[[gnu::noinline]] struct task_result CountModule::RunTask(Context *,
+                                                          bess::PacketBatch *,
+                                                          void *arg) {
+  ++*static_cast<int *>(arg);
+  return {.block = false, .packets = 1, .bits = 0};
+}
+
 // Tests that we can create a leaf node.
 TEST(CreateTree, Leaf) {
   std::unique_ptr<TrafficClass> c(
@@ -627,4 +643,84 @@ TEST(RateLimit, BasicBlockUnblock) {
   TrafficClassBuilder::ClearAll();
 }
 
+// Tests that a work-stealing worker holding several stealable leaves runs all
+// of them in turn.
+TEST(WorkStealingScheduleOnce, RotatesOwnLeaves) {
+  CountModule cm;
+  int runs[3] = {0, 0, 0};
+  std::vector<LeafTrafficClass *> leaves;
+  for (int i = 0; i < 3; i++) {
+    LeafTrafficClass *c =
+        TrafficClassBuilder::CreateTrafficClass<LeafTrafficClass>(
+            "stealable_" + std::to_string(i), new Task(&cm, &runs[i]));
+    c->set_stealable(true);
+    leaves.push_back(c);
+  }
+
+  WorkStealingScheduler s;
+  WorkStealingScheduler::Distribute({&s}, leaves);
+  ASSERT_EQ(3, s.deque().Size());
+
+  Context ctx = {};
+  for (int i = 0; i < 6; i++) {
+    EXPECT_EQ(1, s.ScheduleOnce(&ctx));
+  }
+  EXPECT_EQ(2, runs[0]);
+  EXPECT_EQ(2, runs[1]);
+  EXPECT_EQ(2, runs[2]);
+  EXPECT_EQ(3, s.deque().Size());
+  EXPECT_EQ(0, s.num_stolen());
+
+  WorkStealingScheduler::Distribute({}, {});
+  for (auto *c : leaves) {
+    delete c;
+  }
+  TrafficClassBuilder::ClearAll();
+}
+
+// Tests that a worker takes leaves from a peer holding more than it does, even
+// when its own deque is not empty, until the load is even.
+TEST(WorkStealingScheduleOnce, StealsFromDeeperPeer) {
+  CountModule cm;
+  int runs[5] = {0, 0, 0, 0, 0};
+  std::vector<LeafTrafficClass *> leaves;
+  for (int i = 0; i < 5; i++) {
+    LeafTrafficClass *c =
+        TrafficClassBuilder::CreateTrafficClass<LeafTrafficClass>(
+            "stealable_" + std::to_string(i), new Task(&cm, &runs[i]));
+    c->set_stealable(true);
+    leaves.push_back(c);
+  }
+
+  WorkStealingScheduler s0;
+  WorkStealingScheduler s1;
+  // Leaves 0, 2 and 4 go to s0, leaves 1 and 3 to s1.
+  WorkStealingScheduler::Distribute({&s0, &s1}, leaves);
+  // Move one more leaf over so that s0 holds four and s1 holds one.
+  s1.deque().Steal();
+  ASSERT_TRUE(s0.deque().Push(leaves[1]));
+  ASSERT_EQ(4, s0.deque().Size());
+  ASSERT_EQ(1, s1.deque().Size());
+
+  Context ctx = {};
+  for (int i = 0; i < 4; i++) {
+    s1.ScheduleOnce(&ctx);
+  }
+  EXPECT_EQ(1, s1.num_stolen());
+  EXPECT_EQ(3, s0.deque().Size());
+  EXPECT_EQ(2, s1.deque().Size());
+
+  // Now the load is even, so nothing more gets stolen.
+  for (int i = 0; i < 4; i++) {
+    s1.ScheduleOnce(&ctx);
+  }
+  EXPECT_EQ(1, s1.num_stolen());
+
+  WorkStealingScheduler::Distribute({}, {});
+  for (auto *c : leaves) {
+    delete c;
+  }
+  TrafficClassBuilder::ClearAll();
+}
+
 }  // namespace bess
@@ -10,6 +10,12 @@
 
 #include "bpf.h"
 
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <map>
+#include <utility>
+
 namespace bess {
 namespace utils {
 
@@ -93,6 +99,29 @@ typedef struct bpf_bin_stream {
   u_int *refs;
 } bpf_bin_stream;
 
+/*
+ * A classic BPF instruction with 32-bit jump offsets, as found in merged
+ * programs (see CompileMultiFilter()), which outgrow the 8-bit offsets of
+ * struct bpf_insn. Where a packet access is out of bounds (or a division by
+ * zero happens), the program continues at offset oob (relative, like jt/jf)
+ * instead of returning 0, unless oob is 0.
+ */
+struct bpf_wide_insn {
+  u_short code;
+  u_int jt;
+  u_int jf;
+  bpf_u_int32 k;
+  u_int oob;
+};
+
+static inline u_int insn_oob(const struct bpf_insn *) {
+  return 0;
+}
+
+static inline u_int insn_oob(const struct bpf_wide_insn *ins) {
+  return ins->oob;
+}
+
 /*
  * Prototype of the emit functions.
  *
@@ -496,6 +525,27 @@ typedef void (*emit_func)(bpf_bin_stream *stream, u_int value, u_int n);
       JMP(stream.refs[stream.bpf_pc + (off)] - stream.refs[stream.bpf_pc]); \
   } while (0)
 
+/*
+ * Out-of-bounds packet access (or division by zero): return 0 or, in merged
+ * programs, jump to the instruction given by the oob offset (see
+ * bpf_wide_insn). OOB_LEN is the number of bytes OOB_EXIT() emits.
+ */
+#define OOB_LEN (insn_oob(ins) ? 5 : (fmem ? 2 : 1))
+
+#define OOB_EXIT()                                                        \
+  do {                                                                    \
+    if (insn_oob(ins)) {                                                  \
+      /* relative to the end of this 5-byte jmp */                        \
+      u_int rel = stream.refs[stream.bpf_pc + insn_oob(ins)] -            \
+                  (stream.cur_ip + 5);                                    \
+      JMP(rel);                                                           \
+    } else {                                                              \
+      if (fmem)                                                           \
+        LEAVE();                                                          \
+      RET();                                                              \
+    }                                                                     \
+  } while (0)
+
 /*
  * Emit routine to update the jump table.
  */
@@ -533,7 +583,8 @@ static void emit_code(bpf_bin_stream *stream, u_int value, u_int len) {
 /*
  * Scan the filter program and find possible optimization.
  */
-static int bpf_jit_optimize(struct bpf_insn *prog, u_int nins) {
+template <typename Insn>
+static int bpf_jit_optimize(const Insn *prog, u_int nins) {
   int flags;
   u_int i;
 
@@ -574,6 +625,9 @@ static int bpf_jit_optimize(struct bpf_insn *prog, u_int nins) {
         flags |= BPF_JIT_FJMP;
         break;
     }
+    /* Out-of-bounds exits to an instruction need the jump table, too */
+    if (insn_oob(&prog[i]))
+      flags |= BPF_JIT_FJMP;
     if (flags == BPF_JIT_FLAG_ALL)
       break;
   }
@@ -584,10 +638,11 @@ static int bpf_jit_optimize(struct bpf_insn *prog, u_int nins) {
 /*
  * Function that does the real stuff.
  */
-bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
-                                  size_t *size) {
+template <typename Insn>
+static bpf_filter_func_t jit_compile(const Insn *prog, u_int nins,
+                                     size_t *size) {
   bpf_bin_stream stream;
-  struct bpf_insn *ins;
+  const Insn *ins;
   int flags, fret, fpkt, fmem, fjmp, flen;
   u_int i, pass;
 
@@ -665,15 +720,9 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           MOVrd(EDI, ECX);
           SUBrd(ESI, ECX);
           CMPid(sizeof(int32_t), ECX);
-          if (fmem) {
-            JAEb(4);
-            ZEROrd(EAX);
-            LEAVE();
-          } else {
-            JAEb(3);
-            ZEROrd(EAX);
-          }
-          RET();
+          JAEb(2 + OOB_LEN);
+          ZEROrd(EAX);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           MOVobd(RCX, RSI, EAX);
           BSWAP(EAX);
@@ -687,12 +736,8 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           MOVrd(EDI, ECX);
           SUBrd(ESI, ECX);
           CMPid(sizeof(int16_t), ECX);
-          if (fmem) {
-            JAEb(2);
-            LEAVE();
-          } else
-            JAEb(1);
-          RET();
+          JAEb(OOB_LEN);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           MOVobw(RCX, RSI, AX);
           SWAP_AX();
@@ -702,12 +747,8 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           ZEROrd(EAX);
           MOVid(ins->k, ESI);
           CMPrd(EDI, ESI);
-          if (fmem) {
-            JBb(2);
-            LEAVE();
-          } else
-            JBb(1);
-          RET();
+          JBb(OOB_LEN);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           MOVobb(RCX, RSI, AL);
           break;
@@ -732,15 +773,9 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           MOVrd(EDI, ECX);
           SUBrd(ESI, ECX);
           CMPid(sizeof(int32_t), ECX);
-          if (fmem) {
-            JAEb(4);
-            ZEROrd(EAX);
-            LEAVE();
-          } else {
-            JAEb(3);
-            ZEROrd(EAX);
-          }
-          RET();
+          JAEb(2 + OOB_LEN);
+          ZEROrd(EAX);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           MOVobd(RCX, RSI, EAX);
           BSWAP(EAX);
@@ -759,12 +794,8 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           MOVrd(EDI, ECX);
           SUBrd(ESI, ECX);
           CMPid(sizeof(int16_t), ECX);
-          if (fmem) {
-            JAEb(2);
-            LEAVE();
-          } else
-            JAEb(1);
-          RET();
+          JAEb(OOB_LEN);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           MOVobw(RCX, RSI, AX);
           SWAP_AX();
@@ -778,12 +809,8 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
           MOVrd(EDI, ECX);
           SUBrd(EDX, ECX);
           CMPrd(ESI, ECX);
-          if (fmem) {
-            JAb(2);
-            LEAVE();
-          } else
-            JAb(1);
-          RET();
+          JAb(OOB_LEN);
+          OOB_EXIT();
           MOVrq3(R8, RCX);
           ADDrd(EDX, ESI);
           MOVobb(RCX, RSI, AL);
@@ -792,15 +819,9 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
         case BPF_LDX | BPF_MSH | BPF_B:
           MOVid(ins->k, ESI);
           CMPrd(EDI, ESI);
-          if (fmem) {
-            JBb(4);
-            ZEROrd(EAX);
-            LEAVE();
-          } else {
-            JBb(3);
-            ZEROrd(EAX);
-          }
-          RET();
+          JBb(2 + OOB_LEN);
+          ZEROrd(EAX);
+          OOB_EXIT();
           ZEROrd(EDX);
           MOVrq3(R8, RCX);
           MOVobb(RCX, RSI, DL);
@@ -933,15 +954,9 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
 
         case BPF_ALU | BPF_DIV | BPF_X:
           TESTrd(EDX, EDX);
-          if (fmem) {
-            JNEb(4);
-            ZEROrd(EAX);
-            LEAVE();
-          } else {
-            JNEb(3);
-            ZEROrd(EAX);
-          }
-          RET();
+          JNEb(2 + OOB_LEN);
+          ZEROrd(EAX);
+          OOB_EXIT();
           MOVrd(EDX, ECX);
           ZEROrd(EDX);
           DIVrd(ECX);
@@ -1063,7 +1078,418 @@ bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
 
   return (reinterpret_cast<bpf_filter_func_t>(stream.ibuf));
 }
+
+bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
+                                  size_t *size) {
+  return jit_compile(prog, nins, size);
+}
+
+/*
+ * Merging filters into one program.
+ *
+ * The programs of all filters are laid out back to back. "ret #0" becomes a
+ * jump to the next filter, as does an out-of-bounds packet access, and any
+ * other return yields the gate of the filter plus one. Jumps are then
+ * threaded along paths whose outcome is already known from the packet
+ * fields checked before, so that the checks filters have in common (ether
+ * type, IP protocol, ...) are not repeated by each of them.
+ */
+
+/* An absolute packet load, identified by (code, k) */
+typedef std::pair<u_short, bpf_u_int32> LoadKey;
+
+/* What is known about the value of an absolute packet load */
+struct LoadFact {
+  bool eq_known;
+  bpf_u_int32 eq;
+  std::vector<bpf_u_int32> ne; /* sorted values it is known not to be */
+  bpf_u_int32 zero_bits;       /* bits known to be clear */
+};
+
+/* What is known at an instruction, on all paths that reach it */
+struct FlowState {
+  bool reached = false;
+  bool a_known = false; /* A holds the value of the load a_src */
+  LoadKey a_src;
+  std::map<LoadKey, LoadFact> facts;
+};
+
+static bool IsAbsLoad(u_short code) {
+  return BPF_CLASS(code) == BPF_LD && BPF_MODE(code) == BPF_ABS;
+}
+
+/* Instructions that may end the program early: packet loads and division */
+static bool CanAbort(u_short code) {
+  return (BPF_CLASS(code) == BPF_LD &&
+          (BPF_MODE(code) == BPF_ABS || BPF_MODE(code) == BPF_IND)) ||
+         code == (BPF_LDX | BPF_MSH | BPF_B) ||
+         code == (BPF_ALU | BPF_DIV | BPF_X);
+}
+
+static bool WritesA(u_short code) {
+  return BPF_CLASS(code) == BPF_LD || BPF_CLASS(code) == BPF_ALU ||
+         code == (BPF_MISC | BPF_TXA);
+}
+
+/* Returns true if A is overwritten (or unused) before it is read, when the
+ * program runs from instruction t */
+static bool IsADead(const std::vector<bpf_wide_insn> &prog, u_int t) {
+  while (BPF_CLASS(prog[t].code) == BPF_LDX)
+    t++;
+
+  u_short code = prog[t].code;
+  return BPF_CLASS(code) == BPF_LD || code == (BPF_RET | BPF_K) ||
+         code == (BPF_MISC | BPF_TXA);
+}
+
+/* Merges b into a. Returns false if nothing is known anymore. */
+static bool MeetFact(LoadFact *a, const LoadFact &b) {
+  std::vector<bpf_u_int32> ne;
+
+  if (a->eq_known && b.eq_known && a->eq == b.eq) {
+    return true;
+  }
+
+  a->zero_bits = (a->eq_known ? ~a->eq : a->zero_bits) &
+                 (b.eq_known ? ~b.eq : b.zero_bits);
+
+  if (a->eq_known && b.eq_known) {
+    /* nothing but zero_bits */
+  } else if (a->eq_known || b.eq_known) {
+    bpf_u_int32 eq = a->eq_known ? a->eq : b.eq;
+    const std::vector<bpf_u_int32> &other = a->eq_known ? b.ne : a->ne;
+    std::remove_copy(other.begin(), other.end(), std::back_inserter(ne), eq);
+  } else {
+    std::set_intersection(a->ne.begin(), a->ne.end(), b.ne.begin(),
+                          b.ne.end(), std::back_inserter(ne));
+  }
+
+  a->eq_known = false;
+  a->ne = std::move(ne);
+  return !a->ne.empty() || a->zero_bits != 0;
+}
+
+/* Merges the state of one more path into a */
+static void MeetState(FlowState *a, const FlowState &b) {
+  if (!a->reached) {
+    *a = b;
+    return;
+  }
+
+  a->a_known = a->a_known && b.a_known && a->a_src == b.a_src;
+
+  for (auto it = a->facts.begin(); it != a->facts.end();) {
+    auto other = b.facts.find(it->first);
+    if (other == b.facts.end() || !MeetFact(&it->second, other->second)) {
+      it = a->facts.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+/* Updates the state for the effect of ins on A */
+static void Transfer(FlowState *s, const bpf_wide_insn &ins) {
+  if (IsAbsLoad(ins.code)) {
+    s->a_known = true;
+    s->a_src = LoadKey(ins.code, ins.k);
+  } else if (WritesA(ins.code)) {
+    s->a_known = false;
+  }
+}
+
+/* Returns the outcome (1: jt, 0: jf) of the conditional jump ins, or -1 if
+ * it is not known in state s */
+static int Decide(const FlowState &s, const bpf_wide_insn &ins) {
+  if (BPF_SRC(ins.code) != BPF_K || !s.a_known) {
+    return -1;
+  }
+
+  auto it = s.facts.find(s.a_src);
+  if (it == s.facts.end()) {
+    return -1;
+  }
+
+  const LoadFact &fact = it->second;
+  if (!fact.eq_known) {
+    if (BPF_OP(ins.code) == BPF_JEQ &&
+        std::binary_search(fact.ne.begin(), fact.ne.end(), ins.k)) {
+      return 0;
+    }
+    if (BPF_OP(ins.code) == BPF_JSET && (ins.k & ~fact.zero_bits) == 0) {
+      return 0;
+    }
+    return -1;
+  }
+
+  switch (BPF_OP(ins.code)) {
+    case BPF_JEQ:
+      return fact.eq == ins.k;
+    case BPF_JGT:
+      return fact.eq > ins.k;
+    case BPF_JGE:
+      return fact.eq >= ins.k;
+    case BPF_JSET:
+      return (fact.eq & ins.k) != 0;
+    default:
+      return -1;
+  }
+}
+
+/* Updates the state for taking (or not) the conditional jump ins */
+static void Refine(FlowState *s, const bpf_wide_insn &ins, bool taken) {
+  if (!s->a_known) {
+    return;
+  }
+
+  if (ins.code == (BPF_JMP | BPF_JSET | BPF_K)) {
+    if (!taken) {
+      s->facts[s->a_src].zero_bits |= ins.k;
+    }
+    return;
+  } else if (ins.code != (BPF_JMP | BPF_JEQ | BPF_K)) {
+    return;
+  }
+
+  LoadFact &fact = s->facts[s->a_src];
+  if (taken) {
+    fact.eq_known = true;
+    fact.eq = ins.k;
+    fact.ne.clear();
+  } else if (!fact.eq_known) {
+    auto it = std::lower_bound(fact.ne.begin(), fact.ne.end(), ins.k);
+    if (it == fact.ne.end() || *it != ins.k) {
+      fact.ne.insert(it, ins.k);
+    }
+  }
+}
+
+/* Returns the furthest instruction that a jump to t, taken in state s, can
+ * go to directly. Loads whose value is known are skipped over, which leaves A
+ * stale, so the jump then may only go as far as a point where A is dead or
+ * to the first load skipped. */
+static u_int FollowJumps(const std::vector<bpf_wide_insn> &prog, u_int t,
+                         FlowState s) {
+  u_int best = t;
+  bool a_valid = true; /* A actually holds what s says */
+
+  for (;;) {
+    const bpf_wide_insn &ins = prog[t];
+
+    if (a_valid)
+      best = t;
+
+    if (ins.code == (BPF_JMP | BPF_JA)) {
+      t = ins.jt;
+    } else if (IsAbsLoad(ins.code)) {
+      LoadKey key(ins.code, ins.k);
+      if (!s.a_known || s.a_src != key) {
+        if (s.facts.find(key) == s.facts.end())
+          break;
+        a_valid = false;
+        s.a_known = true;
+        s.a_src = key;
+      }
+      t++;
+    } else if (BPF_CLASS(ins.code) == BPF_JMP) {
+      int taken = Decide(s, ins);
+      if (taken < 0)
+        break;
+      Refine(&s, ins, taken);
+      t = taken ? ins.jt : ins.jf;
+    } else {
+      break;
+    }
+  }
+
+  return (a_valid || IsADead(prog, t)) ? t : best;
+}
+
+/* Retargets the jumps of prog (absolute targets, forward only) */
+static void ThreadJumps(std::vector<bpf_wide_insn> *prog) {
+  std::vector<bpf_wide_insn> &p = *prog;
+  std::vector<FlowState> in(p.size());
+
+  /* Jumps only go forward, so all paths to an instruction are known by the
+   * time it is visited */
+  in[0].reached = true;
+  for (u_int i = 0; i < p.size(); i++) {
+    const bpf_wide_insn &ins = p[i];
+    if (!in[i].reached)
+      continue;
+
+    if (ins.oob) {
+      FlowState aborted = in[i];
+      aborted.a_known = false;
+      MeetState(&in[ins.oob], aborted);
+    }
+
+    FlowState out = in[i];
+    Transfer(&out, ins);
+
+    if (BPF_CLASS(ins.code) == BPF_RET) {
+      continue;
+    } else if (BPF_CLASS(ins.code) != BPF_JMP) {
+      MeetState(&in[i + 1], out);
+    } else if (BPF_OP(ins.code) == BPF_JA) {
+      MeetState(&in[ins.jt], out);
+    } else {
+      FlowState taken = out;
+      Refine(&taken, ins, true);
+      MeetState(&in[ins.jt], taken);
+      Refine(&out, ins, false);
+      MeetState(&in[ins.jf], out);
+    }
+  }
+
+  for (u_int i = 0; i < p.size(); i++) {
+    bpf_wide_insn &ins = p[i];
+    if (!in[i].reached || BPF_CLASS(ins.code) != BPF_JMP)
+      continue;
+
+    if (BPF_OP(ins.code) == BPF_JA) {
+      ins.jt = FollowJumps(p, ins.jt, in[i]);
+    } else {
+      FlowState taken = in[i];
+      Refine(&taken, ins, true);
+      ins.jt = FollowJumps(p, ins.jt, taken);
+      FlowState not_taken = in[i];
+      Refine(&not_taken, ins, false);
+      ins.jf = FollowJumps(p, ins.jf, not_taken);
+    }
+  }
+}
 #endif
 
+/* bpf_filter() returns the snap length if matched, and 0 if unmatched. */
+#define SNAPLEN 0xffff
+
+// Compiles `exp` into classic BPF. Returns 0, -EINVAL, or -ENOMEM.
+static int CompileExpression(const std::string &exp, struct bpf_program *il) {
+  pcap_t *pc = pcap_open_dead(DLT_EN10MB, SNAPLEN);
+  if (!pc) {
+    return -ENOMEM;
+  }
+  int ret = pcap_compile(pc, il, exp.c_str(),
+                         1,  // optimize (IL only)
+                         PCAP_NETMASK_UNKNOWN);
+  pcap_close(pc);
+  if (ret == -1) {
+    return -EINVAL;
+  }
+  return 0;
+}
+
+int CompileFilter(Filter *filter) {
+  struct bpf_program il;
+  int ret = CompileExpression(filter->exp, &il);
+  if (ret < 0) {
+    return ret;
+  }
+
+#ifdef __x86_64
+  filter->func = bpf_jit_compile(il.bf_insns, il.bf_len, &filter->mmap_size);
+  pcap_freecode(&il);
+  if (!filter->func) {
+    return -ENOMEM;
+  }
+#else
+  filter->il_code = il;
+#endif
+
+  return 0;
+}
+
+void FreeFilter(Filter *filter) {
+#ifdef __x86_64
+  munmap(reinterpret_cast<void *>(filter->func), filter->mmap_size);
+  filter->func = nullptr;
+#else
+  pcap_freecode(&filter->il_code);
+#endif
+}
+
+int CompileMultiFilter(const std::vector<Filter> &filters, MultiFilter *mf) {
+#ifdef __x86_64
+  // Branch targets are absolute until the program is complete
+  std::vector<bpf_wide_insn> prog;
+
+  for (const Filter &filter : filters) {
+    struct bpf_program il;
+    int ret = CompileExpression(filter.exp, &il);
+    if (ret < 0) {
+      return ret;
+    }
+
+    u_int base = prog.size();
+    u_int matched = base + il.bf_len;  // "ret #gate + 1", appended below
+    u_int next = matched + 1;          // the next filter
+
+    for (u_int i = 0; i < il.bf_len; i++) {
+      const struct bpf_insn &ins = il.bf_insns[i];
+      bpf_wide_insn w = {ins.code, 0, 0, ins.k, 0};
+
+      if (ins.code == (BPF_JMP | BPF_JA)) {
+        w.jt = base + i + 1 + ins.k;
+      } else if (BPF_CLASS(ins.code) == BPF_JMP) {
+        w.jt = base + i + 1 + ins.jt;
+        w.jf = base + i + 1 + ins.jf;
+      } else if (ins.code == (BPF_RET | BPF_K)) {
+        if (ins.k == 0) {
+          w = {BPF_JMP | BPF_JA, next, 0, 0, 0};
+        } else {
+          w.k = filter.gate + 1;
+        }
+      } else if (BPF_CLASS(ins.code) == BPF_RET) {
+        w = {BPF_JMP | BPF_JEQ | BPF_K, next, matched, 0, 0};
+      }
+
+      if (CanAbort(ins.code)) {
+        w.oob = next;
+      }
+      prog.push_back(w);
+    }
+
+    prog.push_back({BPF_RET | BPF_K, 0, 0, bpf_u_int32(filter.gate + 1), 0});
+    pcap_freecode(&il);
+  }
+
+  prog.push_back({BPF_RET | BPF_K, 0, 0, 0, 0});
+
+  ThreadJumps(&prog);
+
+  for (u_int i = 0; i < prog.size(); i++) {
+    bpf_wide_insn &ins = prog[i];
+    if (ins.code == (BPF_JMP | BPF_JA)) {
+      ins.k = ins.jt - (i + 1);
+      ins.jt = 0;
+    } else if (BPF_CLASS(ins.code) == BPF_JMP) {
+      ins.jt -= i + 1;
+      ins.jf -= i + 1;
+    }
+    if (ins.oob) {
+      ins.oob -= i + 1;
+    }
+  }
+
+  mf->func = jit_compile(prog.data(), prog.size(), &mf->mmap_size);
+  if (!mf->func) {
+    return -ENOMEM;
+  }
+  return 0;
+#else
+  (void)filters;
+  (void)mf;
+  return -ENOTSUP;
+#endif
+}
+
+void FreeMultiFilter(MultiFilter *mf) {
+#ifdef __x86_64
+  munmap(reinterpret_cast<void *>(mf->func), mf->mmap_size);
+#endif
+  mf->func = nullptr;
+}
+
 }  // namespace utils
 }  // namespace bess
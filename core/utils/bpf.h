@@ -15,6 +15,7 @@
 #include <pcap.h>
 #include <string>
 #include <sys/mman.h>
+#include <vector>
 
 namespace bess {
 namespace utils {
@@ -33,11 +34,62 @@ struct Filter {
   std::string exp;  // original filter expression string
 };
 
+// Filters merged into a single program, which returns the gate of the first
+// matching filter plus one, or 0 if none matches.
+struct MultiFilter {
+  bpf_filter_func_t func;
+  size_t mmap_size;  // needed for munmap()
+};
+
 #ifdef __x86_64
 bpf_filter_func_t bpf_jit_compile(struct bpf_insn *prog, u_int nins,
                                   size_t *size);
 #endif  //__x86_64
 
+// Compiles `filter->exp` (pcap-filter(7) syntax) into `filter`, with the JIT
+// where available.  Returns 0 on success, -EINVAL if the expression does not
+// compile, or -ENOMEM.
+int CompileFilter(Filter *filter);
+
+// Releases the code of a filter set up by CompileFilter().
+void FreeFilter(Filter *filter);
+
+// Merges the expressions of `filters`, in the order they are to be tried,
+// into `mf`. Checks on the same packet fields are shared across filters:
+// e.g., once a packet failed "ether proto 0x800" for one filter, the program
+// skips every later filter that requires it. Returns 0 on success, -EINVAL if
+// an expression does not compile, -ENOMEM, or -ENOTSUP without the JIT.
+int CompileMultiFilter(const std::vector<Filter> &filters, MultiFilter *mf);
+
+// Releases the code of a program set up by CompileMultiFilter().
+void FreeMultiFilter(MultiFilter *mf);
+
+// Returns true if the packet `pkt` (`buflen` bytes available out of
+// `wirelen`) matches `filter`.
+static inline bool MatchFilter(const Filter &filter, u_char *pkt,
+                               u_int wirelen, u_int buflen) {
+#ifdef __x86_64
+  return filter.func(pkt, wirelen, buflen) != 0;
+#else
+  return bpf_filter(filter.il_code.bf_insns, pkt, wirelen, buflen) != 0;
+#endif
+}
+
+// Returns the gate of the first filter of `mf` that the packet `pkt` matches,
+// or -1 if there is none.
+static inline int MatchMultiFilter(const MultiFilter &mf, u_char *pkt,
+                                   u_int wirelen, u_int buflen) {
+#ifdef __x86_64
+  return static_cast<int>(mf.func(pkt, wirelen, buflen)) - 1;
+#else
+  (void)mf;
+  (void)pkt;
+  (void)wirelen;
+  (void)buflen;
+  return -1;
+#endif
+}
+
 }  // namespace utils
 }  // namespace bess
 
@@ -0,0 +1,137 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Compares running 64 BPF filters one by one, as the BPF module does by
+// default, against the single merged program of CompileMultiFilter().
+
+#include "bpf.h"
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::CompileFilter;
+using bess::utils::CompileMultiFilter;
+using bess::utils::Filter;
+using bess::utils::FreeFilter;
+using bess::utils::FreeMultiFilter;
+using bess::utils::MatchFilter;
+using bess::utils::MatchMultiFilter;
+using bess::utils::MultiFilter;
+
+namespace {
+
+const int kNumFilters = 64;
+const size_t kNumFrames = 256;
+const size_t kFrameLen = 60;
+
+// 64 "tcp dst port" filters; the frames are TCP to a random one of those
+// ports (or one more) or UDP, by the share of TCP given as the argument.
+class BpfFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    Random rd;
+
+    filters_.clear();
+    for (int i = 0; i < kNumFilters; i++) {
+      Filter filter;
+      filter.exp = "tcp dst port " + std::to_string(1000 + i);
+      filter.gate = i % 8 + 1;
+      filter.priority = 0;
+      CompileFilter(&filter);
+      filters_.push_back(filter);
+    }
+    CompileMultiFilter(filters_, &merged_);
+
+    frames_.assign(kNumFrames, std::vector<u_char>(kFrameLen));
+    for (auto &frame : frames_) {
+      uint16_t port = 1000 + rd.GetRange(kNumFilters + 1);
+      frame[12] = 0x08;
+      frame[14] = 0x45;
+      frame[23] = rd.GetRange(100) < state.range(0) ? 6 : 17;
+      frame[36] = port >> 8;
+      frame[37] = port & 0xff;
+    }
+  }
+
+  void TearDown(benchmark::State &) override {
+    for (Filter &filter : filters_) {
+      FreeFilter(&filter);
+    }
+    FreeMultiFilter(&merged_);
+  }
+
+ protected:
+  std::vector<Filter> filters_;
+  MultiFilter merged_;
+  std::vector<std::vector<u_char>> frames_;
+};
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(BpfFixture, Sequential)(benchmark::State &state) {
+  int sum = 0;
+
+  for (auto _ : state) {
+    for (auto &frame : frames_) {
+      int gate = 0;
+      for (const Filter &filter : filters_) {
+        if (MatchFilter(filter, frame.data(), kFrameLen, kFrameLen)) {
+          gate = filter.gate;
+          break;
+        }
+      }
+      sum += gate;
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * kNumFrames);
+}
+
+BENCHMARK_DEFINE_F(BpfFixture, Merged)(benchmark::State &state) {
+  int sum = 0;
+
+  for (auto _ : state) {
+    for (auto &frame : frames_) {
+      sum += MatchMultiFilter(merged_, frame.data(), kFrameLen, kFrameLen);
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * kNumFrames);
+}
+
+// Percentage of TCP frames
+BENCHMARK_REGISTER_F(BpfFixture, Sequential)->Arg(0)->Arg(50)->Arg(100);
+BENCHMARK_REGISTER_F(BpfFixture, Merged)->Arg(0)->Arg(50)->Arg(100);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,183 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "bpf.h"
+
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <vector>
+
+namespace {
+
+using bess::utils::CompileFilter;
+using bess::utils::CompileMultiFilter;
+using bess::utils::Filter;
+using bess::utils::FreeFilter;
+using bess::utils::FreeMultiFilter;
+using bess::utils::MatchFilter;
+using bess::utils::MatchMultiFilter;
+using bess::utils::MultiFilter;
+
+// An Ethernet frame with the given ether type; IPv4 and IPv6 frames carry a
+// TCP or UDP header with destination port `port`.
+std::vector<u_char> MakeFrame(uint16_t ether_type, uint8_t proto = 0,
+                              uint16_t port = 0) {
+  std::vector<u_char> frame(ether_type == 0x86dd ? 74 : 60);
+  frame[12] = ether_type >> 8;
+  frame[13] = ether_type & 0xff;
+
+  size_t l4;
+  if (ether_type == 0x800) {
+    frame[14] = 0x45;
+    frame[23] = proto;
+    l4 = 34;
+  } else if (ether_type == 0x86dd) {
+    frame[14] = 0x60;
+    frame[20] = proto;
+    l4 = 54;
+  } else {
+    return frame;
+  }
+
+  frame[l4 + 2] = port >> 8;
+  frame[l4 + 3] = port & 0xff;
+  return frame;
+}
+
+class MultiFilterTest : public ::testing::Test {
+ protected:
+  void TearDown() override {
+    for (Filter &filter : filters_) {
+      FreeFilter(&filter);
+    }
+  }
+
+  void AddFilter(const std::string &exp, int gate) {
+    Filter filter;
+    filter.exp = exp;
+    filter.gate = gate;
+    filter.priority = 0;
+    ASSERT_EQ(0, CompileFilter(&filter)) << exp;
+    filters_.push_back(filter);
+  }
+
+  // What the BPF module does without merging: the first match wins
+  int MatchSequential(std::vector<u_char> &frame, u_int buflen) {
+    for (const Filter &filter : filters_) {
+      if (MatchFilter(filter, frame.data(), frame.size(), buflen)) {
+        return filter.gate;
+      }
+    }
+    return -1;
+  }
+
+  // Checks that the merged program agrees with the filters one by one, and
+  // returns its verdict.
+  int Match(const MultiFilter &mf, std::vector<u_char> frame,
+            u_int buflen = 0) {
+    buflen = buflen ?: frame.size();
+    int gate = MatchMultiFilter(mf, frame.data(), frame.size(), buflen);
+    EXPECT_EQ(MatchSequential(frame, buflen), gate);
+    return gate;
+  }
+
+  std::vector<Filter> filters_;
+};
+
+TEST_F(MultiFilterTest, FirstMatchWins) {
+  AddFilter("ip", 1);
+  AddFilter("udp", 2);
+  AddFilter("arp", 0);
+
+  MultiFilter mf;
+  ASSERT_EQ(0, CompileMultiFilter(filters_, &mf));
+
+  EXPECT_EQ(1, Match(mf, MakeFrame(0x800, 17, 53)));
+  EXPECT_EQ(2, Match(mf, MakeFrame(0x86dd, 17, 53)));
+  EXPECT_EQ(0, Match(mf, MakeFrame(0x806)));
+  EXPECT_EQ(-1, Match(mf, MakeFrame(0x86dd, 6, 80)));
+  EXPECT_EQ(-1, Match(mf, MakeFrame(0x88cc)));
+
+  FreeMultiFilter(&mf);
+}
+
+TEST_F(MultiFilterTest, ManyFilters) {
+  for (int i = 0; i < 64; i++) {
+    AddFilter("tcp dst port " + std::to_string(1000 + i), i % 8 + 1);
+  }
+  AddFilter("udp", 9);
+  AddFilter("ip", 10);
+
+  MultiFilter mf;
+  ASSERT_EQ(0, CompileMultiFilter(filters_, &mf));
+
+  for (int i = 0; i < 64; i++) {
+    EXPECT_EQ(i % 8 + 1, Match(mf, MakeFrame(0x800, 6, 1000 + i)));
+    EXPECT_EQ(i % 8 + 1, Match(mf, MakeFrame(0x86dd, 6, 1000 + i)));
+  }
+  EXPECT_EQ(10, Match(mf, MakeFrame(0x800, 6, 80)));
+  EXPECT_EQ(-1, Match(mf, MakeFrame(0x86dd, 6, 80)));
+  EXPECT_EQ(9, Match(mf, MakeFrame(0x800, 17, 1000)));
+  EXPECT_EQ(9, Match(mf, MakeFrame(0x86dd, 17, 1000)));
+  EXPECT_EQ(-1, Match(mf, MakeFrame(0x806)));
+
+  FreeMultiFilter(&mf);
+}
+
+TEST_F(MultiFilterTest, OutOfBounds) {
+  AddFilter("tcp dst port 1000", 1);
+  AddFilter("ip", 2);
+
+  MultiFilter mf;
+  ASSERT_EQ(0, CompileMultiFilter(filters_, &mf));
+
+  // The TCP port (or the IP protocol) is cut off: the first filter fails,
+  // but the second one still gets to see the packet.
+  EXPECT_EQ(1, Match(mf, MakeFrame(0x800, 6, 1000)));
+  EXPECT_EQ(2, Match(mf, MakeFrame(0x800, 6, 1000), 36));
+  EXPECT_EQ(2, Match(mf, MakeFrame(0x800, 6, 1000), 20));
+
+  FreeMultiFilter(&mf);
+}
+
+TEST_F(MultiFilterTest, InvalidExpression) {
+  AddFilter("ip", 1);
+
+  Filter bad;
+  bad.exp = "no such filter";
+  bad.gate = 2;
+  filters_.push_back(bad);
+
+  MultiFilter mf;
+  EXPECT_EQ(-EINVAL, CompileMultiFilter(filters_, &mf));
+
+  filters_.pop_back();
+}
+
+}  // namespace
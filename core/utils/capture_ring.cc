@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "capture_ring.h"
+
+#include <limits.h>
+#include <poll.h>
+#include <time.h>
+
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+CaptureWriter::~CaptureWriter() {
+  // Stop Run() before the rings go away.
+  Terminate();
+  for (int i = 0; i < num_rings_; i++) {
+    delete rings_[i].load();
+  }
+}
+
+void CaptureWriter::AllocRings(const std::vector<bool> &producers) {
+  int n = std::min<int>(num_rings_, producers.size());
+  for (int i = 0; i < n; i++) {
+    if (producers[i] && !rings_[i].load(std::memory_order_relaxed)) {
+      rings_[i].store(new CaptureRing(ring_size_), std::memory_order_release);
+    }
+  }
+}
+
+uint64_t CaptureWriter::records() const {
+  uint64_t total = 0;
+  for (int i = 0; i < num_rings_; i++) {
+    const CaptureRing *ring = rings_[i].load(std::memory_order_acquire);
+    total += ring ? ring->records() : 0;
+  }
+  return total;
+}
+
+uint64_t CaptureWriter::bytes() const {
+  uint64_t total = 0;
+  for (int i = 0; i < num_rings_; i++) {
+    const CaptureRing *ring = rings_[i].load(std::memory_order_acquire);
+    total += ring ? ring->bytes() : 0;
+  }
+  return total;
+}
+
+uint64_t CaptureWriter::dropped() const {
+  uint64_t total = missed_.load(std::memory_order_relaxed);
+  for (int i = 0; i < num_rings_; i++) {
+    const CaptureRing *ring = rings_[i].load(std::memory_order_acquire);
+    total += ring ? ring->dropped() : 0;
+  }
+  return total;
+}
+
+bool CaptureWriter::WriteAll(int fd, struct iovec *vec, int cnt) {
+  while (cnt > 0) {
+    ssize_t ret = writev(fd, vec, std::min(cnt, IOV_MAX));
+    if (ret < 0) {
+      if (errno == EAGAIN) {
+        // The reader is behind: wait for room in the FIFO.
+        struct pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+        ppoll(&pfd, 1, nullptr, Sigmask());
+        if (IsExitRequested()) {
+          return false;
+        }
+        continue;
+      }
+      if (errno == EINTR) {
+        if (IsExitRequested()) {
+          return false;
+        }
+        continue;
+      }
+      return false;
+    }
+
+    // Skip over what was written, possibly stopping in the middle of a
+    // buffer.  The rest of that record goes out with the next writev(),
+    // before anything else, so the stream stays well-formed.
+    size_t done = ret;
+    while (cnt > 0 && done >= vec->iov_len) {
+      done -= vec->iov_len;
+      vec++;
+      cnt--;
+    }
+    if (cnt > 0) {
+      vec->iov_base = static_cast<char *>(vec->iov_base) + done;
+      vec->iov_len -= done;
+    }
+  }
+  return true;
+}
+
+void CaptureWriter::Run() {
+  std::vector<struct iovec> vec(num_rings_ * 2);
+  std::vector<size_t> lens(num_rings_);
+
+  while (!IsExitRequested()) {
+    int cnt = 0;
+    size_t total = 0;
+
+    for (int i = 0; i < num_rings_; i++) {
+      CaptureRing *ring = rings_[i].load(std::memory_order_acquire);
+      lens[i] = 0;
+      if (ring) {
+        cnt += ring->Peek(&vec[cnt], &lens[i]);
+        total += lens[i];
+      }
+    }
+
+    if (total == 0) {
+      struct timespec idle = {.tv_sec = 0, .tv_nsec = kIdleNs};
+      ppoll(nullptr, 0, &idle, Sigmask());
+      continue;
+    }
+
+    int fd;
+    uint32_t gen;
+    std::tie(fd, gen) = opener_->GetCurrentFd();
+    if (opener_->IsValidFd(fd) && !WriteAll(fd, vec.data(), cnt)) {
+      if (IsExitRequested()) {
+        break;
+      }
+      if (errno == EPIPE) {
+        LOG(WARNING) << "Broken pipe: stopping capture";
+        opener_->MarkDead(fd, gen);
+      }
+    }
+
+    // Records that could not be written (no reader, or a broken pipe) are
+    // discarded, just as in the synchronous path.
+    for (int i = 0; i < num_rings_; i++) {
+      if (lens[i]) {
+        rings_[i].load(std::memory_order_relaxed)->Consume(lens[i]);
+      }
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
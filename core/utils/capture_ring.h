@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_CAPTURE_RING_H_
+#define BESS_UTILS_CAPTURE_RING_H_
+
+#include <glog/logging.h>
+#include <sys/uio.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "common.h"
+#include "fifo_opener.h"
+#include "syscallthread.h"
+
+namespace bess {
+namespace utils {
+
+// A single-producer, single-consumer byte ring for captured packet records.
+//
+// The producer (a worker thread) copies whole records in with Push(), which
+// never blocks: if the record does not fit, it is counted as a drop.  The
+// consumer (the CaptureWriter thread) looks at everything published so far
+// with Peek() and releases it with Consume() once written out.  Since the
+// tail only ever advances by whole records, the consumer never sees half a
+// record.
+class CaptureRing {
+ public:
+  static const size_t kDefaultSize = 4 * 1024 * 1024;
+
+  // `size` (in bytes) must be a power of two.
+  explicit CaptureRing(size_t size = kDefaultSize)
+      : head_(0),
+        tail_(0),
+        records_(0),
+        bytes_(0),
+        dropped_(0),
+        size_(size),
+        mask_(size - 1),
+        buf_(new char[size]) {
+    CHECK(size > 0 && (size & (size - 1)) == 0);
+  }
+
+  // Producer only.  Copies the `iovcnt` buffers in `iov` as one record.
+  // Returns false (and counts a drop) if there is not enough room.
+  bool Push(const struct iovec *iov, int iovcnt) {
+    size_t len = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      len += iov[i].iov_len;
+    }
+
+    uint64_t tail = tail_.load(std::memory_order_relaxed);
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (size_ - (tail - head) < len) {
+      dropped_.store(dropped_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+      return false;
+    }
+
+    uint64_t pos = tail;
+    for (int i = 0; i < iovcnt; i++) {
+      Copy(pos, iov[i].iov_base, iov[i].iov_len);
+      pos += iov[i].iov_len;
+    }
+    tail_.store(pos, std::memory_order_release);
+
+    records_.store(records_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    bytes_.store(bytes_.load(std::memory_order_relaxed) + len,
+                 std::memory_order_relaxed);
+    return true;
+  }
+
+  // Consumer only.  Fills `vec` with up to two buffers (the ring may wrap)
+  // covering all published bytes, and returns how many of them were used.
+  // `*len` is set to the total number of bytes.
+  int Peek(struct iovec vec[2], size_t *len) const {
+    uint64_t head = head_.load(std::memory_order_relaxed);
+    uint64_t tail = tail_.load(std::memory_order_acquire);
+    size_t off = head & mask_;
+
+    *len = tail - head;
+    if (*len == 0) {
+      return 0;
+    }
+
+    size_t first = std::min(*len, size_ - off);
+    vec[0] = {buf_.get() + off, first};
+    if (first == *len) {
+      return 1;
+    }
+    vec[1] = {buf_.get(), *len - first};
+    return 2;
+  }
+
+  // Consumer only.  Releases `len` bytes previously returned by Peek().
+  void Consume(size_t len) {
+    head_.store(head_.load(std::memory_order_relaxed) + len,
+                std::memory_order_release);
+  }
+
+  // Number of records pushed, bytes pushed and records dropped.  These are
+  // only updated by the producer, so they are approximate from any other
+  // thread.
+  uint64_t records() const { return records_.load(std::memory_order_relaxed); }
+  uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+  size_t size() const { return size_; }
+
+ private:
+  void Copy(uint64_t pos, const void *src, size_t len) {
+    size_t off = pos & mask_;
+    size_t first = std::min(len, size_ - off);
+    memcpy(buf_.get() + off, src, first);
+    if (first < len) {
+      memcpy(buf_.get(), static_cast<const char *>(src) + first, len - first);
+    }
+  }
+
+  // The consumer writes head_ and the producer writes tail_ and the counters.
+  alignas(64) std::atomic<uint64_t> head_;
+  alignas(64) std::atomic<uint64_t> tail_;
+  std::atomic<uint64_t> records_;
+  std::atomic<uint64_t> bytes_;
+  std::atomic<uint64_t> dropped_;
+
+  alignas(64) const size_t size_;
+  const uint64_t mask_;
+  std::unique_ptr<char[]> buf_;
+};
+
+// A background thread that drains a set of CaptureRings (typically one per
+// worker) into the FIFO of a FifoOpener.  Each round gathers everything that
+// is pending in all rings into one writev(), so the FIFO sees few, large
+// writes instead of one per packet.
+//
+// The writer only blocks in ppoll(), so it is a SyscallThreadPfuncs.
+class CaptureWriter final : public bess::utils::SyscallThreadPfuncs {
+ public:
+  CaptureWriter(FifoOpener *opener, int num_rings, size_t ring_size)
+      : opener_(opener),
+        num_rings_(num_rings),
+        ring_size_(ring_size),
+        rings_(new std::atomic<CaptureRing *>[num_rings]),
+        missed_(0) {
+    for (int i = 0; i < num_rings_; i++) {
+      rings_[i] = nullptr;
+    }
+  }
+
+  ~CaptureWriter();
+
+  // Allocates a ring for each producer `i` with `producers[i]` set, unless it
+  // already has one.  Rings are large, so this is for the control path: call
+  // it before the producers start pushing.
+  void AllocRings(const std::vector<bool> &producers);
+
+  // Returns the ring for producer `i`, or nullptr if AllocRings() did not
+  // set one up.  Records of such a producer go to CountMissed() instead.
+  CaptureRing *GetRing(int i) const {
+    return rings_[i].load(std::memory_order_acquire);
+  }
+
+  // Counts `n` records dropped because their producer has no ring.  These
+  // are included in dropped().
+  void CountMissed(uint64_t n) {
+    missed_.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  // Totals over all rings.
+  uint64_t records() const;
+  uint64_t bytes() const;
+  uint64_t dropped() const;
+
+  void Run() override;
+
+ private:
+  // How long to sleep when all rings are empty.
+  static const long kIdleNs = 100 * 1000;
+
+  // Writes all of `vec` to `fd`, waiting for the reader if the FIFO is full.
+  // Returns false if the FIFO broke or we were asked to exit.
+  bool WriteAll(int fd, struct iovec *vec, int cnt);
+
+  FifoOpener *opener_;
+  const int num_rings_;
+  const size_t ring_size_;
+  std::unique_ptr<std::atomic<CaptureRing *>[]> rings_;
+  std::atomic<uint64_t> missed_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_CAPTURE_RING_H_
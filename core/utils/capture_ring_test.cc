@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "capture_ring.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+namespace {
+
+using bess::utils::CaptureRing;
+using bess::utils::CaptureWriter;
+using bess::utils::FifoOpener;
+
+// The writer is never started, so the FIFO is never opened.
+class NullOpener final : public FifoOpener {
+ public:
+  bool InitFifo(int) override { return true; }
+};
+
+std::string Drain(CaptureRing *ring) {
+  struct iovec vec[2];
+  size_t len;
+  int cnt = ring->Peek(vec, &len);
+  std::string out;
+  for (int i = 0; i < cnt; i++) {
+    out.append(static_cast<const char *>(vec[i].iov_base), vec[i].iov_len);
+  }
+  EXPECT_EQ(len, out.size());
+  ring->Consume(len);
+  return out;
+}
+
+// Buffers of one Push() come out back to back, as a single record.
+TEST(CaptureRingTest, PushPeekConsume) {
+  CaptureRing ring(64);
+  char hdr[] = "hdr:";
+  char data[] = "payload";
+  struct iovec vec[2] = {{hdr, 4}, {data, 7}};
+
+  ASSERT_TRUE(ring.Push(vec, 2));
+  ASSERT_TRUE(ring.Push(vec, 1));
+  EXPECT_EQ("hdr:payloadhdr:", Drain(&ring));
+  EXPECT_EQ("", Drain(&ring));
+
+  EXPECT_EQ(2, ring.records());
+  EXPECT_EQ(15, ring.bytes());
+  EXPECT_EQ(0, ring.dropped());
+}
+
+// Records that straddle the end of the buffer are split in two iovecs.
+TEST(CaptureRingTest, Wraparound) {
+  CaptureRing ring(16);
+  char a[] = "0123456789";
+  char b[] = "abcdefghij";
+  struct iovec va = {a, 10};
+  struct iovec vb = {b, 10};
+
+  ASSERT_TRUE(ring.Push(&va, 1));
+  EXPECT_EQ("0123456789", Drain(&ring));
+
+  ASSERT_TRUE(ring.Push(&vb, 1));
+  struct iovec vec[2];
+  size_t len;
+  EXPECT_EQ(2, ring.Peek(vec, &len));
+  EXPECT_EQ(10, len);
+  EXPECT_EQ(6, vec[0].iov_len);
+  EXPECT_EQ("abcdefghij", Drain(&ring));
+}
+
+// A full ring drops whole records and never overwrites unread data.
+TEST(CaptureRingTest, DropWhenFull) {
+  CaptureRing ring(16);
+  char a[] = "0123456789";
+  struct iovec va = {a, 10};
+
+  ASSERT_TRUE(ring.Push(&va, 1));
+  EXPECT_FALSE(ring.Push(&va, 1));
+  EXPECT_EQ(1, ring.dropped());
+  EXPECT_EQ("0123456789", Drain(&ring));
+
+  EXPECT_TRUE(ring.Push(&va, 1));
+  EXPECT_EQ(2, ring.records());
+  EXPECT_EQ(1, ring.dropped());
+}
+
+// Rings only exist for the producers they were allocated for, and records
+// of the other producers are counted as dropped.
+TEST(CaptureWriterTest, AllocRings) {
+  NullOpener opener;
+  CaptureWriter writer(&opener, 4, 64);
+
+  writer.AllocRings({false, true, false, true});
+  EXPECT_EQ(nullptr, writer.GetRing(0));
+  ASSERT_NE(nullptr, writer.GetRing(1));
+  EXPECT_EQ(nullptr, writer.GetRing(2));
+  ASSERT_NE(nullptr, writer.GetRing(3));
+  EXPECT_EQ(64, writer.GetRing(1)->size());
+
+  // Existing rings are kept.
+  CaptureRing *ring = writer.GetRing(1);
+  writer.AllocRings({true, true});
+  EXPECT_NE(nullptr, writer.GetRing(0));
+  EXPECT_EQ(ring, writer.GetRing(1));
+
+  char a[] = "0123456789";
+  struct iovec va = {a, 10};
+  ASSERT_TRUE(ring->Push(&va, 1));
+  writer.CountMissed(3);
+  EXPECT_EQ(1, writer.records());
+  EXPECT_EQ(10, writer.bytes());
+  EXPECT_EQ(3, writer.dropped());
+}
+
+}  // namespace
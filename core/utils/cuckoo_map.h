@@ -61,6 +61,11 @@ namespace utils {
 typedef uint32_t HashResult;
 typedef uint32_t EntryIndex;
 
+// Maximum number of keys for a single lookup_bulk_data() call, i.e., the
+// number of bits in its hit mask.
+static const int kMaxBulkLookup = RTE_HASH_LOOKUP_BULK_MAX;
+static_assert(kMaxBulkLookup == 64, "hit masks are uint64_t");
+
 // A Hash table implementation using cuckoo hashing
 //
 // Example usage:
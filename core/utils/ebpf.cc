@@ -0,0 +1,640 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#include "format.h"
+
+namespace bess {
+namespace utils {
+
+EbpfMap::EbpfMap(const EbpfMapSpec &spec)
+    : spec_(spec),
+      values_(size_t{spec.max_entries} * spec.value_size),
+      key_buf_(spec.key_size, '\0') {
+  if (spec_.type == EbpfMapSpec::kHash) {
+    slots_.reserve(spec_.max_entries);
+    for (uint32_t i = spec_.max_entries; i > 0; i--) {
+      free_slots_.push_back(i - 1);
+    }
+  }
+}
+
+uint8_t *EbpfMap::Lookup(const uint8_t *key) {
+  if (spec_.type == EbpfMapSpec::kArray) {
+    uint32_t idx;
+    memcpy(&idx, key, sizeof(idx));
+    if (idx >= spec_.max_entries) {
+      return nullptr;
+    }
+    return &values_[size_t{idx} * spec_.value_size];
+  }
+
+  key_buf_.assign(reinterpret_cast<const char *>(key), spec_.key_size);
+  auto it = slots_.find(key_buf_);
+  if (it == slots_.end()) {
+    return nullptr;
+  }
+  return &values_[size_t{it->second} * spec_.value_size];
+}
+
+int EbpfMap::Update(const uint8_t *key, const uint8_t *value,
+                    uint64_t flags) {
+  if (flags > ebpf::kExist) {
+    return -EINVAL;
+  }
+
+  uint8_t *dst = Lookup(key);
+  if (spec_.type == EbpfMapSpec::kArray) {
+    if (!dst) {
+      return -E2BIG;
+    } else if (flags == ebpf::kNoExist) {
+      return -EEXIST;
+    }
+  } else if (dst) {
+    if (flags == ebpf::kNoExist) {
+      return -EEXIST;
+    }
+  } else {
+    if (flags == ebpf::kExist) {
+      return -ENOENT;
+    } else if (free_slots_.empty()) {
+      return -E2BIG;
+    }
+    // key_buf_ still holds the key, from Lookup()
+    uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    slots_.emplace(key_buf_, slot);
+    dst = &values_[size_t{slot} * spec_.value_size];
+  }
+
+  memmove(dst, value, spec_.value_size);
+  return 0;
+}
+
+int EbpfMap::Delete(const uint8_t *key) {
+  if (spec_.type == EbpfMapSpec::kArray) {
+    return -EINVAL;
+  }
+
+  key_buf_.assign(reinterpret_cast<const char *>(key), spec_.key_size);
+  auto it = slots_.find(key_buf_);
+  if (it == slots_.end()) {
+    return -ENOENT;
+  }
+
+  free_slots_.push_back(it->second);
+  slots_.erase(it);
+  return 0;
+}
+
+static bool IsConditionalJump(uint8_t op) {
+  switch (op) {
+    case ebpf::kJeq:
+    case ebpf::kJgt:
+    case ebpf::kJge:
+    case ebpf::kJset:
+    case ebpf::kJne:
+    case ebpf::kJsgt:
+    case ebpf::kJsge:
+    case ebpf::kJlt:
+    case ebpf::kJle:
+    case ebpf::kJslt:
+    case ebpf::kJsle:
+      return true;
+    default:
+      return false;
+  }
+}
+
+Error EbpfProgram::Load(const std::string &code,
+                        const std::vector<EbpfMapSpec> &maps,
+                        const std::map<int32_t, EbpfHelper> &helpers) {
+  using namespace ebpf;
+
+  if (code.size() % sizeof(EbpfInsn) != 0) {
+    return MakeError(EINVAL, "code size must be a multiple of 8 bytes");
+  }
+
+  size_t n = code.size() / sizeof(EbpfInsn);
+  if (n == 0 || n > kMaxInsns) {
+    return MakeError(EINVAL, Format("program must have 1-%zu instructions",
+                                    kMaxInsns));
+  }
+
+  for (const EbpfMapSpec &spec : maps) {
+    if (spec.key_size == 0 || spec.value_size == 0 || spec.max_entries == 0) {
+      return MakeError(EINVAL,
+                       Format("map '%s': sizes must be non-zero",
+                              spec.name.c_str()));
+    }
+    if (spec.type == EbpfMapSpec::kArray && spec.key_size != 4) {
+      return MakeError(EINVAL, Format("map '%s': array keys must be 4 bytes",
+                                      spec.name.c_str()));
+    }
+    if (spec.type != EbpfMapSpec::kArray && spec.type != EbpfMapSpec::kHash) {
+      return MakeError(EINVAL, Format("map '%s': unknown type %d",
+                                      spec.name.c_str(), spec.type));
+    }
+    if (uint64_t{spec.value_size} * spec.max_entries > (1ull << 30)) {
+      return MakeError(EINVAL, Format("map '%s' is too large",
+                                      spec.name.c_str()));
+    }
+  }
+
+  std::vector<EbpfInsn> insns(n);
+  memcpy(insns.data(), code.data(), code.size());
+  std::vector<EbpfHelper> call_fns(n);
+
+  // Second halves of 64-bit immediate loads, which are not instructions
+  std::vector<bool> imm_hi(n);
+  for (size_t pc = 0; pc < n; pc++) {
+    if (insns[pc].code == (kLd | kImm | kDW)) {
+      if (pc + 1 == n) {
+        return MakeError(EINVAL, Format("pc %zu: truncated instruction", pc));
+      }
+      imm_hi[++pc] = true;
+    }
+  }
+
+  for (size_t pc = 0; pc < n; pc++) {
+    const EbpfInsn &insn = insns[pc];
+    uint8_t cls = insn.code & 0x07;
+    uint8_t op = insn.code & 0xf0;
+    uint8_t size = insn.code & 0x18;
+    uint8_t mode = insn.code & 0xe0;
+
+    if (imm_hi[pc]) {
+      if (insn.code != 0 || insn.dst != 0 || insn.src != 0 || insn.off != 0) {
+        return MakeError(EINVAL, Format("pc %zu: invalid 64-bit load", pc));
+      }
+      continue;
+    }
+
+    if (insn.dst > 10 || insn.src > 10) {
+      return MakeError(EINVAL, Format("pc %zu: invalid register", pc));
+    }
+    if (insn.dst == 10 &&
+        (cls == kAlu || cls == kAlu64 || cls == kLd || cls == kLdx)) {
+      return MakeError(EINVAL, Format("pc %zu: r10 is read-only", pc));
+    }
+
+    bool valid;
+    switch (cls) {
+      case kAlu:
+      case kAlu64:
+        valid = op <= kArsh || (op == kEnd && cls == kAlu);
+        if (op == kEnd) {
+          valid = valid && (insn.imm == 16 || insn.imm == 32 || insn.imm == 64);
+        }
+        if ((op == kDiv || op == kMod) && !(insn.code & kX) && insn.imm == 0) {
+          return MakeError(EINVAL, Format("pc %zu: division by zero", pc));
+        }
+        break;
+
+      case kJmp:
+      case kJmp32:
+        if (op == kCall) {
+          valid = cls == kJmp && !(insn.code & kX);
+          if (valid && insn.imm != kMapLookupElem &&
+              insn.imm != kMapUpdateElem && insn.imm != kMapDeleteElem) {
+            auto it = helpers.find(insn.imm);
+            if (it == helpers.end()) {
+              return MakeError(EINVAL, Format("pc %zu: unknown helper %d", pc,
+                                              insn.imm));
+            }
+            call_fns[pc] = it->second;
+          }
+          break;
+        } else if (op == kExit) {
+          valid = cls == kJmp && !(insn.code & kX);
+          break;
+        }
+
+        valid = IsConditionalJump(op) || (op == kJa && cls == kJmp);
+        if (valid) {
+          // No loops: every program terminates
+          if (insn.off < 0) {
+            return MakeError(EINVAL, Format("pc %zu: backward jump", pc));
+          }
+          size_t target = pc + 1 + insn.off;
+          if (target >= n || imm_hi[target]) {
+            return MakeError(EINVAL, Format("pc %zu: invalid jump", pc));
+          }
+        }
+        break;
+
+      case kLd:
+        valid = insn.code == (kLd | kImm | kDW) &&
+                (insn.src == 0 || insn.src == kPseudoMap);
+        if (valid && insn.src == kPseudoMap &&
+            (insn.imm < 0 || static_cast<size_t>(insn.imm) >= maps.size())) {
+          return MakeError(EINVAL, Format("pc %zu: invalid map %d", pc,
+                                          insn.imm));
+        }
+        break;
+
+      case kLdx:
+      case kSt:
+        valid = mode == kMem;
+        break;
+
+      case kStx:
+        // Atomic add, optionally fetching the old value into src
+        valid = mode == kMem ||
+                (mode == kAtomic && (size == kW || size == kDW) &&
+                 (insn.imm == kAdd || insn.imm == (kAdd | 0x01)));
+        break;
+
+      default:
+        valid = false;
+    }
+
+    if (!valid) {
+      return MakeError(EINVAL, Format("pc %zu: invalid opcode 0x%02x", pc,
+                                      insn.code));
+    }
+  }
+
+  if (insns[n - 1].code != (kJmp | kExit) || imm_hi[n - 1]) {
+    return MakeError(EINVAL, "program must end with exit");
+  }
+
+  insns_ = std::move(insns);
+  maps_ = maps;
+  call_fns_ = std::move(call_fns);
+  return MakeError(0);
+}
+
+Error EbpfProgram::CreateMaps(std::vector<EbpfMap> *maps) const {
+  maps->clear();
+  try {
+    maps->reserve(maps_.size());
+    for (const EbpfMapSpec &spec : maps_) {
+      maps->emplace_back(spec);
+    }
+  } catch (const std::bad_alloc &) {
+    maps->clear();
+    return std::make_pair(ENOMEM, "cannot allocate the maps");
+  }
+  return std::make_pair(0, "");
+}
+
+template <typename T>
+static inline T LoadMem(uint64_t addr) {
+  T val;
+  memcpy(&val, reinterpret_cast<const void *>(addr), sizeof(val));
+  return val;
+}
+
+template <typename T>
+static inline void StoreMem(uint64_t addr, T val) {
+  memcpy(reinterpret_cast<void *>(addr), &val, sizeof(val));
+}
+
+static inline size_t AccessSize(uint8_t size) {
+  switch (size) {
+    case ebpf::kB:
+      return 1;
+    case ebpf::kH:
+      return 2;
+    case ebpf::kW:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+static inline uint64_t Alu64(uint8_t op, uint64_t dst, uint64_t src) {
+  using namespace ebpf;
+
+  switch (op) {
+    case kAdd:
+      return dst + src;
+    case kSub:
+      return dst - src;
+    case kMul:
+      return dst * src;
+    case kDiv:
+      return src ? dst / src : 0;
+    case kOr:
+      return dst | src;
+    case kAnd:
+      return dst & src;
+    case kLsh:
+      return dst << (src & 63);
+    case kRsh:
+      return dst >> (src & 63);
+    case kNeg:
+      return -dst;
+    case kMod:
+      return src ? dst % src : dst;
+    case kXor:
+      return dst ^ src;
+    case kMov:
+      return src;
+    default:  // kArsh
+      return static_cast<int64_t>(dst) >> (src & 63);
+  }
+}
+
+static inline uint32_t Alu32(uint8_t op, uint32_t dst, uint32_t src) {
+  using namespace ebpf;
+
+  switch (op) {
+    case kAdd:
+      return dst + src;
+    case kSub:
+      return dst - src;
+    case kMul:
+      return dst * src;
+    case kDiv:
+      return src ? dst / src : 0;
+    case kOr:
+      return dst | src;
+    case kAnd:
+      return dst & src;
+    case kLsh:
+      return dst << (src & 31);
+    case kRsh:
+      return dst >> (src & 31);
+    case kNeg:
+      return -dst;
+    case kMod:
+      return src ? dst % src : dst;
+    case kXor:
+      return dst ^ src;
+    case kMov:
+      return src;
+    default:  // kArsh
+      return static_cast<int32_t>(dst) >> (src & 31);
+  }
+}
+
+// Byte swaps of kEnd. The host is little endian, so only conversions to big
+// endian (kX) swap; those to little endian just truncate.
+static inline uint64_t ConvertEndian(bool to_be, int32_t bits, uint64_t v) {
+  switch (bits) {
+    case 16:
+      return to_be ? __builtin_bswap16(v) : static_cast<uint16_t>(v);
+    case 32:
+      return to_be ? __builtin_bswap32(v) : static_cast<uint32_t>(v);
+    default:
+      return to_be ? __builtin_bswap64(v) : v;
+  }
+}
+
+static inline bool JumpTaken(uint8_t op, bool is_32, uint64_t a, uint64_t b) {
+  using namespace ebpf;
+
+  int64_t sa = a;
+  int64_t sb = b;
+  if (is_32) {
+    a = static_cast<uint32_t>(a);
+    b = static_cast<uint32_t>(b);
+    sa = static_cast<int32_t>(a);
+    sb = static_cast<int32_t>(b);
+  }
+
+  switch (op) {
+    case kJeq:
+      return a == b;
+    case kJgt:
+      return a > b;
+    case kJge:
+      return a >= b;
+    case kJset:
+      return a & b;
+    case kJne:
+      return a != b;
+    case kJsgt:
+      return sa > sb;
+    case kJsge:
+      return sa >= sb;
+    case kJlt:
+      return a < b;
+    case kJle:
+      return a <= b;
+    case kJslt:
+      return sa < sb;
+    default:  // kJsle
+      return sa <= sb;
+  }
+}
+
+bool EbpfProgram::Run(std::vector<EbpfMap> *maps, const void *ctx,
+                      size_t ctx_size, void *pkt, size_t pkt_size,
+                      void *helper_arg, uint64_t *ret) const {
+  using namespace ebpf;
+
+  // Zeroed, so that a program cannot read what the previous run left there
+  alignas(8) uint8_t stack[kStackSize] = {};
+  uint64_t reg[11] = {};
+
+  const uintptr_t stack_addr = reinterpret_cast<uintptr_t>(stack);
+  const uintptr_t ctx_addr = reinterpret_cast<uintptr_t>(ctx);
+  const uintptr_t pkt_addr = reinterpret_cast<uintptr_t>(pkt);
+  const uintptr_t maps_addr = reinterpret_cast<uintptr_t>(maps->data());
+
+  reg[1] = ctx_addr;
+  reg[10] = stack_addr + kStackSize;
+
+  // Is [addr, addr + size) accessible? (size is at most 8)
+  auto accessible = [&](uint64_t addr, size_t size, bool write) {
+    if (addr - stack_addr <= kStackSize - size ||
+        (size <= pkt_size && addr - pkt_addr <= pkt_size - size) ||
+        (!write && size <= ctx_size && addr - ctx_addr <= ctx_size - size)) {
+      return true;
+    }
+    for (const EbpfMap &map : *maps) {
+      if (map.IsValueRange(addr, size)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Same for the keys and values given to map helpers, of any size
+  auto accessible_buf = [&](uint64_t addr, size_t size) {
+    if ((size <= kStackSize && addr - stack_addr <= kStackSize - size) ||
+        (size <= pkt_size && addr - pkt_addr <= pkt_size - size)) {
+      return true;
+    }
+    for (const EbpfMap &map : *maps) {
+      if (map.IsValueRange(addr, size)) {
+        return true;
+      }
+    }
+    return false;
+  };
+
+  // Map handles are the addresses of the elements of *maps
+  auto to_map = [&](uint64_t handle) -> EbpfMap * {
+    uint64_t off = handle - maps_addr;
+    if (off % sizeof(EbpfMap) != 0 || off / sizeof(EbpfMap) >= maps->size()) {
+      return nullptr;
+    }
+    return &(*maps)[off / sizeof(EbpfMap)];
+  };
+
+  for (size_t pc = 0;; pc++) {
+    const EbpfInsn &insn = insns_[pc];
+    uint64_t &dst = reg[insn.dst];
+    uint8_t cls = insn.code & 0x07;
+    uint8_t op = insn.code & 0xf0;
+    uint8_t size = insn.code & 0x18;
+    uint64_t src = (insn.code & kX) ? reg[insn.src]
+                                     : static_cast<int64_t>(insn.imm);
+
+    switch (cls) {
+      case kAlu64:
+        dst = Alu64(op, dst, src);
+        break;
+
+      case kAlu:
+        if (op == kEnd) {
+          dst = ConvertEndian(insn.code & kX, insn.imm, dst);
+        } else {
+          dst = Alu32(op, dst, src);
+        }
+        break;
+
+      case kJmp:
+      case kJmp32:
+        if (op == kExit) {
+          *ret = reg[0];
+          return true;
+        } else if (op == kJa) {
+          pc += insn.off;
+        } else if (op != kCall) {
+          if (JumpTaken(op, cls == kJmp32, dst, src)) {
+            pc += insn.off;
+          }
+        } else if (call_fns_[pc]) {
+          reg[0] = call_fns_[pc](helper_arg, reg[1], reg[2], reg[3], reg[4],
+                                 reg[5]);
+        } else {
+          EbpfMap *map = to_map(reg[1]);
+          if (!map || !accessible_buf(reg[2], map->spec().key_size)) {
+            return false;
+          }
+          const uint8_t *key = reinterpret_cast<const uint8_t *>(reg[2]);
+
+          if (insn.imm == kMapLookupElem) {
+            reg[0] = reinterpret_cast<uintptr_t>(map->Lookup(key));
+          } else if (insn.imm == kMapUpdateElem) {
+            if (!accessible_buf(reg[3], map->spec().value_size)) {
+              return false;
+            }
+            reg[0] = map->Update(
+                key, reinterpret_cast<const uint8_t *>(reg[3]), reg[4]);
+          } else {
+            reg[0] = map->Delete(key);
+          }
+        }
+        break;
+
+      case kLd:
+        // A 64-bit immediate, the only kind Load() lets through
+        if (insn.src == kPseudoMap) {
+          dst = maps_addr + insn.imm * sizeof(EbpfMap);
+        } else {
+          dst = static_cast<uint32_t>(insn.imm) |
+                (uint64_t{static_cast<uint32_t>(insns_[pc + 1].imm)} << 32);
+        }
+        pc++;
+        break;
+
+      case kLdx: {
+        uint64_t addr = reg[insn.src] + insn.off;
+        if (!accessible(addr, AccessSize(size), false)) {
+          return false;
+        }
+        switch (size) {
+          case kB:
+            dst = LoadMem<uint8_t>(addr);
+            break;
+          case kH:
+            dst = LoadMem<uint16_t>(addr);
+            break;
+          case kW:
+            dst = LoadMem<uint32_t>(addr);
+            break;
+          default:
+            dst = LoadMem<uint64_t>(addr);
+        }
+        break;
+      }
+
+      default: {  // kSt, kStx
+        uint64_t addr = dst + insn.off;
+        uint64_t val = (cls == kSt) ? static_cast<int64_t>(insn.imm)
+                                    : reg[insn.src];
+        if (!accessible(addr, AccessSize(size), true)) {
+          return false;
+        }
+
+        if ((insn.code & 0xe0) == kAtomic) {
+          // Maps are not shared between threads, so this need not be atomic
+          uint64_t old = (size == kW) ? LoadMem<uint32_t>(addr)
+                                      : LoadMem<uint64_t>(addr);
+          if (size == kW) {
+            StoreMem<uint32_t>(addr, old + val);
+          } else {
+            StoreMem<uint64_t>(addr, old + val);
+          }
+          if (insn.imm & 0x01) {  // BPF_FETCH
+            reg[insn.src] = old;
+          }
+          break;
+        }
+
+        switch (size) {
+          case kB:
+            StoreMem<uint8_t>(addr, val);
+            break;
+          case kH:
+            StoreMem<uint16_t>(addr, val);
+            break;
+          case kW:
+            StoreMem<uint32_t>(addr, val);
+            break;
+          default:
+            StoreMem<uint64_t>(addr, val);
+        }
+      }
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_EBPF_H_
+#define BESS_UTILS_EBPF_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+using Error = std::pair<int, std::string>;
+
+// An eBPF instruction, as in the kernel's struct bpf_insn (which is not used
+// here since it clashes with the classic BPF one of libpcap).
+struct EbpfInsn {
+  uint8_t code;
+  uint8_t dst : 4;
+  uint8_t src : 4;
+  int16_t off;
+  int32_t imm;
+};
+
+static_assert(sizeof(EbpfInsn) == 8, "struct EbpfInsn is incorrect");
+
+// Opcode fields of eBPF instructions (see the kernel's
+// Documentation/bpf/instruction-set.rst)
+namespace ebpf {
+
+// Instruction classes
+const uint8_t kLd = 0x00;
+const uint8_t kLdx = 0x01;
+const uint8_t kSt = 0x02;
+const uint8_t kStx = 0x03;
+const uint8_t kAlu = 0x04;
+const uint8_t kJmp = 0x05;
+const uint8_t kJmp32 = 0x06;
+const uint8_t kAlu64 = 0x07;
+
+// Source operand of ALU and jump instructions
+const uint8_t kK = 0x00;
+const uint8_t kX = 0x08;
+
+// Sizes and modes of load and store instructions
+const uint8_t kW = 0x00;
+const uint8_t kH = 0x08;
+const uint8_t kB = 0x10;
+const uint8_t kDW = 0x18;
+const uint8_t kImm = 0x00;
+const uint8_t kMem = 0x60;
+const uint8_t kAtomic = 0xc0;
+
+// ALU operations
+const uint8_t kAdd = 0x00;
+const uint8_t kSub = 0x10;
+const uint8_t kMul = 0x20;
+const uint8_t kDiv = 0x30;
+const uint8_t kOr = 0x40;
+const uint8_t kAnd = 0x50;
+const uint8_t kLsh = 0x60;
+const uint8_t kRsh = 0x70;
+const uint8_t kNeg = 0x80;
+const uint8_t kMod = 0x90;
+const uint8_t kXor = 0xa0;
+const uint8_t kMov = 0xb0;
+const uint8_t kArsh = 0xc0;
+const uint8_t kEnd = 0xd0;  // kK: to little endian, kX: to big endian
+
+// Jump operations
+const uint8_t kJa = 0x00;
+const uint8_t kJeq = 0x10;
+const uint8_t kJgt = 0x20;
+const uint8_t kJge = 0x30;
+const uint8_t kJset = 0x40;
+const uint8_t kJne = 0x50;
+const uint8_t kJsgt = 0x60;
+const uint8_t kJsge = 0x70;
+const uint8_t kCall = 0x80;
+const uint8_t kExit = 0x90;
+const uint8_t kJlt = 0xa0;
+const uint8_t kJle = 0xb0;
+const uint8_t kJslt = 0xc0;
+const uint8_t kJsle = 0xd0;
+
+// src of a 64-bit immediate load whose imm is a map index
+const uint8_t kPseudoMap = 1;
+
+// Built-in helpers, numbered as in the kernel
+const int32_t kMapLookupElem = 1;
+const int32_t kMapUpdateElem = 2;
+const int32_t kMapDeleteElem = 3;
+
+// Flags of kMapUpdateElem
+const uint64_t kAny = 0;
+const uint64_t kNoExist = 1;
+const uint64_t kExist = 2;
+
+}  // namespace ebpf
+
+struct EbpfMapSpec {
+  enum Type {
+    kArray = 0,  // keys are uint32_t indices, all entries exist
+    kHash = 1,
+  };
+
+  std::string name;
+  Type type;
+  uint32_t key_size;
+  uint32_t value_size;
+  uint32_t max_entries;
+};
+
+// One instance of an eBPF map. Values are kept in a single buffer, so that
+// pointers into it (handed out to programs by lookups) can be checked
+// quickly and stay valid until the entry is deleted.
+class EbpfMap {
+ public:
+  explicit EbpfMap(const EbpfMapSpec &spec);
+
+  // Returns the value for `key` (spec().key_size bytes) or nullptr.
+  uint8_t *Lookup(const uint8_t *key);
+
+  // Returns 0, or -ENOENT, -EEXIST (depending on flags), -E2BIG if the map
+  // is full, or -EINVAL.
+  int Update(const uint8_t *key, const uint8_t *value, uint64_t flags);
+
+  // Returns 0 or -ENOENT. Array entries cannot be deleted (-EINVAL).
+  int Delete(const uint8_t *key);
+
+  // Calls f(key, value) for every entry.
+  template <typename F>
+  void ForEach(F f) const;
+
+  const EbpfMapSpec &spec() const { return spec_; }
+
+  // True if [addr, addr + size) lies within one value
+  bool IsValueRange(uintptr_t addr, size_t size) const {
+    uintptr_t base = reinterpret_cast<uintptr_t>(values_.data());
+    return addr >= base && addr - base < values_.size() &&
+           (addr - base) % spec_.value_size + size <= spec_.value_size;
+  }
+
+ private:
+  EbpfMapSpec spec_;
+  std::vector<uint8_t> values_;  // max_entries * value_size bytes
+
+  // kHash only: slots of values_ by key, and unused slots
+  std::unordered_map<std::string, uint32_t> slots_;
+  std::vector<uint32_t> free_slots_;
+  std::string key_buf_;  // to look up slots_ without allocating
+};
+
+template <typename F>
+void EbpfMap::ForEach(F f) const {
+  if (spec_.type == EbpfMapSpec::kArray) {
+    for (uint32_t i = 0; i < spec_.max_entries; i++) {
+      f(reinterpret_cast<const uint8_t *>(&i),
+        &values_[size_t{i} * spec_.value_size]);
+    }
+  } else {
+    for (const auto &it : slots_) {
+      f(reinterpret_cast<const uint8_t *>(it.first.data()),
+        &values_[size_t{it.second} * spec_.value_size]);
+    }
+  }
+}
+
+// A helper function for "call imm", with arguments r1-r5. `arg` is what was
+// given to EbpfProgram::Run().
+typedef uint64_t (*EbpfHelper)(void *arg, uint64_t r1, uint64_t r2,
+                               uint64_t r3, uint64_t r4, uint64_t r5);
+
+// A userspace eBPF virtual machine. Programs are checked once when loaded
+// and then run by an interpreter, which checks memory accesses at runtime:
+// programs can only access their stack, the (read-only) context, the packet
+// and the values of their maps. Backward jumps are not allowed, so every
+// program terminates.
+class EbpfProgram {
+ public:
+  static const size_t kMaxInsns = 4096;
+  static const size_t kStackSize = 512;
+
+  // Checks and loads `code` (raw instructions, as in the .text section of an
+  // object file), which refers to `maps` by their index and may call the
+  // built-in map helpers and `helpers`.
+  Error Load(const std::string &code, const std::vector<EbpfMapSpec> &maps,
+             const std::map<int32_t, EbpfHelper> &helpers);
+
+  // Creates a set of the maps of this program in *maps, to be passed to
+  // Run(). Each set is independent, e.g., one per worker. Fails with ENOMEM
+  // (leaving *maps empty) if the values cannot be allocated.
+  Error CreateMaps(std::vector<EbpfMap> *maps) const;
+
+  // Runs the program with r1 = ctx (ctx_size bytes, read only), and the
+  // packet data [pkt, pkt + pkt_size) writable. The stack starts zeroed. Returns false if the program
+  // made an invalid memory access; otherwise sets *ret to r0.
+  // As in the kernel, x / 0 = 0 and x % 0 = x.
+  bool Run(std::vector<EbpfMap> *maps, const void *ctx, size_t ctx_size,
+           void *pkt, size_t pkt_size, void *helper_arg, uint64_t *ret) const;
+
+  const std::vector<EbpfMapSpec> &maps() const { return maps_; }
+
+ private:
+  Error MakeError(int code, const std::string &msg = "") {
+    return std::make_pair(code, msg);
+  }
+
+  std::vector<EbpfInsn> insns_;
+  std::vector<EbpfMapSpec> maps_;
+
+  // The helper of each "call imm" instruction (other than the built-in
+  // ones), by instruction index
+  std::vector<EbpfHelper> call_fns_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_EBPF_H_
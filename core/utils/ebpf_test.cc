@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "ebpf.h"
+
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bess::utils::EbpfHelper;
+using bess::utils::EbpfInsn;
+using bess::utils::EbpfMap;
+using bess::utils::EbpfMapSpec;
+using bess::utils::EbpfProgram;
+
+using namespace bess::utils::ebpf;
+
+EbpfInsn Insn(uint8_t code, uint8_t dst, uint8_t src, int16_t off,
+              int32_t imm) {
+  EbpfInsn insn;
+  insn.code = code;
+  insn.dst = dst;
+  insn.src = src;
+  insn.off = off;
+  insn.imm = imm;
+  return insn;
+}
+
+EbpfInsn Exit() {
+  return Insn(kJmp | kExit, 0, 0, 0, 0);
+}
+
+std::string Code(const std::vector<EbpfInsn> &insns) {
+  return std::string(reinterpret_cast<const char *>(insns.data()),
+                     insns.size() * sizeof(EbpfInsn));
+}
+
+struct Context {
+  uint32_t len;
+  uint32_t port;
+};
+
+class EbpfTest : public ::testing::Test {
+ protected:
+  void Load(const std::vector<EbpfInsn> &insns,
+            const std::vector<EbpfMapSpec> &maps = {},
+            const std::map<int32_t, EbpfHelper> &helpers = {}) {
+    ASSERT_EQ(0, prog_.Load(Code(insns), maps, helpers).first);
+    ASSERT_EQ(0, prog_.CreateMaps(&maps_).first);
+  }
+
+  int LoadError(const std::vector<EbpfInsn> &insns) {
+    return prog_.Load(Code(insns), {}, {}).first;
+  }
+
+  // Returns r0, or -1 if the program faulted
+  int64_t Run(std::vector<uint8_t> pkt = {}, Context ctx = {}) {
+    uint64_t ret;
+    if (!prog_.Run(&maps_, &ctx, sizeof(ctx), pkt.data(), pkt.size(), this,
+                   &ret)) {
+      return -1;
+    }
+    return ret;
+  }
+
+  EbpfProgram prog_;
+  std::vector<EbpfMap> maps_;
+};
+
+TEST_F(EbpfTest, Alu) {
+  Load({
+      Insn(kAlu64 | kMov | kK, 0, 0, 0, 7),
+      Insn(kAlu64 | kMul | kK, 0, 0, 0, 6),     // r0 = 42
+      Insn(kAlu64 | kMov | kK, 1, 0, 0, -1),
+      Insn(kAlu | kAdd | kK, 1, 0, 0, 1),       // r1 = (u32)(-1 + 1) = 0
+      Insn(kAlu64 | kDiv | kX, 0, 1, 0, 0),     // r0 = r0 / 0 = 0
+      Insn(kAlu64 | kAdd | kK, 0, 0, 0, 0x1234),
+      Insn(kAlu | kEnd | kX, 0, 0, 0, 16),      // r0 = htons(r0)
+      Exit(),
+  });
+  EXPECT_EQ(0x3412, Run());
+}
+
+// Nothing written to the stack by one run is seen by the next one
+TEST_F(EbpfTest, StackZeroed) {
+  // if (ctx->len) *(u32 *)(r10 - 8) = ctx->len; r0 = *(u32 *)(r10 - 8)
+  Load({
+      Insn(kLdx | kMem | kW, 2, 1, 0, 0),
+      Insn(kJmp | kJeq | kK, 2, 0, 1, 0),
+      Insn(kStx | kMem | kW, 10, 2, -8, 0),
+      Insn(kLdx | kMem | kW, 0, 10, -8, 0),
+      Exit(),
+  });
+  EXPECT_EQ(42, Run({}, {42, 0}));
+  EXPECT_EQ(0, Run({}, {0, 0}));
+}
+
+TEST_F(EbpfTest, Jumps) {
+  // r0 = (ctx->port == 53) ? 1 : (ctx->len > 100 ? 2 : 3)
+  Load({
+      Insn(kLdx | kMem | kW, 2, 1, 4, 0),
+      Insn(kJmp | kJne | kK, 2, 0, 2, 53),
+      Insn(kAlu64 | kMov | kK, 0, 0, 0, 1),
+      Exit(),
+      Insn(kLdx | kMem | kW, 2, 1, 0, 0),
+      Insn(kAlu64 | kMov | kK, 0, 0, 0, 2),
+      Insn(kJmp32 | kJgt | kK, 2, 0, 1, 100),
+      Insn(kAlu64 | kMov | kK, 0, 0, 0, 3),
+      Exit(),
+  });
+  EXPECT_EQ(1, Run({}, {200, 53}));
+  EXPECT_EQ(2, Run({}, {200, 80}));
+  EXPECT_EQ(3, Run({}, {60, 80}));
+}
+
+TEST_F(EbpfTest, Packet) {
+  // Returns the ether type, after overwriting it with 0xffff
+  struct {
+    uint64_t data;
+  } ctx;
+
+  Load({
+      Insn(kLdx | kMem | kDW, 2, 1, 0, 0),
+      Insn(kLdx | kMem | kH, 0, 2, 12, 0),
+      Insn(kAlu | kEnd | kX, 0, 0, 0, 16),
+      Insn(kSt | kMem | kH, 2, 0, 12, -1),
+      Exit(),
+  });
+
+  std::vector<uint8_t> pkt(60);
+  pkt[12] = 0x08;
+  pkt[13] = 0x06;
+  ctx.data = reinterpret_cast<uintptr_t>(pkt.data());
+
+  uint64_t ret = 0;
+  ASSERT_TRUE(prog_.Run(&maps_, &ctx, sizeof(ctx), pkt.data(), pkt.size(),
+                        nullptr, &ret));
+  EXPECT_EQ(0x0806, ret);
+  EXPECT_EQ(0xff, pkt[12]);
+  EXPECT_EQ(0xff, pkt[13]);
+
+  // A 13-byte packet cuts the ether type in half
+  EXPECT_FALSE(prog_.Run(&maps_, &ctx, sizeof(ctx), pkt.data(), 13, nullptr,
+                         &ret));
+
+  // The context is read only
+  Load({
+      Insn(kSt | kMem | kW, 1, 0, 0, 0),
+      Exit(),
+  });
+  EXPECT_FALSE(prog_.Run(&maps_, &ctx, sizeof(ctx), pkt.data(), pkt.size(),
+                         nullptr, &ret));
+}
+
+TEST_F(EbpfTest, Stack) {
+  Load({
+      Insn(kSt | kMem | kDW, 10, 0, -8, 5),
+      Insn(kAlu64 | kMov | kK, 1, 0, 0, 3),
+      Insn(kStx | kAtomic | kDW, 10, 1, -8, kAdd | 0x01),  // fetch and add
+      Insn(kLdx | kMem | kDW, 0, 10, -8, 0),
+      Insn(kAlu64 | kMul | kK, 0, 0, 0, 10),
+      Insn(kAlu64 | kAdd | kX, 0, 1, 0, 0),  // (5 + 3) * 10 + 5
+      Exit(),
+  });
+  EXPECT_EQ(85, Run());
+
+  // Above the top of the stack
+  Load({
+      Insn(kLdx | kMem | kW, 0, 10, 0, 0),
+      Exit(),
+  });
+  EXPECT_EQ(-1, Run());
+}
+
+TEST_F(EbpfTest, ArrayMap) {
+  EbpfMapSpec counters = {"counters", EbpfMapSpec::kArray, 4, 8, 4};
+
+  // counters[ctx->port & 3] += ctx->len; returns the new value
+  Load(
+      {
+          Insn(kLdx | kMem | kW, 2, 1, 4, 0),
+          Insn(kAlu | kAnd | kK, 2, 0, 0, 3),
+          Insn(kStx | kMem | kW, 10, 2, -4, 0),
+          Insn(kLdx | kMem | kW, 6, 1, 0, 0),
+          Insn(kLd | kImm | kDW, 1, kPseudoMap, 0, 0),
+          Insn(0, 0, 0, 0, 0),
+          Insn(kAlu64 | kMov | kX, 2, 10, 0, 0),
+          Insn(kAlu64 | kAdd | kK, 2, 0, 0, -4),
+          Insn(kJmp | kCall, 0, 0, 0, kMapLookupElem),
+          Insn(kJmp | kJne | kK, 0, 0, 1, 0),
+          Exit(),
+          Insn(kStx | kAtomic | kDW, 0, 6, 0, kAdd),
+          Insn(kLdx | kMem | kDW, 0, 0, 0, 0),
+          Exit(),
+      },
+      {counters});
+
+  EXPECT_EQ(100, Run({}, {100, 1}));
+  EXPECT_EQ(150, Run({}, {50, 5}));
+  EXPECT_EQ(60, Run({}, {60, 2}));
+
+  // Each set of maps is independent
+  std::vector<EbpfMap> other;
+  ASSERT_EQ(0, prog_.CreateMaps(&other).first);
+  Context ctx = {10, 1};
+  uint64_t ret;
+  ASSERT_TRUE(prog_.Run(&other, &ctx, sizeof(ctx), nullptr, 0, nullptr, &ret));
+  EXPECT_EQ(10, ret);
+
+  uint32_t idx = 1;
+  const uint8_t *value = maps_[0].Lookup(reinterpret_cast<uint8_t *>(&idx));
+  ASSERT_NE(nullptr, value);
+  uint64_t sum;
+  memcpy(&sum, value, sizeof(sum));
+  EXPECT_EQ(150, sum);
+
+  idx = 4;
+  EXPECT_EQ(nullptr, maps_[0].Lookup(reinterpret_cast<uint8_t *>(&idx)));
+  EXPECT_EQ(-EINVAL, maps_[0].Delete(reinterpret_cast<uint8_t *>(&idx)));
+}
+
+TEST_F(EbpfTest, HashMap) {
+  EbpfMap map({"flows", EbpfMapSpec::kHash, 2, 4, 2});
+  uint16_t keys[] = {1, 2, 3};
+  uint32_t value = 7;
+  const uint8_t *v = reinterpret_cast<uint8_t *>(&value);
+
+  EXPECT_EQ(nullptr, map.Lookup(reinterpret_cast<uint8_t *>(&keys[0])));
+  EXPECT_EQ(-ENOENT,
+            map.Update(reinterpret_cast<uint8_t *>(&keys[0]), v, kExist));
+  EXPECT_EQ(0, map.Update(reinterpret_cast<uint8_t *>(&keys[0]), v, kAny));
+  EXPECT_EQ(-EEXIST,
+            map.Update(reinterpret_cast<uint8_t *>(&keys[0]), v, kNoExist));
+  EXPECT_EQ(0, map.Update(reinterpret_cast<uint8_t *>(&keys[1]), v, kAny));
+  EXPECT_EQ(-E2BIG,
+            map.Update(reinterpret_cast<uint8_t *>(&keys[2]), v, kAny));
+
+  EXPECT_EQ(0, map.Delete(reinterpret_cast<uint8_t *>(&keys[0])));
+  EXPECT_EQ(-ENOENT, map.Delete(reinterpret_cast<uint8_t *>(&keys[0])));
+  EXPECT_EQ(0, map.Update(reinterpret_cast<uint8_t *>(&keys[2]), v, kAny));
+
+  int n = 0;
+  map.ForEach([&](const uint8_t *key, const uint8_t *val) {
+    uint16_t k;
+    memcpy(&k, key, sizeof(k));
+    EXPECT_TRUE(k == 2 || k == 3);
+    EXPECT_EQ(0, memcmp(val, v, sizeof(value)));
+    n++;
+  });
+  EXPECT_EQ(2, n);
+}
+
+uint64_t AddHelper(void *arg, uint64_t r1, uint64_t r2, uint64_t, uint64_t,
+                   uint64_t) {
+  (*static_cast<int *>(arg))++;
+  return r1 + r2;
+}
+
+TEST_F(EbpfTest, Helper) {
+  ASSERT_EQ(0, prog_.Load(Code({
+                              Insn(kAlu64 | kMov | kK, 1, 0, 0, 40),
+                              Insn(kAlu64 | kMov | kK, 2, 0, 0, 2),
+                              Insn(kJmp | kCall, 0, 0, 0, 0x1000),
+                              Exit(),
+                          }),
+                          {}, {{0x1000, AddHelper}})
+                   .first);
+
+  int calls = 0;
+  uint64_t ret;
+  ASSERT_TRUE(prog_.Run(&maps_, nullptr, 0, nullptr, 0, &calls, &ret));
+  EXPECT_EQ(42, ret);
+  EXPECT_EQ(1, calls);
+}
+
+TEST_F(EbpfTest, Rejected) {
+  EXPECT_EQ(EINVAL, LoadError({}));
+
+  // No exit at the end
+  EXPECT_EQ(EINVAL, LoadError({Insn(kAlu64 | kMov | kK, 0, 0, 0, 0)}));
+
+  // Loops
+  EXPECT_EQ(EINVAL, LoadError({
+                        Insn(kAlu64 | kMov | kK, 0, 0, 0, 0),
+                        Insn(kJmp | kJa, 0, 0, -2, 0),
+                        Exit(),
+                    }));
+
+  // Out of the program
+  EXPECT_EQ(EINVAL, LoadError({
+                        Insn(kJmp | kJeq | kK, 0, 0, 5, 0),
+                        Exit(),
+                    }));
+
+  // Unknown helper, map and opcode
+  EXPECT_EQ(EINVAL, LoadError({Insn(kJmp | kCall, 0, 0, 0, 9), Exit()}));
+  EXPECT_EQ(EINVAL, LoadError({
+                        Insn(kLd | kImm | kDW, 1, kPseudoMap, 0, 0),
+                        Insn(0, 0, 0, 0, 0),
+                        Exit(),
+                    }));
+  EXPECT_EQ(EINVAL, LoadError({Insn(0xff, 0, 0, 0, 0), Exit()}));
+
+  // Writes to r10, constant division by zero
+  EXPECT_EQ(EINVAL, LoadError({Insn(kAlu64 | kMov | kK, 10, 0, 0, 0), Exit()}));
+  EXPECT_EQ(EINVAL, LoadError({Insn(kAlu64 | kDiv | kK, 0, 0, 0, 0), Exit()}));
+}
+
+}  // namespace
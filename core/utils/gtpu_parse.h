@@ -0,0 +1,290 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_GTPU_PARSE_H_
+#define BESS_UTILS_GTPU_PARSE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "endian.h"
+#include "ether.h"
+#include "gtp.h"
+#include "ip.h"
+#include "udp.h"
+
+namespace bess {
+namespace utils {
+
+// QoS information carried by a PDU session container (TS 38.415). All fields
+// are zero if there is no container.
+struct GtpuPscInfo {
+  uint8_t qfi;       // QoS flow identifier
+  uint8_t pdu_type;  // 0: downlink, 1: uplink
+  uint8_t rqi;       // reflective QoS indicator (downlink only)
+  uint8_t present;   // 1 if a PDU session container was found
+};
+
+// What WalkGtpuExtHeaders() does with each extension header type
+// (TS 29.281 5.2.1). Unknown types are skipped unless their two most
+// significant bits say that the receiver must comprehend them.
+class GtpuExtTable {
+ public:
+  enum Action : uint8_t {
+    kSkip = 0,
+    kPduSessionContainer,
+    kReject,
+  };
+
+  constexpr GtpuExtTable() : actions_() {
+    for (int i = 0; i < 256; i++) {
+      actions_[i] = (i & 0x80) ? kReject : kSkip;
+    }
+    actions_[0x81] = kSkip;  // RAN container
+    actions_[0x82] = kSkip;  // Long PDCP PDU number
+    actions_[0x83] = kSkip;  // Xw RAN container
+    actions_[0x84] = kSkip;  // NR RAN container
+    actions_[EXT_TYPE_PDU_SESSION_CONTAINER] = kPduSessionContainer;
+    actions_[0xc0] = kSkip;  // PDCP PDU number
+  }
+
+  constexpr Action operator[](uint8_t type) const { return actions_[type]; }
+
+ private:
+  Action actions_[256];
+};
+
+static constexpr GtpuExtTable kGtpuExtTable;
+
+// Limits the work spent on a (malicious) long chain
+static const int kGtpuMaxExtHeaders = 8;
+
+// Fills `info` from the PDU session container starting at `ext`, which
+// holds at least 4 bytes.
+inline void ParseGtpuPsc(const uint8_t *ext, GtpuPscInfo *info) {
+  info->pdu_type = ext[1] >> 4;
+  info->qfi = ext[2] & 0x3f;
+  info->rqi = (ext[2] >> 6) & (info->pdu_type == 0);
+  info->present = 1;
+}
+
+// Walks the extension header chain of the GTP-U header at `gtp`, of which
+// `len` bytes are readable. Returns false if the header is truncated, or if
+// the chain is malformed, too long, or has a header that must be comprehended
+// but is not known. Otherwise, if `hdr_len` is not null, stores the length of
+// the whole GTP-U header (options and extension headers included) there.
+// Unlike Gtpv1::header_length(), this never reads past `len` and always
+// terminates.
+inline bool WalkGtpuExtHeaders(const uint8_t *gtp, size_t len,
+                               GtpuPscInfo *info, size_t *hdr_len = nullptr) {
+  *info = {};
+  if (len < sizeof(Gtpv1)) {
+    return false;
+  }
+
+  const Gtpv1 *gtph = reinterpret_cast<const Gtpv1 *>(gtp);
+  size_t pos = sizeof(Gtpv1);
+  if (gtph->seq || gtph->pdn || gtph->ex) {
+    pos += 4;
+    if (len < pos) {
+      return false;
+    }
+  }
+
+  uint8_t type = gtph->ex ? gtp[pos - 1] : 0;
+  for (int i = 0; type != 0; i++) {
+    if (i == kGtpuMaxExtHeaders || pos >= len) {
+      return false;
+    }
+    size_t ext_len = gtp[pos] << 2;
+    if (ext_len == 0 || pos + ext_len > len) {
+      return false;
+    }
+
+    switch (kGtpuExtTable[type]) {
+      case GtpuExtTable::kPduSessionContainer:
+        ParseGtpuPsc(gtp + pos, info);
+        break;
+      case GtpuExtTable::kReject:
+        return false;
+      default:
+        break;
+    }
+
+    type = gtp[pos + ext_len - 1];
+    pos += ext_len;
+  }
+
+  if (hdr_len) {
+    *hdr_len = pos;
+  }
+  return true;
+}
+
+// Same as WalkGtpuExtHeaders(), with a fast path for the common layout of a
+// single 4-byte PDU session container: one 64-bit load and compare checks
+// the layout, and the fields are extracted without branches.
+inline bool ParseGtpuExtHeaders(const uint8_t *gtp, size_t len,
+                                GtpuPscInfo *info, size_t *hdr_len = nullptr) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Bytes 8-15 of the header: sequence number (2), N-PDU number (1), next
+  // type = PSC, PSC length = 1, PDU type/flags, PPP/RQI/QFI, next type = 0.
+  const uint64_t kMask = 0xff0000ffff000000ull;
+  const uint64_t kPattern = 0x0000000185000000ull;
+  // Version 1 with the E flag
+  const uint8_t kFlagsMask = 0xe4;
+  const uint8_t kFlags = 0x24;
+
+  if (len >= sizeof(Gtpv1) + 8) {
+    uint64_t v;
+    memcpy(&v, gtp + sizeof(Gtpv1), sizeof(v));
+    if ((gtp[0] & kFlagsMask) == kFlags && (v & kMask) == kPattern) {
+      uint8_t pdu_type = (v >> 44) & 0xf;
+      info->pdu_type = pdu_type;
+      info->qfi = (v >> 48) & 0x3f;
+      info->rqi = ((v >> 54) & 1) & (pdu_type == 0);
+      info->present = 1;
+      if (hdr_len) {
+        *hdr_len = sizeof(Gtpv1) + 8;
+      }
+      return true;
+    }
+  }
+#endif
+
+  return WalkGtpuExtHeaders(gtp, len, info, hdr_len);
+}
+
+// Where the headers of a GTP-U G-PDU frame start, relative to the beginning
+// of the frame. Filled once per packet so that later stages (classification,
+// decapsulation) do not need to walk the headers again.
+struct GtpuHeaderOffsets {
+  uint16_t l3;            // outer IPv4/IPv6 header
+  uint16_t l4;            // outer UDP header
+  uint16_t gtp;           // GTP-U header, with options and extension headers
+  uint16_t inner;         // inner IPv4/IPv6 header
+  uint32_t teid;          // host order
+  uint8_t l3_version;     // 4 or 6
+  uint8_t inner_version;  // 4 or 6
+};
+
+// Parses `len` bytes at `frame` as Ethernet/IP/UDP/GTP-U carrying an IPv4 or
+// IPv6 G-PDU, over IPv4 or IPv6. IPv6 extension headers on the outer header
+// are not supported. Returns false for anything else, including truncated
+// frames.
+inline bool ParseGtpuHeaders(const void *frame, size_t len,
+                             GtpuHeaderOffsets *off) {
+  const uint8_t *p = static_cast<const uint8_t *>(frame);
+  const size_t l3 = sizeof(Ethernet);
+  size_t l4;
+
+  if (len < l3 + sizeof(Ipv4)) {
+    return false;
+  }
+
+  be16_t ether_type = reinterpret_cast<const Ethernet *>(p)->ether_type;
+  if (ether_type == be16_t(Ethernet::kIpv4)) {
+    const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(p + l3);
+    if (ip->protocol != Ipv4::kUdp || ip->header_length < 5) {
+      return false;
+    }
+    l4 = l3 + (ip->header_length << 2);
+    off->l3_version = 4;
+  } else if (ether_type == be16_t(Ethernet::kIpv6)) {
+    const Ipv6 *ip6 = reinterpret_cast<const Ipv6 *>(p + l3);
+    if (len < l3 + sizeof(Ipv6) || ip6->next_header != Ipv4::kUdp) {
+      return false;
+    }
+    l4 = l3 + sizeof(Ipv6);
+    off->l3_version = 6;
+  } else {
+    return false;
+  }
+
+  const size_t gtp = l4 + sizeof(Udp);
+  if (len < gtp + sizeof(Gtpv1)) {
+    return false;
+  }
+
+  const Udp *udp = reinterpret_cast<const Udp *>(p + l4);
+  const Gtpv1 *gtph = reinterpret_cast<const Gtpv1 *>(p + gtp);
+  if (udp->dst_port != be16_t(UDP_PORT_GTPU) || gtph->type != GTP_GPDU) {
+    return false;
+  }
+
+  // Not Gtpv1::header_length(), which follows the extension header chain
+  // without bounds.
+  GtpuPscInfo info;
+  size_t gtp_len;
+  if (!ParseGtpuExtHeaders(p + gtp, len - gtp, &info, &gtp_len)) {
+    return false;
+  }
+
+  const size_t inner = gtp + gtp_len;
+  if (inner >= len) {
+    return false;
+  }
+
+  off->inner_version = p[inner] >> 4;
+  if (off->inner_version != 4 && off->inner_version != 6) {
+    return false;
+  }
+
+  off->l3 = l3;
+  off->l4 = l4;
+  off->gtp = gtp;
+  off->inner = inner;
+  off->teid = gtph->teid.value();
+  return true;
+}
+
+// Returns true if any packet of `batch` has an IPv6 (outer) header. GTP-U
+// modules check this once per batch, so that IPv4-only batches stay on their
+// IPv4 loop.
+template <typename PacketBatch>
+inline bool HasIpv6Packet(const PacketBatch *batch) {
+  for (int i = 0; i < batch->cnt(); i++) {
+    const Ethernet *eth =
+        batch->pkts()[i]->template head_data<const Ethernet *>();
+    if (eth->ether_type == be16_t(Ethernet::kIpv6)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Ethernet type for an IP header of the given version.
+inline be16_t EtherTypeForIpVersion(uint8_t version) {
+  return be16_t(version == 6 ? Ethernet::kIpv6 : Ethernet::kIpv4);
+}
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_GTPU_PARSE_H_
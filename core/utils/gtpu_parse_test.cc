@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtpu_parse.h"
+
+#include <cstring>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "pcap_file.h"
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Ethernet;
+using bess::utils::Gtpv1;
+using bess::utils::GtpuHeaderOffsets;
+using bess::utils::Ipv4;
+using bess::utils::GtpuPscInfo;
+using bess::utils::ParseGtpuExtHeaders;
+using bess::utils::ParseGtpuHeaders;
+using bess::utils::WalkGtpuExtHeaders;
+using bess::utils::PcapFile;
+using bess::utils::Udp;
+
+// Builds Ethernet/IPv4/UDP/GTP-U followed by `opt_len` bytes of GTP-U
+// options and a minimal inner IPv4 header. Returns the frame length.
+size_t BuildFrame(uint8_t *buf, uint32_t teid, const uint8_t *opts = nullptr,
+                  size_t opt_len = 0) {
+  memset(buf, 0, 256);
+
+  Ethernet *eth = reinterpret_cast<Ethernet *>(buf);
+  eth->ether_type = be16_t(Ethernet::kIpv4);
+
+  Ipv4 *ip = reinterpret_cast<Ipv4 *>(eth + 1);
+  ip->version = 4;
+  ip->header_length = 5;
+  ip->protocol = Ipv4::kUdp;
+
+  Udp *udp = reinterpret_cast<Udp *>(ip + 1);
+  udp->dst_port = be16_t(UDP_PORT_GTPU);
+
+  Gtpv1 *gtph = reinterpret_cast<Gtpv1 *>(udp + 1);
+  gtph->version = GTPU_VERSION;
+  gtph->pt = GTP_PROTOCOL_TYPE_GTP;
+  gtph->type = GTP_GPDU;
+  gtph->teid = be32_t(teid);
+
+  uint8_t *p = reinterpret_cast<uint8_t *>(gtph + 1);
+  if (opt_len) {
+    gtph->seq = 1;
+    gtph->ex = opts[3] != 0;
+    memcpy(p, opts, opt_len);
+    p += opt_len;
+  }
+
+  Ipv4 *inner = reinterpret_cast<Ipv4 *>(p);
+  inner->version = 4;
+  inner->header_length = 5;
+  return p + sizeof(Ipv4) - buf;
+}
+
+TEST(GtpuParseTest, Basic) {
+  uint8_t buf[256];
+  size_t len = BuildFrame(buf, 0x12345678);
+  GtpuHeaderOffsets off;
+
+  ASSERT_TRUE(ParseGtpuHeaders(buf, len, &off));
+  EXPECT_EQ(14, off.l3);
+  EXPECT_EQ(34, off.l4);
+  EXPECT_EQ(42, off.gtp);
+  EXPECT_EQ(50, off.inner);
+  EXPECT_EQ(0x12345678, off.teid);
+  EXPECT_EQ(4, off.l3_version);
+  EXPECT_EQ(4, off.inner_version);
+}
+
+TEST(GtpuParseTest, ExtensionHeaders) {
+  // Sequence number, N-PDU, next type = PDU session container, then a
+  // 4-byte container with no further extension.
+  const uint8_t opts[] = {0, 1, 0, 0x85, 1, 0x10, 0x09, 0};
+  uint8_t buf[256];
+  size_t len = BuildFrame(buf, 7, opts, sizeof(opts));
+  GtpuHeaderOffsets off;
+
+  ASSERT_TRUE(ParseGtpuHeaders(buf, len, &off));
+  EXPECT_EQ(58, off.inner);
+  EXPECT_EQ(7, off.teid);
+}
+
+// Parses the extension headers of a frame from BuildFrame() with both the
+// fast path and the walker, and checks that they agree.
+bool ParseExt(const uint8_t *opts, size_t opt_len, GtpuPscInfo *info) {
+  uint8_t buf[256];
+  size_t len = BuildFrame(buf, 1, opts, opt_len);
+  GtpuPscInfo walked;
+
+  bool ret = ParseGtpuExtHeaders(buf + 42, len - 42, info);
+  EXPECT_EQ(ret, WalkGtpuExtHeaders(buf + 42, len - 42, &walked));
+  if (ret) {
+    EXPECT_EQ(info->qfi, walked.qfi);
+    EXPECT_EQ(info->pdu_type, walked.pdu_type);
+    EXPECT_EQ(info->rqi, walked.rqi);
+    EXPECT_EQ(info->present, walked.present);
+  }
+  return ret;
+}
+
+TEST(GtpuParseTest, PduSessionContainer) {
+  GtpuPscInfo info;
+
+  // Downlink, RQI set, QFI 5
+  const uint8_t dl[] = {0, 1, 0, 0x85, 1, 0x00, 0x45, 0};
+  ASSERT_TRUE(ParseExt(dl, sizeof(dl), &info));
+  EXPECT_EQ(1, info.present);
+  EXPECT_EQ(0, info.pdu_type);
+  EXPECT_EQ(5, info.qfi);
+  EXPECT_EQ(1, info.rqi);
+
+  // Uplink, QFI 9. Bit 6 is the "new IE" flag there, not RQI.
+  const uint8_t ul[] = {0, 2, 0, 0x85, 1, 0x10, 0x49, 0};
+  ASSERT_TRUE(ParseExt(ul, sizeof(ul), &info));
+  EXPECT_EQ(1, info.present);
+  EXPECT_EQ(1, info.pdu_type);
+  EXPECT_EQ(9, info.qfi);
+  EXPECT_EQ(0, info.rqi);
+
+  // No extension header at all
+  const uint8_t none[] = {0, 3, 0, 0};
+  ASSERT_TRUE(ParseExt(none, sizeof(none), &info));
+  EXPECT_EQ(0, info.present);
+  EXPECT_EQ(0, info.qfi);
+}
+
+TEST(GtpuParseTest, ExtensionChain) {
+  GtpuPscInfo info;
+
+  // PDCP PDU number, then a PSC: not the fast path layout
+  const uint8_t chain[] = {0, 0, 0, 0xc0, 1, 0x12, 0x34, 0x85,
+                           1, 0x00, 0x07, 0};
+  ASSERT_TRUE(ParseExt(chain, sizeof(chain), &info));
+  EXPECT_EQ(1, info.present);
+  EXPECT_EQ(7, info.qfi);
+
+  // Unknown, comprehension not required: skipped
+  const uint8_t optional[] = {0, 0, 0, 0x10, 1, 0, 0, 0};
+  ASSERT_TRUE(ParseExt(optional, sizeof(optional), &info));
+  EXPECT_EQ(0, info.present);
+
+  // Unknown, comprehension required
+  const uint8_t required[] = {0, 0, 0, 0xa0, 1, 0, 0, 0};
+  EXPECT_FALSE(ParseExt(required, sizeof(required), &info));
+
+  // Zero length extension header
+  const uint8_t zero[] = {0, 0, 0, 0x85, 0, 0, 0, 0};
+  EXPECT_FALSE(ParseExt(zero, sizeof(zero), &info));
+}
+
+// Gtpv1::header_length() loops forever on the first frame and reads past the
+// end of the second: both must be rejected.
+TEST(GtpuParseTest, MalformedExtensionHeaders) {
+  uint8_t buf[256];
+  GtpuHeaderOffsets off;
+
+  // Zero length extension header
+  const uint8_t zero[] = {0, 0, 0, 0x85, 0, 0, 0, 0};
+  size_t len = BuildFrame(buf, 1, zero, sizeof(zero));
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+
+  // A chain that runs past the end of the frame: the last header claims
+  // 4 * 0xff bytes.
+  const uint8_t past_end[] = {0, 0, 0, 0xc0, 1, 0, 0, 0xc0, 0xff, 0, 0, 0};
+  len = BuildFrame(buf, 1, past_end, sizeof(past_end));
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+
+  // Cut in the middle of an otherwise valid chain
+  const uint8_t chain[] = {0, 0, 0, 0xc0, 1, 0x12, 0x34, 0x85,
+                           1, 0x00, 0x07, 0};
+  len = BuildFrame(buf, 1, chain, sizeof(chain));
+  ASSERT_TRUE(ParseGtpuHeaders(buf, len, &off));
+  EXPECT_EQ(42 + 8 + sizeof(chain), off.inner);
+  EXPECT_FALSE(ParseGtpuHeaders(buf, 42 + 8 + 10, &off));
+}
+
+// The header length covers the options and the whole extension chain.
+TEST(GtpuParseTest, HeaderLength) {
+  uint8_t buf[256];
+  GtpuPscInfo info;
+  size_t hdr_len;
+
+  size_t len = BuildFrame(buf, 1);
+  ASSERT_TRUE(WalkGtpuExtHeaders(buf + 42, len - 42, &info, &hdr_len));
+  EXPECT_EQ(8, hdr_len);
+
+  const uint8_t none[] = {0, 3, 0, 0};
+  len = BuildFrame(buf, 1, none, sizeof(none));
+  ASSERT_TRUE(WalkGtpuExtHeaders(buf + 42, len - 42, &info, &hdr_len));
+  EXPECT_EQ(12, hdr_len);
+  EXPECT_FALSE(WalkGtpuExtHeaders(buf + 42, 10, &info, &hdr_len));
+
+  const uint8_t psc[] = {0, 1, 0, 0x85, 1, 0x10, 0x09, 0};
+  len = BuildFrame(buf, 1, psc, sizeof(psc));
+  ASSERT_TRUE(ParseGtpuExtHeaders(buf + 42, len - 42, &info, &hdr_len));
+  EXPECT_EQ(16, hdr_len);
+  ASSERT_TRUE(WalkGtpuExtHeaders(buf + 42, len - 42, &info, &hdr_len));
+  EXPECT_EQ(16, hdr_len);
+}
+
+TEST(GtpuParseTest, NotGtpu) {
+  uint8_t buf[256];
+  size_t len = BuildFrame(buf, 1);
+  GtpuHeaderOffsets off;
+
+  // Echo request rather than a G-PDU
+  reinterpret_cast<Gtpv1 *>(buf + 42)->type = GTPU_ECHO_REQUEST;
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+
+  BuildFrame(buf, 1);
+  reinterpret_cast<Udp *>(buf + 34)->dst_port = be16_t(53);
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+
+  BuildFrame(buf, 1);
+  reinterpret_cast<Ipv4 *>(buf + 14)->protocol = Ipv4::kTcp;
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+
+  BuildFrame(buf, 1);
+  reinterpret_cast<Ethernet *>(buf)->ether_type = be16_t(Ethernet::kArp);
+  EXPECT_FALSE(ParseGtpuHeaders(buf, len, &off));
+}
+
+TEST(GtpuParseTest, Truncated) {
+  uint8_t buf[256];
+  size_t len = BuildFrame(buf, 1);
+  GtpuHeaderOffsets off;
+
+  EXPECT_FALSE(ParseGtpuHeaders(buf, 50, &off));
+  EXPECT_FALSE(ParseGtpuHeaders(buf, 20, &off));
+  EXPECT_TRUE(ParseGtpuHeaders(buf, len, &off));
+}
+
+// IPv6 transport and/or IPv6 UE traffic, see gtpu-ipv6.pcap:
+//  1. IPv6 / UDP / GTP-U + PDU session container / IPv4 / UDP
+//  2. IPv4 / UDP / GTP-U / IPv6 / TCP
+//  3. IPv6 / UDP / GTP-U / IPv6 / UDP
+//  4. IPv6 / UDP / GTP-U echo request
+TEST(GtpuParseTest, Ipv6Captures) {
+  PcapFile pcap;
+  std::string err;
+  ASSERT_EQ(0, pcap.Open("testdata/test-pktcaptures/gtpu-ipv6.pcap", &err))
+      << err;
+
+  const auto &recs = pcap.records();
+  ASSERT_EQ(4, recs.size());
+  GtpuHeaderOffsets off;
+
+  ASSERT_TRUE(ParseGtpuHeaders(recs[0].data, recs[0].len, &off));
+  EXPECT_EQ(6, off.l3_version);
+  EXPECT_EQ(54, off.l4);
+  EXPECT_EQ(62, off.gtp);
+  EXPECT_EQ(78, off.inner);
+  EXPECT_EQ(4, off.inner_version);
+  EXPECT_EQ(0x100, off.teid);
+
+  GtpuPscInfo info;
+  ASSERT_TRUE(ParseGtpuExtHeaders(recs[0].data + off.gtp,
+                                  recs[0].len - off.gtp, &info));
+  EXPECT_EQ(1, info.pdu_type);
+  EXPECT_EQ(9, info.qfi);
+
+  ASSERT_TRUE(ParseGtpuHeaders(recs[1].data, recs[1].len, &off));
+  EXPECT_EQ(4, off.l3_version);
+  EXPECT_EQ(50, off.inner);
+  EXPECT_EQ(6, off.inner_version);
+  EXPECT_EQ(0x200, off.teid);
+
+  ASSERT_TRUE(ParseGtpuHeaders(recs[2].data, recs[2].len, &off));
+  EXPECT_EQ(6, off.l3_version);
+  EXPECT_EQ(70, off.inner);
+  EXPECT_EQ(6, off.inner_version);
+  EXPECT_EQ(0x300, off.teid);
+
+  EXPECT_FALSE(ParseGtpuHeaders(recs[3].data, recs[3].len, &off));
+
+  // Cut inside the outer IPv6 header
+  EXPECT_FALSE(ParseGtpuHeaders(recs[0].data, 40, &off));
+}
+
+}  // namespace
@@ -49,6 +49,11 @@
 // A bin b_i corresponds for the range [i * width, (i + 1) * width)
 // (note that it's left-closed and right-open), and (i * width) is used for its
 // representative value.
+//
+// Alternatively, with "sub_bucket_bits" (s) > 0, bins are log-linear as in HDR
+// histograms: the first 2^s bins have the given width, and every further power
+// of two is split into 2^(s-1) bins, so that the relative error is bounded by
+// 2^(1-s) over the whole range. See SubBucketBits() and NumLogBuckets().
 template <typename T = uint64_t>
 class Histogram {
  public:
@@ -64,9 +69,32 @@ class Histogram {
   };
 
   // Construct a new histogram with "num_buckets" buckets of width
-  // "bucket_width".
-  Histogram(size_t num_buckets, T bucket_width)
-      : bucket_width_(bucket_width), buckets_(num_buckets + 1) {}
+  // "bucket_width" (at least; see above for "sub_bucket_bits").
+  Histogram(size_t num_buckets, T bucket_width, int sub_bucket_bits = 0)
+      : bucket_width_(bucket_width),
+        sub_bucket_bits_(sub_bucket_bits),
+        buckets_(num_buckets + 1) {}
+
+  // Returns the sub_bucket_bits for log-linear bins precise to
+  // "significant_digits" decimal digits.
+  static int SubBucketBits(int significant_digits) {
+    uint64_t sub_buckets = 2;
+    for (int i = 0; i < significant_digits; i++) {
+      sub_buckets *= 10;
+    }
+
+    int bits = 1;
+    while ((1ull << bits) < sub_buckets) {
+      bits++;
+    }
+    return bits;
+  }
+
+  // Returns the number of log-linear buckets to cover up to "max_units"
+  // times the bucket width.
+  static size_t NumLogBuckets(uint64_t max_units, int sub_bucket_bits) {
+    return LogIndex(max_units, sub_bucket_bits) + 1;
+  }
 
   // Swap operator allows clean summarizing with external lock,
   // when using a histogram on an active data stream.
@@ -77,6 +105,7 @@ class Histogram {
   void swap(Histogram &other) noexcept {
     using std::swap;
     swap(bucket_width_, other.bucket_width_);
+    swap(sub_bucket_bits_, other.sub_bucket_bits_);
     swap(buckets_, other.buckets_);
   }
 
@@ -84,11 +113,13 @@ class Histogram {
   // histogram -- note that this is very much non-atomic.
   Histogram(Histogram &&other) noexcept {
     bucket_width_ = other.bucket_width_;
+    sub_bucket_bits_ = other.sub_bucket_bits_;
     buckets_ = std::move(other.buckets_);
   }
 
   Histogram &operator=(Histogram &&other) noexcept {
     bucket_width_ = other.bucket_width_;
+    sub_bucket_bits_ = other.sub_bucket_bits_;
     buckets_ = std::move(other.buckets_);
     return *this;
   }
@@ -98,7 +129,7 @@ class Histogram {
   void Insert(T x) {
     // The last element of the buckets_ is used to count data points above
     // the upper bound of the histogram range.
-    size_t index = x / bucket_width_;
+    size_t index = BucketIndex(x);
     index = std::min(index, buckets_.size() - 1);
     buckets_[index].store(1 + buckets_[index].load(std::memory_order_relaxed),
                           std::memory_order_relaxed);
@@ -109,7 +140,7 @@ class Histogram {
   void AtomicInsert(T x) {
     // The last element of the buckets_ is used to count data points above
     // the upper bound of the histogram range.
-    size_t index = x / bucket_width_;
+    size_t index = BucketIndex(x);
     index = std::min(index, buckets_.size() - 1);
     buckets_[index].fetch_add(1);
   }
@@ -138,7 +169,7 @@ class Histogram {
     auto percentile_value_it = ret.percentile_values.begin();
 
     for (size_t i = 0; i < buckets_.size(); i++) {
-      T val = i * bucket_width_;
+      T val = BucketValue(i);
       T freq = buckets_[i];
       total += val * freq;
       count_so_far += freq;
@@ -179,6 +210,7 @@ class Histogram {
 
   size_t num_buckets() const { return buckets_.size(); }
   T bucket_width() const { return bucket_width_; }
+  int sub_bucket_bits() const { return sub_bucket_bits_; }
 
   size_t max_num_buckets() const {
     // This constant is mainly to keep resets to a reasonable speed.
@@ -192,14 +224,49 @@ class Histogram {
 
   // Resize the histogram.  Note that this resets it (i.e., this
   // does not attempt to redistribute existing counts).
-  void Resize(size_t num_buckets, T bucket_width) {
+  void Resize(size_t num_buckets, T bucket_width, int sub_bucket_bits = 0) {
     buckets_ = std::vector<std::atomic<uint64_t>>(num_buckets + 1);
     bucket_width_ = bucket_width;
+    sub_bucket_bits_ = sub_bucket_bits;
   }
 
  private:
-  // TODO(melvin): add support for logarithmic binning
+  // Index of the log-linear bucket for "units" multiples of the bucket width
+  static size_t LogIndex(uint64_t units, int sub_bucket_bits) {
+    const uint64_t sub_buckets = 1ull << sub_bucket_bits;
+    if (units < sub_buckets) {
+      return units;
+    }
+
+    // units >> shift is in [sub_buckets / 2, sub_buckets)
+    int shift = 64 - __builtin_clzll(units) - sub_bucket_bits;
+    return sub_buckets + (shift - 1) * (sub_buckets / 2) +
+           ((units >> shift) - sub_buckets / 2);
+  }
+
+  size_t BucketIndex(T x) const {
+    size_t units = x / bucket_width_;
+    if (sub_bucket_bits_ == 0) {
+      return units;
+    }
+    return LogIndex(units, sub_bucket_bits_);
+  }
+
+  // The lower bound of bucket i
+  T BucketValue(size_t i) const {
+    const size_t sub_buckets = size_t{1} << sub_bucket_bits_;
+    if (sub_bucket_bits_ == 0 || i < sub_buckets) {
+      return i * bucket_width_;
+    }
+
+    size_t half = sub_buckets / 2;
+    int shift = (i - sub_buckets) / half + 1;
+    size_t units = ((i - sub_buckets) % half + half) << shift;
+    return units * bucket_width_;
+  }
+
   T bucket_width_;
+  int sub_bucket_bits_;
   std::vector<std::atomic<uint64_t>> buckets_;
 };
 
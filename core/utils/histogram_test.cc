@@ -80,4 +80,36 @@ TEST(HistogramTest, DoubleQuartiles) {
   EXPECT_DOUBLE_EQ(6.0, ret.percentile_values[3]);  // 100th percentile
 }
 
+TEST(HistogramTest, LogBuckets) {
+  EXPECT_EQ(5, Histogram<>::SubBucketBits(1));   // 20 -> 32
+  EXPECT_EQ(11, Histogram<>::SubBucketBits(3));  // 2000 -> 2048
+
+  // 8 linear buckets of width 10, then 4 per power of two
+  const int bits = 3;
+  const size_t num_buckets = Histogram<>::NumLogBuckets(1000, bits);
+  EXPECT_EQ(8 + 4 * 7, num_buckets);
+
+  Histogram<uint64_t> hist(num_buckets, 10, bits);
+  for (uint64_t x : {0, 15, 75, 80, 95, 100, 5000, 9999, 10000, 20000}) {
+    hist.Insert(x);
+  }
+
+  auto ret = hist.Summarize({5.0, 15.0, 25.0, 35.0, 45.0, 55.0, 65.0, 75.0,
+                             85.0, 95.0});
+
+  EXPECT_EQ(10, ret.count);
+  EXPECT_EQ(1, ret.above_range);
+  EXPECT_EQ(0, ret.min);
+  EXPECT_EQ(0, ret.percentile_values[0]);
+  EXPECT_EQ(10, ret.percentile_values[1]);
+  EXPECT_EQ(70, ret.percentile_values[2]);
+  EXPECT_EQ(80, ret.percentile_values[3]);  // [80, 100)
+  EXPECT_EQ(80, ret.percentile_values[4]);
+  EXPECT_EQ(100, ret.percentile_values[5]);    // [100, 120)
+  EXPECT_EQ(4480, ret.percentile_values[6]);   // [4480, 5120)
+  EXPECT_EQ(8960, ret.percentile_values[7]);   // [8960, 10240)
+  EXPECT_EQ(8960, ret.percentile_values[8]);   // 10000 too
+  EXPECT_EQ(10240, ret.percentile_values[9]);  // above range
+}
+
 }  // namespace
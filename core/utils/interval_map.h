@@ -0,0 +1,109 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_INTERVAL_MAP_H_
+#define BESS_UTILS_INTERVAL_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+// A map from disjoint closed intervals [start, end] of an ordered key type K
+// to values of type V. Intervals are kept sorted by their start, so a lookup
+// is a binary search over a dense array of keys instead of a scan over all
+// intervals. Insertion is O(n); it is meant to be done at configuration time.
+//
+// K only needs to be copyable and ordered by operator<, so it can be uint32_t
+// for IPv4 addresses or unsigned __int128 for IPv6 ones.
+template <typename K, typename V>
+class IntervalMap {
+ public:
+  // Adds [start, end] -> value. Returns false (and changes nothing) if
+  // start > end or the interval overlaps one that is already in the map.
+  bool Insert(const K &start, const K &end, const V &value) {
+    if (end < start) {
+      return false;
+    }
+
+    size_t pos = std::upper_bound(starts_.begin(), starts_.end(), start) -
+                 starts_.begin();
+    if (pos > 0 && !(ends_[pos - 1] < start)) {
+      return false;
+    }
+    if (pos < starts_.size() && !(end < starts_[pos])) {
+      return false;
+    }
+
+    starts_.insert(starts_.begin() + pos, start);
+    ends_.insert(ends_.begin() + pos, end);
+    values_.insert(values_.begin() + pos, value);
+    return true;
+  }
+
+  // Returns the value of the interval that contains key, or nullptr.
+  const V *Find(const K &key) const {
+    size_t n = starts_.size();
+    if (n == 0 || key < starts_[0]) {
+      return nullptr;
+    }
+
+    // Branch-free lower half search for the last start <= key
+    const K *base = starts_.data();
+    while (n > 1) {
+      size_t half = n / 2;
+      base = (key < base[half]) ? base : base + half;
+      n -= half;
+    }
+
+    size_t pos = base - starts_.data();
+    return (ends_[pos] < key) ? nullptr : &values_[pos];
+  }
+
+  void Clear() {
+    starts_.clear();
+    ends_.clear();
+    values_.clear();
+  }
+
+  size_t size() const { return starts_.size(); }
+
+ private:
+  // Parallel arrays, sorted by start. Only starts_ is touched until the
+  // search has narrowed down to a single interval.
+  std::vector<K> starts_;
+  std::vector<K> ends_;
+  std::vector<V> values_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_INTERVAL_MAP_H_
@@ -0,0 +1,122 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Compares the IntervalMap lookup StaticNAT uses against the linear scan over
+// address range pairs it replaced, as the number of pairs grows.
+
+#include "interval_map.h"
+
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "random.h"
+
+using bess::utils::IntervalMap;
+
+namespace {
+
+const size_t kNumLookups = 1024;
+
+struct NatPair {
+  uint32_t int_addr;
+  uint32_t ext_addr;
+  uint32_t size;
+};
+
+class IntervalMapFixture : public benchmark::Fixture {
+ public:
+  void SetUp(benchmark::State &state) override {
+    Random rd;
+    size_t n = state.range(0);
+
+    // One /24-sized block per pair, every other block left unmapped
+    pairs_.clear();
+    map_.Clear();
+    for (size_t i = 0; i < n; i++) {
+      uint32_t start = 0x0a000000 + i * 512;
+      pairs_.push_back({start, start + 0x10000000, 256});
+      map_.Insert(start, start + 255, 0x10000000);
+    }
+
+    addrs_.clear();
+    for (size_t i = 0; i < kNumLookups; i++) {
+      addrs_.push_back(0x0a000000 + rd.GetRange(n * 512));
+    }
+  }
+
+ protected:
+  std::vector<NatPair> pairs_;
+  IntervalMap<uint32_t, uint32_t> map_;
+  std::vector<uint32_t> addrs_;
+};
+
+}  // namespace
+
+BENCHMARK_DEFINE_F(IntervalMapFixture, LinearScan)(benchmark::State &state) {
+  uint32_t sum = 0;
+
+  for (auto _ : state) {
+    for (uint32_t addr : addrs_) {
+      for (const auto &pair : pairs_) {
+        if (pair.int_addr <= addr && addr < pair.int_addr + pair.size) {
+          sum += addr + (pair.ext_addr - pair.int_addr);
+          break;
+        }
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+BENCHMARK_DEFINE_F(IntervalMapFixture, IntervalMap)(benchmark::State &state) {
+  uint32_t sum = 0;
+
+  for (auto _ : state) {
+    for (uint32_t addr : addrs_) {
+      const uint32_t *diff = map_.Find(addr);
+      if (diff) {
+        sum += addr + *diff;
+      }
+    }
+  }
+
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * kNumLookups);
+}
+
+BENCHMARK_REGISTER_F(IntervalMapFixture, LinearScan)
+    ->RangeMultiplier(4)
+    ->Range(4, 16384);
+BENCHMARK_REGISTER_F(IntervalMapFixture, IntervalMap)
+    ->RangeMultiplier(4)
+    ->Range(4, 16384);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "interval_map.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdint>
+
+namespace {
+
+using bess::utils::IntervalMap;
+
+TEST(IntervalMapTest, Empty) {
+  IntervalMap<uint32_t, int> m;
+  EXPECT_EQ(0, m.size());
+  EXPECT_EQ(nullptr, m.Find(0));
+  EXPECT_EQ(nullptr, m.Find(12345));
+}
+
+TEST(IntervalMapTest, Find) {
+  IntervalMap<uint32_t, int> m;
+  ASSERT_TRUE(m.Insert(100, 199, 1));
+  ASSERT_TRUE(m.Insert(10, 10, 2));
+  ASSERT_TRUE(m.Insert(300, 0xffffffff, 3));
+  ASSERT_TRUE(m.Insert(200, 200, 4));
+  EXPECT_EQ(4, m.size());
+
+  EXPECT_EQ(nullptr, m.Find(9));
+  EXPECT_EQ(2, *m.Find(10));
+  EXPECT_EQ(nullptr, m.Find(11));
+  EXPECT_EQ(nullptr, m.Find(99));
+  EXPECT_EQ(1, *m.Find(100));
+  EXPECT_EQ(1, *m.Find(150));
+  EXPECT_EQ(1, *m.Find(199));
+  EXPECT_EQ(4, *m.Find(200));
+  EXPECT_EQ(nullptr, m.Find(201));
+  EXPECT_EQ(nullptr, m.Find(299));
+  EXPECT_EQ(3, *m.Find(300));
+  EXPECT_EQ(3, *m.Find(0xffffffff));
+
+  m.Clear();
+  EXPECT_EQ(0, m.size());
+  EXPECT_EQ(nullptr, m.Find(150));
+}
+
+TEST(IntervalMapTest, RejectsOverlap) {
+  IntervalMap<uint32_t, int> m;
+  ASSERT_TRUE(m.Insert(100, 199, 1));
+
+  EXPECT_FALSE(m.Insert(50, 100, 2));
+  EXPECT_FALSE(m.Insert(199, 250, 2));
+  EXPECT_FALSE(m.Insert(120, 130, 2));
+  EXPECT_FALSE(m.Insert(0, 1000, 2));
+  EXPECT_FALSE(m.Insert(300, 299, 2));
+  EXPECT_EQ(1, m.size());
+
+  EXPECT_TRUE(m.Insert(50, 99, 2));
+  EXPECT_TRUE(m.Insert(200, 250, 3));
+  EXPECT_EQ(2, *m.Find(99));
+  EXPECT_EQ(3, *m.Find(200));
+}
+
+TEST(IntervalMapTest, WideKeys) {
+  typedef unsigned __int128 uint128_t;
+  IntervalMap<uint128_t, int> m;
+  uint128_t base = static_cast<uint128_t>(0x20010db800000000ull) << 64;
+
+  ASSERT_TRUE(m.Insert(base, base + 0xffff, 1));
+  ASSERT_TRUE(m.Insert(base + (uint128_t(1) << 64), ~uint128_t(0), 2));
+
+  EXPECT_EQ(nullptr, m.Find(base - 1));
+  EXPECT_EQ(1, *m.Find(base));
+  EXPECT_EQ(1, *m.Find(base + 0xffff));
+  EXPECT_EQ(nullptr, m.Find(base + 0x10000));
+  EXPECT_EQ(2, *m.Find(~uint128_t(0)));
+}
+
+}  // namespace
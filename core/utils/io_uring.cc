@@ -0,0 +1,411 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "io_uring.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "copy.h"
+
+namespace bess {
+namespace utils {
+
+int IoUring::Init(uint32_t entries, uint32_t cq_entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+  p.flags = IORING_SETUP_CQSIZE;
+  p.cq_entries = cq_entries;
+
+  int fd = syscall(__NR_io_uring_setup, entries, &p);
+  if (fd < 0) {
+    return -errno;
+  }
+  fd_ = fd;
+
+  sq_map_size_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  cq_map_size_ = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    sq_map_size_ = cq_map_size_ = std::max(sq_map_size_, cq_map_size_);
+  }
+
+  void *sq = mmap(nullptr, sq_map_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq == MAP_FAILED) {
+    int ret = -errno;
+    Close();
+    return ret;
+  }
+  sq_map_ = sq;
+
+  if (single_mmap) {
+    cq_map_ = sq_map_;
+  } else {
+    void *cq = mmap(nullptr, cq_map_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq == MAP_FAILED) {
+      int ret = -errno;
+      Close();
+      return ret;
+    }
+    cq_map_ = cq;
+  }
+
+  sqes_size_ = p.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    int ret = -errno;
+    Close();
+    return ret;
+  }
+  sqes_ = static_cast<struct io_uring_sqe *>(sqes);
+
+  char *sqp = static_cast<char *>(sq_map_);
+  sq_head_ = reinterpret_cast<std::atomic<uint32_t> *>(sqp + p.sq_off.head);
+  sq_tail_ = reinterpret_cast<std::atomic<uint32_t> *>(sqp + p.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<uint32_t *>(sqp + p.sq_off.ring_mask);
+  sq_entries_ = p.sq_entries;
+  sq_array_ = reinterpret_cast<uint32_t *>(sqp + p.sq_off.array);
+  sq_local_tail_ = sq_tail_->load(std::memory_order_relaxed);
+
+  char *cqp = static_cast<char *>(cq_map_);
+  cq_head_ = reinterpret_cast<std::atomic<uint32_t> *>(cqp + p.cq_off.head);
+  cq_tail_ = reinterpret_cast<std::atomic<uint32_t> *>(cqp + p.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<uint32_t *>(cqp + p.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe *>(cqp + p.cq_off.cqes);
+
+  return 0;
+}
+
+void IoUring::Close() {
+  if (sqes_) {
+    munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_map_ && cq_map_ != sq_map_) {
+    munmap(cq_map_, cq_map_size_);
+  }
+  cq_map_ = nullptr;
+  if (sq_map_) {
+    munmap(sq_map_, sq_map_size_);
+    sq_map_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+struct io_uring_sqe *IoUring::GetSqe() {
+  uint32_t head = sq_head_->load(std::memory_order_acquire);
+  if (sq_local_tail_ - head >= sq_entries_) {
+    return nullptr;
+  }
+
+  uint32_t idx = sq_local_tail_++ & sq_mask_;
+  sq_array_[idx] = idx;
+  memset(&sqes_[idx], 0, sizeof(sqes_[idx]));
+  return &sqes_[idx];
+}
+
+int IoUring::Submit() {
+  // Without SQPOLL the kernel only consumes SQEs in io_uring_enter(), so
+  // anything past the SQ head was either just queued or left over by a
+  // failed call, and is to be (re)submitted.
+  uint32_t to_submit = unsubmitted();
+  if (to_submit == 0) {
+    return 0;
+  }
+  sq_tail_->store(sq_local_tail_, std::memory_order_release);
+
+  int ret = syscall(__NR_io_uring_enter, fd_, to_submit, 0, 0, nullptr, 0);
+  return (ret < 0) ? -errno : ret;
+}
+
+int IoUring::Wait(uint32_t nr) {
+  int ret = syscall(__NR_io_uring_enter, fd_, 0, nr, IORING_ENTER_GETEVENTS,
+                    nullptr, 0);
+  return (ret < 0) ? -errno : 0;
+}
+
+int UringPacketReceiver::Init(PacketPool *pool, uint32_t num_bufs) {
+  if (num_bufs == 0 || num_bufs > 8192 || (num_bufs & (num_bufs - 1))) {
+    return -EINVAL;
+  }
+
+  // Room for giving back all buffers and re-arming at once.  Every buffer
+  // may come back in a CQE, plus one final CQE per request.
+  int ret = ring_.Init(num_bufs * 2, num_bufs * 4);
+  if (ret < 0) {
+    return ret;
+  }
+
+  bufs_.assign(num_bufs, nullptr);
+  missing_.clear();
+  for (uint32_t i = 0; i < num_bufs; i++) {
+    missing_.push_back(num_bufs - 1 - i);
+  }
+  Replenish(pool);
+
+  ret = ring_.Submit();
+  if (ret < 0) {
+    Close();
+    return ret;
+  }
+
+  // Only the payload: no source address, no control messages.
+  memset(&msg_, 0, sizeof(msg_));
+
+  fd_ = -1;
+  armed_ = false;
+  return 0;
+}
+
+void UringPacketReceiver::Close() {
+  // Closing the ring cancels the receive request.
+  ring_.Close();
+
+  for (Packet *&pkt : bufs_) {
+    Packet::Free(pkt);
+    pkt = nullptr;
+  }
+  missing_.clear();
+  fd_ = -1;
+  armed_ = false;
+}
+
+void UringPacketReceiver::Replenish(PacketPool *pool) {
+  Packet *pkts[PacketBatch::kMaxBurst];
+
+  while (!missing_.empty()) {
+    uint16_t burst =
+        std::min<size_t>(missing_.size(), PacketBatch::kMaxBurst);
+    if (!pool->AllocBulk(pkts, burst)) {
+      return;
+    }
+
+    for (uint16_t i = 0; i < burst; i++) {
+      struct io_uring_sqe *sqe = ring_.GetSqe();
+      if (!sqe) {
+        // The SQ is full (submissions are failing): retry on the next call.
+        Packet::Free(pkts + i, burst - i);
+        return;
+      }
+
+      uint16_t bid = missing_.back();
+      missing_.pop_back();
+      bufs_[bid] = pkts[i];
+
+      // The kernel puts a struct io_uring_recvmsg_out in front of the
+      // payload, which is to land where packet data normally starts.
+      sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+      sqe->fd = 1;  // number of buffers
+      sqe->addr = reinterpret_cast<uintptr_t>(
+          pkts[i]->head_data<char *>() - sizeof(struct io_uring_recvmsg_out));
+      sqe->len = sizeof(struct io_uring_recvmsg_out) + SNBUF_DATA;
+      sqe->off = bid;
+      sqe->buf_group = kBufGroup;
+      sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+      sqe->user_data = kProvideTag;
+    }
+  }
+}
+
+bool UringPacketReceiver::Arm() {
+  struct io_uring_sqe *sqe = ring_.GetSqe();
+  if (!sqe) {
+    return false;
+  }
+
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = fd_;
+  sqe->addr = reinterpret_cast<uintptr_t>(&msg_);
+  sqe->len = 1;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = kBufGroup;
+  sqe->user_data = fd_;
+  return true;
+}
+
+int UringPacketReceiver::Recv(int fd, PacketPool *pool, Packet **pkts,
+                              int cnt) {
+  if (fd != fd_) {
+    // A request on the previous socket ends by itself when it is closed.
+    fd_ = fd;
+    armed_ = false;
+  }
+
+  if (!armed_) {
+    // The kernel ends the request when it runs out of buffers.  Once queued,
+    // the request counts as armed, even if submitting it fails below: it
+    // stays in the SQ until a later submission succeeds.
+    Replenish(pool);
+    armed_ = Arm();
+  }
+
+  uint32_t idx;
+  uint32_t n = ring_.PeekCqes(&idx);
+  uint32_t i;
+  int received = 0;
+
+  for (i = 0; i < n && received < cnt; i++) {
+    const struct io_uring_cqe &cqe = ring_.cqe(idx + i);
+
+    if (cqe.flags & IORING_CQE_F_BUFFER) {
+      uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+      Packet *pkt = bufs_[bid];
+      bufs_[bid] = nullptr;
+      missing_.push_back(bid);
+
+      const auto *out = reinterpret_cast<const struct io_uring_recvmsg_out *>(
+          pkt->head_data<char *>() - sizeof(struct io_uring_recvmsg_out));
+      if (cqe.res > 0 && out->payloadlen > 0 &&
+          !(out->flags & MSG_TRUNC)) {
+        pkt->append(out->payloadlen);
+        pkts[received++] = pkt;
+      } else {
+        // Errors, end of stream (empty), or too large
+        truncated_ += (cqe.res > 0 && (out->flags & MSG_TRUNC));
+        Packet::Free(pkt);
+      }
+    }
+
+    if (!(cqe.flags & IORING_CQE_F_MORE) &&
+        cqe.user_data == static_cast<uint64_t>(fd_)) {
+      armed_ = false;
+    }
+  }
+  ring_.AdvanceCq(i);
+
+  // Buffers go back in batches, to keep system calls rare.  A new request,
+  // and SQEs that a failed submission left in the SQ, go out here too.
+  if (missing_.size() >= bufs_.size() / 4) {
+    Replenish(pool);
+  }
+  if (ring_.unsubmitted() > 0) {
+    ring_.Submit();
+  }
+
+  return received;
+}
+
+int UringPacketSender::Init(uint32_t entries) {
+  entries_ = entries;
+  inflight_ = 0;
+  return ring_.Init(entries, entries * 2);
+}
+
+void UringPacketSender::Close() {
+  while (ring_.is_initialized() && inflight_ > 0) {
+    if (ring_.Submit() < 0 || ring_.Wait(inflight_) < 0) {
+      break;
+    }
+    Reap();
+  }
+
+  // Packets of sends that did not finish are lost, rather than freed under
+  // the kernel's feet.
+  ring_.Close();
+  inflight_ = 0;
+}
+
+void UringPacketSender::Reap() {
+  Packet *pkts[PacketBatch::kMaxBurst];
+  uint32_t idx;
+  uint32_t n = ring_.PeekCqes(&idx);
+
+  while (n > 0) {
+    uint32_t burst = std::min<uint32_t>(n, PacketBatch::kMaxBurst);
+    for (uint32_t i = 0; i < burst; i++) {
+      pkts[i] = reinterpret_cast<Packet *>(ring_.cqe(idx + i).user_data);
+    }
+    ring_.AdvanceCq(burst);
+    Packet::Free(pkts, burst);
+
+    inflight_ -= burst;
+    idx += burst;
+    n -= burst;
+  }
+}
+
+int UringPacketSender::Send(int fd, PacketPool *pool, Packet **pkts,
+                            int cnt) {
+  Reap();
+
+  int sent;
+  for (sent = 0; sent < cnt && inflight_ < entries_; sent++) {
+    Packet *pkt = pkts[sent];
+
+    if (!pkt->is_linear()) {
+      Packet *copy = pool->Alloc();
+      char *p = copy ? static_cast<char *>(copy->append(pkt->total_len()))
+                     : nullptr;
+      if (!p) {
+        Packet::Free(copy);
+        break;
+      }
+
+      for (Packet *seg = pkt; seg; seg = seg->next()) {
+        Copy(p, seg->head_data(), seg->head_len());
+        p += seg->head_len();
+      }
+
+      // If it cannot be sent after all, the caller drops the copy.
+      Packet::Free(pkt);
+      pkts[sent] = pkt = copy;
+    }
+
+    // Cannot fail while fewer than entries_ sends are in flight.
+    struct io_uring_sqe *sqe = ring_.GetSqe();
+    if (!sqe) {
+      break;
+    }
+
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(pkt->head_data());
+    sqe->len = pkt->head_len();
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = reinterpret_cast<uintptr_t>(pkt);
+    inflight_++;
+  }
+
+  ring_.Submit();
+  return sent;
+}
+
+}  // namespace utils
+}  // namespace bess
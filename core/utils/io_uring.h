@@ -0,0 +1,239 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_IO_URING_H_
+#define BESS_UTILS_IO_URING_H_
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "../packet.h"
+#include "../packet_pool.h"
+
+namespace bess {
+namespace utils {
+
+// A bare io_uring instance, driven through the raw system calls (no liburing
+// dependency).  Not thread-safe: one thread submits and reaps.
+class IoUring {
+ public:
+  IoUring()
+      : fd_(-1),
+        sq_map_(),
+        sq_map_size_(),
+        cq_map_(),
+        cq_map_size_(),
+        sqes_(),
+        sqes_size_(),
+        sq_head_(),
+        sq_tail_(),
+        sq_mask_(),
+        sq_entries_(),
+        sq_array_(),
+        sq_local_tail_(),
+        cq_head_(),
+        cq_tail_(),
+        cq_mask_(),
+        cqes_() {}
+
+  ~IoUring() { Close(); }
+
+  // Sets up a ring with `entries` SQEs and `cq_entries` CQEs.  Returns 0 or
+  // a negative errno value.
+  int Init(uint32_t entries, uint32_t cq_entries);
+
+  void Close();
+
+  bool is_initialized() const { return fd_ >= 0; }
+
+  // Returns a cleared SQE to fill in, or nullptr if the SQ is full.
+  struct io_uring_sqe *GetSqe();
+
+  // Submits all SQEs obtained so far that the kernel has not consumed yet,
+  // including those left over by a failed submission.  Returns how many were
+  // consumed, or a negative errno value.
+  int Submit();
+
+  // SQEs obtained but not consumed by the kernel yet.
+  uint32_t unsubmitted() const {
+    return sq_local_tail_ - sq_head_->load(std::memory_order_acquire);
+  }
+
+  // Returns how many CQEs are ready, starting at `*idx`.
+  uint32_t PeekCqes(uint32_t *idx) {
+    *idx = cq_head_->load(std::memory_order_relaxed);
+    return cq_tail_->load(std::memory_order_acquire) - *idx;
+  }
+
+  const struct io_uring_cqe &cqe(uint32_t idx) const {
+    return cqes_[idx & cq_mask_];
+  }
+
+  // Hands `n` harvested CQEs back to the kernel.
+  void AdvanceCq(uint32_t n) {
+    cq_head_->store(cq_head_->load(std::memory_order_relaxed) + n,
+                    std::memory_order_release);
+  }
+
+  // Waits until at least `nr` CQEs are ready.  Returns 0 or a negative errno
+  // value.
+  int Wait(uint32_t nr);
+
+  int fd() const { return fd_; }
+
+ private:
+  int fd_;
+
+  void *sq_map_;
+  size_t sq_map_size_;
+  void *cq_map_;
+  size_t cq_map_size_;
+  struct io_uring_sqe *sqes_;
+  size_t sqes_size_;
+
+  std::atomic<uint32_t> *sq_head_;
+  std::atomic<uint32_t> *sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t sq_entries_;
+  uint32_t *sq_array_;
+  uint32_t sq_local_tail_;
+
+  std::atomic<uint32_t> *cq_head_;
+  std::atomic<uint32_t> *cq_tail_;
+  uint32_t cq_mask_;
+  struct io_uring_cqe *cqes_;
+};
+
+// Receives packets from a datagram or packet socket with a multishot
+// IORING_OP_RECVMSG, straight into Packet buffers provided to the kernel
+// (IORING_OP_PROVIDE_BUFFERS).  Once armed, Recv() only harvests completions;
+// used buffers are given back in batches, with one system call per batch.
+//
+// Each received message becomes one Packet.  Messages larger than a Packet
+// buffer (SNBUF_DATA) are truncated by the kernel, and dropped.
+class UringPacketReceiver {
+ public:
+  static const uint32_t kDefaultBuffers = 512;
+
+  UringPacketReceiver()
+      : ring_(),
+        bufs_(),
+        missing_(),
+        msg_(),
+        fd_(-1),
+        armed_(),
+        truncated_() {}
+
+  ~UringPacketReceiver() { Close(); }
+
+  // Sets up the ring with `num_bufs` (a power of 2) buffers from `pool`.
+  // Returns 0 or a negative errno value.
+  int Init(PacketPool *pool, uint32_t num_bufs = kDefaultBuffers);
+
+  // Stops receiving and frees all buffers.
+  void Close();
+
+  bool is_initialized() const { return ring_.is_initialized(); }
+
+  // Receives up to `cnt` packets from `fd`.  The receive request is issued
+  // from the calling thread, on the first call for a socket (and again
+  // whenever the kernel ends it), so call it from the datapath thread.
+  // New buffers are allocated from `pool`.
+  int Recv(int fd, PacketPool *pool, Packet **pkts, int cnt);
+
+  // Messages dropped because they did not fit in a Packet.
+  uint64_t truncated() const { return truncated_; }
+
+ private:
+  static const uint16_t kBufGroup = 0;
+  static const uint64_t kProvideTag = ~0ull;  // user_data, unlike any fd
+
+  // Queues the multishot receive on fd_.  The caller submits.
+  bool Arm();
+
+  // Queues the buffers of the `missing_` ids for the kernel, with new
+  // packets from `pool`.  Ids stay in `missing_` while the SQ is full.  The
+  // caller submits.
+  void Replenish(PacketPool *pool);
+
+  IoUring ring_;
+
+  // Packets backing the buffers, by buffer id, and the ids that need one.
+  std::vector<Packet *> bufs_;
+  std::vector<uint16_t> missing_;
+
+  // Template of the multishot RECVMSG (no name, no control data).
+  struct msghdr msg_;
+
+  int fd_;
+  bool armed_;
+  uint64_t truncated_;
+};
+
+// Sends packets on a socket with one io_uring submission per batch, instead
+// of one system call per packet.  Packets are freed once their send has
+// completed.
+class UringPacketSender {
+ public:
+  static const uint32_t kDefaultEntries = 256;
+
+  UringPacketSender() : ring_(), entries_(), inflight_() {}
+
+  ~UringPacketSender() { Close(); }
+
+  // Returns 0 or a negative errno value.
+  int Init(uint32_t entries = kDefaultEntries);
+
+  // Waits for pending sends and frees their packets.
+  void Close();
+
+  bool is_initialized() const { return ring_.is_initialized(); }
+
+  // Queues up to `cnt` packets for sending on `fd`, and returns how many were
+  // taken.  Chained packets are linearized with a copy from `pool`.
+  int Send(int fd, PacketPool *pool, Packet **pkts, int cnt);
+
+ private:
+  // Frees the packets whose send has completed.
+  void Reap();
+
+  IoUring ring_;
+
+  // At most entries_ sends are in flight, so that the CQ cannot overflow.
+  uint32_t entries_;
+  uint32_t inflight_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_IO_URING_H_
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "io_uring.h"
+
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+using bess::Packet;
+using bess::PlainPacketPool;
+using bess::utils::IoUring;
+using bess::utils::UringPacketReceiver;
+using bess::utils::UringPacketSender;
+
+class IoUringTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    // io_uring may be compiled out or blocked (e.g., by seccomp).
+    IoUring ring;
+    int ret = ring.Init(4, 8);
+    if (ret == -ENOSYS || ret == -EPERM) {
+      GTEST_SKIP() << "io_uring is not available";
+    }
+    ASSERT_EQ(0, ret);
+
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK, 0, sv_));
+  }
+
+  void TearDown() override {
+    for (int fd : sv_) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  // Calls Recv() on sv_[0] until `cnt` messages have arrived or it gives up.
+  std::vector<std::string> RecvAll(UringPacketReceiver *rx, size_t cnt) {
+    std::vector<std::string> ret;
+    Packet *pkts[bess::PacketBatch::kMaxBurst];
+
+    for (int i = 0; i < 1000000 && ret.size() < cnt; i++) {
+      int n = rx->Recv(sv_[0], &pool_, pkts, bess::PacketBatch::kMaxBurst);
+      for (int j = 0; j < n; j++) {
+        ret.emplace_back(pkts[j]->head_data<char *>(), pkts[j]->head_len());
+      }
+      Packet::Free(pkts, n);
+    }
+    return ret;
+  }
+
+  PlainPacketPool pool_;
+  int sv_[2] = {-1, -1};
+};
+
+// Messages come in through the multishot RECVMSG, one per packet, in order.
+TEST_F(IoUringTest, Recv) {
+  UringPacketReceiver rx;
+  ASSERT_EQ(0, rx.Init(&pool_, 8));
+
+  for (int i = 0; i < 5; i++) {
+    std::string msg = "message " + std::to_string(i);
+    ASSERT_EQ(msg.size(), send(sv_[1], msg.data(), msg.size(), 0));
+  }
+
+  std::vector<std::string> got = RecvAll(&rx, 5);
+  ASSERT_EQ(5, got.size());
+  for (int i = 0; i < 5; i++) {
+    EXPECT_EQ("message " + std::to_string(i), got[i]);
+  }
+  EXPECT_EQ(0, rx.truncated());
+}
+
+// With fewer buffers than messages, the kernel ends the receive request when
+// it runs out of them. The receiver must give the buffers back and re-arm,
+// without losing any message.
+TEST_F(IoUringTest, RecvReplenish) {
+  const int kMessages = 50;
+  UringPacketReceiver rx;
+  ASSERT_EQ(0, rx.Init(&pool_, 4));
+
+  for (int i = 0; i < kMessages; i++) {
+    std::string msg = std::to_string(i);
+    ASSERT_EQ(msg.size(), send(sv_[1], msg.data(), msg.size(), 0));
+  }
+
+  std::vector<std::string> got = RecvAll(&rx, kMessages);
+  ASSERT_EQ(kMessages, got.size());
+  for (int i = 0; i < kMessages; i++) {
+    EXPECT_EQ(std::to_string(i), got[i]);
+  }
+
+  // The request keeps working afterwards.
+  ASSERT_EQ(4, send(sv_[1], "more", 4, 0));
+  got = RecvAll(&rx, 1);
+  ASSERT_EQ(1, got.size());
+  EXPECT_EQ("more", got[0]);
+}
+
+// Messages that do not fit in a packet are dropped and counted.
+TEST_F(IoUringTest, RecvTruncated) {
+  UringPacketReceiver rx;
+  ASSERT_EQ(0, rx.Init(&pool_, 8));
+
+  std::vector<char> big(SNBUF_DATA + 1, 'x');
+  ASSERT_EQ(big.size(), send(sv_[1], big.data(), big.size(), 0));
+  ASSERT_EQ(5, send(sv_[1], "small", 5, 0));
+
+  std::vector<std::string> got = RecvAll(&rx, 1);
+  ASSERT_EQ(1, got.size());
+  EXPECT_EQ("small", got[0]);
+  EXPECT_EQ(1, rx.truncated());
+}
+
+// Packets are sent one message each, and chained packets are linearized.
+TEST_F(IoUringTest, Send) {
+  UringPacketSender tx;
+  ASSERT_EQ(0, tx.Init(16));
+
+  const int kPackets = 4;
+  Packet *pkts[kPackets];
+  ASSERT_TRUE(pool_.AllocBulk(pkts, kPackets));
+  for (int i = 0; i < kPackets; i++) {
+    std::string msg = "packet " + std::to_string(i);
+    memcpy(pkts[i]->append(msg.size()), msg.data(), msg.size());
+  }
+
+  Packet *tail = pool_.Alloc();
+  ASSERT_NE(nullptr, tail);
+  memcpy(tail->append(5), " tail", 5);
+  pkts[kPackets - 1]->set_next(tail);
+  pkts[kPackets - 1]->set_nb_segs(2);
+  pkts[kPackets - 1]->set_total_len(pkts[kPackets - 1]->head_len() + 5);
+
+  ASSERT_EQ(kPackets, tx.Send(sv_[1], &pool_, pkts, kPackets));
+
+  char buf[SNBUF_DATA];
+  for (int i = 0; i < kPackets; i++) {
+    struct pollfd pfd = {sv_[0], POLLIN, 0};
+    ASSERT_EQ(1, poll(&pfd, 1, 1000));
+    ssize_t len = recv(sv_[0], buf, sizeof(buf), 0);
+    ASSERT_GT(len, 0);
+
+    std::string expected = "packet " + std::to_string(i);
+    if (i == kPackets - 1) {
+      expected += " tail";
+    }
+    EXPECT_EQ(expected, std::string(buf, len));
+  }
+
+  // Waits for the completions and frees the packets.
+  tx.Close();
+  EXPECT_FALSE(tx.is_initialized());
+}
+
+}  // namespace
@@ -31,6 +31,7 @@
 
 #include "ip.h"
 
+#include <arpa/inet.h>
 #include <glog/logging.h>
 
 #include "bits.h"
@@ -62,6 +63,15 @@ std::string ToIpv4Address(be32_t addr) {
                              t.bytes[2], t.bytes[3]);
 }
 
+bool ParseIpv6Address(const std::string &str, uint8_t *addr) {
+  return inet_pton(AF_INET6, str.c_str(), addr) == 1;
+}
+
+std::string ToIpv6Address(const uint8_t *addr) {
+  char buf[INET6_ADDRSTRLEN];
+  return inet_ntop(AF_INET6, addr, buf, sizeof(buf));
+}
+
 Ipv4Prefix::Ipv4Prefix(const std::string &prefix) {
   size_t delim_pos = prefix.find('/');
 
@@ -45,6 +45,12 @@ bool ParseIpv4Address(const std::string &str, be32_t *addr);
 // be32 -> string
 std::string ToIpv4Address(be32_t addr);
 
+// return false if string -> 16-byte (network order) conversion failed
+bool ParseIpv6Address(const std::string &str, uint8_t *addr);
+
+// 16 bytes (network order) -> string, e.g., "2001:db8::1"
+std::string ToIpv6Address(const uint8_t *addr);
+
 // An IPv4 header definition loosely based on the BSD version.
 struct [[gnu::packed]] Ipv4 {
   enum Flag : uint16_t {
@@ -62,6 +68,7 @@ struct [[gnu::packed]] Ipv4 {
     kGre = 47,
     kEsp = 50,  // IPsec ESP (Encapsulating Security Payload)
     kAh = 51,   // IPsec AH (Authentication Header)
+    kIcmpv6 = 58,
     kSctp = 132,
     kUdpLite = 136,
     kMpls = 137,  // MPLS-in-IPv4
@@ -91,6 +98,22 @@ struct [[gnu::packed]] Ipv4 {
 static_assert(std::is_pod<Ipv4>::value, "not a POD type");
 static_assert(sizeof(Ipv4) == 20, "struct Ipv4 is incorrect");
 
+// An IPv6 fixed header (RFC 8200). Extension headers are not modeled.
+struct [[gnu::packed]] Ipv6 {
+  be32_t vtc_flow;        // Version, traffic class and flow label.
+  be16_t payload_length;  // Length of everything after this header.
+  uint8_t next_header;    // Same numbering as Ipv4::Proto.
+  uint8_t hop_limit;      // Hop limit.
+  uint8_t src[16];        // Source address.
+  uint8_t dst[16];        // Destination address.
+
+  uint8_t version() const { return vtc_flow.value() >> 28; }
+  uint8_t traffic_class() const { return (vtc_flow.value() >> 20) & 0xff; }
+};
+
+static_assert(std::is_pod<Ipv6>::value, "not a POD type");
+static_assert(sizeof(Ipv6) == 40, "struct Ipv6 is incorrect");
+
 struct Ipv4Prefix {
   // Implicit default constructor is not allowed
   Ipv4Prefix() = delete;
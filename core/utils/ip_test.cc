@@ -31,6 +31,8 @@
 
 #include "ip.h"
 
+#include <cstring>
+
 #include <gtest/gtest.h>
 
 using bess::utils::be32_t;
@@ -38,6 +40,8 @@ using bess::utils::be32_t;
 namespace {
 
 using bess::utils::Ipv4Prefix;
+using bess::utils::ParseIpv6Address;
+using bess::utils::ToIpv6Address;
 
 TEST(IPTest, AddressInStr) {
   be32_t a(192 << 24 | 168 << 16 | 100 << 8 | 199);
@@ -55,6 +59,30 @@ TEST(IPTest, AddressInStr) {
   EXPECT_FALSE(ParseIpv4Address("1.1.256.1", &b));
 }
 
+TEST(IPTest, Ipv6AddressInStr) {
+  const uint8_t a[16] = {0x20, 0x01, 0x0d, 0xb8, 0, 0, 0, 0,
+                         0,    0,    0,    0,    0, 0, 0, 1};
+
+  std::string str = ToIpv6Address(a);
+  EXPECT_EQ(str, "2001:db8::1");
+
+  uint8_t b[16];
+  bool ret = ParseIpv6Address(str, b);
+  EXPECT_TRUE(ret);
+  EXPECT_EQ(0, memcmp(a, b, sizeof(a)));
+
+  EXPECT_FALSE(ParseIpv6Address("hello", b));
+  EXPECT_FALSE(ParseIpv6Address("192.168.0.1", b));
+  EXPECT_FALSE(ParseIpv6Address("2001:db8::1::2", b));
+}
+
+TEST(IPTest, Ipv6Header) {
+  bess::utils::Ipv6 ip6 = {};
+  ip6.vtc_flow = be32_t(6 << 28 | 0xb8 << 20 | 0x12345);
+  EXPECT_EQ(6, ip6.version());
+  EXPECT_EQ(0xb8, ip6.traffic_class());
+}
+
 // Check if Ipv4Prefix can be correctly constructed from strings
 TEST(IPTest, PrefixInStr) {
   Ipv4Prefix prefix_1("192.168.0.1/24");
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_NDP_H_
+#define BESS_UTILS_NDP_H_
+
+#include "endian.h"
+#include "ether.h"
+
+namespace bess {
+namespace utils {
+
+// An ICMPv6 Neighbor Solicitation or Advertisement message (RFC 4861),
+// which may be followed by options
+struct [[gnu::packed]] Ndp {
+  enum Type : uint8_t {
+    kNeighborSolicitation = 135,
+    kNeighborAdvertisement = 136,
+  };
+
+  // Flags of advertisements
+  enum Flag : uint32_t {
+    kRouter = 1u << 31,
+    kSolicited = 1 << 30,
+    kOverride = 1 << 29,
+  };
+
+  enum Option : uint8_t {
+    kSourceLinkAddr = 1,
+    kTargetLinkAddr = 2,
+  };
+
+  uint8_t type;       // ICMPv6 type
+  uint8_t code;       // ICMPv6 code, always 0
+  uint16_t checksum;  // ICMPv6 checksum, including the pseudo header
+  be32_t flags;       // reserved in solicitations
+  uint8_t target[16];
+};
+
+static_assert(sizeof(Ndp) == 24, "struct Ndp size is incorrect");
+
+// A source/target link-layer address option of an Ndp message
+struct [[gnu::packed]] NdpLinkAddrOption {
+  uint8_t type;
+  uint8_t length;  // in units of 8 bytes
+  Ethernet::Address addr;
+};
+
+static_assert(sizeof(NdpLinkAddrOption) == 8,
+              "struct NdpLinkAddrOption size is incorrect");
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_NDP_H_
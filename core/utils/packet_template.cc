@@ -0,0 +1,427 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_template.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "checksum.h"
+#include "copy.h"
+#include "ether.h"
+#include "gtp.h"
+#include "ip.h"
+#include "random.h"
+#include "udp.h"
+
+namespace bess {
+namespace utils {
+
+// Sizes are shuffled over this many slots at most
+static const size_t kMaxImixSlots = 1 << 16;
+
+PacketTemplate::PacketTemplate()
+    : size_cursor_(),
+      headers_end_(),
+      refresh_ipv4_csum_(),
+      seq_enabled_(),
+      seq_offset_(),
+      seq_(),
+      ts_enabled_(),
+      ts_offset_(),
+      ts_marker_(),
+      min_size_(),
+      max_size_() {}
+
+Error PacketTemplate::SetTemplate(const void *data, size_t len) {
+  if (len < sizeof(Ethernet)) {
+    return {EINVAL, "template is too short"};
+  }
+  if (len > UINT16_MAX) {
+    return {EINVAL, "template is too long"};
+  }
+
+  tmpl_.assign(static_cast<const char *>(data), len);
+  fields_.clear();
+  seq_enabled_ = false;
+  ts_enabled_ = false;
+  refresh_ipv4_csum_ = false;
+
+  ParseHeaders();
+
+  sizes_ = {len};
+  size_seq_ = {0};
+  BuildTemplates();
+
+  return {0, ""};
+}
+
+Error PacketTemplate::SetImix(const std::vector<size_t> &sizes,
+                              const std::vector<uint32_t> &weights) {
+  if (tmpl_.empty()) {
+    return {EINVAL, "template is not set"};
+  }
+  if (sizes.empty() || sizes.size() != weights.size()) {
+    return {EINVAL, "sizes and weights must be non-empty and of equal length"};
+  }
+
+  uint64_t slots = 0;
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (sizes[i] < headers_end_ || sizes[i] > UINT16_MAX) {
+      return {EINVAL, "packet size " + std::to_string(sizes[i]) +
+                          " must be in [" + std::to_string(headers_end_) +
+                          ", " + std::to_string(UINT16_MAX) + "]"};
+    }
+    if (weights[i] == 0) {
+      return {EINVAL, "weights must be positive"};
+    }
+    slots += weights[i];
+  }
+  if (slots > kMaxImixSlots) {
+    return {EINVAL, "weights must add up to at most " +
+                        std::to_string(kMaxImixSlots)};
+  }
+
+  size_t min_size = *std::min_element(sizes.begin(), sizes.end());
+  for (const FieldState &state : fields_) {
+    if (state.field.offset + state.field.size > min_size) {
+      return {EINVAL, "a field does not fit in the smallest packet"};
+    }
+  }
+  if ((seq_enabled_ && seq_offset_ + sizeof(uint32_t) > min_size) ||
+      (ts_enabled_ &&
+       ts_offset_ + sizeof(uint32_t) + sizeof(uint64_t) > min_size)) {
+    return {EINVAL, "a stamp does not fit in the smallest packet"};
+  }
+
+  sizes_ = sizes;
+  size_seq_.clear();
+  for (size_t i = 0; i < weights.size(); i++) {
+    size_seq_.insert(size_seq_.end(), weights[i], i);
+  }
+
+  // Interleave the sizes with a fixed seed, so that runs are reproducible
+  Random rng(0x5EED5EED5EED5EEDul);
+  for (size_t i = size_seq_.size() - 1; i > 0; i--) {
+    std::swap(size_seq_[i], size_seq_[rng.GetRange(i + 1)]);
+  }
+
+  BuildTemplates();
+
+  return {0, ""};
+}
+
+Error PacketTemplate::CheckRange(size_t offset, size_t size) const {
+  if (tmpl_.empty()) {
+    return {EINVAL, "template is not set"};
+  }
+  if (offset + size > min_size_) {
+    return {EINVAL, "offset " + std::to_string(offset) +
+                        " does not fit in the smallest packet (" +
+                        std::to_string(min_size_) + " bytes)"};
+  }
+  return {0, ""};
+}
+
+Error PacketTemplate::AddField(const Field &field) {
+  if (field.size != 1 && field.size != 2 && field.size != 4) {
+    return {EINVAL, "field size must be 1, 2, or 4"};
+  }
+
+  Error err = CheckRange(field.offset, field.size);
+  if (err.first != 0) {
+    return err;
+  }
+
+  FieldState state = {field, 0, 0};
+  if (state.field.step == 0) {
+    state.field.step = 1;
+  }
+  if (state.field.count == 0) {
+    state.field.count = 1ull << (field.size * 8);
+  }
+
+  // The initial value is read from the template (zero past its end)
+  for (size_t i = 0; i < field.size; i++) {
+    size_t off = field.offset + i;
+    uint8_t byte = off < tmpl_.size() ? tmpl_[off] : 0;
+    state.base = (state.base << 8) | byte;
+  }
+
+  for (size_t off : ipv4_offsets_) {
+    const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(tmpl_.data() + off);
+    if (field.offset < off + (ip->header_length << 2) &&
+        off < field.offset + field.size) {
+      refresh_ipv4_csum_ = true;
+    }
+  }
+
+  fields_.push_back(state);
+  return {0, ""};
+}
+
+Error PacketTemplate::SetSequence(size_t offset) {
+  Error err = CheckRange(offset, sizeof(uint32_t));
+  if (err.first != 0) {
+    return err;
+  }
+
+  seq_enabled_ = true;
+  seq_offset_ = offset;
+  seq_ = 0;
+  return {0, ""};
+}
+
+Error PacketTemplate::SetTimestamp(size_t offset, uint32_t marker) {
+  Error err = CheckRange(offset, sizeof(uint32_t) + sizeof(uint64_t));
+  if (err.first != 0) {
+    return err;
+  }
+
+  ts_enabled_ = true;
+  ts_offset_ = offset;
+  ts_marker_ = marker;
+  return {0, ""};
+}
+
+void PacketTemplate::ParseHeaders() {
+  const char *p = tmpl_.data();
+  const size_t len = tmpl_.size();
+
+  length_fields_.clear();
+  ipv4_offsets_.clear();
+  udp_csum_offsets_.clear();
+
+  size_t off = sizeof(Ethernet);
+  be16_t ether_type = reinterpret_cast<const Ethernet *>(p)->ether_type;
+  headers_end_ = off;
+
+  if (ether_type == be16_t(Ethernet::Type::kVlan)) {
+    if (len < off + sizeof(Vlan)) {
+      return;
+    }
+    ether_type = reinterpret_cast<const Vlan *>(p + off)->ether_type;
+    off += sizeof(Vlan);
+    headers_end_ = off;
+  }
+
+  if (ether_type != be16_t(Ethernet::Type::kIpv4)) {
+    return;
+  }
+
+  // Outer IPv4/UDP, then the inner IPv4/UDP if the outer one is GTP-U
+  for (int depth = 0; depth < 2; depth++) {
+    const Ipv4 *ip = reinterpret_cast<const Ipv4 *>(p + off);
+    if (len < off + sizeof(*ip) || ip->version != 4) {
+      return;
+    }
+
+    size_t ip_bytes = ip->header_length << 2;
+    if (ip_bytes < sizeof(*ip) || len < off + ip_bytes) {
+      return;
+    }
+
+    ipv4_offsets_.push_back(off);
+    length_fields_.push_back({off + offsetof(Ipv4, length),
+                              ip->length.value() - static_cast<int>(len)});
+    off += ip_bytes;
+    headers_end_ = off;
+
+    const Udp *udp = reinterpret_cast<const Udp *>(p + off);
+    if (ip->protocol != Ipv4::Proto::kUdp || len < off + sizeof(*udp)) {
+      return;
+    }
+
+    length_fields_.push_back({off + offsetof(Udp, length),
+                              udp->length.value() - static_cast<int>(len)});
+    udp_csum_offsets_.push_back(off + offsetof(Udp, checksum));
+    off += sizeof(*udp);
+    headers_end_ = off;
+
+    const Gtpv1 *gtp = reinterpret_cast<const Gtpv1 *>(p + off);
+    if (depth > 0 || udp->dst_port != be16_t(UDP_PORT_GTPU) ||
+        len < off + sizeof(*gtp) || gtp->version != GTPU_VERSION ||
+        gtp->type != GTP_GPDU) {
+      return;
+    }
+
+    // Same as Gtpv1::header_length(), but without reading past the template
+    size_t gtp_bytes = sizeof(*gtp);
+    if (gtp->seq || gtp->pdn || gtp->ex) {
+      gtp_bytes += 4;
+    }
+    if (gtp->ex) {
+      while (gtp_bytes <= len - off && p[off + gtp_bytes - 1] != 0) {
+        if (gtp_bytes == len - off || p[off + gtp_bytes] == 0) {
+          return;
+        }
+        gtp_bytes += static_cast<uint8_t>(p[off + gtp_bytes]) << 2;
+      }
+    }
+    if (len < off + gtp_bytes) {
+      return;
+    }
+
+    length_fields_.push_back({off + offsetof(Gtpv1, length),
+                              gtp->length.value() - static_cast<int>(len)});
+    off += gtp_bytes;
+    headers_end_ = off;
+  }
+}
+
+void PacketTemplate::BuildTemplates() {
+  tmpls_.clear();
+
+  for (size_t size : sizes_) {
+    std::string t(size, '\0');
+    memcpy(&t[0], tmpl_.data(), std::min(size, tmpl_.size()));
+
+    for (const LengthField &lf : length_fields_) {
+      be16_t value(static_cast<uint16_t>(size + lf.delta));
+      memcpy(&t[lf.offset], &value, sizeof(value));
+    }
+
+    for (size_t off : udp_csum_offsets_) {
+      memset(&t[off], 0, sizeof(uint16_t));
+    }
+
+    for (size_t off : ipv4_offsets_) {
+      Ipv4 *ip = reinterpret_cast<Ipv4 *>(&t[off]);
+      ip->checksum = CalculateIpv4Checksum(*ip);
+    }
+
+    tmpls_.push_back(std::move(t));
+  }
+
+  size_cursor_ = 0;
+  min_size_ = *std::min_element(sizes_.begin(), sizes_.end());
+  max_size_ = *std::max_element(sizes_.begin(), sizes_.end());
+}
+
+void PacketTemplate::FillFields(FieldState *state, void *const *bufs,
+                                size_t cnt) {
+  const Field &field = state->field;
+  const uint64_t cursor = state->cursor;
+  const uint64_t count = field.count;
+  const uint32_t base = state->base;
+  const uint32_t step = field.step;
+
+  // Compute all values of the chunk first, in loops free of dependencies
+  // across packets so that they can be vectorized.
+  uint32_t vals[kMaxBurst];
+
+  if (count >= cnt) {
+    for (size_t i = 0; i < cnt; i++) {
+      uint64_t idx = cursor + i;
+      idx = (idx >= count) ? idx - count : idx;
+      vals[i] = base + static_cast<uint32_t>(idx) * step;
+    }
+  } else {
+    for (size_t i = 0; i < cnt; i++) {
+      vals[i] = base + static_cast<uint32_t>((cursor + i) % count) * step;
+    }
+  }
+
+  state->cursor = (cursor + cnt) % count;
+
+  const size_t offset = field.offset;
+
+  switch (field.size) {
+    case 1:
+      for (size_t i = 0; i < cnt; i++) {
+        static_cast<uint8_t *>(bufs[i])[offset] = vals[i];
+      }
+      break;
+    case 2:
+      for (size_t i = 0; i < cnt; i++) {
+        uint16_t v = __builtin_bswap16(vals[i]);
+        memcpy(static_cast<char *>(bufs[i]) + offset, &v, sizeof(v));
+      }
+      break;
+    case 4:
+      for (size_t i = 0; i < cnt; i++) {
+        uint32_t v = __builtin_bswap32(vals[i]);
+        memcpy(static_cast<char *>(bufs[i]) + offset, &v, sizeof(v));
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+size_t PacketTemplate::Fill(void *const *bufs, uint16_t *sizes, size_t cnt,
+                            uint64_t now_ns) {
+  size_t total_bytes = 0;
+
+  for (size_t i = 0; i < cnt; i++) {
+    const std::string &t = tmpls_[size_seq_[size_cursor_]];
+    if (++size_cursor_ == size_seq_.size()) {
+      size_cursor_ = 0;
+    }
+
+    CopyInlined(bufs[i], t.data(), t.size());
+    sizes[i] = t.size();
+    total_bytes += t.size();
+  }
+
+  for (size_t i = 0; i < cnt; i += kMaxBurst) {
+    size_t n = std::min(kMaxBurst, cnt - i);
+    for (FieldState &state : fields_) {
+      FillFields(&state, bufs + i, n);
+    }
+  }
+
+  if (seq_enabled_) {
+    for (size_t i = 0; i < cnt; i++) {
+      uint32_t v = __builtin_bswap32(seq_++);
+      memcpy(static_cast<char *>(bufs[i]) + seq_offset_, &v, sizeof(v));
+    }
+  }
+
+  if (ts_enabled_) {
+    for (size_t i = 0; i < cnt; i++) {
+      char *p = static_cast<char *>(bufs[i]) + ts_offset_;
+      memcpy(p, &ts_marker_, sizeof(ts_marker_));
+      memcpy(p + sizeof(ts_marker_), &now_ns, sizeof(now_ns));
+    }
+  }
+
+  if (refresh_ipv4_csum_) {
+    for (size_t i = 0; i < cnt; i++) {
+      for (size_t off : ipv4_offsets_) {
+        Ipv4 *ip = reinterpret_cast<Ipv4 *>(static_cast<char *>(bufs[i]) + off);
+        ip->checksum = CalculateIpv4Checksum(*ip);
+      }
+    }
+  }
+
+  return total_bytes;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,156 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PACKET_TEMPLATE_H_
+#define BESS_UTILS_PACKET_TEMPLATE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+using Error = std::pair<int, std::string>;
+
+// Stamps packets out of a precomputed template, for traffic generation.
+//
+// The template is laid out once per packet size (see SetImix()), with the
+// length fields of the Ethernet/IPv4/UDP[/GTP-U/IPv4/UDP] headers found in the
+// template adjusted to that size. Per packet, Fill() only copies the template
+// and then, a burst at a time and field by field, writes the varying fields
+// (e.g., IP addresses, ports, TEIDs), an optional sequence number and an
+// optional timestamp, and finally refreshes the IPv4 header checksums.
+// UDP checksums are cleared since they are optional over IPv4; TCP checksums
+// are left as they are in the template.
+class PacketTemplate {
+ public:
+  // Fill() processes packets in chunks of this many
+  static constexpr size_t kMaxBurst = 32;
+
+  // A big-endian field of 'size' (1, 2, or 4) bytes at 'offset'. It starts
+  // from the value found in the template and is incremented by 'step' for
+  // every packet, going back to the template value after 'count' packets
+  // (0 means the full range of the field).
+  struct Field {
+    size_t offset;
+    size_t size;
+    uint32_t step;
+    uint64_t count;
+  };
+
+  PacketTemplate();
+
+  // Sets the template packet. This resets everything else.
+  Error SetTemplate(const void *data, size_t len);
+
+  // Packet sizes are drawn from 'sizes' (in bytes, without CRC) in proportion
+  // to 'weights', e.g., {64, 594, 1518} with {7, 4, 1} for the simple IMIX.
+  // By default all packets are as large as the template.
+  Error SetImix(const std::vector<size_t> &sizes,
+                const std::vector<uint32_t> &weights);
+
+  Error AddField(const Field &field);
+
+  // Writes a 32-bit big-endian sequence number at 'offset'
+  Error SetSequence(size_t offset);
+
+  // Writes the 32-bit 'marker' followed by the 64-bit time in nanoseconds
+  // at 'offset', both in host order. This is the format the Timestamp module
+  // uses, so that Measure can consume it.
+  Error SetTimestamp(size_t offset, uint32_t marker);
+
+  // Fills 'cnt' buffers of at least max_size() bytes each and stores the
+  // packet sizes in 'sizes'. Returns the total number of bytes.
+  size_t Fill(void *const *bufs, uint16_t *sizes, size_t cnt,
+              uint64_t now_ns);
+
+  bool empty() const { return tmpls_.empty(); }
+  size_t min_size() const { return min_size_; }
+  size_t max_size() const { return max_size_; }
+
+ private:
+  // A length field to be set to the packet size plus 'delta'
+  struct LengthField {
+    size_t offset;
+    int delta;
+  };
+
+  struct FieldState {
+    Field field;
+    uint32_t base;    // initial value, in host order
+    uint64_t cursor;  // [0, count)
+  };
+
+  // Finds the headers whose lengths and checksums depend on the packet size
+  void ParseHeaders();
+
+  // Lays out the template for every packet size
+  void BuildTemplates();
+
+  Error CheckRange(size_t offset, size_t size) const;
+
+  void FillFields(FieldState *state, void *const *bufs, size_t cnt);
+
+  std::string tmpl_;
+
+  std::vector<size_t> sizes_;
+  std::vector<std::string> tmpls_;  // one per entry of sizes_
+
+  // Indices into sizes_, in the order they are used
+  std::vector<uint16_t> size_seq_;
+  size_t size_cursor_;
+
+  std::vector<LengthField> length_fields_;
+  std::vector<size_t> ipv4_offsets_;
+  std::vector<size_t> udp_csum_offsets_;
+  size_t headers_end_;
+
+  std::vector<FieldState> fields_;
+
+  // Whether any field lies in an IPv4 header
+  bool refresh_ipv4_csum_;
+
+  bool seq_enabled_;
+  size_t seq_offset_;
+  uint32_t seq_;
+
+  bool ts_enabled_;
+  size_t ts_offset_;
+  uint32_t ts_marker_;
+
+  size_t min_size_;
+  size_t max_size_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PACKET_TEMPLATE_H_
@@ -0,0 +1,252 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "packet_template.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <map>
+
+#include "checksum.h"
+#include "ether.h"
+#include "gtp.h"
+#include "ip.h"
+#include "udp.h"
+
+namespace {
+
+using bess::utils::be16_t;
+using bess::utils::be32_t;
+using bess::utils::Ethernet;
+using bess::utils::Gtpv1;
+using bess::utils::Ipv4;
+using bess::utils::PacketTemplate;
+using bess::utils::Udp;
+
+const size_t kOuterIp = sizeof(Ethernet);
+const size_t kOuterUdp = kOuterIp + sizeof(Ipv4);
+const size_t kGtp = kOuterUdp + sizeof(Udp);
+const size_t kInnerIp = kGtp + sizeof(Gtpv1);
+const size_t kInnerUdp = kInnerIp + sizeof(Ipv4);
+const size_t kPayload = kInnerUdp + sizeof(Udp);
+const size_t kTemplateSize = 100;
+
+void FillIpv4(Ipv4 *ip, uint16_t length, uint32_t src, uint32_t dst) {
+  ip->version = 4;
+  ip->header_length = 5;
+  ip->length = be16_t(length);
+  ip->ttl = 64;
+  ip->protocol = Ipv4::Proto::kUdp;
+  ip->src = be32_t(src);
+  ip->dst = be32_t(dst);
+}
+
+// Ethernet/IPv4/UDP/GTP-U/IPv4/UDP
+std::string GtpuTemplate() {
+  std::string pkt(kTemplateSize, '\0');
+  char *p = &pkt[0];
+
+  reinterpret_cast<Ethernet *>(p)->ether_type = be16_t(Ethernet::Type::kIpv4);
+  FillIpv4(reinterpret_cast<Ipv4 *>(p + kOuterIp), kTemplateSize - kOuterIp,
+           0x0a000001, 0x0a000002);
+
+  Udp *udp = reinterpret_cast<Udp *>(p + kOuterUdp);
+  udp->src_port = be16_t(UDP_PORT_GTPU);
+  udp->dst_port = be16_t(UDP_PORT_GTPU);
+  udp->length = be16_t(kTemplateSize - kOuterUdp);
+  udp->checksum = 0x1234;
+
+  Gtpv1 *gtp = reinterpret_cast<Gtpv1 *>(p + kGtp);
+  gtp->version = GTPU_VERSION;
+  gtp->pt = 1;
+  gtp->type = GTP_GPDU;
+  gtp->length = be16_t(kTemplateSize - kInnerIp);
+  gtp->teid = be32_t(0x100);
+
+  FillIpv4(reinterpret_cast<Ipv4 *>(p + kInnerIp), kTemplateSize - kInnerIp,
+           0xc0a80001, 0x08080808);
+
+  udp = reinterpret_cast<Udp *>(p + kInnerUdp);
+  udp->src_port = be16_t(1000);
+  udp->dst_port = be16_t(2000);
+  udp->length = be16_t(kTemplateSize - kInnerUdp);
+
+  return pkt;
+}
+
+template <typename T>
+T *At(std::string &buf, size_t offset) {
+  return reinterpret_cast<T *>(&buf[offset]);
+}
+
+class PacketTemplateTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::string pkt = GtpuTemplate();
+    ASSERT_EQ(0, gen_.SetTemplate(pkt.data(), pkt.size()).first);
+  }
+
+  // Generates 'cnt' packets into bufs_
+  void Generate(size_t cnt, uint64_t now_ns = 0) {
+    bufs_.assign(cnt, std::string(gen_.max_size(), '\0'));
+    sizes_.assign(cnt, 0);
+
+    std::vector<void *> ptrs;
+    for (std::string &buf : bufs_) {
+      ptrs.push_back(&buf[0]);
+    }
+
+    size_t total = gen_.Fill(ptrs.data(), sizes_.data(), cnt, now_ns);
+    size_t expected = 0;
+    for (size_t i = 0; i < cnt; i++) {
+      expected += sizes_[i];
+      bufs_[i].resize(sizes_[i]);
+    }
+    EXPECT_EQ(expected, total);
+  }
+
+  PacketTemplate gen_;
+  std::vector<std::string> bufs_;
+  std::vector<uint16_t> sizes_;
+};
+
+TEST_F(PacketTemplateTest, Lengths) {
+  ASSERT_EQ(0, gen_.SetImix({kPayload, 594, 1518}, {1, 1, 1}).first);
+  EXPECT_EQ(kPayload, gen_.min_size());
+  EXPECT_EQ(1518, gen_.max_size());
+
+  Generate(3);
+  for (std::string &buf : bufs_) {
+    size_t size = buf.size();
+    Ipv4 *outer_ip = At<Ipv4>(buf, kOuterIp);
+    Ipv4 *inner_ip = At<Ipv4>(buf, kInnerIp);
+
+    EXPECT_EQ(size - kOuterIp, outer_ip->length.value());
+    EXPECT_EQ(size - kOuterUdp, At<Udp>(buf, kOuterUdp)->length.value());
+    EXPECT_EQ(size - kInnerIp, At<Gtpv1>(buf, kGtp)->length.value());
+    EXPECT_EQ(size - kInnerIp, inner_ip->length.value());
+    EXPECT_EQ(size - kInnerUdp, At<Udp>(buf, kInnerUdp)->length.value());
+
+    EXPECT_TRUE(bess::utils::VerifyIpv4Checksum(*outer_ip));
+    EXPECT_TRUE(bess::utils::VerifyIpv4Checksum(*inner_ip));
+    EXPECT_EQ(0, At<Udp>(buf, kOuterUdp)->checksum);
+  }
+}
+
+TEST_F(PacketTemplateTest, Imix) {
+  ASSERT_EQ(0, gen_.SetImix({kPayload, 594, 1518}, {7, 4, 1}).first);
+
+  // A whole cycle of sizes comes out in the given proportion
+  std::map<size_t, int> counts;
+  Generate(12 * 10);
+  for (uint16_t size : sizes_) {
+    counts[size]++;
+  }
+  EXPECT_EQ(70, counts[kPayload]);
+  EXPECT_EQ(40, counts[594]);
+  EXPECT_EQ(10, counts[1518]);
+
+  // Sizes are interleaved, rather than in runs of 7, 4, and 1
+  bool interleaved = false;
+  for (size_t i = 0; i < 7; i++) {
+    interleaved |= (sizes_[i] != kPayload);
+  }
+  EXPECT_TRUE(interleaved);
+}
+
+TEST_F(PacketTemplateTest, Fields) {
+  // Inner source address: 3 values, 2 apart
+  ASSERT_EQ(0, gen_.AddField({kInnerIp + offsetof(Ipv4, src), 4, 2, 3}).first);
+  // TEID: over the full range, i.e., never wraps here
+  ASSERT_EQ(0, gen_.AddField({kGtp + offsetof(Gtpv1, teid), 4, 1, 0}).first);
+  // Inner source port: wraps at 16 bits
+  ASSERT_EQ(0,
+            gen_.AddField({kInnerUdp + offsetof(Udp, src_port), 2, 65000, 0})
+                .first);
+
+  // More than one chunk
+  const size_t cnt = PacketTemplate::kMaxBurst * 2 + 5;
+  Generate(cnt);
+  for (size_t i = 0; i < cnt; i++) {
+    std::string &buf = bufs_[i];
+    Ipv4 *inner_ip = At<Ipv4>(buf, kInnerIp);
+
+    EXPECT_EQ(0xc0a80001 + (i % 3) * 2, inner_ip->src.value());
+    EXPECT_EQ(0x100 + i, At<Gtpv1>(buf, kGtp)->teid.value());
+    EXPECT_EQ(static_cast<uint16_t>(1000 + i * 65000),
+              At<Udp>(buf, kInnerUdp)->src_port.value());
+    EXPECT_TRUE(bess::utils::VerifyIpv4Checksum(*inner_ip));
+  }
+
+  // Fields carry on across calls
+  Generate(1);
+  EXPECT_EQ(0xc0a80001 + (cnt % 3) * 2,
+            At<Ipv4>(bufs_[0], kInnerIp)->src.value());
+  EXPECT_EQ(0x100 + cnt, At<Gtpv1>(bufs_[0], kGtp)->teid.value());
+}
+
+TEST_F(PacketTemplateTest, Stamps) {
+  const uint32_t kMarker = 0x54C5BE55;
+  ASSERT_EQ(0, gen_.SetSequence(kPayload).first);
+  ASSERT_EQ(0, gen_.SetTimestamp(kPayload + 4, kMarker).first);
+
+  Generate(40, 123456789);
+  for (size_t i = 0; i < bufs_.size(); i++) {
+    uint32_t marker;
+    uint64_t ts;
+    memcpy(&marker, &bufs_[i][kPayload + 4], sizeof(marker));
+    memcpy(&ts, &bufs_[i][kPayload + 8], sizeof(ts));
+
+    EXPECT_EQ(i, At<be32_t>(bufs_[i], kPayload)->value());
+    EXPECT_EQ(kMarker, marker);
+    EXPECT_EQ(123456789, ts);
+  }
+}
+
+TEST_F(PacketTemplateTest, Errors) {
+  EXPECT_EQ(EINVAL, gen_.AddField({0, 3, 1, 0}).first);
+  EXPECT_EQ(EINVAL, gen_.AddField({kTemplateSize - 1, 2, 1, 0}).first);
+  EXPECT_EQ(EINVAL, gen_.SetSequence(kTemplateSize - 2).first);
+
+  // Sizes must hold all headers
+  EXPECT_EQ(EINVAL, gen_.SetImix({kPayload - 1}, {1}).first);
+  EXPECT_EQ(EINVAL, gen_.SetImix({64, 128}, {1}).first);
+  EXPECT_EQ(EINVAL, gen_.SetImix({64, 128}, {1, 0}).first);
+
+  // Existing fields must fit in the new sizes
+  ASSERT_EQ(0, gen_.AddField({90, 4, 1, 0}).first);
+  EXPECT_EQ(EINVAL, gen_.SetImix({64, 128}, {1, 1}).first);
+  EXPECT_EQ(0, gen_.SetImix({96, 128}, {1, 1}).first);
+
+  PacketTemplate empty;
+  EXPECT_EQ(EINVAL, empty.SetTemplate("", 0).first);
+  EXPECT_EQ(EINVAL, empty.SetSequence(0).first);
+}
+
+}  // namespace
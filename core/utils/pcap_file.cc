@@ -0,0 +1,317 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "pcap.h"
+#include "pcapng.h"
+
+namespace bess {
+namespace utils {
+
+namespace {
+
+// Same as PCAP_MAGIC_NUMBER, but with nanosecond timestamps.
+const uint32_t kPcapMagicNsec = 0xa1b23c4d;
+
+// pcapng if_tsresol option, and its default: microseconds.
+const uint16_t kOptTsresol = 9;
+const uint8_t kDefaultTsresol = 6;
+
+// pcapng Simple Packet Block: no interface id nor timestamp.
+const uint32_t kSimplePacketBlockType = 0x00000003;
+
+inline uint16_t Load16(const uint8_t *p, bool swap) {
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return swap ? __builtin_bswap16(v) : v;
+}
+
+inline uint32_t Load32(const uint8_t *p, bool swap) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return swap ? __builtin_bswap32(v) : v;
+}
+
+// Converts a pcapng timestamp in units given by if_tsresol to nanoseconds:
+// 10^-n seconds, or 2^-n seconds if the most significant bit is set.
+uint64_t TsToNs(uint64_t ts, uint8_t tsresol) {
+  if (tsresol & 0x80) {
+    return (static_cast<unsigned __int128>(ts) * 1000000000) >>
+           (tsresol & 0x7f);
+  }
+
+  for (uint8_t exp = tsresol; exp < 9; exp++) {
+    ts *= 10;
+  }
+  for (uint8_t exp = 9; exp < tsresol; exp++) {
+    ts /= 10;
+  }
+  return ts;
+}
+
+}  // namespace
+
+int PcapFile::Open(const std::string &path, std::string *err) {
+  Close();
+
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    *err = "open(" + path + ") failed";
+    return -errno;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    int ret = -errno;
+    close(fd);
+    *err = "fstat(" + path + ") failed";
+    return ret;
+  }
+
+  if (st.st_size < static_cast<off_t>(sizeof(pcap_hdr))) {
+    close(fd);
+    *err = path + " is not a pcap or pcapng file";
+    return -EINVAL;
+  }
+
+  // MAP_POPULATE reads the whole file in now, rather than at replay time.
+  void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE,
+                 fd, 0);
+  int ret = -errno;
+  close(fd);
+  if (p == MAP_FAILED) {
+    *err = "mmap(" + path + ") failed";
+    return ret;
+  }
+
+  base_ = static_cast<const uint8_t *>(p);
+  size_ = st.st_size;
+
+  if (Load32(base_, false) == pcapng::SectionHeaderBlock::kType) {
+    ret = ParsePcapng(err);
+  } else {
+    ret = ParsePcap(err);
+  }
+
+  if (ret < 0) {
+    *err = path + ": " + *err;
+    Close();
+    return ret;
+  }
+
+  NormalizeTimestamps();
+  return 0;
+}
+
+void PcapFile::Close() {
+  if (base_) {
+    munmap(const_cast<uint8_t *>(base_), size_);
+    base_ = nullptr;
+    size_ = 0;
+  }
+  records_.clear();
+}
+
+int PcapFile::ParsePcap(std::string *err) {
+  bool swap;
+  bool nsec;
+
+  switch (Load32(base_, false)) {
+    case PCAP_MAGIC_NUMBER:
+      swap = false;
+      nsec = false;
+      break;
+    case __builtin_bswap32(PCAP_MAGIC_NUMBER):
+      swap = true;
+      nsec = false;
+      break;
+    case kPcapMagicNsec:
+      swap = false;
+      nsec = true;
+      break;
+    case __builtin_bswap32(kPcapMagicNsec):
+      swap = true;
+      nsec = true;
+      break;
+    default:
+      *err = "not a pcap or pcapng file";
+      return -EINVAL;
+  }
+
+  if (Load32(base_ + offsetof(pcap_hdr, network), swap) != PCAP_NETWORK) {
+    *err = "not an Ethernet capture";
+    return -EINVAL;
+  }
+
+  size_t off = sizeof(pcap_hdr);
+  while (off + sizeof(pcap_rec_hdr) <= size_) {
+    const uint8_t *rec = base_ + off;
+    uint64_t sec = Load32(rec + offsetof(pcap_rec_hdr, ts_sec), swap);
+    uint64_t frac = Load32(rec + offsetof(pcap_rec_hdr, ts_usec), swap);
+    uint32_t len = Load32(rec + offsetof(pcap_rec_hdr, incl_len), swap);
+
+    off += sizeof(pcap_rec_hdr);
+    if (len > size_ - off) {
+      break;
+    }
+
+    records_.push_back({base_ + off, len,
+                        sec * 1000000000 + (nsec ? frac : frac * 1000)});
+    off += len;
+  }
+
+  return 0;
+}
+
+int PcapFile::ParsePcapng(std::string *err) {
+  // if_tsresol of each interface in the current section
+  std::vector<uint8_t> ifaces;
+  bool swap = false;
+
+  size_t off = 0;
+  while (off + 3 * sizeof(uint32_t) <= size_) {
+    const uint8_t *block = base_ + off;
+    uint32_t type = Load32(block, swap);
+
+    // The type of a section header reads the same in either byte order.
+    if (type == pcapng::SectionHeaderBlock::kType) {
+      uint32_t bom = Load32(block + 8, false);
+      if (bom == pcapng::SectionHeaderBlock::kBom) {
+        swap = false;
+      } else if (bom == __builtin_bswap32(pcapng::SectionHeaderBlock::kBom)) {
+        swap = true;
+      } else {
+        *err = "bad pcapng byte-order magic";
+        return -EINVAL;
+      }
+      ifaces.clear();
+    }
+
+    uint32_t len = Load32(block + 4, swap);
+    if (len > size_ - off) {
+      break;
+    }
+    if (len < 3 * sizeof(uint32_t) || len % 4) {
+      *err = "bad pcapng block length at offset " + std::to_string(off);
+      return -EINVAL;
+    }
+
+    switch (type) {
+      case pcapng::InterfaceDescriptionBlock::kType: {
+        if (len < 20) {
+          *err = "short interface block";
+          return -EINVAL;
+        }
+        if (Load16(block + 8, swap) !=
+            pcapng::InterfaceDescriptionBlock::kEthernet) {
+          *err = "not an Ethernet capture";
+          return -EINVAL;
+        }
+
+        uint8_t tsresol = kDefaultTsresol;
+        size_t opt = 16;
+        while (opt + 4 <= len - 4) {
+          uint16_t code = Load16(block + opt, swap);
+          uint16_t opt_len = Load16(block + opt + 2, swap);
+          if (code == pcapng::Option::kEndOfOpts) {
+            break;
+          }
+          if (code == kOptTsresol && opt_len == 1) {
+            tsresol = block[opt + 4];
+          }
+          opt += 4 + ((opt_len + 3) & ~3);
+        }
+        ifaces.push_back(tsresol);
+        break;
+      }
+
+      case pcapng::EnhancedPacketBlock::kType: {
+        const size_t hdr = sizeof(pcapng::EnhancedPacketBlock);
+        if (len < hdr + 4) {
+          *err = "short packet block";
+          return -EINVAL;
+        }
+        uint32_t iface = Load32(block + 8, swap);
+        uint64_t ts = (static_cast<uint64_t>(Load32(block + 12, swap)) << 32) |
+                      Load32(block + 16, swap);
+        uint32_t caplen = Load32(block + 20, swap);
+        if (iface >= ifaces.size() || caplen > len - hdr - 4) {
+          *err = "bad packet block at offset " + std::to_string(off);
+          return -EINVAL;
+        }
+        records_.push_back({block + hdr, caplen, TsToNs(ts, ifaces[iface])});
+        break;
+      }
+
+      case kSimplePacketBlockType: {
+        if (ifaces.empty() || len < 16) {
+          *err = "bad packet block at offset " + std::to_string(off);
+          return -EINVAL;
+        }
+        // No timestamp: same time as the previous packet.
+        uint32_t caplen = std::min<uint32_t>(Load32(block + 8, swap), len - 16);
+        uint64_t ts = records_.empty() ? 0 : records_.back().ts_ns;
+        records_.push_back({block + 12, caplen, ts});
+        break;
+      }
+
+      default:  // Statistics, name resolution, ...
+        break;
+    }
+
+    off += len;
+  }
+
+  return 0;
+}
+
+void PcapFile::NormalizeTimestamps() {
+  if (records_.empty()) {
+    return;
+  }
+
+  uint64_t first = records_.front().ts_ns;
+  uint64_t last = 0;
+  for (Record &rec : records_) {
+    rec.ts_ns = std::max(rec.ts_ns, first) - first;
+    rec.ts_ns = last = std::max(rec.ts_ns, last);
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,93 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_PCAP_FILE_H_
+#define BESS_UTILS_PCAP_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "common.h"
+
+namespace bess {
+namespace utils {
+
+// A pcap or pcapng capture file, memory-mapped read-only and indexed, for
+// replay. Only Ethernet captures are accepted.
+//
+// The whole file is faulted in at Open() time, so that walking the records
+// afterwards never blocks on disk.
+class PcapFile {
+ public:
+  struct Record {
+    const uint8_t *data;
+    uint32_t len;    // Captured length (may be less than on the wire)
+    uint64_t ts_ns;  // Capture time, relative to the first record
+  };
+
+  PcapFile() : base_(), size_(), records_() {}
+  ~PcapFile() { Close(); }
+
+  // Maps and indexes the file at `path`. Returns 0 on success, or -errno
+  // with a description in *err. A record cut short at the end of the file
+  // (e.g., tcpdump was killed) ends the capture, and is not an error.
+  int Open(const std::string &path, std::string *err);
+
+  // Unmaps the file. Record data pointers become invalid.
+  void Close();
+
+  bool is_open() const { return base_ != nullptr; }
+
+  const std::vector<Record> &records() const { return records_; }
+
+  // Time between the first and the last record.
+  uint64_t duration_ns() const {
+    return records_.empty() ? 0 : records_.back().ts_ns;
+  }
+
+ private:
+  int ParsePcap(std::string *err);
+  int ParsePcapng(std::string *err);
+
+  // Makes timestamps relative to the first record, and never decreasing
+  // (e.g., for merged captures), so that pacing only ever waits forward.
+  void NormalizeTimestamps();
+
+  const uint8_t *base_;
+  size_t size_;
+  std::vector<Record> records_;
+
+  DISALLOW_COPY_AND_ASSIGN(PcapFile);
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_PCAP_FILE_H_
@@ -0,0 +1,211 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "pcap_file.h"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "pcap.h"
+#include "pcapng.h"
+
+namespace {
+
+using bess::utils::PcapFile;
+
+class PcapFileTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    char tmpl[] = "/tmp/pcap_file_test.XXXXXX";
+    int fd = mkstemp(tmpl);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    path_ = tmpl;
+  }
+
+  void TearDown() override { unlink(path_.c_str()); }
+
+  template <typename T>
+  void Put(const T &v) {
+    buf_.append(reinterpret_cast<const char *>(&v), sizeof(v));
+  }
+
+  void Put32(uint32_t v) { Put(v); }
+
+  void PutSwapped32(uint32_t v) { Put(__builtin_bswap32(v)); }
+
+  void Write() {
+    FILE *f = fopen(path_.c_str(), "w");
+    ASSERT_NE(nullptr, f);
+    ASSERT_EQ(buf_.size(), fwrite(buf_.data(), 1, buf_.size(), f));
+    fclose(f);
+  }
+
+  std::string path_;
+  std::string buf_;
+};
+
+TEST_F(PcapFileTest, Pcap) {
+  Put(pcap_hdr{PCAP_MAGIC_NUMBER, PCAP_VERSION_MAJOR, PCAP_VERSION_MINOR,
+               PCAP_THISZONE, PCAP_SIGFIGS, PCAP_SNAPLEN, PCAP_NETWORK});
+  Put(pcap_rec_hdr{10, 500, 3, 60});
+  buf_.append("abc");
+  Put(pcap_rec_hdr{10, 700, 2, 2});
+  buf_.append("de");
+  // Earlier than the previous record: clamped.
+  Put(pcap_rec_hdr{10, 600, 1, 1});
+  buf_.append("f");
+  // Cut short.
+  Put(pcap_rec_hdr{11, 0, 100, 100});
+  buf_.append("gh");
+  Write();
+
+  PcapFile file;
+  std::string err;
+  ASSERT_EQ(0, file.Open(path_, &err)) << err;
+  ASSERT_EQ(3, file.records().size());
+  EXPECT_EQ(0, memcmp("abc", file.records()[0].data, 3));
+  EXPECT_EQ(3, file.records()[0].len);
+  EXPECT_EQ(0, file.records()[0].ts_ns);
+  EXPECT_EQ(0, memcmp("de", file.records()[1].data, 2));
+  EXPECT_EQ(200000, file.records()[1].ts_ns);
+  EXPECT_EQ(200000, file.records()[2].ts_ns);
+  EXPECT_EQ(200000, file.duration_ns());
+}
+
+TEST_F(PcapFileTest, PcapSwappedNsec) {
+  PutSwapped32(0xa1b23c4d);
+  Put(__builtin_bswap16(PCAP_VERSION_MAJOR));
+  Put(__builtin_bswap16(PCAP_VERSION_MINOR));
+  PutSwapped32(0);
+  PutSwapped32(0);
+  PutSwapped32(PCAP_SNAPLEN);
+  PutSwapped32(PCAP_NETWORK);
+  for (uint32_t ns : {5u, 8u}) {
+    PutSwapped32(1);
+    PutSwapped32(ns);
+    PutSwapped32(4);
+    PutSwapped32(4);
+    buf_.append("wxyz");
+  }
+  Write();
+
+  PcapFile file;
+  std::string err;
+  ASSERT_EQ(0, file.Open(path_, &err)) << err;
+  ASSERT_EQ(2, file.records().size());
+  EXPECT_EQ(4, file.records()[1].len);
+  EXPECT_EQ(3, file.records()[1].ts_ns);
+}
+
+TEST_F(PcapFileTest, Pcapng) {
+  using namespace bess::utils::pcapng;
+
+  // Section header, no options
+  Put32(SectionHeaderBlock::kType);
+  Put32(28);
+  Put32(SectionHeaderBlock::kBom);
+  Put(uint16_t{1});
+  Put(uint16_t{0});
+  Put(int64_t{-1});
+  Put32(28);
+
+  // Interface with nanosecond timestamps
+  Put32(InterfaceDescriptionBlock::kType);
+  Put32(32);
+  Put(uint16_t{InterfaceDescriptionBlock::kEthernet});
+  Put(uint16_t{0});
+  Put32(0);
+  Put(uint16_t{9});  // if_tsresol
+  Put(uint16_t{1});
+  Put32(9);
+  Put32(0);  // opt_endofopt
+  Put32(32);
+
+  // Enhanced packet, 5 bytes padded to 8
+  Put32(EnhancedPacketBlock::kType);
+  Put32(40);
+  Put32(0);
+  Put32(0);
+  Put32(1000);
+  Put32(5);
+  Put32(5);
+  buf_.append("hello\0\0\0", 8);
+  Put32(40);
+
+  // Some other block, skipped
+  Put32(0x00000005);
+  Put32(16);
+  Put32(0);
+  Put32(16);
+
+  // Simple packet
+  Put32(0x00000003);
+  Put32(20);
+  Put32(4);
+  buf_.append("spb!");
+  Put32(20);
+
+  Put32(EnhancedPacketBlock::kType);
+  Put32(36);
+  Put32(0);
+  Put32(0);
+  Put32(3500);
+  Put32(1);
+  Put32(1);
+  buf_.append("z\0\0\0", 4);
+  Put32(36);
+  Write();
+
+  PcapFile file;
+  std::string err;
+  ASSERT_EQ(0, file.Open(path_, &err)) << err;
+  ASSERT_EQ(3, file.records().size());
+  EXPECT_EQ(0, memcmp("hello", file.records()[0].data, 5));
+  EXPECT_EQ(0, memcmp("spb!", file.records()[1].data, 4));
+  EXPECT_EQ(0, file.records()[1].ts_ns);
+  EXPECT_EQ(1, file.records()[2].len);
+  EXPECT_EQ(2500, file.records()[2].ts_ns);
+}
+
+TEST_F(PcapFileTest, Garbage) {
+  buf_.assign(64, 'x');
+  Write();
+
+  PcapFile file;
+  std::string err;
+  EXPECT_EQ(-EINVAL, file.Open(path_, &err));
+  EXPECT_FALSE(file.is_open());
+  EXPECT_EQ(-ENOENT, file.Open(path_ + ".missing", &err));
+}
+
+}  // namespace
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rss_reta.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace bess {
+namespace utils {
+
+size_t RebalanceReta(std::vector<uint16_t> *reta,
+                     const std::vector<double> &rates, double threshold,
+                     size_t max_moves) {
+  size_t num_queues = rates.size();
+  if (num_queues < 2) {
+    return 0;
+  }
+
+  std::vector<size_t> buckets(num_queues);
+  for (uint16_t q : *reta) {
+    if (q < num_queues) {
+      buckets[q]++;
+    }
+  }
+
+  double sum = 0;
+  size_t hot = 0;
+  size_t cold = 0;
+  for (size_t q = 0; q < num_queues; q++) {
+    sum += rates[q];
+    if (rates[q] > rates[hot]) {
+      hot = q;
+    }
+    if (rates[q] < rates[cold]) {
+      cold = q;
+    }
+  }
+
+  double mean = sum / num_queues;
+  if (mean <= 0 || rates[hot] <= mean * threshold || buckets[hot] < 2) {
+    return 0;
+  }
+
+  // Moving a bucket must not just make the cold queue the new hot one.
+  double per_bucket = rates[hot] / buckets[hot];
+  if (rates[cold] + per_bucket >= rates[hot]) {
+    return 0;
+  }
+
+  double excess = std::min(rates[hot] - mean, mean - rates[cold]);
+  size_t moves = std::max<size_t>(1, std::floor(excess / per_bucket));
+  moves = std::min(moves, buckets[hot] - 1);
+  if (max_moves) {
+    moves = std::min(moves, max_moves);
+  }
+
+  // Take buckets from the end of the table, so that repeated steps do not
+  // keep reshuffling the same flows.
+  size_t moved = 0;
+  for (size_t i = reta->size(); i-- > 0 && moved < moves;) {
+    if ((*reta)[i] == hot) {
+      (*reta)[i] = cold;
+      moved++;
+    }
+  }
+  return moved;
+}
+
+}  // namespace utils
+}  // namespace bess
@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_RSS_RETA_H_
+#define BESS_UTILS_RSS_RETA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bess {
+namespace utils {
+
+// One step of RSS rebalancing: if the busiest RX queue gets more than
+// `threshold` times the mean packet rate, moves some of its redirection table
+// (RETA) buckets to the least busy queue.
+//
+// `rates` has the recent packet rate of each queue, and `reta` maps buckets to
+// queues. Load is assumed to be spread evenly over the buckets of a queue, so
+// enough buckets to even out the two queues are moved, but never more than
+// `max_moves` (0 for no limit), and never the last bucket of a queue.
+//
+// Returns the number of buckets moved.
+size_t RebalanceReta(std::vector<uint16_t> *reta,
+                     const std::vector<double> &rates, double threshold,
+                     size_t max_moves);
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_RSS_RETA_H_
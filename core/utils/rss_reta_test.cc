@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "rss_reta.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+namespace {
+
+using bess::utils::RebalanceReta;
+
+// Returns how many buckets of `reta` map to queue `q`.
+size_t CountBuckets(const std::vector<uint16_t> &reta, uint16_t q) {
+  return std::count(reta.begin(), reta.end(), q);
+}
+
+TEST(RssRetaTest, Balanced) {
+  std::vector<uint16_t> reta = {0, 1, 0, 1, 0, 1, 0, 1};
+  std::vector<uint16_t> orig = reta;
+
+  EXPECT_EQ(0, RebalanceReta(&reta, {100, 110}, 1.2, 0));
+  EXPECT_EQ(orig, reta);
+
+  // Idle ports are left alone, too.
+  EXPECT_EQ(0, RebalanceReta(&reta, {0, 0}, 1.2, 0));
+  EXPECT_EQ(orig, reta);
+}
+
+TEST(RssRetaTest, MovesFromHotToCold) {
+  std::vector<uint16_t> reta = {0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2};
+
+  // Queue 0 gets 4 buckets and 400 pps: 100 pps per bucket. Moving one
+  // bucket to queue 2 evens things out best.
+  EXPECT_EQ(1, RebalanceReta(&reta, {400, 200, 100}, 1.2, 0));
+  EXPECT_EQ(3, CountBuckets(reta, 0));
+  EXPECT_EQ(4, CountBuckets(reta, 1));
+  EXPECT_EQ(5, CountBuckets(reta, 2));
+  EXPECT_EQ(2, reta[9]);  // the last bucket of queue 0
+}
+
+TEST(RssRetaTest, MaxMoves) {
+  std::vector<uint16_t> reta(64);
+  for (size_t i = 0; i < reta.size(); i++) {
+    reta[i] = i % 2;
+  }
+
+  // Queue 1 is idle: half of queue 0's buckets should go, but only 4 now.
+  EXPECT_EQ(4, RebalanceReta(&reta, {1000, 0}, 1.2, 4));
+  EXPECT_EQ(28, CountBuckets(reta, 0));
+  EXPECT_EQ(14, RebalanceReta(&reta, {1000, 0}, 1.2, 0));
+  EXPECT_EQ(14, CountBuckets(reta, 0));
+}
+
+TEST(RssRetaTest, SingleHotBucket) {
+  // One elephant flow: nothing to gain by moving its only bucket around.
+  std::vector<uint16_t> reta = {0, 1, 1, 1};
+  EXPECT_EQ(0, RebalanceReta(&reta, {1000, 10}, 1.2, 0));
+
+  // Not even if the hot queue has more, if one bucket carries it all.
+  reta = {0, 0, 1, 1};
+  EXPECT_EQ(0, RebalanceReta(&reta, {1000, 600}, 1.2, 0));
+}
+
+}  // namespace
@@ -0,0 +1,198 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "shm_ring.h"
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+namespace bess {
+namespace utils {
+namespace shm {
+
+void Ring::Attach(void *area, uint32_t ring_size, uint32_t qid,
+                  RingType type) {
+  char *p = static_cast<char *>(area) +
+            (qid * kNumRingTypes + type) * RingBytes(ring_size);
+
+  hdr_ = reinterpret_cast<RingHeader *>(p);
+  descs_ = reinterpret_cast<Desc *>(p + sizeof(RingHeader));
+  size_ = ring_size;
+  mask_ = ring_size - 1;
+  cached_prod_ = hdr_->producer.load(std::memory_order_acquire);
+  cached_cons_ = hdr_->consumer.load(std::memory_order_acquire);
+}
+
+int SendHello(int sock, const Hello &hello, int region_fd, int rings_fd) {
+  int fds[2] = {region_fd, rings_fd};
+  char control[CMSG_SPACE(sizeof(fds))];
+  struct iovec iov = {const_cast<Hello *>(&hello), sizeof(hello)};
+  struct msghdr msg = {};
+
+  memset(control, 0, sizeof(control));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+  ssize_t ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+  if (ret < 0) {
+    return -errno;
+  }
+  return (ret == sizeof(hello)) ? 0 : -EIO;
+}
+
+int RecvHello(int sock, Hello *hello, int *region_fd, int *rings_fd) {
+  int fds[2];
+  char control[CMSG_SPACE(sizeof(fds))];
+  struct iovec iov = {hello, sizeof(*hello)};
+  struct msghdr msg = {};
+
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+  if (ret < 0) {
+    return -errno;
+  }
+
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    return -EPROTO;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+  if (ret != sizeof(*hello) || hello->magic != kMagic ||
+      hello->version != kVersion) {
+    close(fds[0]);
+    close(fds[1]);
+    return -EPROTO;
+  }
+
+  *region_fd = fds[0];
+  *rings_fd = fds[1];
+  return 0;
+}
+
+int Peer::Connect(const char *path) {
+  struct sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+  // This doesn't include the trailing null character.
+  socklen_t addrlen = sizeof(addr.sun_family) + strlen(addr.sun_path);
+  if (addr.sun_path[0] == '@') {
+    addr.sun_path[0] = '\0';
+  }
+
+  int sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if (sock < 0) {
+    return -errno;
+  }
+
+  if (connect(sock, reinterpret_cast<struct sockaddr *>(&addr), addrlen) < 0) {
+    int err = errno;
+    close(sock);
+    return -err;
+  }
+
+  return Attach(sock);
+}
+
+int Peer::Attach(int sock) {
+  int region_fd;
+  int rings_fd;
+
+  Close();
+  sock_ = sock;
+
+  int ret = RecvHello(sock_, &hello_, &region_fd, &rings_fd);
+  if (ret < 0) {
+    Close();
+    return ret;
+  }
+
+  void *region = mmap(nullptr, hello_.region_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, region_fd, 0);
+  void *rings = mmap(nullptr, hello_.rings_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, rings_fd, 0);
+  close(region_fd);
+  close(rings_fd);
+
+  region_ = (region == MAP_FAILED) ? nullptr : static_cast<char *>(region);
+  rings_ = (rings == MAP_FAILED) ? nullptr : static_cast<char *>(rings);
+  if (!region_ || !rings_) {
+    Close();
+    return -ENOMEM;
+  }
+
+  HelloAck ack = {kMagic, kVersion};
+  ssize_t sent = send(sock_, &ack, sizeof(ack), MSG_NOSIGNAL);
+  if (sent != sizeof(ack)) {
+    ret = (sent < 0) ? -errno : -EIO;
+    Close();
+    return ret;
+  }
+
+  return 0;
+}
+
+void Peer::Close() {
+  if (region_) {
+    munmap(region_, hello_.region_size);
+    region_ = nullptr;
+  }
+  if (rings_) {
+    munmap(rings_, hello_.rings_size);
+    rings_ = nullptr;
+  }
+  if (sock_ >= 0) {
+    close(sock_);
+    sock_ = -1;
+  }
+}
+
+}  // namespace shm
+}  // namespace utils
+}  // namespace bess
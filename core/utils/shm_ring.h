@@ -0,0 +1,240 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_SHM_RING_H_
+#define BESS_UTILS_SHM_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Shared-memory packet channel between BESS (ShmPort) and a peer process.
+//
+// This header and shm_ring.cc depend on nothing else in BESS, so that peer
+// applications can build them in.
+//
+// Handshake: BESS listens on a SOCK_SEQPACKET UNIX socket. When a peer
+// connects, BESS sends a Hello message with two file descriptors attached:
+// the packet buffer region and the ring area. The peer maps both (read/write,
+// MAP_SHARED) and answers with a HelloAck. The channel is up until either
+// side closes the socket.
+//
+// The ring area holds 4 rings for each of the Hello::num_queues queues, each
+// with one producer and one consumer. Buffers are owned by BESS and loaned
+// to the peer; each loan carries an id which the peer must hand back, on
+// the same queue, with the buffer:
+//
+//   kFill (BESS -> peer): empty buffers, for the peer to send packets with.
+//   kRx   (peer -> BESS): packets from the peer, in buffers taken from kFill.
+//   kTx   (BESS -> peer): packets for the peer.
+//   kComp (peer -> BESS): buffers taken from kTx, once the peer is done.
+//
+// A Desc gives the data position as an offset in the region. The peer may
+// move the data within the Hello::buf_size bytes that start buf_headroom
+// bytes before the offset it got (e.g., to prepend a header).
+//
+// The region holds only packet buffers, never any BESS state (mbuf headers,
+// metadata), which BESS rebuilds for every buffer that comes back. Still,
+// the peer can read and write all buffers of the region, including those of
+// packets it was not handed, so it must be trusted with their data.
+namespace bess {
+namespace utils {
+namespace shm {
+
+static const uint32_t kMagic = 0x42455353;  // "BESS"
+static const uint32_t kVersion = 1;
+
+enum RingType : uint32_t {
+  kFill = 0,
+  kRx = 1,
+  kTx = 2,
+  kComp = 3,
+  kNumRingTypes = 4,
+};
+
+struct Desc {
+  uint64_t offset;  // of the packet data in the region
+  uint32_t len;     // of the packet data (kFill: room for the data)
+  uint32_t id;      // of the loan
+};
+
+struct Hello {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t num_queues;
+  uint32_t ring_size;     // entries per ring (a power of 2)
+  uint32_t buf_headroom;  // usable bytes in front of a kFill offset
+  uint32_t buf_size;      // usable bytes per buffer, including headroom
+  uint64_t region_size;
+  uint64_t rings_size;
+};
+
+struct HelloAck {
+  uint32_t magic;
+  uint32_t version;
+};
+
+// The shared part of a ring: indices on separate cache lines, followed by
+// the entries.
+struct RingHeader {
+  alignas(64) std::atomic<uint32_t> producer;
+  alignas(64) std::atomic<uint32_t> consumer;
+};
+
+// Size of one ring, and of the ring area, in bytes.
+static inline size_t RingBytes(uint32_t ring_size) {
+  return sizeof(RingHeader) + ring_size * sizeof(Desc);
+}
+
+static inline size_t RingAreaBytes(uint32_t num_queues, uint32_t ring_size) {
+  return num_queues * kNumRingTypes * RingBytes(ring_size);
+}
+
+// One side (producer or consumer) of a ring in the ring area.
+//
+// Producer side: Reserve() slots, fill them in with at(), then Submit().
+// Consumer side: Peek() at entries, read them with at(), then Release().
+class Ring {
+ public:
+  Ring()
+      : hdr_(), descs_(), size_(), mask_(), cached_prod_(), cached_cons_() {}
+
+  // Attaches to ring `type` of queue `qid` in the ring area at `area`.
+  void Attach(void *area, uint32_t ring_size, uint32_t qid, RingType type);
+
+  void Detach() { hdr_ = nullptr; }
+
+  bool is_attached() const { return hdr_ != nullptr; }
+
+  uint32_t size() const { return size_; }
+
+  Desc &at(uint32_t idx) { return descs_[idx & mask_]; }
+
+  // Producer.  Reserves up to `n` slots starting at `*idx`, and returns how
+  // many were reserved.
+  uint32_t Reserve(uint32_t n, uint32_t *idx) {
+    uint32_t free = size_ - (cached_prod_ - cached_cons_);
+    if (free < n) {
+      cached_cons_ = hdr_->consumer.load(std::memory_order_acquire);
+      free = size_ - (cached_prod_ - cached_cons_);
+    }
+    n = n < free ? n : free;
+    *idx = cached_prod_;
+    cached_prod_ += n;
+    return n;
+  }
+
+  // Producer.  Gives back the last `n` reserved (not yet submitted) slots.
+  void Cancel(uint32_t n) { cached_prod_ -= n; }
+
+  // Producer.  Hands the `n` reserved slots over to the consumer.
+  void Submit(uint32_t n) {
+    hdr_->producer.store(hdr_->producer.load(std::memory_order_relaxed) + n,
+                         std::memory_order_release);
+  }
+
+  // Consumer.  Returns how many entries (up to `n`) are ready, starting at
+  // `*idx`.
+  uint32_t Peek(uint32_t n, uint32_t *idx) {
+    uint32_t avail = cached_prod_ - cached_cons_;
+    if (avail < n) {
+      cached_prod_ = hdr_->producer.load(std::memory_order_acquire);
+      avail = cached_prod_ - cached_cons_;
+    }
+    n = n < avail ? n : avail;
+    *idx = cached_cons_;
+    cached_cons_ += n;
+    return n;
+  }
+
+  // Consumer.  Gives the `n` entries back to the producer.
+  void Release(uint32_t n) {
+    hdr_->consumer.store(hdr_->consumer.load(std::memory_order_relaxed) + n,
+                         std::memory_order_release);
+  }
+
+ private:
+  RingHeader *hdr_;
+  Desc *descs_;
+
+  uint32_t size_;
+  uint32_t mask_;
+
+  // Local copies of the shared indices.  For a producer cached_cons_ is only
+  // a lower bound, and vice versa.
+  uint32_t cached_prod_;
+  uint32_t cached_cons_;
+};
+
+// Sends a Hello with the region and ring area descriptors attached.
+// Returns 0 or a negative errno value.
+int SendHello(int sock, const Hello &hello, int region_fd, int rings_fd);
+
+// Receives a Hello and the two descriptors attached to it, and checks its
+// magic and version.  Returns 0 or a negative errno value.
+int RecvHello(int sock, Hello *hello, int *region_fd, int *rings_fd);
+
+// The peer end of a channel.
+class Peer {
+ public:
+  Peer() : sock_(-1), hello_(), region_(), rings_() {}
+  ~Peer() { Close(); }
+
+  // Connects to the ShmPort listening on `path` ('@' for an abstract
+  // address) and maps the shared memory.  Returns 0 or a negative errno
+  // value.
+  int Connect(const char *path);
+
+  // Same as Connect(), on an already connected socket, which the Peer then
+  // owns.
+  int Attach(int sock);
+
+  void Close();
+
+  const Hello &hello() const { return hello_; }
+
+  // Address of region offset `offset`.
+  char *addr(uint64_t offset) const { return region_ + offset; }
+
+  // Attaches `ring` to ring `type` of queue `qid`.
+  void AttachRing(Ring *ring, uint32_t qid, RingType type) const {
+    ring->Attach(rings_, hello_.ring_size, qid, type);
+  }
+
+ private:
+  int sock_;
+  Hello hello_;
+  char *region_;
+  char *rings_;
+};
+
+}  // namespace shm
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_SHM_RING_H_
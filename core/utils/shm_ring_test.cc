@@ -0,0 +1,166 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "shm_ring.h"
+
+#include <gtest/gtest.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace {
+
+using namespace bess::utils::shm;
+
+// A shared, zero-filled mapping of `size` bytes, and its file descriptor.
+char *MapMemfd(size_t size, int *fd) {
+  *fd = memfd_create("shm_ring_test", MFD_CLOEXEC);
+  if (*fd < 0 || ftruncate(*fd, size) < 0) {
+    return nullptr;
+  }
+  void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+  return (p == MAP_FAILED) ? nullptr : static_cast<char *>(p);
+}
+
+TEST(ShmRingTest, ProduceConsume) {
+  const uint32_t kSize = 4;
+  int fd;
+  char *area = MapMemfd(RingAreaBytes(2, kSize), &fd);
+  ASSERT_NE(nullptr, area);
+
+  Ring prod;
+  Ring cons;
+  Ring other;
+  prod.Attach(area, kSize, 1, kTx);
+  cons.Attach(area, kSize, 1, kTx);
+  other.Attach(area, kSize, 1, kComp);
+
+  uint32_t idx;
+  ASSERT_EQ(3, prod.Reserve(3, &idx));
+  for (uint32_t i = 0; i < 3; i++) {
+    prod.at(idx + i) = {i * 100, i, i};
+  }
+  prod.Submit(3);
+
+  // Only 1 slot is left, and cancelled slots can be reserved again.
+  EXPECT_EQ(1, prod.Reserve(2, &idx));
+  prod.Cancel(1);
+  EXPECT_EQ(1, prod.Reserve(1, &idx));
+  prod.Cancel(1);
+
+  ASSERT_EQ(2, cons.Peek(2, &idx));
+  EXPECT_EQ(0, cons.at(idx).offset);
+  EXPECT_EQ(100, cons.at(idx + 1).offset);
+  cons.Release(2);
+
+  ASSERT_EQ(1, cons.Peek(4, &idx));
+  EXPECT_EQ(2, cons.at(idx).id);
+  cons.Release(1);
+  EXPECT_EQ(0, cons.Peek(4, &idx));
+
+  // Full again after wrapping around, and the other ring is untouched.
+  EXPECT_EQ(4, prod.Reserve(8, &idx));
+  EXPECT_EQ(0, other.Peek(4, &idx));
+
+  munmap(area, RingAreaBytes(2, kSize));
+  close(fd);
+}
+
+TEST(ShmRingTest, Handshake) {
+  const uint32_t kSize = 8;
+  const size_t kRegionSize = 4096;
+  int sv[2];
+  ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv));
+
+  int region_fd;
+  int rings_fd;
+  char *region = MapMemfd(kRegionSize, &region_fd);
+  char *rings = MapMemfd(RingAreaBytes(1, kSize), &rings_fd);
+  ASSERT_NE(nullptr, region);
+  ASSERT_NE(nullptr, rings);
+
+  Hello hello = {.magic = kMagic,
+                 .version = kVersion,
+                 .num_queues = 1,
+                 .ring_size = kSize,
+                 .buf_headroom = 128,
+                 .buf_size = 2048,
+                 .region_size = kRegionSize,
+                 .rings_size = RingAreaBytes(1, kSize)};
+  ASSERT_EQ(0, SendHello(sv[0], hello, region_fd, rings_fd));
+
+  Peer peer;
+  ASSERT_EQ(0, peer.Attach(sv[1]));
+  EXPECT_EQ(kSize, peer.hello().ring_size);
+
+  HelloAck ack;
+  ASSERT_EQ(sizeof(ack), recv(sv[0], &ack, sizeof(ack), 0));
+  EXPECT_EQ(kMagic, ack.magic);
+
+  // Loan a buffer through kFill, and get it back through kRx.
+  Ring fill;
+  Ring rx;
+  fill.Attach(rings, kSize, 0, kFill);
+  rx.Attach(rings, kSize, 0, kRx);
+
+  Ring peer_fill;
+  Ring peer_rx;
+  peer.AttachRing(&peer_fill, 0, kFill);
+  peer.AttachRing(&peer_rx, 0, kRx);
+
+  uint32_t idx;
+  ASSERT_EQ(1, fill.Reserve(1, &idx));
+  fill.at(idx) = {256, 2048, 7};
+  fill.Submit(1);
+
+  uint32_t pidx;
+  ASSERT_EQ(1, peer_fill.Peek(1, &pidx));
+  Desc desc = peer_fill.at(pidx);
+  peer_fill.Release(1);
+  strcpy(peer.addr(desc.offset), "hello");
+
+  ASSERT_EQ(1, peer_rx.Reserve(1, &pidx));
+  peer_rx.at(pidx) = {desc.offset, 6, desc.id};
+  peer_rx.Submit(1);
+
+  ASSERT_EQ(1, rx.Peek(1, &idx));
+  EXPECT_EQ(7, rx.at(idx).id);
+  EXPECT_STREQ("hello", region + rx.at(idx).offset);
+  rx.Release(1);
+
+  peer.Close();
+  munmap(region, kRegionSize);
+  munmap(rings, RingAreaBytes(1, kSize));
+  close(region_fd);
+  close(rings_fd);
+  close(sv[0]);
+}
+
+}  // namespace
@@ -0,0 +1,157 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_WORK_STEALING_DEQUE_H_
+#define BESS_UTILS_WORK_STEALING_DEQUE_H_
+
+#include <glog/logging.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+
+namespace bess {
+namespace utils {
+
+// A bounded, lock-free work-stealing deque (Chase and Lev, "Dynamic Circular
+// Work-Stealing Deque", SPAA '05, with the memory orderings of Le et al.,
+// "Correct and Efficient Work-Stealing for Weak Memory Models", PPoPP '13).
+//
+// Exactly one thread, the owner, may call Push() and Pop(), which operate on
+// the bottom end in LIFO order.  Any other thread may call Steal(), which
+// takes from the top end in FIFO order.  Only pointer types are supported,
+// and nullptr is returned when there is nothing to pop or steal.
+template <typename T>
+class WorkStealingDeque {
+  static_assert(std::is_pointer<T>::value,
+                "WorkStealingDeque only supports pointer types");
+
+ public:
+  static const size_t kDefaultCapacity = 256;
+
+  // `capacity` must be a power of two.
+  explicit WorkStealingDeque(size_t capacity = kDefaultCapacity)
+      : top_(0),
+        bottom_(0),
+        capacity_(capacity),
+        mask_(capacity - 1),
+        buf_(new std::atomic<T>[capacity]) {
+    CHECK(capacity > 0 && (capacity & (capacity - 1)) == 0);
+  }
+
+  // Owner only. Returns false if the deque is full.
+  bool Push(T obj) {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    if (b - t >= static_cast<int64_t>(capacity_)) {
+      return false;
+    }
+    buf_[b & mask_].store(obj, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Owner only. Takes the most recently pushed object.
+  T Pop() {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+
+    if (t > b) {
+      // Empty.
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+
+    T obj = buf_[b & mask_].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last element: race against thieves for it.
+      if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        obj = nullptr;
+      }
+      bottom_.store(b + 1, std::memory_order_relaxed);
+    }
+    return obj;
+  }
+
+  // Any thread. Takes the least recently pushed object.
+  T Steal() {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+
+    if (t >= b) {
+      return nullptr;
+    }
+
+    T obj = buf_[t & mask_].load(std::memory_order_relaxed);
+    if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      // Lost the race against the owner or another thief.
+      return nullptr;
+    }
+    return obj;
+  }
+
+  // Approximate when called concurrently with Push(), Pop() or Steal().
+  size_t Size() const {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? b - t : 0;
+  }
+
+  bool Empty() const { return Size() == 0; }
+
+  size_t Capacity() const { return capacity_; }
+
+  // Not thread safe: only call this while no other thread is using the deque.
+  void Clear() {
+    top_.store(0, std::memory_order_relaxed);
+    bottom_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  // Kept on separate cache lines since thieves only write top_ and the owner
+  // mostly writes bottom_.
+  alignas(64) std::atomic<int64_t> top_;
+  alignas(64) std::atomic<int64_t> bottom_;
+
+  alignas(64) const size_t capacity_;
+  const int64_t mask_;
+  std::unique_ptr<std::atomic<T>[]> buf_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_WORK_STEALING_DEQUE_H_
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "work_stealing_deque.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bess::utils::WorkStealingDeque;
+
+// The owner pops in LIFO order, thieves steal in FIFO order.
+TEST(WorkStealingDequeTest, PopAndStealOrder) {
+  WorkStealingDeque<int *> q(8);
+  int vals[4];
+
+  EXPECT_TRUE(q.Empty());
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(q.Push(&vals[i]));
+  }
+  EXPECT_EQ(4, q.Size());
+
+  EXPECT_EQ(&vals[3], q.Pop());
+  EXPECT_EQ(&vals[0], q.Steal());
+  EXPECT_EQ(&vals[2], q.Pop());
+  EXPECT_EQ(&vals[1], q.Steal());
+
+  EXPECT_EQ(nullptr, q.Pop());
+  EXPECT_EQ(nullptr, q.Steal());
+  EXPECT_TRUE(q.Empty());
+}
+
+TEST(WorkStealingDequeTest, Full) {
+  WorkStealingDeque<int *> q(4);
+  int vals[5];
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(q.Push(&vals[i]));
+  }
+  EXPECT_FALSE(q.Push(&vals[4]));
+
+  // Stealing frees up a slot at the other end.
+  EXPECT_EQ(&vals[0], q.Steal());
+  EXPECT_TRUE(q.Push(&vals[4]));
+  EXPECT_EQ(4, q.Size());
+
+  q.Clear();
+  EXPECT_TRUE(q.Empty());
+  EXPECT_EQ(nullptr, q.Pop());
+}
+
+// Every pushed object must be taken exactly once, either by the owner or by
+// one of the thieves.
+TEST(WorkStealingDequeTest, ConcurrentSteal) {
+  const int kItems = 100000;
+  const int kThieves = 3;
+
+  WorkStealingDeque<int *> q(1024);
+  std::vector<int> vals(kItems);
+  std::vector<std::atomic<int>> taken(kItems);
+  for (auto &t : taken) {
+    t = 0;
+  }
+
+  std::atomic<bool> done(false);
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < kThieves; i++) {
+    thieves.emplace_back([&]() {
+      while (!done.load()) {
+        if (int *p = q.Steal()) {
+          taken[p - vals.data()]++;
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < kItems; i++) {
+    while (!q.Push(&vals[i])) {
+      if (int *p = q.Pop()) {
+        taken[p - vals.data()]++;
+      }
+    }
+    if (i % 3 == 0) {
+      if (int *p = q.Pop()) {
+        taken[p - vals.data()]++;
+      }
+    }
+  }
+  while (int *p = q.Pop()) {
+    taken[p - vals.data()]++;
+  }
+
+  done = true;
+  for (auto &t : thieves) {
+    t.join();
+  }
+
+  for (int i = 0; i < kItems; i++) {
+    ASSERT_EQ(1, taken[i]) << "item " << i;
+  }
+}
+
+}  // namespace
@@ -0,0 +1,315 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "xsk.h"
+
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <initializer_list>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+
+namespace bess {
+namespace utils {
+
+template <typename T>
+int XskSocket::MapRing(XskRing<T> *ring, const struct xdp_ring_offset &off,
+                       uint32_t size, uint64_t pgoff) {
+  size_t map_size = off.desc + size * sizeof(T);
+  void *map = mmap(nullptr, map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, pgoff);
+  if (map == MAP_FAILED) {
+    return -errno;
+  }
+
+  char *base = static_cast<char *>(map);
+  ring->producer_ =
+      reinterpret_cast<std::atomic<uint32_t> *>(base + off.producer);
+  ring->consumer_ =
+      reinterpret_cast<std::atomic<uint32_t> *>(base + off.consumer);
+  ring->flags_ = reinterpret_cast<uint32_t *>(base + off.flags);
+  ring->ring_ = reinterpret_cast<T *>(base + off.desc);
+  ring->map_ = map;
+  ring->map_size_ = map_size;
+  ring->size_ = size;
+  ring->mask_ = size - 1;
+  ring->cached_prod_ = ring->producer_->load(std::memory_order_relaxed);
+  ring->cached_cons_ = ring->consumer_->load(std::memory_order_relaxed);
+  return 0;
+}
+
+template <typename T>
+void XskSocket::UnmapRing(XskRing<T> *ring) {
+  if (ring->map_) {
+    munmap(ring->map_, ring->map_size_);
+  }
+  *ring = XskRing<T>();
+}
+
+int XskSocket::Open(const Config &config, const Umem &umem, int shared_fd) {
+  struct xdp_mmap_offsets off;
+  socklen_t optlen = sizeof(off);
+  int ret;
+
+  fd_ = socket(AF_XDP, SOCK_RAW | SOCK_CLOEXEC, 0);
+  if (fd_ < 0) {
+    return -errno;
+  }
+
+  if (shared_fd < 0) {
+    struct xdp_umem_reg reg = {
+        .addr = reinterpret_cast<uint64_t>(umem.addr),
+        .len = umem.len,
+        .chunk_size = umem.chunk_size,
+        .headroom = umem.headroom,
+        .flags = umem.flags,
+    };
+    if (setsockopt(fd_, SOL_XDP, XDP_UMEM_REG, &reg, sizeof(reg)) < 0) {
+      goto fail;
+    }
+  }
+
+  // Even with a shared UMEM, each socket bound to a different queue needs its
+  // own fill and completion rings.
+  if (setsockopt(fd_, SOL_XDP, XDP_UMEM_FILL_RING, &config.fill_size,
+                 sizeof(config.fill_size)) < 0 ||
+      setsockopt(fd_, SOL_XDP, XDP_UMEM_COMPLETION_RING, &config.comp_size,
+                 sizeof(config.comp_size)) < 0) {
+    goto fail;
+  }
+  if (config.rx_size && setsockopt(fd_, SOL_XDP, XDP_RX_RING, &config.rx_size,
+                                   sizeof(config.rx_size)) < 0) {
+    goto fail;
+  }
+  if (config.tx_size && setsockopt(fd_, SOL_XDP, XDP_TX_RING, &config.tx_size,
+                                   sizeof(config.tx_size)) < 0) {
+    goto fail;
+  }
+
+  if (getsockopt(fd_, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+    goto fail;
+  }
+
+  if ((ret = MapRing(&fill, off.fr, config.fill_size,
+                     XDP_UMEM_PGOFF_FILL_RING)) < 0 ||
+      (ret = MapRing(&comp, off.cr, config.comp_size,
+                     XDP_UMEM_PGOFF_COMPLETION_RING)) < 0 ||
+      (config.rx_size &&
+       (ret = MapRing(&rx, off.rx, config.rx_size, XDP_PGOFF_RX_RING)) < 0) ||
+      (config.tx_size &&
+       (ret = MapRing(&tx, off.tx, config.tx_size, XDP_PGOFF_TX_RING)) < 0)) {
+    Close();
+    return ret;
+  }
+
+  {
+    struct sockaddr_xdp addr = {
+        .sxdp_family = AF_XDP,
+        .sxdp_flags = config.bind_flags,
+        .sxdp_ifindex = static_cast<uint32_t>(config.ifindex),
+        .sxdp_queue_id = config.queue_id,
+        .sxdp_shared_umem_fd = 0,
+    };
+    if (shared_fd >= 0) {
+      addr.sxdp_flags |= XDP_SHARED_UMEM;
+      addr.sxdp_shared_umem_fd = shared_fd;
+    }
+    if (bind(fd_, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+        0) {
+      goto fail;
+    }
+  }
+
+  return 0;
+
+fail:
+  ret = -errno;
+  Close();
+  return ret;
+}
+
+void XskSocket::Close() {
+  UnmapRing(&rx);
+  UnmapRing(&tx);
+  UnmapRing(&fill);
+  UnmapRing(&comp);
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+int XskSocket::SetBusyPoll(uint32_t usecs, uint32_t budget) {
+  int one = 1;
+  int us = usecs;
+  int b = budget;
+
+  if (setsockopt(fd_, SOL_SOCKET, SO_PREFER_BUSY_POLL, &one, sizeof(one)) <
+          0 ||
+      setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL, &us, sizeof(us)) < 0 ||
+      setsockopt(fd_, SOL_SOCKET, SO_BUSY_POLL_BUDGET, &b, sizeof(b)) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+void XskSocket::KickTx() {
+  // EAGAIN/EBUSY/ENOBUFS only mean "try again later".
+  sendto(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, 0);
+}
+
+void XskSocket::KickRx() {
+  recvfrom(fd_, nullptr, 0, MSG_DONTWAIT, nullptr, nullptr);
+}
+
+int XskSocket::GetStats(struct xdp_statistics *stats) const {
+  socklen_t optlen = sizeof(*stats);
+  if (getsockopt(fd_, SOL_XDP, XDP_STATISTICS, stats, &optlen) < 0) {
+    return -errno;
+  }
+  return 0;
+}
+
+static int sys_bpf(enum bpf_cmd cmd, union bpf_attr *attr) {
+  int ret = syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+  return ret < 0 ? -errno : ret;
+}
+
+int XdpRedirectProgram::Attach(int ifindex, uint32_t num_queues,
+                               uint32_t xdp_flags) {
+  union bpf_attr attr;
+  int ret;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof(uint32_t);
+  attr.value_size = sizeof(int);
+  attr.max_entries = num_queues;
+  if ((ret = sys_bpf(BPF_MAP_CREATE, &attr)) < 0) {
+    return ret;
+  }
+  map_fd_ = ret;
+
+  // return bpf_redirect_map(&xsks, ctx->rx_queue_index, XDP_PASS);
+  // (the lower bits of the flags are the action if the lookup fails)
+  struct bpf_insn prog[] = {
+      // r2 = ctx->rx_queue_index
+      {.code = BPF_LDX | BPF_MEM | BPF_W,
+       .dst_reg = BPF_REG_2,
+       .src_reg = BPF_REG_1,
+       .off = offsetof(struct xdp_md, rx_queue_index),
+       .imm = 0},
+      // r1 = &xsks (a 16-byte instruction)
+      {.code = BPF_LD | BPF_DW | BPF_IMM,
+       .dst_reg = BPF_REG_1,
+       .src_reg = BPF_PSEUDO_MAP_FD,
+       .off = 0,
+       .imm = map_fd_},
+      {.code = 0, .dst_reg = 0, .src_reg = 0, .off = 0, .imm = 0},
+      // r3 = XDP_PASS
+      {.code = BPF_ALU64 | BPF_MOV | BPF_K,
+       .dst_reg = BPF_REG_3,
+       .src_reg = 0,
+       .off = 0,
+       .imm = XDP_PASS},
+      {.code = BPF_JMP | BPF_CALL,
+       .dst_reg = 0,
+       .src_reg = 0,
+       .off = 0,
+       .imm = BPF_FUNC_redirect_map},
+      {.code = BPF_JMP | BPF_EXIT,
+       .dst_reg = 0,
+       .src_reg = 0,
+       .off = 0,
+       .imm = 0},
+  };
+  static const char license[] = "Dual BSD/GPL";
+
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = reinterpret_cast<uint64_t>(prog);
+  attr.insn_cnt = sizeof(prog) / sizeof(prog[0]);
+  attr.license = reinterpret_cast<uint64_t>(license);
+  if ((ret = sys_bpf(BPF_PROG_LOAD, &attr)) < 0) {
+    Detach();
+    return ret;
+  }
+  prog_fd_ = ret;
+
+  // A BPF link detaches the program automatically when its fd is closed,
+  // even if we crash.
+  memset(&attr, 0, sizeof(attr));
+  attr.link_create.prog_fd = prog_fd_;
+  attr.link_create.target_ifindex = ifindex;
+  attr.link_create.attach_type = BPF_XDP;
+  attr.link_create.flags = xdp_flags;
+  if ((ret = sys_bpf(BPF_LINK_CREATE, &attr)) < 0) {
+    Detach();
+    return ret;
+  }
+  link_fd_ = ret;
+
+  return 0;
+}
+
+int XdpRedirectProgram::Register(uint32_t queue_id, int xsk_fd) {
+  union bpf_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = map_fd_;
+  attr.key = reinterpret_cast<uint64_t>(&queue_id);
+  attr.value = reinterpret_cast<uint64_t>(&xsk_fd);
+  attr.flags = BPF_ANY;
+  int ret = sys_bpf(BPF_MAP_UPDATE_ELEM, &attr);
+  return ret < 0 ? ret : 0;
+}
+
+void XdpRedirectProgram::Detach() {
+  for (int *fd : {&link_fd_, &prog_fd_, &map_fd_}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+}  // namespace utils
+}  // namespace bess
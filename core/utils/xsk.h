@@ -0,0 +1,242 @@
+// SPDX-License-Identifier: BSD-3-Clause
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+//
+// * Redistributions of source code must retain the above copyright notice, this
+// list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+//
+// * Neither the names of the copyright holders nor the names of their
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#ifndef BESS_UTILS_XSK_H_
+#define BESS_UTILS_XSK_H_
+
+#include <linux/if_xdp.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace bess {
+namespace utils {
+
+// One of the four AF_XDP rings (RX, TX, fill, completion), as mapped from the
+// kernel.  Each ring has exactly one producer and one consumer, one of which
+// is the kernel.  T is struct xdp_desc for RX/TX, and uint64_t (a UMEM
+// address) for fill/completion.
+//
+// Producer side: Reserve() slots, fill them in with at(), then Submit().
+// Consumer side: Peek() at entries, read them with at(), then Release().
+template <typename T>
+class XskRing {
+ public:
+  XskRing()
+      : producer_(),
+        consumer_(),
+        flags_(),
+        ring_(),
+        map_(),
+        map_size_(),
+        size_(),
+        mask_(),
+        cached_prod_(),
+        cached_cons_() {}
+
+  bool is_mapped() const { return map_ != nullptr; }
+
+  uint32_t size() const { return size_; }
+
+  T &at(uint32_t idx) { return ring_[idx & mask_]; }
+
+  // Producer.  Reserves up to `n` slots starting at `*idx`, and returns how
+  // many were reserved.
+  uint32_t Reserve(uint32_t n, uint32_t *idx) {
+    uint32_t free = size_ - (cached_prod_ - cached_cons_);
+    if (free < n) {
+      cached_cons_ = consumer_->load(std::memory_order_acquire);
+      free = size_ - (cached_prod_ - cached_cons_);
+    }
+    n = n < free ? n : free;
+    *idx = cached_prod_;
+    cached_prod_ += n;
+    return n;
+  }
+
+  // Producer.  Gives back the last `n` reserved (not yet submitted) slots.
+  void Cancel(uint32_t n) { cached_prod_ -= n; }
+
+  // Producer.  Hands the `n` reserved slots over to the kernel.
+  void Submit(uint32_t n) {
+    producer_->store(producer_->load(std::memory_order_relaxed) + n,
+                     std::memory_order_release);
+  }
+
+  // Consumer.  Returns how many entries (up to `n`) are ready, starting at
+  // `*idx`.
+  uint32_t Peek(uint32_t n, uint32_t *idx) {
+    uint32_t avail = cached_prod_ - cached_cons_;
+    if (avail < n) {
+      cached_prod_ = producer_->load(std::memory_order_acquire);
+      avail = cached_prod_ - cached_cons_;
+    }
+    n = n < avail ? n : avail;
+    *idx = cached_cons_;
+    cached_cons_ += n;
+    return n;
+  }
+
+  // Consumer.  Gives the `n` entries back to the kernel.
+  void Release(uint32_t n) {
+    consumer_->store(consumer_->load(std::memory_order_relaxed) + n,
+                     std::memory_order_release);
+  }
+
+  // Producer.  Returns how many submitted entries the kernel has not
+  // consumed yet, starting at `*idx`.  Only meaningful once the kernel is
+  // done with the ring (e.g., on teardown).
+  uint32_t Outstanding(uint32_t *idx) {
+    cached_cons_ = consumer_->load(std::memory_order_acquire);
+    *idx = cached_cons_;
+    return producer_->load(std::memory_order_relaxed) - cached_cons_;
+  }
+
+  // True if the kernel asks to be woken up (XDP_USE_NEED_WAKEUP) to make
+  // progress on this ring.
+  bool NeedsWakeup() const {
+    return *flags_ & XDP_RING_NEED_WAKEUP;
+  }
+
+ private:
+  friend class XskSocket;
+
+  std::atomic<uint32_t> *producer_;
+  std::atomic<uint32_t> *consumer_;
+  uint32_t *flags_;
+  T *ring_;
+
+  void *map_;
+  size_t map_size_;
+
+  uint32_t size_;
+  uint32_t mask_;
+
+  // Local copies of the shared indices, to touch the shared cache lines as
+  // rarely as possible.  For a producer ring cached_cons_ is only a lower
+  // bound, and vice versa.
+  uint32_t cached_prod_;
+  uint32_t cached_cons_;
+};
+
+// An AF_XDP socket bound to one queue of a network interface.
+//
+// The first socket of a set registers the UMEM (the packet buffer area); the
+// other ones share it, but still get their own fill and completion rings, so
+// that each queue can be served by a different worker without locking.
+class XskSocket {
+ public:
+  struct Config {
+    int ifindex;
+    uint32_t queue_id;
+    uint32_t rx_size;    // 0: no RX ring
+    uint32_t tx_size;    // 0: no TX ring
+    uint32_t fill_size;  // (ring sizes must be powers of 2)
+    uint32_t comp_size;
+    uint16_t bind_flags;  // XDP_COPY, XDP_ZEROCOPY, XDP_USE_NEED_WAKEUP
+  };
+
+  struct Umem {
+    void *addr;
+    uint64_t len;
+    uint32_t chunk_size;
+    uint32_t headroom;
+    uint32_t flags;  // XDP_UMEM_UNALIGNED_CHUNK_FLAG
+  };
+
+  XskSocket() : fd_(-1), rx(), tx(), fill(), comp() {}
+  ~XskSocket() { Close(); }
+
+  // Opens the socket, registering `umem` or, if `shared_fd` is not -1,
+  // sharing the UMEM of that socket.  Returns 0 or a negative errno value.
+  int Open(const Config &config, const Umem &umem, int shared_fd = -1);
+
+  void Close();
+
+  // Enables busy polling of the underlying device queue from the
+  // application (SO_PREFER_BUSY_POLL).  Returns 0 or a negative errno value.
+  int SetBusyPoll(uint32_t usecs, uint32_t budget);
+
+  // Nudges the kernel to process the TX ring, or to refill RX from the fill
+  // ring (and, with busy polling, to run the device's NAPI loop).
+  void KickTx();
+  void KickRx();
+
+  // Returns 0 and fills in `stats`, or a negative errno value.
+  int GetStats(struct xdp_statistics *stats) const;
+
+  int fd() const { return fd_; }
+
+ private:
+  template <typename T>
+  int MapRing(XskRing<T> *ring, const struct xdp_ring_offset &off,
+              uint32_t size, uint64_t pgoff);
+
+  template <typename T>
+  void UnmapRing(XskRing<T> *ring);
+
+  int fd_;
+
+ public:
+  // The rings are used directly by the port driver on the datapath.
+  XskRing<struct xdp_desc> rx;
+  XskRing<struct xdp_desc> tx;
+  XskRing<uint64_t> fill;
+  XskRing<uint64_t> comp;
+};
+
+// A minimal XDP program, attached to a network interface, that steers packets
+// from queue N to the AF_XDP socket registered for queue N, and passes
+// everything else to the kernel stack as usual.  Built and loaded with the
+// bpf(2) system call only, so that no libbpf/libxdp is required.
+class XdpRedirectProgram {
+ public:
+  XdpRedirectProgram() : map_fd_(-1), prog_fd_(-1), link_fd_(-1) {}
+  ~XdpRedirectProgram() { Detach(); }
+
+  // Attaches to `ifindex` with `xdp_flags` (XDP_FLAGS_SKB_MODE,
+  // XDP_FLAGS_DRV_MODE, or 0 to let the kernel choose), for queues
+  // [0, num_queues).  Returns 0 or a negative errno value.
+  int Attach(int ifindex, uint32_t num_queues, uint32_t xdp_flags);
+
+  // Steers queue `queue_id` to socket `xsk_fd`.
+  int Register(uint32_t queue_id, int xsk_fd);
+
+  void Detach();
+
+ private:
+  int map_fd_;
+  int prog_fd_;
+  int link_fd_;
+};
+
+}  // namespace utils
+}  // namespace bess
+
+#endif  // BESS_UTILS_XSK_H_
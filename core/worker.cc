@@ -38,8 +38,13 @@
 
 #include <glog/logging.h>
 #include <rte_config.h>
+#include <rte_cpuflags.h>
+#include <rte_interrupts.h>
 #include <rte_lcore.h>
+#include <rte_pause.h>
+#include <rte_power_intrinsics.h>
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
 #include <cstring>
@@ -51,6 +56,7 @@
 #include "module.h"
 #include "opts.h"
 #include "packet_pool.h"
+#include "port.h"
 #include "resume_hook.h"
 #include "resume_hooks/metadata.h"
 #include "scheduler.h"
@@ -60,6 +66,7 @@
 using bess::DefaultScheduler;
 using bess::ExperimentalScheduler;
 using bess::Scheduler;
+using bess::WorkStealingScheduler;
 
 int num_workers = 0;
 std::thread worker_threads[Worker::kMaxWorkers];
@@ -78,8 +85,12 @@ struct thread_arg {
   int wid;
   int core;
   Scheduler *scheduler;
+  IdlePolicy idle_policy;
 };
 
+// The shortest back-off step, in cycles.
+static const uint64_t kMinBackoffCycles = 256;
+
 #define SYS_CPU_DIR "/sys/devices/system/cpu/cpu%u"
 #define CORE_ID_FILE "topology/core_id"
 
@@ -158,6 +169,10 @@ void attach_orphans() {
     Worker *w;
 
     int wid = tc.first;
+    if (wid == Worker::kAnyWorker && WorkStealingScheduler::AddStealable(c)) {
+      continue;
+    }
+
     if (wid == Worker::kAnyWorker || workers[wid] == nullptr) {
       w = get_next_active_worker();
     } else {
@@ -168,6 +183,8 @@ void attach_orphans() {
   }
 
   orphan_tcs.clear();
+
+  WorkStealingScheduler::Redistribute();
 }
 
 void resume_all_workers() {
@@ -183,6 +200,21 @@ void resume_all_workers() {
 }
 
 void destroy_worker(int wid) {
+  // Other work-stealing workers may be stealing from this worker's deque, so
+  // they must stay paused until its stealable leaves have been handed over.
+  std::list<int> peers_paused;
+  bool work_stealing =
+      workers[wid] &&
+      dynamic_cast<WorkStealingScheduler *>(workers[wid]->scheduler());
+  if (work_stealing) {
+    for (int i = 0; i < Worker::kMaxWorkers; i++) {
+      if (i != wid && is_worker_running(i)) {
+        pause_worker(i);
+        peers_paused.push_back(i);
+      }
+    }
+  }
+
   pause_worker(wid);
 
   if (workers[wid] && workers[wid]->status() == WORKER_PAUSED) {
@@ -200,6 +232,13 @@ void destroy_worker(int wid) {
     num_workers--;
   }
 
+  if (work_stealing) {
+    WorkStealingScheduler::Redistribute();
+    for (int i : peers_paused) {
+      resume_worker(i);
+    }
+  }
+
   if (num_workers > 0) {
     return;
   }
@@ -257,6 +296,10 @@ int Worker::BlockWorker() {
   worker_signal t;
   int ret;
 
+  // Ports may go away while we are paused.
+  ClearRxInterruptQueues();
+  ResetIdle();
+
   status_ = WORKER_PAUSED;
 
   ret = read(fd_event_, &t, sizeof(t));
@@ -276,6 +319,103 @@ int Worker::BlockWorker() {
   return 0;
 }
 
+uint64_t Worker::Idle(uint64_t cycles, uint64_t now) {
+  idle_cycles_ += cycles;
+
+  // Poll all tasks for a while between two back-off steps, so that a packet
+  // waits at most one step (max_sleep_us) plus poll_rounds task runs.
+  if (max_backoff_cycles_ == 0 || ++idle_rounds_ % idle_policy_.poll_rounds) {
+    return now;
+  }
+
+  if (backoff_cycles_ < max_backoff_cycles_) {
+    backoff_cycles_ = std::max(kMinBackoffCycles, backoff_cycles_ << 1);
+    backoff_cycles_ = std::min(max_backoff_cycles_, backoff_cycles_);
+  }
+
+  bool all_intr = num_rx_intr_queues_ > 0;
+  for (int i = 0; i < num_rx_intr_queues_; i++) {
+    all_intr &= rx_intr_queues_[i].supported;
+  }
+
+  if (idle_policy_.rx_interrupt && all_intr &&
+      backoff_cycles_ == max_backoff_cycles_) {
+    WaitRxInterrupt((idle_policy_.max_sleep_us + 999) / 1000);
+  } else {
+    uint64_t until = now + backoff_cycles_;
+    if (power_pause_) {
+      // May return early, e.g., on interrupts. That is fine.
+      rte_power_pause(until);
+    } else {
+      while (rdtsc() < until) {
+        rte_pause();
+      }
+    }
+  }
+
+  uint64_t after = rdtsc();
+  idle_cycles_ += after - now;
+  idle_sleep_cycles_ += after - now;
+  return after;
+}
+
+void Worker::AddRxInterruptQueue(Port *port, uint8_t qid) {
+  for (int i = 0; i < num_rx_intr_queues_; i++) {
+    if (rx_intr_queues_[i].port == port && rx_intr_queues_[i].qid == qid) {
+      return;
+    }
+  }
+
+  if (num_rx_intr_queues_ == kMaxRxInterruptQueues) {
+    LOG_FIRST_N(WARNING, 1) << "Worker " << wid_ << ": too many RX queues "
+                            << "for RX interrupts, " << port->name() << ":"
+                            << static_cast<int>(qid) << " is ignored";
+    return;
+  }
+
+  RxInterruptQueue *q = &rx_intr_queues_[num_rx_intr_queues_++];
+  q->port = port;
+  q->qid = qid;
+  q->supported = true;
+
+  int ret = port->RxInterruptCtl(qid, true, q);
+  if (ret != 0) {
+    // Keep it around, so that we do not retry on every poll, and so that this
+    // worker does not wait for interrupts that will never come.
+    VLOG(1) << "Worker " << wid_ << ": no RX interrupt for " << port->name()
+            << ":" << static_cast<int>(qid) << ": " << strerror(-ret);
+    q->supported = false;
+  }
+}
+
+void Worker::WaitRxInterrupt(int timeout_ms) {
+  rte_epoll_event events[kMaxRxInterruptQueues];
+
+  for (int i = 0; i < num_rx_intr_queues_; i++) {
+    rx_intr_queues_[i].port->EnableRxInterrupt(rx_intr_queues_[i].qid, true);
+  }
+
+  int n = rte_epoll_wait(RTE_EPOLL_PER_THREAD, events, num_rx_intr_queues_,
+                         timeout_ms);
+  if (n > 0) {
+    rx_interrupt_wakeups_++;
+  }
+
+  for (int i = 0; i < num_rx_intr_queues_; i++) {
+    rx_intr_queues_[i].port->EnableRxInterrupt(rx_intr_queues_[i].qid, false);
+  }
+}
+
+void Worker::ClearRxInterruptQueues() {
+  for (int i = 0; i < num_rx_intr_queues_; i++) {
+    if (rx_intr_queues_[i].supported) {
+      rx_intr_queues_[i].port->RxInterruptCtl(rx_intr_queues_[i].qid, false,
+                                              nullptr);
+    }
+  }
+  num_rx_intr_queues_ = 0;
+}
+
 /* The entry point of worker threads */
 void *Worker::Run(void *_arg) {
   struct thread_arg *arg = (struct thread_arg *)_arg;
@@ -307,9 +447,24 @@ void *Worker::Run(void *_arg) {
 
   scheduler_ = arg->scheduler;
 
+  idle_policy_ = arg->idle_policy;
+  if (idle_policy_.poll_rounds == 0) {
+    idle_policy_.poll_rounds = kDefaultIdlePollRounds;
+  }
+  max_backoff_cycles_ = idle_policy_.max_sleep_us * (tsc_hz / 1000000);
+
+  rte_cpu_intrinsics intrinsics = {};
+  rte_cpu_get_intrinsics_support(&intrinsics);
+  power_pause_ = intrinsics.power_pause;
+
   current_tsc_ = rdtsc();
 
-  packet_pool_ = bess::PacketPool::GetDefaultPool(socket_);
+  if (FLAGS_worker_buffers > 0) {
+    packet_pool_ = bess::PacketPool::GetOrCreateWorkerPool(
+        wid_, socket_, FLAGS_worker_buffers);
+  } else {
+    packet_pool_ = bess::PacketPool::GetDefaultPool(socket_);
+  }
   CHECK_NOTNULL(packet_pool_);
 
   status_ = WORKER_PAUSING;
@@ -343,12 +498,18 @@ void *run_worker(void *_arg) {
 }
 
 void launch_worker(int wid, int core,
-                   [[maybe_unused]] const std::string &scheduler) {
-  struct thread_arg arg = {.wid = wid, .core = core, .scheduler = nullptr};
+                   [[maybe_unused]] const std::string &scheduler,
+                   const IdlePolicy &idle_policy) {
+  struct thread_arg arg = {.wid = wid,
+                           .core = core,
+                           .scheduler = nullptr,
+                           .idle_policy = idle_policy};
   if (scheduler == "") {
     arg.scheduler = new DefaultScheduler();
   } else if (scheduler == "experimental") {
     arg.scheduler = new ExperimentalScheduler();
+  } else if (scheduler == "work_stealing") {
+    arg.scheduler = new WorkStealingScheduler();
   } else {
     CHECK(false) << "Scheduler " << scheduler << " is invalid.";
   }
@@ -419,6 +580,11 @@ bool detach_tc(bess::TrafficClass *c) {
     }
   }
 
+  // Try to remove from the leaves shared by work-stealing workers
+  if (WorkStealingScheduler::RemoveStealable(c)) {
+    return true;
+  }
+
   // Try to remove from orphan_tcs
   return remove_tc_from_orphan(c);
 }
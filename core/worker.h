@@ -73,12 +73,33 @@ class PacketPool;
 }  // namespace bess
 
 class Task;
+class Port;
+
+// How a worker backs off when its tasks keep finding no work. See
+// Worker::Idle(). A zero-initialized policy keeps the worker busy-polling.
+struct IdlePolicy {
+  // Consecutive task runs without any packet before the worker starts
+  // backing off. 0 means kDefaultIdlePollRounds.
+  uint32_t poll_rounds;
+
+  // Upper bound of a single back-off step, i.e., of the extra wake-up latency
+  // the worker may add. 0 disables backing off.
+  uint32_t max_sleep_us;
+
+  // Once fully backed off, sleep until a packet arrives on one of the RX
+  // queues this worker polls (see Worker::AddRxInterruptQueue()), or until
+  // max_sleep_us has passed (rounded up to a millisecond).
+  bool rx_interrupt;
+};
 
 class Worker {
  public:
   static const int kMaxWorkers = 64;
   static const int kAnyWorker = -1;  // unspecified worker ID
 
+  static const uint32_t kDefaultIdlePollRounds = 1024;
+  static const int kMaxRxInterruptQueues = 32;
+
   /* ----------------------------------------------------------------------
    * functions below are invoked by non-worker threads (the master)
    * ---------------------------------------------------------------------- */
@@ -119,7 +140,48 @@ class Worker {
 
   Random *rand() const { return rand_; }
 
+  const IdlePolicy &idle_policy() const { return idle_policy_; }
+
+  // Cycles spent in task runs that found no work, plus idle_sleep_cycles().
+  uint64_t idle_cycles() const { return idle_cycles_; }
+  // Cycles spent backing off (pausing or waiting for RX interrupts).
+  uint64_t idle_sleep_cycles() const { return idle_sleep_cycles_; }
+  // Number of times the worker woke up from an RX interrupt wait.
+  uint64_t rx_interrupt_wakeups() const { return rx_interrupt_wakeups_; }
+
+  // Called by the scheduler after a task run that handled some packets.
+  void ResetIdle() {
+    if (idle_rounds_) {
+      idle_rounds_ = 0;
+      backoff_cycles_ = 0;
+    }
+  }
+
+  // Called by the scheduler after a task run (or a round without any runnable
+  // task) that took 'cycles' cycles and found no work. Backs off according to
+  // the idle policy once the worker has been idle long enough. Returns the
+  // current TSC, which is 'now' unless the worker slept.
+  uint64_t Idle(uint64_t cycles, uint64_t now);
+
+  // Tells the worker that it polls RX queue 'qid' of 'port', so that it can
+  // wait for RX interrupts from it when idle. Called by tasks that poll ports
+  // when they find the queue empty, only if idle_policy().rx_interrupt is set.
+  void AddRxInterruptQueue(Port *port, uint8_t qid);
+
  private:
+  struct RxInterruptQueue {
+    Port *port;
+    uint8_t qid;
+    bool supported;  // false if the port cannot raise RX interrupts
+  };
+
+  // Sleeps until an RX interrupt or 'timeout_ms' elapses.
+  void WaitRxInterrupt(int timeout_ms);
+
+  // Unregisters all RX interrupt queues. Must be called by this worker's
+  // thread, since the epoll instance is per thread.
+  void ClearRxInterruptQueues();
+
   volatile worker_status_t status_;
 
   int wid_;   // always [0, kMaxWorkers - 1]
@@ -137,6 +199,18 @@ class Worker {
   uint64_t current_ns_;
 
   Random *rand_;
+
+  IdlePolicy idle_policy_;
+  bool power_pause_;  // whether rte_power_pause() (TPAUSE) is available
+  uint64_t max_backoff_cycles_;
+  uint64_t idle_rounds_;
+  uint64_t backoff_cycles_;
+  uint64_t idle_cycles_;
+  uint64_t idle_sleep_cycles_;
+  uint64_t rx_interrupt_wakeups_;
+
+  RxInterruptQueue rx_intr_queues_[kMaxRxInterruptQueues];
+  int num_rx_intr_queues_;
 };
 
 // NOTE: Do not use "thread_local" here. It requires a function call every time
@@ -188,8 +262,9 @@ inline bool is_worker_running(int wid) {
 }
 
 // arg (int) is the core id the worker should run on, and optionally the
-// scheduler to use.
-void launch_worker(int wid, int core, const std::string &scheduler = "");
+// scheduler and the idle policy to use.
+void launch_worker(int wid, int core, const std::string &scheduler = "",
+                   const IdlePolicy &idle_policy = IdlePolicy());
 
 Worker *get_next_active_worker();
 
@@ -419,6 +419,40 @@ class BESS(object):
         request.name = name
         return self._request('GetLinkStatus', request)
 
+    def run_port_command(self, name, cmd, arg_type, arg):
+        request = bess_msg.CommandRequest()
+        request.name = name
+        request.cmd = cmd
+
+        # Driver-specific types, or generic ones like EmptyArg
+        message_type = getattr(port_msg, arg_type,
+                               getattr(module_pb, arg_type, None))
+        if message_type is None:
+            raise self.APIError('Unknown arg "%s"' % arg_type)
+
+        try:
+            arg_msg = pb_conv.dict_to_protobuf(message_type, arg)
+        except (KeyError, ValueError) as e:
+            raise self.APIError(e)
+
+        request.arg.Pack(arg_msg)
+
+        try:
+            response = self._request('PortCommand', request)
+        except self.Error as e:
+            e.info.update(port=name, command=cmd, command_arg=arg)
+            raise
+
+        if response.HasField('data'):
+            response_type_str = response.data.type_url.split('.')[-1]
+            response_type = getattr(port_msg, response_type_str,
+                                    module_msg.EmptyArg)
+            result = response_type()
+            response.data.Unpack(result)
+            return result
+        else:
+            return response
+
     def import_plugin(self, path):
         request = bess_msg.ImportPluginRequest()
         request.path = path
@@ -563,8 +597,9 @@ class BESS(object):
 
         if response.HasField('data'):
             response_type_str = response.data.type_url.split('.')[-1]
-            response_type = getattr(module_pb, response_type_str,
-                                    module_msg.EmptyArg)
+            # Hook responses live in bess_msg, not in the module protos
+            response_type = getattr(module_pb, response_type_str, None) or \
+                getattr(bess_msg, response_type_str, module_msg.EmptyArg)
             result = response_type()
             response.data.Unpack(result)
             return result
@@ -602,10 +637,20 @@ class BESS(object):
         request.arg.Pack(arg)
         return self._request('ConfigureResumeHook', request)
 
-    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def tcpdump_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                     async_mode=False, ring_size=0, filter=None,
+                     sample_every=0, max_pps=0, snaplen=0):
         arg = bess_msg.TcpdumpArg()
         if fifo is not None:
             arg.fifo = fifo
+        # 'async' is a Python keyword
+        setattr(arg, 'async', async_mode)
+        arg.ring_size = ring_size
+        if filter is not None:
+            arg.filter = filter
+        arg.sample_every = sample_every
+        arg.max_pps = max_pps
+        arg.snaplen = snaplen
         return self._configure_gate_hook('TcpDump', name, m, arg, enable,
                                          direction, gate)
 
@@ -616,21 +661,35 @@ class BESS(object):
         return self._configure_gate_hook('Track', name, m, arg, enable,
                                          direction, gate)
 
-    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None):
+    def pcapng_gate(self, enable, name, m, direction='out', gate=0, fifo=None,
+                    async_mode=False, ring_size=0, filter=None, sample_every=0,
+                    max_pps=0, snaplen=0):
         arg = bess_msg.PcapngArg()
         if fifo is not None:
             arg.fifo = fifo
+        # 'async' is a Python keyword
+        setattr(arg, 'async', async_mode)
+        arg.ring_size = ring_size
+        if filter is not None:
+            arg.filter = filter
+        arg.sample_every = sample_every
+        arg.max_pps = max_pps
+        arg.snaplen = snaplen
         return self._configure_gate_hook('PcapNg', name, m, arg, enable,
                                          direction, gate)
 
     def list_workers(self):
         return self._request('ListWorkers')
 
-    def add_worker(self, wid, core, scheduler=None):
+    def add_worker(self, wid, core, scheduler=None, max_idle_sleep_us=0,
+                   idle_poll_rounds=0, rx_interrupt=False):
         request = bess_msg.AddWorkerRequest()
         request.wid = wid
         request.core = core
         request.scheduler = scheduler or ''
+        request.max_idle_sleep_us = max_idle_sleep_us
+        request.idle_poll_rounds = idle_poll_rounds
+        request.rx_interrupt = rx_interrupt
         return self._request('AddWorker', request)
 
     def destroy_worker(self, wid):
@@ -738,7 +797,14 @@ class BESS(object):
         request.name = name
         return self._request('GetTcStats', request)
 
-    def dump_mempool(self, socket=-1):
+    def get_module_profile(self, names=None, reset=False):
+        request = bess_msg.GetModuleProfileRequest()
+        request.names.extend(names or [])
+        request.reset = reset
+        return self._request('GetModuleProfile', request)
+
+    def dump_mempool(self, socket=-1, reset_stats=False):
         request = bess_msg.DumpMempoolRequest()
         request.socket = socket
+        request.reset_stats = reset_stats
         return self._request('DumpMempool', request)
@@ -30,6 +30,14 @@
 # ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
 # POSSIBILITY OF SUCH DAMAGE.
 
+import types
+
+
+def _callback_factory(self, cmd, arg_type):
+    return lambda port, **kwargs: \
+        self.bess.run_port_command(self.name, cmd, arg_type, kwargs)
+
+
 class Port(object):
 
     def __init__(self, **kwargs):
@@ -46,6 +54,13 @@ class Port(object):
         self.name = ret.name
         self.mac_addr = ret.mac_addr
 
+        # add driver-specific methods
+        info = self.bess.get_driver_info(self.driver)
+        assert len(info.commands) == len(info.cmd_args)
+        for cmd, arg_type in zip(info.commands, info.cmd_args):
+            func = _callback_factory(self, cmd, arg_type)
+            setattr(self, cmd, types.MethodType(func, self))
+
     def __str__(self):
         return '%s/%s' % (self.name, self.driver)
 
@@ -58,6 +58,10 @@ class DummyServiceImpl(service_pb2_grpc.BESSControlServicer):
         response = bess_msg.CommandResponse()
         return response
 
+    def PortCommand(self, request, context):
+        response = bess_msg.CommandResponse()
+        return response
+
     def ListModules(self, request, context):
         response = bess_msg.ListModulesResponse()
         return response
@@ -150,3 +154,15 @@ class TestBESS(unittest.TestCase):
                                              {'gate': 0,
                                                  'fields': [{'value_bin': b'\x11'}, {'value_bin': b'\x22'}]})
         self.assertEqual(0, response.error.code)
+
+    def test_run_port_command(self):
+        client = bess.BESS()
+        client.connect(grpc_url=self.GRPC_URL)
+
+        response = client.run_port_command('p0',
+                                           'add_flow_rule',
+                                           'PMDPortFlowRuleArg',
+                                           {'gtpu': True,
+                                            'gtpu_msg_type': 1,
+                                            'queue': 3})
+        self.assertEqual(0, response.error.code)